@@ -1,21 +1,74 @@
 {
+  "variables": {
+    "ptz_include_dirs": [
+      "/usr/include/",
+      "/usr/include/libusb-1.0",
+      "/usr/local/include",
+      "/usr/local/include/libuvc",
+      "/usr/local/Cellar/libuvc/0.0.5/include",
+      "/usr/local/Cellar/libuvc/0.0.5/include/libuvc",
+      "/usr/local/Cellar/libusb/1.0.21/include",
+      "/usr/local/Cellar/libusb/1.0.21/include/libusb-1.0"
+    ],
+    "ptz_device_sources": [
+      "lib/command.cpp",
+      "lib/control.cpp",
+      "lib/device.cpp",
+      "lib/device_index.cpp",
+      "lib/error.cpp",
+      "lib/estimator.cpp",
+      "lib/group.cpp",
+      "lib/mapped_file.cpp",
+      "lib/pointing.cpp",
+      "lib/preset.cpp",
+      "lib/profile.cpp",
+      "lib/realtime.cpp",
+      "lib/recorder.cpp",
+      "lib/session.cpp",
+      "lib/simulator.cpp",
+      "lib/stats.cpp",
+      "lib/timer_wheel.cpp",
+      "lib/tour.cpp",
+      "lib/tracker.cpp",
+      "lib/velocity.cpp",
+      "lib/warm_cache.cpp",
+      "lib/watchdog.cpp"
+    ]
+  },
   "targets": [
     {
       "target_name": "ptz",
-      "sources": ["lib/ptz.cpp"],
-      "libraries": ["-luvc"],
+      "sources": ["lib/ptz.cpp", "<@(ptz_device_sources)"],
+      "libraries": ["-luvc", "-lusb-1.0"],
       "cflags": ["-std=c++17 -g -Wno-cast-function-type"],
       "include_dirs": [
         "<!(node -e \"require('nan')\")",
-        "/usr/include/",
-        "/usr/include/libusb-1.0",
-        "/usr/local/include",
-        "/usr/local/include/libuvc",
-        "/usr/local/Cellar/libuvc/0.0.5/include",
-        "/usr/local/Cellar/libuvc/0.0.5/include/libuvc",
-        "/usr/local/Cellar/libusb/1.0.21/include",
-        "/usr/local/Cellar/libusb/1.0.21/include/libusb-1.0"
+        "<@(ptz_include_dirs)"
       ]
+    },
+    {
+      "target_name": "ptzctl",
+      "type": "executable",
+      "sources": ["lib/ptzctl.cpp", "<@(ptz_device_sources)"],
+      "libraries": ["-luvc", "-lusb-1.0", "-lpthread"],
+      "cflags": ["-std=c++17 -g"],
+      "include_dirs": ["<@(ptz_include_dirs)"]
+    },
+    {
+      "target_name": "ptzd",
+      "type": "executable",
+      "sources": ["lib/ptzd.cpp", "lib/ipc.cpp", "<@(ptz_device_sources)"],
+      "libraries": ["-luvc", "-lusb-1.0", "-lpthread"],
+      "cflags": ["-std=c++17 -g"],
+      "include_dirs": ["<@(ptz_include_dirs)"]
+    },
+    {
+      "target_name": "alloc_test",
+      "type": "executable",
+      "sources": ["test/alloc.cpp", "<@(ptz_device_sources)"],
+      "libraries": ["-luvc", "-lusb-1.0", "-lpthread"],
+      "cflags": ["-std=c++17 -g"],
+      "include_dirs": ["lib", "<@(ptz_include_dirs)"]
     }
   ]
 }
@@ -1,21 +1,188 @@
 "use strict";
+const EventEmitter = require("events");
 const ptz = require("../build/Release/ptz");
+const CommandStream = require("./stream");
+const Tracker = require("./tracker");
+const VelocityChannel = require("./velocity");
 
-class Camera {
+class Camera extends EventEmitter {
   constructor(options) {
+    super();
     this.vendorId = options.vendorId;
     this.productId = options.productId;
+    // with several identical cameras attached, either one picks which
+    this.serialNumber = options.serialNumber;
+    this.port = options.port;
+    this.simulated = !!options.simulated;
+    this.async = !!options.async;
+    // a camera reached through ptzd, whose commands are always async
+    this.client = options.client;
+
+    // backpressure for async cameras: once this many commands are pending,
+    // backpressure is set until the camera's queue empties and emits "drain"
+    this.highWaterMark = options.highWaterMark || 16;
+    this.pending = 0;
+    this.backpressure = false;
   }
 
   execute(functionName, input) {
     if (!input) {
       input = {};
     }
-    input.vendorId = this.vendorId;
-    input.productId = this.productId;
+    Object.assign(input, this.identity());
+    if (this.client) {
+      return this.queue((callback) => this.client.execute(functionName, input, callback));
+    }
+    if (this.async) {
+      return this.queue((callback) => ptz.executeAsync(functionName, input, callback));
+    }
     return ptz[functionName](input);
   }
 
+  // submit(callback) queues work on the camera's thread and returns the
+  // pending count, the callback gets (err, result, pending)
+  queue(submit) {
+    return new Promise((resolve, reject) => {
+      this.pending = submit((err, result, pending) => {
+        this.pending = pending;
+        if (this.backpressure && pending === 0) {
+          this.backpressure = false;
+          this.emit("drain");
+        }
+        if (err) {
+          return reject(err);
+        }
+        resolve(result);
+      });
+      if (this.pending >= this.highWaterMark) {
+        this.backpressure = true;
+      }
+    });
+  }
+
+  identity() {
+    return {
+      vendorId: this.vendorId,
+      productId: this.productId,
+      serialNumber: this.serialNumber,
+      port: this.port,
+      simulated: this.simulated,
+    };
+  }
+
+  configure(options) {
+    return ptz.configureCamera(Object.assign({}, options, this.identity()));
+  }
+
+  getStats() {
+    return ptz.getCameraStats(this.identity());
+  }
+
+  // fails every command queued for the camera in this process with
+  // UVC_ERROR_INTERRUPTED and aborts the ones on the bus, returning how many
+  // queued commands were dropped
+  cancel() {
+    return ptz.cancelCamera(this.identity());
+  }
+
+  // { pan, tilt, zoom, panError, tiltError, zoomError, confidence, moving,
+  // ageMs } estimated from the last read and the moves sent since, without
+  // touching the usb bus
+  getPosition() {
+    return ptz.estimatePosition(this.identity());
+  }
+
+  // drives the camera through its speeds on every axis and back again,
+  // resolving with the measured profile. the camera's speed model uses it
+  // from then on, and it is saved when a profile store is open. options are
+  // speeds per axis, moveMs per measuring move and sampleMs between reads.
+  calibrate(options) {
+    const input = Object.assign({}, options, this.identity());
+    return this.queue((callback) => ptz.calibrateCamera(input, callback));
+  }
+
+  // the stored profile for this camera, or another of the same model, or null
+  getProfile() {
+    return ptz.getProfile(this.identity());
+  }
+
+  openVelocity(options) {
+    return new VelocityChannel(Object.assign({}, options, this.identity()));
+  }
+
+  // an object mode Writable of { command, ...args }, see stream.js.
+  // options are those of a Writable, highWaterMark defaults to the camera's.
+  createWriteStream(options) {
+    return new CommandStream(this, options);
+  }
+
+  openTracker(options) {
+    return new Tracker(Object.assign({}, options, this.identity()));
+  }
+
+  // position is { pan, tilt, zoom }, the camera's current position is
+  // stored for anything left out
+  savePreset(name, position) {
+    return ptz.savePreset(Object.assign({}, position, { name }, this.identity()));
+  }
+
+  getPreset(name) {
+    return ptz.getPreset(Object.assign({ name }, this.identity()));
+  }
+
+  deletePreset(name) {
+    return ptz.deletePreset(Object.assign({ name }, this.identity()));
+  }
+
+  listPresets() {
+    return ptz.listPresets(this.identity());
+  }
+
+  recallPreset(name, options) {
+    const input = Object.assign({}, options, { name }, this.identity());
+    if (this.async) {
+      return this.queue((callback) => ptz.recallPreset(input, callback));
+    }
+    return ptz.recallPreset(input);
+  }
+
+  // x, y from 0, 0 at the top left of the picture to 1, 1 at the bottom right
+  centerOn(x, y) {
+    const input = Object.assign({ x, y }, this.identity());
+    if (this.async) {
+      return this.queue((callback) => ptz.centerOn(input, callback));
+    }
+    return ptz.centerOn(input);
+  }
+
+  // points is a Float64Array or array of x, y pairs, answered with pan, tilt
+  // pairs for the camera as it is now
+  pointsToPanTilt(points) {
+    return ptz.pointsToPanTilt(Object.assign({ points }, this.identity()));
+  }
+
+  // stops are { preset } or { pan, tilt, zoom }, each with dwellMs and an
+  // optional moveMs for a smooth move. options are laps and resumeAfterMs.
+  startTour(stops, options) {
+    return ptz.startTour(Object.assign({}, options, { stops }, this.identity()));
+  }
+
+  pauseTour() {
+    return ptz.pauseTour(this.identity());
+  }
+
+  resumeTour() {
+    return ptz.resumeTour(this.identity());
+  }
+
+  stopTour() {
+    return ptz.stopTour(this.identity());
+  }
+
+  getTourStats() {
+    return ptz.getTourStats(this.identity());
+  }
+
   getCapabilities() {
     return this.execute("getCapabilities");
   }
@@ -24,9 +191,13 @@ class Camera {
     return this.execute("getAbsoluteZoom");
   }
 
-  absoluteZoom(zoom) {
+  // options are force, to send it even when the camera was already told,
+  // and timeoutMs, a deadline for this command in place of the camera's
+  absoluteZoom(zoom, options) {
     return this.execute("absoluteZoom", {
       zoom,
+      force: !!(options && options.force),
+      timeoutMs: options && options.timeoutMs,
     });
   }
 
@@ -59,10 +230,12 @@ class Camera {
     return this.execute("getAbsolutePanTilt");
   }
 
-  absolutePanTilt(pan, tilt) {
+  absolutePanTilt(pan, tilt, options) {
     return this.execute("absolutePanTilt", {
       pan,
       tilt,
+      force: !!(options && options.force),
+      timeoutMs: options && options.timeoutMs,
     });
   }
 
@@ -78,6 +251,30 @@ class Camera {
       tiltSpeed,
     });
   }
+
+  // any camera terminal control by its name in control.h, e.g.
+  // getControl("focusAbsolute") answers { focus }
+  getControl(control) {
+    return this.execute("getControl", { control });
+  }
+
+  // values names the control's fields, e.g. { roll: 90 } for "rollAbsolute"
+  setControl(control, values, options) {
+    return this.execute(
+      "setControl",
+      Object.assign({}, values, {
+        control,
+        force: !!(options && options.force),
+        timeoutMs: options && options.timeoutMs,
+      })
+    );
+  }
+
+  // { min, max, resolution, default }, each the control's fields or null
+  // when the camera doesn't report it
+  getRanges(control) {
+    return this.execute("getRanges", { control });
+  }
 }
 
 module.exports = Camera;
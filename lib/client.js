@@ -0,0 +1,290 @@
+"use strict";
+const net = require("net");
+const Camera = require("./camera");
+
+// ptzd's wire protocol, laid out in ipc.h. ops, argument names and result
+// names follow command.cpp and the addon's results.
+const COMMAND_FORCE = 1;
+const SERIAL_SIZE = 64;
+const PORT_SIZE = 32;
+
+const commands = [
+  {
+    name: "getCapabilities",
+    args: [],
+    results: [
+      "absoluteZoom",
+      "relativeZoom",
+      "absolutePanTilt",
+      "relativePanTilt",
+      "absoluteRoll",
+      "relativeRoll",
+    ],
+    booleans: 0b111111,
+  },
+  {
+    name: "getAbsoluteZoom",
+    args: [],
+    results: ["min", "max", "resolution", "current", "default"],
+  },
+  { name: "absoluteZoom", args: ["zoom"], results: [] },
+  {
+    name: "getRelativeZoom",
+    args: [],
+    results: [
+      "direction",
+      "digitalZoom",
+      "minSpeed",
+      "maxSpeed",
+      "resolutionSpeed",
+      "currentSpeed",
+      "defaultSpeed",
+    ],
+    booleans: 0b10,
+  },
+  { name: "relativeZoom", args: ["direction", "speed"], results: [] },
+  {
+    name: "getAbsolutePanTilt",
+    args: [],
+    results: [
+      "minPan",
+      "minTilt",
+      "maxPan",
+      "maxTilt",
+      "resolutionPan",
+      "resolutionTilt",
+      "currentPan",
+      "currentTilt",
+      "defaultPan",
+      "defaultTilt",
+    ],
+  },
+  { name: "absolutePanTilt", args: ["pan", "tilt"], results: [] },
+  {
+    name: "getRelativePanTilt",
+    args: [],
+    results: [
+      "panDirection",
+      "tiltDirection",
+      "minPanSpeed",
+      "minTiltSpeed",
+      "maxPanSpeed",
+      "maxTiltSpeed",
+      "resolutionPanSpeed",
+      "resolutionTiltSpeed",
+      "defaultPanSpeed",
+      "defaultTiltSpeed",
+      "currentPanSpeed",
+      "currentTiltSpeed",
+    ],
+  },
+  {
+    name: "relativePanTilt",
+    args: ["panDirection", "panSpeed", "tiltDirection", "tiltSpeed"],
+    results: [],
+  },
+];
+
+// control.h's table, each control becoming getControl, setControl and
+// getRanges in turn after the dedicated commands
+const controls = [
+  { name: "scanningMode", fields: ["mode"] },
+  { name: "autoExposureMode", fields: ["mode"] },
+  { name: "autoExposurePriority", fields: ["priority"] },
+  { name: "exposureTimeAbsolute", fields: ["time"] },
+  { name: "exposureTimeRelative", fields: ["step"] },
+  { name: "focusAbsolute", fields: ["focus"] },
+  { name: "focusRelative", fields: ["direction", "speed"] },
+  { name: "focusAuto", fields: ["auto"] },
+  { name: "irisAbsolute", fields: ["iris"] },
+  { name: "irisRelative", fields: ["step"] },
+  { name: "zoomAbsolute", fields: ["zoom"] },
+  { name: "zoomRelative", fields: ["direction", "digitalZoom", "speed"] },
+  { name: "panTiltAbsolute", fields: ["pan", "tilt"] },
+  { name: "panTiltRelative", fields: ["panDirection", "panSpeed", "tiltDirection", "tiltSpeed"] },
+  { name: "rollAbsolute", fields: ["roll"] },
+  { name: "rollRelative", fields: ["direction", "speed"] },
+  { name: "privacy", fields: ["privacy"] },
+];
+const RANGES = ["min", "max", "resolution", "default"];
+controls.forEach((control) => {
+  commands.push({ name: "getControl", control: control.name, args: [], results: control.fields });
+  commands.push({ name: "setControl", control: control.name, args: control.fields, results: [] });
+  commands.push({
+    name: "getRanges",
+    control: control.name,
+    args: [],
+    results: control.fields,
+    ranges: true,
+  });
+});
+
+// error.cpp's codes by result, so errors carry the same code as the addon's
+const ERROR_CODES = new Map([
+  [-1, "UVC_ERROR_IO"],
+  [-2, "UVC_ERROR_INVALID_PARAM"],
+  [-3, "UVC_ERROR_ACCESS"],
+  [-4, "UVC_ERROR_NO_DEVICE"],
+  [-5, "UVC_ERROR_NOT_FOUND"],
+  [-6, "UVC_ERROR_BUSY"],
+  [-7, "UVC_ERROR_TIMEOUT"],
+  [-8, "UVC_ERROR_OVERFLOW"],
+  [-9, "UVC_ERROR_PIPE"],
+  [-10, "UVC_ERROR_INTERRUPTED"],
+  [-11, "UVC_ERROR_NO_MEM"],
+  [-12, "UVC_ERROR_NOT_SUPPORTED"],
+  [-50, "UVC_ERROR_INVALID_DEVICE"],
+  [-51, "UVC_ERROR_INVALID_MODE"],
+  [-52, "UVC_ERROR_CALLBACK_EXISTS"],
+]);
+
+const commandKey = (name, control) => (control ? `${name}:${control}` : name);
+const ops = new Map(commands.map((command, op) => [commandKey(command.name, command.control), op]));
+
+// getRanges values are the ranges answered, then each range's fields
+function decodeRanges(command, values) {
+  const result = {};
+  const fields = command.results.length;
+  RANGES.forEach((range, i) => {
+    result[range] = null;
+    if (values[0] & (1 << i)) {
+      result[range] = {};
+      command.results.forEach((name, field) => {
+        result[range][name] = values[1 + i * fields + field];
+      });
+    }
+  });
+  return result;
+}
+
+function encodeRequest(id, op, input) {
+  const serial = Buffer.from(input.serialNumber || "").subarray(0, SERIAL_SIZE - 1);
+  const port = Buffer.from(input.port || "").subarray(0, PORT_SIZE - 1);
+  const frame = Buffer.alloc(4 + 28 + 2 + serial.length + port.length);
+  let at = frame.writeUInt32LE(frame.length - 4, 0);
+  at = frame.writeUInt32LE(id, at);
+  at = frame.writeUInt8(op, at);
+  at = frame.writeUInt8(input.force ? COMMAND_FORCE : 0, at);
+  at = frame.writeUInt8(input.simulated ? 1 : 0, at);
+  at = frame.writeUInt8(0, at);
+  at = frame.writeUInt16LE(input.vendorId & 0xffff, at);
+  at = frame.writeUInt16LE(input.productId & 0xffff, at);
+  for (let i = 0; i < 4; i++) {
+    const name = commands[op].args[i];
+    at = frame.writeInt32LE(name ? input[name] | 0 : 0, at);
+  }
+  at = frame.writeUInt8(serial.length, at);
+  at += serial.copy(frame, at);
+  at = frame.writeUInt8(port.length, at);
+  port.copy(frame, at);
+  return frame;
+}
+
+// a connection to ptzd. cameras from getCamera() have the Camera api, with
+// their commands sent to the daemon and always answered with promises.
+class Client {
+  constructor(path) {
+    this.path = path;
+    this.calls = new Map();
+    this.nextId = 1;
+    this.input = Buffer.alloc(0);
+    this.corked = false;
+
+    this.socket = net.createConnection(path);
+    this.socket.on("data", (chunk) => this.receive(chunk));
+    this.socket.on("error", (err) => this.fail(err));
+    this.socket.on("close", () => this.fail(new Error("ptzd connection closed")));
+  }
+
+  getCamera(options) {
+    const input = Object.assign({ vendorId: 0, productId: 0 }, options, { client: this });
+    return new Camera(input);
+  }
+
+  // same contract as the addon's executeAsync: the callback gets (err,
+  // result, pending) and the return is the number of calls out
+  execute(name, input, callback) {
+    const op = ops.has(name) ? ops.get(name) : ops.get(commandKey(name, input.control));
+    if (op === undefined) {
+      throw new Error("unknown command");
+    }
+    const id = this.nextId;
+    this.nextId = (this.nextId + 1) >>> 0 || 1;
+    this.calls.set(id, { op, callback });
+
+    // calls made in the same tick go out in one write
+    if (!this.corked) {
+      this.corked = true;
+      this.socket.cork();
+      process.nextTick(() => {
+        this.corked = false;
+        this.socket.uncork();
+      });
+    }
+    this.socket.write(encodeRequest(id, op, input));
+    return this.calls.size;
+  }
+
+  receive(chunk) {
+    this.input = this.input.length ? Buffer.concat([this.input, chunk]) : chunk;
+    let at = 0;
+    while (this.input.length - at >= 4) {
+      const length = 4 + this.input.readUInt32LE(at);
+      if (this.input.length - at < length) {
+        break;
+      }
+      this.deliver(this.input.subarray(at + 4, at + length));
+      at += length;
+    }
+    this.input = this.input.subarray(at);
+  }
+
+  deliver(body) {
+    const id = body.readUInt32LE(0);
+    const call = this.calls.get(id);
+    if (!call) {
+      return;
+    }
+    this.calls.delete(id);
+
+    const result = body.readInt32LE(4);
+    const pending = body.readUInt32LE(8);
+    const count = body.readUInt8(12);
+    if (result !== 0) {
+      const errorAt = 13 + count * 4;
+      const error = body.toString("utf8", errorAt + 1, errorAt + 1 + body.readUInt8(errorAt));
+      const err = new Error(error || `uvc error ${result}`);
+      err.code = ERROR_CODES.get(result) || "UVC_ERROR_OTHER";
+      return call.callback(err, undefined, pending);
+    }
+    const command = commands[call.op];
+    if (command.results.length === 0) {
+      return call.callback(null, undefined, pending);
+    }
+    if (command.ranges) {
+      const raw = [];
+      for (let i = 0; i < count; i++) {
+        raw.push(body.readInt32LE(13 + i * 4));
+      }
+      return call.callback(null, decodeRanges(command, raw), pending);
+    }
+    const values = {};
+    command.results.forEach((name, i) => {
+      const value = i < count ? body.readInt32LE(13 + i * 4) : 0;
+      values[name] = command.booleans & (1 << i) ? value !== 0 : value;
+    });
+    call.callback(null, values, pending);
+  }
+
+  fail(err) {
+    const calls = this.calls;
+    this.calls = new Map();
+    calls.forEach((call) => call.callback(err, undefined, 0));
+  }
+
+  close() {
+    this.socket.end();
+  }
+}
+
+module.exports = Client;
@@ -0,0 +1,207 @@
+#include "command.h"
+#include <string.h>
+#include <array>
+#include "error.h"
+#include "recorder.h"
+#include "stats.h"
+
+namespace ptz {
+
+// the dedicated commands, then three per control built from its table entry
+static constexpr std::array<struct CommandSpec, CMD_COUNT> buildCommandSpecs() {
+    std::array<struct CommandSpec, CMD_COUNT> specs = {{
+        {"getCapabilities", 0, 1, {NULL, NULL, NULL, NULL}},
+        {"getAbsoluteZoom", 0, 1, {NULL, NULL, NULL, NULL}},
+        {"absoluteZoom", 1, 0, {"zoom", NULL, NULL, NULL}},
+        {"getRelativeZoom", 0, 1, {NULL, NULL, NULL, NULL}},
+        {"relativeZoom", 2, 0, {"direction", "speed", NULL, NULL}},
+        {"getAbsolutePanTilt", 0, 1, {NULL, NULL, NULL, NULL}},
+        {"absolutePanTilt", 2, 0, {"pan", "tilt", NULL, NULL}},
+        {"getRelativePanTilt", 0, 1, {NULL, NULL, NULL, NULL}},
+        {"relativePanTilt", 4, 0, {"panDirection", "panSpeed", "tiltDirection", "tiltSpeed"}},
+    }};
+    for (int control = 0; control < CONTROL_COUNT; control++) {
+        const struct ControlSpec& spec = controlSpecs[control];
+
+        struct CommandSpec get    = {"getControl", 0, 1, {NULL, NULL, NULL, NULL}};
+        struct CommandSpec set    = {"setControl", 0, 0, {NULL, NULL, NULL, NULL}};
+        struct CommandSpec ranges = {"getRanges", 0, 1, {NULL, NULL, NULL, NULL}};
+        set.argCount              = controlFieldCount(spec);
+        for (int i = 0; i < set.argCount; i++) {
+            set.argNames[i] = spec.fields[i].name;
+        }
+        specs[controlOp(control, CONTROL_GET)]    = get;
+        specs[controlOp(control, CONTROL_SET)]    = set;
+        specs[controlOp(control, CONTROL_RANGES)] = ranges;
+    }
+    return specs;
+}
+
+static constexpr std::array<struct CommandSpec, CMD_COUNT> commandSpecs = buildCommandSpecs();
+static_assert(commandSpecs[CMD_CONTROL_BASE - 1].name != NULL, "every command needs a spec");
+
+const struct CommandSpec* commandSpec(int op) {
+    if (op < 0 || op >= CMD_COUNT) {
+        return NULL;
+    }
+    return &commandSpecs[op];
+}
+
+int commandFind(const char* name) {
+    for (int op = 0; op < CMD_CONTROL_BASE; op++) {
+        if (strcmp(commandSpecs[op].name, name) == 0) {
+            return op;
+        }
+    }
+    return -1;
+}
+
+int commandFindControl(const char* name, const char* control) {
+    int index = controlFind(control);
+    if (index < 0) {
+        return -1;
+    }
+    for (int request = 0; request < CONTROL_REQUEST_COUNT; request++) {
+        int op = controlOp(index, request);
+        if (strcmp(commandSpecs[op].name, name) == 0) {
+            return op;
+        }
+    }
+    return -1;
+}
+
+static void executeControl(struct UVCDevice*     uvcDevice,
+                           const struct Command* command,
+                           struct CommandResult* commandResult) {
+    int control = commandControl(command->op);
+    if (control < 0) {
+        commandResult->result = UVC_ERROR_INVALID_PARAM;
+        commandResult->error  = errorMessage(UVC_ERROR_INVALID_PARAM);
+        return;
+    }
+    switch (commandControlRequest(command->op)) {
+        case CONTROL_GET:
+            commandResult->result = controlGet(uvcDevice, control, &commandResult->controlValues);
+            break;
+        case CONTROL_SET: {
+            struct ControlValues values;
+            memcpy(values.values, command->args, sizeof(values.values));
+            commandResult->result = controlSet(uvcDevice, control, &values);
+            break;
+        }
+        default:
+            commandResult->result =
+                controlGetRanges(uvcDevice, control, &commandResult->controlRanges);
+            break;
+    }
+    commandResult->error = commandResult->result != 0 ? errorMessage(commandResult->result) : NULL;
+}
+
+void executeCommand(struct UVCDevice*     uvcDevice,
+                    const struct Command* command,
+                    struct CommandResult* commandResult) {
+    commandResult->result = UVC_SUCCESS;
+    commandResult->error  = NULL;
+
+    switch (command->op) {
+        case CMD_GET_CAPABILITIES:
+            commandResult->result = getDeviceCapability(uvcDevice, &commandResult->capability);
+            if (commandResult->result != 0) {
+                commandResult->error = errorMessage(commandResult->result);
+            }
+            break;
+        case CMD_GET_ABSOLUTE_ZOOM:
+            getAbsoluteZoomInfo(uvcDevice, &commandResult->absoluteZoomInfo);
+            commandResult->result = commandResult->absoluteZoomInfo.result;
+            commandResult->error  = commandResult->absoluteZoomInfo.error;
+            break;
+        case CMD_ABSOLUTE_ZOOM: {
+            struct AbsoluteZoom absoluteZoom;
+            absoluteZoom.zoom = command->args[0];
+            setAbsoluteZoom(uvcDevice, &absoluteZoom);
+            commandResult->result = absoluteZoom.result;
+            commandResult->error  = absoluteZoom.error;
+            break;
+        }
+        case CMD_GET_RELATIVE_ZOOM:
+            getRelativeZoomInfo(uvcDevice, &commandResult->relativeZoomInfo);
+            commandResult->result = commandResult->relativeZoomInfo.result;
+            commandResult->error  = commandResult->relativeZoomInfo.error;
+            break;
+        case CMD_RELATIVE_ZOOM: {
+            struct RelativeZoom relativeZoom;
+            relativeZoom.direction = command->args[0];
+            relativeZoom.speed     = command->args[1];
+            setRelativeZoom(uvcDevice, &relativeZoom);
+            commandResult->result = relativeZoom.result;
+            commandResult->error  = relativeZoom.error;
+            break;
+        }
+        case CMD_GET_ABSOLUTE_PAN_TILT:
+            getAbsolutePanTiltInfo(uvcDevice, &commandResult->absolutePanTiltInfo);
+            commandResult->result = commandResult->absolutePanTiltInfo.result;
+            commandResult->error  = commandResult->absolutePanTiltInfo.error;
+            break;
+        case CMD_ABSOLUTE_PAN_TILT: {
+            struct AbsolutePanTilt absolutePanTilt;
+            absolutePanTilt.pan  = command->args[0];
+            absolutePanTilt.tilt = command->args[1];
+            setAbsolutePanTilt(uvcDevice, &absolutePanTilt);
+            commandResult->result = absolutePanTilt.result;
+            commandResult->error  = absolutePanTilt.error;
+            break;
+        }
+        case CMD_GET_RELATIVE_PAN_TILT:
+            getRelativePanTiltInfo(uvcDevice, &commandResult->relativePanTiltInfo);
+            commandResult->result = commandResult->relativePanTiltInfo.result;
+            commandResult->error  = commandResult->relativePanTiltInfo.error;
+            break;
+        case CMD_RELATIVE_PAN_TILT: {
+            struct RelativePanTilt relativePanTilt;
+            relativePanTilt.pan_direction  = command->args[0];
+            relativePanTilt.pan_speed      = command->args[1];
+            relativePanTilt.tilt_direction = command->args[2];
+            relativePanTilt.tilt_speed     = command->args[3];
+            setRelativePanTilt(uvcDevice, &relativePanTilt);
+            commandResult->result = relativePanTilt.result;
+            commandResult->error  = relativePanTilt.error;
+            break;
+        }
+        default:
+            executeControl(uvcDevice, command, commandResult);
+            break;
+    }
+}
+
+void runCommand(struct UVCDevice*     uvcDevice,
+                const struct Command* command,
+                struct CommandResult* commandResult) {
+    runCommandGated(uvcDevice, command, NULL, commandResult);
+}
+
+void runCommandGated(struct UVCDevice*         uvcDevice,
+                     const struct Command*     command,
+                     const struct CommandGate* gate,
+                     struct CommandResult*     commandResult) {
+    uint64_t start = monotonicNanos();
+
+    openDevice(uvcDevice);
+    uvc_error_t gated = gate != NULL ? gate->wait(gate->context, uvcDevice) : UVC_SUCCESS;
+    if (uvcDevice->result != 0) {
+        commandResult->result = uvcDevice->result;
+    } else {
+        if (gated != 0) {
+            commandResult->result = gated;
+        } else {
+            executeCommand(uvcDevice, command, commandResult);
+        }
+        closeDevice(uvcDevice);
+    }
+    commandResult->error = commandResult->result != 0 ? errorMessage(commandResult->result) : NULL;
+
+    if (recorderActive()) {
+        recorderAppend(uvcDevice, command, commandResult, start, monotonicNanos());
+    }
+}
+
+}  // namespace ptz
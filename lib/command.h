@@ -0,0 +1,103 @@
+#ifndef PTZ_COMMAND_H
+#define PTZ_COMMAND_H
+
+#include <stdint.h>
+#include "control.h"
+#include "device.h"
+
+namespace ptz {
+
+// every operation the addon exposes, in a form that can be queued, scripted
+// and replayed. names match the exported node functions.
+enum CommandOp {
+    CMD_GET_CAPABILITIES = 0,
+    CMD_GET_ABSOLUTE_ZOOM,
+    CMD_ABSOLUTE_ZOOM,
+    CMD_GET_RELATIVE_ZOOM,
+    CMD_RELATIVE_ZOOM,
+    CMD_GET_ABSOLUTE_PAN_TILT,
+    CMD_ABSOLUTE_PAN_TILT,
+    CMD_GET_RELATIVE_PAN_TILT,
+    CMD_RELATIVE_PAN_TILT,
+    // then getControl, setControl and getRanges for each entry in control.h
+    CMD_CONTROL_BASE,
+    CMD_COUNT = CMD_CONTROL_BASE + CONTROL_COUNT * CONTROL_REQUEST_COUNT
+};
+
+constexpr int controlOp(int control, int request) {
+    return CMD_CONTROL_BASE + control * CONTROL_REQUEST_COUNT + request;
+}
+// the control a command drives, -1 for the dedicated commands
+constexpr int commandControl(int op) {
+    if (op < CMD_CONTROL_BASE || op >= CMD_COUNT) {
+        return -1;
+    }
+    return (op - CMD_CONTROL_BASE) / CONTROL_REQUEST_COUNT;
+}
+constexpr int commandControlRequest(int op) {
+    return (op - CMD_CONTROL_BASE) % CONTROL_REQUEST_COUNT;
+}
+
+struct CommandSpec {
+    const char* name;
+    int         argCount;
+    int         read;  // only queries the device, never changes its state
+    const char* argNames[4];
+};
+const struct CommandSpec* commandSpec(int op);
+// returns -1 for unknown names. control commands are found by
+// commandFindControl, their names are shared.
+int commandFind(const char* name);
+int commandFindControl(const char* name, const char* control);
+
+#define COMMAND_FORCE 1      // send even when the camera was already told this
+#define COMMAND_SCHEDULED 2  // sent by a native scheduler rather than an operator
+
+struct Command {
+    uint8_t op;
+    uint8_t flags;
+    int32_t args[4];
+};
+
+struct CommandResult {
+    uvc_error_t result;
+    const char* error;
+    union {
+        struct DeviceCapability    capability;
+        struct AbsoluteZoomInfo    absoluteZoomInfo;
+        struct RelativeZoomInfo    relativeZoomInfo;
+        struct AbsolutePanTiltInfo absolutePanTiltInfo;
+        struct RelativePanTiltInfo relativePanTiltInfo;
+        struct ControlValues       controlValues;
+        struct ControlRanges       controlRanges;
+    };
+};
+
+// run one command against an open device
+void executeCommand(struct UVCDevice*     uvcDevice,
+                    const struct Command* command,
+                    struct CommandResult* commandResult);
+
+// open the device, run one command and close it again, the way every addon
+// call works. the command is captured when a recorder is running.
+void runCommand(struct UVCDevice*     uvcDevice,
+                const struct Command* command,
+                struct CommandResult* commandResult);
+
+// holds a command back once its device is open, so several cameras can be
+// opened first and then released together. wait returns 0 to send, or the
+// error to fail the command with instead.
+struct CommandGate {
+    uvc_error_t (*wait)(void* context, const struct UVCDevice* uvcDevice);
+    void* context;
+};
+// runCommand, calling gate->wait between opening the device and sending,
+// even when the open failed. gate may be NULL.
+void runCommandGated(struct UVCDevice*         uvcDevice,
+                     const struct Command*     command,
+                     const struct CommandGate* gate,
+                     struct CommandResult*     commandResult);
+
+}  // namespace ptz
+
+#endif  // PTZ_COMMAND_H
@@ -0,0 +1,168 @@
+#include "control.h"
+#include <string.h>
+#include <type_traits>
+#include "device.h"
+
+namespace ptz {
+
+#define CONTROL_MAX_LENGTH 16
+
+static_assert(CONTROL_MAX_LENGTH >= 4 * CONTROL_MAX_FIELDS, "payload buffer too small");
+
+int controlFind(const char* name) {
+    for (int control = 0; control < CONTROL_COUNT; control++) {
+        if (strcmp(controlSpecs[control].name, name) == 0) {
+            return control;
+        }
+    }
+    return -1;
+}
+
+const struct ControlSpec* controlBySelector(uint8_t selector) {
+    for (int control = 0; control < CONTROL_COUNT; control++) {
+        if (controlSpecs[control].selector == selector) {
+            return &controlSpecs[control];
+        }
+    }
+    return NULL;
+}
+
+// little endian, like every uvc payload
+template <typename T>
+static T readField(const uint8_t* data) {
+    typename std::make_unsigned<T>::type value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        value |= (typename std::make_unsigned<T>::type)data[i] << (8 * i);
+    }
+    return (T)value;
+}
+
+template <typename T>
+static void writeField(uint8_t* data, int32_t value) {
+    typename std::make_unsigned<T>::type bits = (T)value;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        data[i] = (uint8_t)(bits >> (8 * i));
+    }
+}
+
+static void unpack(const struct ControlSpec* spec, const uint8_t* data, int32_t* values) {
+    memset(values, 0, sizeof(int32_t) * CONTROL_MAX_FIELDS);
+    for (int i = 0; i < controlFieldCount(*spec); i++) {
+        switch (spec->fields[i].type) {
+            case CONTROL_U8:
+                values[i] = readField<uint8_t>(data);
+                break;
+            case CONTROL_S8:
+                values[i] = readField<int8_t>(data);
+                break;
+            case CONTROL_U16:
+                values[i] = readField<uint16_t>(data);
+                break;
+            case CONTROL_S16:
+                values[i] = readField<int16_t>(data);
+                break;
+            case CONTROL_U32:
+                values[i] = (int32_t)readField<uint32_t>(data);
+                break;
+            default:
+                values[i] = readField<int32_t>(data);
+                break;
+        }
+        data += controlTypeSize(spec->fields[i].type);
+    }
+}
+
+static void pack(const struct ControlSpec* spec, const int32_t* values, uint8_t* data) {
+    for (int i = 0; i < controlFieldCount(*spec); i++) {
+        switch (spec->fields[i].type) {
+            case CONTROL_U8:
+                writeField<uint8_t>(data, values[i]);
+                break;
+            case CONTROL_S8:
+                writeField<int8_t>(data, values[i]);
+                break;
+            case CONTROL_U16:
+                writeField<uint16_t>(data, values[i]);
+                break;
+            case CONTROL_S16:
+                writeField<int16_t>(data, values[i]);
+                break;
+            case CONTROL_U32:
+                writeField<uint32_t>(data, values[i]);
+                break;
+            default:
+                writeField<int32_t>(data, values[i]);
+                break;
+        }
+        data += controlTypeSize(spec->fields[i].type);
+    }
+}
+
+static uvc_error_t readRequest(struct UVCDevice*         uvcDevice,
+                               const struct ControlSpec* spec,
+                               enum uvc_req_code         requestCode,
+                               int32_t*                  values) {
+    uint8_t     data[CONTROL_MAX_LENGTH];
+    uvc_error_t result =
+        getCameraControl(uvcDevice, spec->selector, data, controlLength(*spec), requestCode);
+    if (result == 0) {
+        unpack(spec, data, values);
+    }
+    return result;
+}
+
+uvc_error_t controlGet(struct UVCDevice* uvcDevice, int control, struct ControlValues* values) {
+    if (control < 0 || control >= CONTROL_COUNT) {
+        return UVC_ERROR_INVALID_PARAM;
+    }
+    return readRequest(uvcDevice, &controlSpecs[control], UVC_GET_CUR, values->values);
+}
+
+uvc_error_t controlSet(struct UVCDevice*           uvcDevice,
+                       int                         control,
+                       const struct ControlValues* values) {
+    if (control < 0 || control >= CONTROL_COUNT) {
+        return UVC_ERROR_INVALID_PARAM;
+    }
+    const struct ControlSpec* spec = &controlSpecs[control];
+    uint8_t                   data[CONTROL_MAX_LENGTH];
+    pack(spec, values->values, data);
+    return setCameraControl(uvcDevice, spec->selector, data, controlLength(*spec));
+}
+
+uvc_error_t controlGetRanges(struct UVCDevice*     uvcDevice,
+                             int                   control,
+                             struct ControlRanges* ranges) {
+    static const struct {
+        uint32_t          bit;
+        enum uvc_req_code requestCode;
+    } requests[] = {
+        {CONTROL_HAS_MIN, UVC_GET_MIN},
+        {CONTROL_HAS_MAX, UVC_GET_MAX},
+        {CONTROL_HAS_RES, UVC_GET_RES},
+        {CONTROL_HAS_DEF, UVC_GET_DEF},
+    };
+
+    memset(ranges, 0, sizeof(*ranges));
+    if (control < 0 || control >= CONTROL_COUNT) {
+        return UVC_ERROR_INVALID_PARAM;
+    }
+    const struct ControlSpec* spec   = &controlSpecs[control];
+    int32_t*                  out[4] = {ranges->min, ranges->max, ranges->resolution, ranges->def};
+    for (int i = 0; i < 4; i++) {
+        if (!(spec->ranges & requests[i].bit)) {
+            continue;
+        }
+        uvc_error_t result = readRequest(uvcDevice, spec, requests[i].requestCode, out[i]);
+        if (result == UVC_ERROR_PIPE) {
+            continue;
+        }
+        if (result != 0) {
+            return result;
+        }
+        ranges->requests |= requests[i].bit;
+    }
+    return UVC_SUCCESS;
+}
+
+}  // namespace ptz
@@ -0,0 +1,203 @@
+#ifndef PTZ_CONTROL_H
+#define PTZ_CONTROL_H
+
+#include <stdint.h>
+#include "libuvc/libuvc.h"
+
+namespace ptz {
+
+struct UVCDevice;
+
+// every uvc camera terminal control the addon can drive, described once. a
+// control is a selector and the little endian fields of its payload, in
+// order. each one becomes three commands, getControl, setControl and
+// getRanges, so they all get the session's caching, batching and rate
+// limits and go through ptzd. the table is append only: command numbers
+// are derived from it and end up in recordings and on the wire.
+#define CONTROL_MAX_FIELDS 4
+
+enum ControlType { CONTROL_U8 = 0, CONTROL_S8, CONTROL_U16, CONTROL_S16, CONTROL_U32, CONTROL_S32 };
+
+enum ControlKind {
+    CONTROL_SETTING = 0,  // a mode or switch, setting it again changes nothing
+    CONTROL_ABSOLUTE,     // a position, sets within the resolution change nothing
+    CONTROL_RELATIVE,     // a motion, every set goes out
+};
+
+// what a set moves, so writes on one axis forget what was sent on the others.
+// zoom and pan/tilt share the session's numbering for the dedicated commands.
+enum ControlAxis {
+    CONTROL_AXIS_NONE = 0,
+    CONTROL_AXIS_ZOOM,
+    CONTROL_AXIS_PAN_TILT,
+    CONTROL_AXIS_ROLL,
+    CONTROL_AXIS_FOCUS,
+    CONTROL_AXIS_IRIS,
+    CONTROL_AXIS_EXPOSURE,
+    CONTROL_AXIS_COUNT,
+};
+
+// range requests a control answers besides GET_CUR, from the uvc spec
+#define CONTROL_HAS_MIN 1
+#define CONTROL_HAS_MAX 2
+#define CONTROL_HAS_RES 4
+#define CONTROL_HAS_DEF 8
+#define CONTROL_HAS_RANGE 15
+
+struct ControlField {
+    const char* name;
+    uint8_t     type;
+};
+
+struct ControlSpec {
+    const char*         name;
+    uint8_t             selector;
+    uint8_t             kind;
+    uint8_t             axis;
+    uint8_t             ranges;  // CONTROL_HAS_* bits
+    struct ControlField fields[CONTROL_MAX_FIELDS];
+};
+
+// clang-format off
+inline constexpr struct ControlSpec controlSpecs[] = {
+    {"scanningMode", UVC_CT_SCANNING_MODE_CONTROL, CONTROL_SETTING, CONTROL_AXIS_NONE, 0,
+     {{"mode", CONTROL_U8}}},
+    {"autoExposureMode", UVC_CT_AE_MODE_CONTROL, CONTROL_SETTING, CONTROL_AXIS_EXPOSURE,
+     CONTROL_HAS_RES | CONTROL_HAS_DEF,
+     {{"mode", CONTROL_U8}}},
+    {"autoExposurePriority", UVC_CT_AE_PRIORITY_CONTROL, CONTROL_SETTING, CONTROL_AXIS_EXPOSURE, 0,
+     {{"priority", CONTROL_U8}}},
+    {"exposureTimeAbsolute", UVC_CT_EXPOSURE_TIME_ABSOLUTE_CONTROL, CONTROL_ABSOLUTE,
+     CONTROL_AXIS_EXPOSURE, CONTROL_HAS_RANGE,
+     {{"time", CONTROL_U32}}},
+    {"exposureTimeRelative", UVC_CT_EXPOSURE_TIME_RELATIVE_CONTROL, CONTROL_RELATIVE,
+     CONTROL_AXIS_EXPOSURE, 0,
+     {{"step", CONTROL_S8}}},
+    {"focusAbsolute", UVC_CT_FOCUS_ABSOLUTE_CONTROL, CONTROL_ABSOLUTE, CONTROL_AXIS_FOCUS,
+     CONTROL_HAS_RANGE,
+     {{"focus", CONTROL_U16}}},
+    {"focusRelative", UVC_CT_FOCUS_RELATIVE_CONTROL, CONTROL_RELATIVE, CONTROL_AXIS_FOCUS,
+     CONTROL_HAS_RANGE,
+     {{"direction", CONTROL_S8}, {"speed", CONTROL_U8}}},
+    {"focusAuto", UVC_CT_FOCUS_AUTO_CONTROL, CONTROL_SETTING, CONTROL_AXIS_FOCUS, CONTROL_HAS_DEF,
+     {{"auto", CONTROL_U8}}},
+    {"irisAbsolute", UVC_CT_IRIS_ABSOLUTE_CONTROL, CONTROL_ABSOLUTE, CONTROL_AXIS_IRIS,
+     CONTROL_HAS_RANGE,
+     {{"iris", CONTROL_U16}}},
+    {"irisRelative", UVC_CT_IRIS_RELATIVE_CONTROL, CONTROL_RELATIVE, CONTROL_AXIS_IRIS, 0,
+     {{"step", CONTROL_S8}}},
+    {"zoomAbsolute", UVC_CT_ZOOM_ABSOLUTE_CONTROL, CONTROL_ABSOLUTE, CONTROL_AXIS_ZOOM,
+     CONTROL_HAS_RANGE,
+     {{"zoom", CONTROL_U16}}},
+    {"zoomRelative", UVC_CT_ZOOM_RELATIVE_CONTROL, CONTROL_RELATIVE, CONTROL_AXIS_ZOOM,
+     CONTROL_HAS_RANGE,
+     {{"direction", CONTROL_S8}, {"digitalZoom", CONTROL_U8}, {"speed", CONTROL_U8}}},
+    {"panTiltAbsolute", UVC_CT_PANTILT_ABSOLUTE_CONTROL, CONTROL_ABSOLUTE, CONTROL_AXIS_PAN_TILT,
+     CONTROL_HAS_RANGE,
+     {{"pan", CONTROL_S32}, {"tilt", CONTROL_S32}}},
+    {"panTiltRelative", UVC_CT_PANTILT_RELATIVE_CONTROL, CONTROL_RELATIVE, CONTROL_AXIS_PAN_TILT,
+     CONTROL_HAS_RANGE,
+     {{"panDirection", CONTROL_S8}, {"panSpeed", CONTROL_U8},
+      {"tiltDirection", CONTROL_S8}, {"tiltSpeed", CONTROL_U8}}},
+    {"rollAbsolute", UVC_CT_ROLL_ABSOLUTE_CONTROL, CONTROL_ABSOLUTE, CONTROL_AXIS_ROLL,
+     CONTROL_HAS_RANGE,
+     {{"roll", CONTROL_S16}}},
+    {"rollRelative", UVC_CT_ROLL_RELATIVE_CONTROL, CONTROL_RELATIVE, CONTROL_AXIS_ROLL,
+     CONTROL_HAS_RANGE,
+     {{"direction", CONTROL_S8}, {"speed", CONTROL_U8}}},
+    {"privacy", UVC_CT_PRIVACY_CONTROL, CONTROL_SETTING, CONTROL_AXIS_NONE, 0,
+     {{"privacy", CONTROL_U8}}},
+};
+// clang-format on
+
+inline constexpr int CONTROL_COUNT = sizeof(controlSpecs) / sizeof(controlSpecs[0]);
+
+constexpr int controlTypeSize(int type) {
+    return type <= CONTROL_S8 ? 1 : (type <= CONTROL_S16 ? 2 : 4);
+}
+
+constexpr bool controlTypeSigned(int type) {
+    return type == CONTROL_S8 || type == CONTROL_S16 || type == CONTROL_S32;
+}
+
+constexpr int controlFieldCount(const struct ControlSpec& spec) {
+    int count = 0;
+    while (count < CONTROL_MAX_FIELDS && spec.fields[count].name != nullptr) {
+        count++;
+    }
+    return count;
+}
+
+// bytes on the wire, the fields packed back to back
+constexpr int controlLength(const struct ControlSpec& spec) {
+    int length = 0;
+    for (int i = 0; i < controlFieldCount(spec); i++) {
+        length += controlTypeSize(spec.fields[i].type);
+    }
+    return length;
+}
+
+constexpr bool controlTableValid() {
+    for (int control = 0; control < CONTROL_COUNT; control++) {
+        const struct ControlSpec& spec = controlSpecs[control];
+        if (controlFieldCount(spec) == 0) {
+            return false;
+        }
+        // fields after the first missing one would never be sent
+        for (int i = controlFieldCount(spec); i < CONTROL_MAX_FIELDS; i++) {
+            if (spec.fields[i].name != nullptr) {
+                return false;
+            }
+        }
+        if (control > 0 && spec.selector <= controlSpecs[control - 1].selector) {
+            return false;
+        }
+        // a relative control stops when its signed fields are all 0
+        if (spec.kind == CONTROL_RELATIVE && !controlTypeSigned(spec.fields[0].type)) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(controlTableValid(), "control table entries need fields and ascending selectors");
+
+// a relative control with a speed moves until it is stopped. iris and
+// exposure have none, they take one step per set and 0 picks the default.
+constexpr bool controlIsMotion(const struct ControlSpec& spec) {
+    return spec.kind == CONTROL_RELATIVE && controlFieldCount(spec) > 1;
+}
+
+// the three commands every control has, see controlOp in command.h
+enum ControlRequest { CONTROL_GET = 0, CONTROL_SET, CONTROL_RANGES, CONTROL_REQUEST_COUNT };
+
+// returns -1 for unknown names
+int                       controlFind(const char* name);
+const struct ControlSpec* controlBySelector(uint8_t selector);
+
+// the fields of one GET_CUR, or of a SET_CUR
+struct ControlValues {
+    int32_t values[CONTROL_MAX_FIELDS];
+};
+
+struct ControlRanges {
+    uint32_t requests;  // CONTROL_HAS_* bits the camera answered
+    int32_t  min[CONTROL_MAX_FIELDS];
+    int32_t  max[CONTROL_MAX_FIELDS];
+    int32_t  resolution[CONTROL_MAX_FIELDS];
+    int32_t  def[CONTROL_MAX_FIELDS];
+};
+
+// one transfer each, on an open device
+uvc_error_t controlGet(struct UVCDevice* uvcDevice, int control, struct ControlValues* values);
+uvc_error_t controlSet(struct UVCDevice*           uvcDevice,
+                       int                         control,
+                       const struct ControlValues* values);
+// a transfer per range the control has. a range the camera stalls on is left
+// out of requests rather than failing the rest.
+uvc_error_t controlGetRanges(struct UVCDevice*     uvcDevice,
+                             int                   control,
+                             struct ControlRanges* ranges);
+
+}  // namespace ptz
+
+#endif  // PTZ_CONTROL_H
@@ -0,0 +1,720 @@
+#include "device.h"
+#include <string.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <atomic>
+#include "device_index.h"
+#include "error.h"
+#include "simulator.h"
+#include "stats.h"
+
+namespace ptz {
+
+// class specific requests on the video control interface, from the uvc spec
+#define DEVICE_REQUEST_GET 0xa1
+#define DEVICE_REQUEST_SET 0x21
+
+// the largest payload in control.h
+#define DEVICE_CONTROL_MAX_LENGTH 16
+
+// how often a transfer in flight looks for a cancel
+#define DEVICE_CANCEL_POLL_NS 10000000ULL
+
+static bool transferCancelled(const struct UVCDevice* uvcDevice) {
+    return uvcDevice->cancels != NULL &&
+           uvcDevice->cancels->load(std::memory_order_acquire) != uvcDevice->cancelMark;
+}
+
+// why a transfer must not start, UVC_SUCCESS when it may
+static uvc_error_t transferBlocked(const struct UVCDevice* uvcDevice, uint64_t now) {
+    if (transferCancelled(uvcDevice)) {
+        return UVC_ERROR_INTERRUPTED;
+    }
+    if (uvcDevice->deadline != 0 && now >= uvcDevice->deadline) {
+        return UVC_ERROR_TIMEOUT;
+    }
+    return UVC_SUCCESS;
+}
+
+// a hung simulated camera answers nothing until it recovers, the deadline
+// passes or the transfer is cancelled, like a wedged control endpoint
+static uvc_error_t simTransferReady(struct UVCDevice* uvcDevice) {
+    for (;;) {
+        uint64_t    now    = monotonicNanos();
+        uvc_error_t result = transferBlocked(uvcDevice, now);
+        if (result != 0 || !simIsHung(uvcDevice->sim)) {
+            return result;
+        }
+        uint64_t wake = now + DEVICE_CANCEL_POLL_NS;
+        if (uvcDevice->deadline != 0) {
+            wake = std::min(wake, uvcDevice->deadline);
+        }
+        sleepUntil(wake);
+    }
+}
+
+static void onTransferDone(struct libusb_transfer* transfer) {
+    *(int*)transfer->user_data = 1;
+}
+
+static uvc_error_t transferStatus(const struct libusb_transfer* transfer) {
+    switch (transfer->status) {
+        case LIBUSB_TRANSFER_COMPLETED:
+            return UVC_SUCCESS;
+        case LIBUSB_TRANSFER_TIMED_OUT:
+            return UVC_ERROR_TIMEOUT;
+        case LIBUSB_TRANSFER_CANCELLED:
+            return UVC_ERROR_INTERRUPTED;
+        case LIBUSB_TRANSFER_STALL:
+            return UVC_ERROR_PIPE;
+        case LIBUSB_TRANSFER_NO_DEVICE:
+            return UVC_ERROR_NO_DEVICE;
+        case LIBUSB_TRANSFER_OVERFLOW:
+            return UVC_ERROR_OVERFLOW;
+        default:
+            return UVC_ERROR_IO;
+    }
+}
+
+// one request to the camera terminal. libuvc's own accessors wait as long
+// as the camera takes, so the transfer is made here instead: libusb times
+// it out at the deadline, and the loop pumping its events cancels it when
+// asked to.
+static uvc_error_t controlRequest(struct UVCDevice* uvcDevice,
+                                  uint8_t           requestType,
+                                  uint8_t           request,
+                                  uint8_t           selector,
+                                  uint8_t*          data,
+                                  int               length) {
+    const uvc_input_terminal_t* terminal = uvc_get_camera_terminal(uvcDevice->devicehandle);
+    if (terminal == NULL || uvcDevice->transfer == NULL) {
+        return UVC_ERROR_NOT_SUPPORTED;
+    }
+    if (length > DEVICE_CONTROL_MAX_LENGTH) {
+        return UVC_ERROR_INVALID_PARAM;
+    }
+    uint64_t    now    = monotonicNanos();
+    uvc_error_t result = transferBlocked(uvcDevice, now);
+    if (result != 0) {
+        return result;
+    }
+    // whole milliseconds, rounded up, where 0 waits forever
+    unsigned int timeoutMs = 0;
+    if (uvcDevice->deadline != 0) {
+        timeoutMs = (unsigned int)((uvcDevice->deadline - now + 999999) / 1000000);
+    }
+
+    bool    in = (requestType & 0x80) != 0;
+    uint8_t buffer[LIBUSB_CONTROL_SETUP_SIZE + DEVICE_CONTROL_MAX_LENGTH];
+    libusb_fill_control_setup(buffer,
+                              requestType,
+                              request,
+                              (uint16_t)(selector << 8),
+                              (uint16_t)(terminal->bTerminalID << 8 | uvcDevice->controlInterface),
+                              (uint16_t)length);
+    if (!in) {
+        memcpy(buffer + LIBUSB_CONTROL_SETUP_SIZE, data, length);
+    }
+
+    struct libusb_transfer* transfer  = uvcDevice->transfer;
+    int                     completed = 0;
+    libusb_fill_control_transfer(transfer,
+                                 uvc_get_libusb_handle(uvcDevice->devicehandle),
+                                 buffer,
+                                 onTransferDone,
+                                 &completed,
+                                 timeoutMs);
+    // libusb and libuvc number their errors alike
+    int submitted = libusb_submit_transfer(transfer);
+    if (submitted != 0) {
+        return (uvc_error_t)submitted;
+    }
+
+    // the buffer is on this stack, so nothing returns before the callback
+    libusb_context* usb        = deviceIndexContext();
+    bool            cancelling = false;
+    while (!completed) {
+        struct timeval poll = {0, (suseconds_t)(DEVICE_CANCEL_POLL_NS / 1000)};
+        libusb_handle_events_timeout_completed(usb, &poll, &completed);
+        if (!completed && !cancelling && transferCancelled(uvcDevice)) {
+            libusb_cancel_transfer(transfer);
+            cancelling = true;
+        }
+    }
+
+    result = transferStatus(transfer);
+    if (result != 0) {
+        return result;
+    }
+    // a short transfer means the camera disagrees with the table about the layout
+    if (transfer->actual_length != length) {
+        return UVC_ERROR_OTHER;
+    }
+    if (in) {
+        memcpy(data, buffer + LIBUSB_CONTROL_SETUP_SIZE, length);
+    }
+    return UVC_SUCCESS;
+}
+
+uvc_error_t getCameraControl(struct UVCDevice* uvcDevice,
+                             uint8_t           selector,
+                             uint8_t*          data,
+                             int               length,
+                             enum uvc_req_code requestCode) {
+    if (uvcDevice->sim != NULL) {
+        uvc_error_t result = simTransferReady(uvcDevice);
+        if (result != 0) {
+            return result;
+        }
+        return simGetControl(uvcDevice->sim, selector, data, length, requestCode);
+    }
+    return controlRequest(uvcDevice, DEVICE_REQUEST_GET, requestCode, selector, data, length);
+}
+
+uvc_error_t setCameraControl(struct UVCDevice* uvcDevice,
+                             uint8_t           selector,
+                             const uint8_t*    data,
+                             int               length) {
+    if (uvcDevice->sim != NULL) {
+        uvc_error_t result = simTransferReady(uvcDevice);
+        if (result != 0) {
+            return result;
+        }
+        return simSetControl(uvcDevice->sim, selector, data, length);
+    }
+    return controlRequest(
+        uvcDevice, DEVICE_REQUEST_SET, UVC_SET_CUR, selector, (uint8_t*)data, length);
+}
+
+// the typed accessors, packed and unpacked here so they take the same
+// transfers as every other control. payloads are little endian.
+static void put16(uint8_t* data, uint16_t value) {
+    data[0] = (uint8_t)value;
+    data[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t* data, uint32_t value) {
+    put16(data, (uint16_t)value);
+    put16(data + 2, (uint16_t)(value >> 16));
+}
+
+static uint16_t get16(const uint8_t* data) {
+    return (uint16_t)(data[0] | data[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* data) {
+    return (uint32_t)get16(data) | (uint32_t)get16(data + 2) << 16;
+}
+
+static uvc_error_t getZoomAbs(struct UVCDevice* uvcDevice,
+                              uint16_t*         focal_length,
+                              enum uvc_req_code requestCode) {
+    uint8_t     data[2];
+    uvc_error_t result = getCameraControl(
+        uvcDevice, UVC_CT_ZOOM_ABSOLUTE_CONTROL, data, sizeof(data), requestCode);
+    if (result == 0) {
+        *focal_length = get16(data);
+    }
+    return result;
+}
+static uvc_error_t setZoomAbs(struct UVCDevice* uvcDevice, uint16_t focal_length) {
+    uint8_t data[2];
+    put16(data, focal_length);
+    return setCameraControl(uvcDevice, UVC_CT_ZOOM_ABSOLUTE_CONTROL, data, sizeof(data));
+}
+static uvc_error_t getZoomRel(struct UVCDevice* uvcDevice,
+                              int8_t*           zoom_rel,
+                              uint8_t*          digital_zoom,
+                              uint8_t*          speed,
+                              enum uvc_req_code requestCode) {
+    uint8_t     data[3];
+    uvc_error_t result = getCameraControl(
+        uvcDevice, UVC_CT_ZOOM_RELATIVE_CONTROL, data, sizeof(data), requestCode);
+    if (result == 0) {
+        *zoom_rel     = (int8_t)data[0];
+        *digital_zoom = data[1];
+        *speed        = data[2];
+    }
+    return result;
+}
+static uvc_error_t setZoomRel(struct UVCDevice* uvcDevice,
+                              int8_t            zoom_rel,
+                              uint8_t           digital_zoom,
+                              uint8_t           speed) {
+    uint8_t data[3] = {(uint8_t)zoom_rel, digital_zoom, speed};
+    return setCameraControl(uvcDevice, UVC_CT_ZOOM_RELATIVE_CONTROL, data, sizeof(data));
+}
+static uvc_error_t getPanTiltAbs(struct UVCDevice* uvcDevice,
+                                 int32_t*          pan,
+                                 int32_t*          tilt,
+                                 enum uvc_req_code requestCode) {
+    uint8_t     data[8];
+    uvc_error_t result = getCameraControl(
+        uvcDevice, UVC_CT_PANTILT_ABSOLUTE_CONTROL, data, sizeof(data), requestCode);
+    if (result == 0) {
+        *pan  = (int32_t)get32(data);
+        *tilt = (int32_t)get32(data + 4);
+    }
+    return result;
+}
+static uvc_error_t setPanTiltAbs(struct UVCDevice* uvcDevice, int32_t pan, int32_t tilt) {
+    uint8_t data[8];
+    put32(data, (uint32_t)pan);
+    put32(data + 4, (uint32_t)tilt);
+    return setCameraControl(uvcDevice, UVC_CT_PANTILT_ABSOLUTE_CONTROL, data, sizeof(data));
+}
+static uvc_error_t getPanTiltRel(struct UVCDevice* uvcDevice,
+                                 int8_t*           pan_rel,
+                                 uint8_t*          pan_speed,
+                                 int8_t*           tilt_rel,
+                                 uint8_t*          tilt_speed,
+                                 enum uvc_req_code requestCode) {
+    uint8_t     data[4];
+    uvc_error_t result = getCameraControl(
+        uvcDevice, UVC_CT_PANTILT_RELATIVE_CONTROL, data, sizeof(data), requestCode);
+    if (result == 0) {
+        *pan_rel    = (int8_t)data[0];
+        *pan_speed  = data[1];
+        *tilt_rel   = (int8_t)data[2];
+        *tilt_speed = data[3];
+    }
+    return result;
+}
+static uvc_error_t setPanTiltRel(struct UVCDevice* uvcDevice,
+                                 int8_t            pan_rel,
+                                 uint8_t           pan_speed,
+                                 int8_t            tilt_rel,
+                                 uint8_t           tilt_speed) {
+    uint8_t data[4] = {(uint8_t)pan_rel, pan_speed, (uint8_t)tilt_rel, tilt_speed};
+    return setCameraControl(uvcDevice, UVC_CT_PANTILT_RELATIVE_CONTROL, data, sizeof(data));
+}
+static uvc_error_t getRollAbs(struct UVCDevice* uvcDevice,
+                              int16_t*          roll,
+                              enum uvc_req_code requestCode) {
+    uint8_t     data[2];
+    uvc_error_t result = getCameraControl(
+        uvcDevice, UVC_CT_ROLL_ABSOLUTE_CONTROL, data, sizeof(data), requestCode);
+    if (result == 0) {
+        *roll = (int16_t)get16(data);
+    }
+    return result;
+}
+static uvc_error_t getRollRel(struct UVCDevice* uvcDevice,
+                              int8_t*           roll_rel,
+                              uint8_t*          speed,
+                              enum uvc_req_code requestCode) {
+    uint8_t     data[2];
+    uvc_error_t result = getCameraControl(
+        uvcDevice, UVC_CT_ROLL_RELATIVE_CONTROL, data, sizeof(data), requestCode);
+    if (result == 0) {
+        *roll_rel = (int8_t)data[0];
+        *speed    = data[1];
+    }
+    return result;
+}
+
+// handle accounting, so long running processes can spot leaked opens
+static std::atomic<uint64_t> deviceOpens(0);
+static std::atomic<uint64_t> deviceCloses(0);
+static std::atomic<uint64_t> deviceOpenFailures(0);
+
+void getDeviceCounters(struct DeviceCounters* counters) {
+    // closes first, so a racing open can only over count
+    counters->closes   = deviceCloses.load(std::memory_order_relaxed);
+    counters->opens    = deviceOpens.load(std::memory_order_relaxed);
+    counters->failures = deviceOpenFailures.load(std::memory_order_relaxed);
+    counters->open     = (int64_t)(counters->opens - counters->closes);
+}
+
+static void openDeviceHandle(UVCDevice* uvcDevice);
+void openDevice(UVCDevice* uvcDevice) {
+    openDeviceHandle(uvcDevice);
+    if (uvcDevice->result == 0) {
+        deviceOpens.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        deviceOpenFailures.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+static void openDeviceHandle(UVCDevice* uvcDevice) {
+    uvcDevice->ctx              = NULL;
+    uvcDevice->device           = NULL;
+    uvcDevice->devicehandle     = NULL;
+    uvcDevice->sim              = NULL;
+    uvcDevice->transfer         = NULL;
+    uvcDevice->controlInterface = 0;
+    uvcDevice->attachment       = 0;
+
+    // simulated cameras skip the usb stack entirely
+    if (uvcDevice->simulated) {
+        uvcDevice->sim    = simFindCamera(
+            uvcDevice->vendorId, uvcDevice->productId, uvcDevice->serial, uvcDevice->port);
+        uvcDevice->result = simOpen(uvcDevice->sim);
+        if (uvcDevice->result != 0) {
+            uvcDevice->sim = NULL;
+            uvcDevice->error = errorMessage(uvcDevice->result);
+            return;
+        }
+        uvcDevice->attachment = simAttachment(uvcDevice->sim);
+        return;
+    }
+
+    // the index holds every attached camera, so this is a lookup rather than
+    // a descriptor read of each device on the bus
+    deviceIndexOpen(uvcDevice);
+    if (uvcDevice->result != 0) {
+        uvcDevice->error = errorMessage(uvcDevice->result);
+    }
+}
+void closeDevice(UVCDevice* uvcDevice) {
+    deviceCloses.fetch_add(1, std::memory_order_relaxed);
+    if (uvcDevice->sim != NULL) {
+        simClose(uvcDevice->sim);
+        uvcDevice->sim = NULL;
+        return;
+    }
+    deviceIndexClose(uvcDevice);
+}
+
+// a probe the camera stalled or refused means the control is missing. one
+// that timed out, was cancelled or lost the camera says nothing either way.
+static bool probeFailed(uvc_error_t result) {
+    return result == UVC_ERROR_TIMEOUT || result == UVC_ERROR_INTERRUPTED ||
+           result == UVC_ERROR_NO_DEVICE;
+}
+
+// device operation support check
+uvc_error_t getDeviceCapability(struct UVCDevice*        uvcDevice,
+                                struct DeviceCapability* deviceCapability) {
+    enum uvc_req_code requestCode;
+    uvc_error_t       res;
+    int32_t           v1;
+    int32_t           v2;
+    uint16_t          v3;
+    int8_t            v4;
+    uint8_t           v5;
+    uint8_t           v6;
+    uint8_t           v7;
+    int16_t           v8;
+    int8_t            v10;
+
+    memset(deviceCapability, 0, sizeof(*deviceCapability));
+
+    requestCode = UVC_GET_DEF;
+    res         = getZoomAbs(uvcDevice, &v3, requestCode);
+    if (probeFailed(res)) {
+        return res;
+    }
+    deviceCapability->absolute_zoom = res == 0 ? 1 : 0;
+
+    requestCode = UVC_GET_DEF;
+    res         = getZoomRel(uvcDevice, &v4, &v5, &v6, requestCode);
+    if (probeFailed(res)) {
+        return res;
+    }
+    deviceCapability->relative_zoom = res == 0 ? 1 : 0;
+
+    requestCode = UVC_GET_DEF;
+    res         = getPanTiltAbs(uvcDevice, &v1, &v2, requestCode);
+    if (probeFailed(res)) {
+        return res;
+    }
+    deviceCapability->absolute_pan_tilt = res == 0 ? 1 : 0;
+
+    requestCode = UVC_GET_DEF;
+    res         = getPanTiltRel(uvcDevice, &v4, &v5, &v10, &v7, requestCode);
+    if (probeFailed(res)) {
+        return res;
+    }
+    deviceCapability->relative_pan_tilt = res == 0 ? 1 : 0;
+
+    requestCode = UVC_GET_DEF;
+    res         = getRollAbs(uvcDevice, &v8, requestCode);
+    if (probeFailed(res)) {
+        return res;
+    }
+    deviceCapability->absolute_roll = res == 0 ? 1 : 0;
+
+    requestCode = UVC_GET_DEF;
+    res         = getRollRel(uvcDevice, &v4, &v5, requestCode);
+    if (probeFailed(res)) {
+        return res;
+    }
+    deviceCapability->relative_roll = res == 0 ? 1 : 0;
+
+    return UVC_SUCCESS;
+}
+
+// absolute zoom operations
+void getAbsoluteZoomInfo(struct UVCDevice* uvcDevice, struct AbsoluteZoomInfo* absoluteZoomInfo) {
+    enum uvc_req_code requestCode;
+
+    requestCode              = UVC_GET_MIN;
+    absoluteZoomInfo->result = getZoomAbs(
+        uvcDevice, &absoluteZoomInfo->min, requestCode);
+    if (absoluteZoomInfo->result != 0) {
+        absoluteZoomInfo->error = errorMessage(absoluteZoomInfo->result);
+        return;
+    }
+
+    requestCode              = UVC_GET_MAX;
+    absoluteZoomInfo->result = getZoomAbs(
+        uvcDevice, &absoluteZoomInfo->max, requestCode);
+    if (absoluteZoomInfo->result != 0) {
+        absoluteZoomInfo->error = errorMessage(absoluteZoomInfo->result);
+        return;
+    }
+
+    requestCode              = UVC_GET_RES;
+    absoluteZoomInfo->result = getZoomAbs(
+        uvcDevice, &absoluteZoomInfo->resolution, requestCode);
+    if (absoluteZoomInfo->result != 0) {
+        absoluteZoomInfo->error = errorMessage(absoluteZoomInfo->result);
+        return;
+    }
+
+    requestCode              = UVC_GET_DEF;
+    absoluteZoomInfo->result = getZoomAbs(
+        uvcDevice, &absoluteZoomInfo->def, requestCode);
+    if (absoluteZoomInfo->result != 0) {
+        absoluteZoomInfo->error = errorMessage(absoluteZoomInfo->result);
+        return;
+    }
+
+    requestCode              = UVC_GET_CUR;
+    absoluteZoomInfo->result = getZoomAbs(
+        uvcDevice, &absoluteZoomInfo->current, requestCode);
+    if (absoluteZoomInfo->result != 0) {
+        absoluteZoomInfo->error = errorMessage(absoluteZoomInfo->result);
+        return;
+    }
+}
+
+void setAbsoluteZoom(struct UVCDevice* uvcDevice, struct AbsoluteZoom* absoluteZoom) {
+    absoluteZoom->result = setZoomAbs(uvcDevice, absoluteZoom->zoom);
+    if (absoluteZoom->result != 0) {
+        absoluteZoom->error = errorMessage(absoluteZoom->result);
+        return;
+    }
+}
+
+uvc_error_t getCurrentZoom(struct UVCDevice* uvcDevice, uint16_t* zoom) {
+    return getZoomAbs(uvcDevice, zoom, UVC_GET_CUR);
+}
+
+// relative zoom operations
+void getRelativeZoomInfo(struct UVCDevice* uvcDevice, struct RelativeZoomInfo* relativeZoomInfo) {
+    enum uvc_req_code requestCode;
+
+    requestCode              = UVC_GET_MIN;
+    relativeZoomInfo->result = getZoomRel(uvcDevice,
+                                          &relativeZoomInfo->direction,
+                                          &relativeZoomInfo->digital_zoom,
+                                          &relativeZoomInfo->min_speed,
+                                          requestCode);
+    if (relativeZoomInfo->result != 0) {
+        relativeZoomInfo->error = errorMessage(relativeZoomInfo->result);
+        return;
+    }
+
+    requestCode              = UVC_GET_MAX;
+    relativeZoomInfo->result = getZoomRel(uvcDevice,
+                                          &relativeZoomInfo->direction,
+                                          &relativeZoomInfo->digital_zoom,
+                                          &relativeZoomInfo->max_speed,
+                                          requestCode);
+    if (relativeZoomInfo->result != 0) {
+        relativeZoomInfo->error = errorMessage(relativeZoomInfo->result);
+        return;
+    }
+
+    requestCode              = UVC_GET_RES;
+    relativeZoomInfo->result = getZoomRel(uvcDevice,
+                                          &relativeZoomInfo->direction,
+                                          &relativeZoomInfo->digital_zoom,
+                                          &relativeZoomInfo->resolution_speed,
+                                          requestCode);
+    if (relativeZoomInfo->result != 0) {
+        relativeZoomInfo->error = errorMessage(relativeZoomInfo->result);
+        return;
+    }
+
+    requestCode              = UVC_GET_DEF;
+    relativeZoomInfo->result = getZoomRel(uvcDevice,
+                                          &relativeZoomInfo->direction,
+                                          &relativeZoomInfo->digital_zoom,
+                                          &relativeZoomInfo->default_speed,
+                                          requestCode);
+    if (relativeZoomInfo->result != 0) {
+        relativeZoomInfo->error = errorMessage(relativeZoomInfo->result);
+        return;
+    }
+
+    requestCode              = UVC_GET_CUR;
+    relativeZoomInfo->result = getZoomRel(uvcDevice,
+                                          &relativeZoomInfo->direction,
+                                          &relativeZoomInfo->digital_zoom,
+                                          &relativeZoomInfo->current_speed,
+                                          requestCode);
+    if (relativeZoomInfo->result != 0) {
+        relativeZoomInfo->error = errorMessage(relativeZoomInfo->result);
+        return;
+    }
+}
+
+void setRelativeZoom(struct UVCDevice* uvcDevice, struct RelativeZoom* relativeZoom) {
+    relativeZoom->result = setZoomRel(
+        uvcDevice, relativeZoom->direction, 1, relativeZoom->speed);
+    if (relativeZoom->result != 0) {
+        relativeZoom->error = errorMessage(relativeZoom->result);
+        return;
+    }
+}
+
+// absolute pan tilt operations
+void getAbsolutePanTiltInfo(struct UVCDevice*           uvcDevice,
+                            struct AbsolutePanTiltInfo* absolutePanTiltInfo) {
+    enum uvc_req_code requestCode;
+
+    requestCode                 = UVC_GET_MIN;
+    absolutePanTiltInfo->result = getPanTiltAbs(uvcDevice,
+                                                &absolutePanTiltInfo->min_pan,
+                                                &absolutePanTiltInfo->min_tilt,
+                                                requestCode);
+    if (absolutePanTiltInfo->result != 0) {
+        absolutePanTiltInfo->error = errorMessage(absolutePanTiltInfo->result);
+        return;
+    }
+
+    requestCode                 = UVC_GET_MAX;
+    absolutePanTiltInfo->result = getPanTiltAbs(uvcDevice,
+                                                &absolutePanTiltInfo->max_pan,
+                                                &absolutePanTiltInfo->max_tilt,
+                                                requestCode);
+    if (absolutePanTiltInfo->result != 0) {
+        absolutePanTiltInfo->error = errorMessage(absolutePanTiltInfo->result);
+        return;
+    }
+
+    requestCode                 = UVC_GET_RES;
+    absolutePanTiltInfo->result = getPanTiltAbs(uvcDevice,
+                                                &absolutePanTiltInfo->resolution_pan,
+                                                &absolutePanTiltInfo->resolution_tilt,
+                                                requestCode);
+    if (absolutePanTiltInfo->result != 0) {
+        absolutePanTiltInfo->error = errorMessage(absolutePanTiltInfo->result);
+        return;
+    }
+
+    requestCode                 = UVC_GET_DEF;
+    absolutePanTiltInfo->result = getPanTiltAbs(uvcDevice,
+                                                &absolutePanTiltInfo->default_pan,
+                                                &absolutePanTiltInfo->default_tilt,
+                                                requestCode);
+    if (absolutePanTiltInfo->result != 0) {
+        absolutePanTiltInfo->error = errorMessage(absolutePanTiltInfo->result);
+        return;
+    }
+
+    requestCode                 = UVC_GET_CUR;
+    absolutePanTiltInfo->result = getPanTiltAbs(uvcDevice,
+                                                &absolutePanTiltInfo->current_pan,
+                                                &absolutePanTiltInfo->current_tilt,
+                                                requestCode);
+    if (absolutePanTiltInfo->result != 0) {
+        absolutePanTiltInfo->error = errorMessage(absolutePanTiltInfo->result);
+        return;
+    }
+}
+
+void setAbsolutePanTilt(struct UVCDevice* uvcDevice, struct AbsolutePanTilt* absolutePanTilt) {
+    absolutePanTilt->result = setPanTiltAbs(
+        uvcDevice, absolutePanTilt->pan, absolutePanTilt->tilt);
+    if (absolutePanTilt->result != 0) {
+        absolutePanTilt->error = errorMessage(absolutePanTilt->result);
+        return;
+    }
+}
+
+uvc_error_t getCurrentPanTilt(struct UVCDevice* uvcDevice, int32_t* pan, int32_t* tilt) {
+    return getPanTiltAbs(uvcDevice, pan, tilt, UVC_GET_CUR);
+}
+
+// relative pan tilt operations
+void getRelativePanTiltInfo(struct UVCDevice*           uvcDevice,
+                            struct RelativePanTiltInfo* relativePanTiltInfo) {
+    enum uvc_req_code requestCode;
+
+    requestCode                 = UVC_GET_MIN;
+    relativePanTiltInfo->result = getPanTiltRel(uvcDevice,
+                                                &relativePanTiltInfo->pan_direction,
+                                                &relativePanTiltInfo->min_pan_speed,
+                                                &relativePanTiltInfo->tilt_direction,
+                                                &relativePanTiltInfo->min_tilt_speed,
+                                                requestCode);
+    if (relativePanTiltInfo->result != 0) {
+        relativePanTiltInfo->error = errorMessage(relativePanTiltInfo->result);
+        return;
+    }
+
+    requestCode                 = UVC_GET_MAX;
+    relativePanTiltInfo->result = getPanTiltRel(uvcDevice,
+                                                &relativePanTiltInfo->pan_direction,
+                                                &relativePanTiltInfo->max_pan_speed,
+                                                &relativePanTiltInfo->tilt_direction,
+                                                &relativePanTiltInfo->max_tilt_speed,
+                                                requestCode);
+    if (relativePanTiltInfo->result != 0) {
+        relativePanTiltInfo->error = errorMessage(relativePanTiltInfo->result);
+        return;
+    }
+
+    requestCode                 = UVC_GET_RES;
+    relativePanTiltInfo->result = getPanTiltRel(uvcDevice,
+                                                &relativePanTiltInfo->pan_direction,
+                                                &relativePanTiltInfo->resolution_pan_speed,
+                                                &relativePanTiltInfo->tilt_direction,
+                                                &relativePanTiltInfo->resolution_tilt_speed,
+                                                requestCode);
+    if (relativePanTiltInfo->result != 0) {
+        relativePanTiltInfo->error = errorMessage(relativePanTiltInfo->result);
+        return;
+    }
+
+    requestCode                 = UVC_GET_DEF;
+    relativePanTiltInfo->result = getPanTiltRel(uvcDevice,
+                                                &relativePanTiltInfo->pan_direction,
+                                                &relativePanTiltInfo->default_pan_speed,
+                                                &relativePanTiltInfo->tilt_direction,
+                                                &relativePanTiltInfo->default_tilt_speed,
+                                                requestCode);
+    if (relativePanTiltInfo->result != 0) {
+        relativePanTiltInfo->error = errorMessage(relativePanTiltInfo->result);
+        return;
+    }
+
+    requestCode                 = UVC_GET_CUR;
+    relativePanTiltInfo->result = getPanTiltRel(uvcDevice,
+                                                &relativePanTiltInfo->pan_direction,
+                                                &relativePanTiltInfo->current_pan_speed,
+                                                &relativePanTiltInfo->tilt_direction,
+                                                &relativePanTiltInfo->current_tilt_speed,
+                                                requestCode);
+    if (relativePanTiltInfo->result != 0) {
+        relativePanTiltInfo->error = errorMessage(relativePanTiltInfo->result);
+        return;
+    }
+}
+
+void setRelativePanTilt(struct UVCDevice* uvcDevice, struct RelativePanTilt* relativePanTilt) {
+    relativePanTilt->result = setPanTiltRel(uvcDevice,
+                                            relativePanTilt->pan_direction,
+                                            relativePanTilt->pan_speed,
+                                            relativePanTilt->tilt_direction,
+                                            relativePanTilt->tilt_speed);
+    if (relativePanTilt->result != 0) {
+        relativePanTilt->error = errorMessage(relativePanTilt->result);
+        return;
+    }
+}
+
+}  // namespace ptz
@@ -0,0 +1,188 @@
+#ifndef PTZ_DEVICE_H
+#define PTZ_DEVICE_H
+
+#include <stdint.h>
+#include <atomic>
+#include "libuvc/libuvc.h"
+
+namespace ptz {
+
+struct SimCamera;
+
+#define DEVICE_SERIAL_SIZE 64
+#define DEVICE_PORT_SIZE 32
+
+// open close device operations. with several identical cameras attached,
+// serial or port picks one, otherwise the first matching vendor/product
+// opens. vendor and product 0 match any camera.
+//
+// every transfer finishes by deadline, failing with UVC_ERROR_TIMEOUT, and
+// gives up with UVC_ERROR_INTERRUPTED as soon as *cancels moves away from
+// cancelMark. the session fills both in, see sessionCancel.
+struct UVCDevice {
+    uvc_context_t*       ctx;
+    uvc_device_t*        device;
+    uvc_device_handle_t* devicehandle;
+    uvc_error_t          result;
+    const char*          error;
+    int                  vendorId;
+    int                  productId;
+    char                 serial[DEVICE_SERIAL_SIZE];  // empty for any
+    char                 port[DEVICE_PORT_SIZE];      // usb bus and port path like "1-2.3"
+    int                  simulated;                   // route transfers to the simulated backend
+    SimCamera*           sim;
+
+    uint64_t                     deadline;  // monotonicNanos(), 0 for none
+    const std::atomic<uint32_t>* cancels;   // NULL when nothing can cancel
+    uint32_t                     cancelMark;
+
+    // allocated by each open of a real camera and freed by its close, so the
+    // transfers in between allocate nothing. NULL for simulated cameras.
+    struct libusb_transfer* transfer;
+    uint8_t                 controlInterface;  // wIndex of the video control interface
+
+    // which attachment of the camera the last open reached, bus and address
+    // for real cameras. it changes when the camera re-enumerates.
+    uint32_t attachment;
+};
+void openDevice(UVCDevice* uvcDevice);
+void closeDevice(UVCDevice* uvcDevice);
+
+// process wide open/close totals
+struct DeviceCounters {
+    uint64_t opens;
+    uint64_t closes;
+    uint64_t failures;  // opens that did not return a handle
+    int64_t  open;      // handles currently held
+};
+void getDeviceCounters(struct DeviceCounters* counters);
+
+// raw camera terminal transfers of exactly length bytes. every control,
+// typed accessors included, goes through these two. see control.h.
+uvc_error_t getCameraControl(struct UVCDevice* uvcDevice,
+                             uint8_t           selector,
+                             uint8_t*          data,
+                             int               length,
+                             enum uvc_req_code requestCode);
+uvc_error_t setCameraControl(struct UVCDevice* uvcDevice,
+                             uint8_t           selector,
+                             const uint8_t*    data,
+                             int               length);
+
+// device operation support check
+struct DeviceCapability {
+    int absolute_zoom;
+    int relative_zoom;
+    int absolute_pan_tilt;
+    int relative_pan_tilt;
+    int absolute_roll;
+    int relative_roll;
+};
+// a control counts as missing when the camera stalls or rejects it. a
+// timeout, cancel or unplug fails the whole check instead.
+uvc_error_t getDeviceCapability(struct UVCDevice* uvcDevice, struct DeviceCapability* capability);
+
+// absolute zoom operations
+struct AbsoluteZoomInfo {
+    uint16_t    min;
+    uint16_t    max;
+    uint16_t    resolution;
+    uint16_t    current;
+    uint16_t    def;
+    uvc_error_t result;
+    const char* error;
+};
+void getAbsoluteZoomInfo(struct UVCDevice* uvcDevice, struct AbsoluteZoomInfo* absoluteZoomInfo);
+
+struct AbsoluteZoom {
+    uint16_t    zoom;
+    uvc_error_t result;
+    const char* error;
+};
+void setAbsoluteZoom(struct UVCDevice* uvcDevice, struct AbsoluteZoom* absoluteZoom);
+// the current zoom alone, one transfer where the info read takes five
+uvc_error_t getCurrentZoom(struct UVCDevice* uvcDevice, uint16_t* zoom);
+
+// relative zoom operations
+struct RelativeZoomInfo {
+    int8_t      direction;
+    uint8_t     digital_zoom;
+    uint8_t     min_speed;
+    uint8_t     max_speed;
+    uint8_t     resolution_speed;
+    uint8_t     current_speed;
+    uint8_t     default_speed;
+    uvc_error_t result;
+    const char* error;
+};
+void getRelativeZoomInfo(struct UVCDevice* uvcDevice, struct RelativeZoomInfo* relativeZoomInfo);
+
+struct RelativeZoom {
+    int8_t      direction;
+    int8_t      speed;
+    uvc_error_t result;
+    const char* error;
+};
+void setRelativeZoom(struct UVCDevice* uvcDevice, struct RelativeZoom* relativeZoom);
+
+// absolute pan tilt operations
+struct AbsolutePanTiltInfo {
+    int32_t     min_pan;
+    int32_t     min_tilt;
+    int32_t     max_pan;
+    int32_t     max_tilt;
+    int32_t     resolution_pan;
+    int32_t     resolution_tilt;
+    int32_t     current_pan;
+    int32_t     current_tilt;
+    int32_t     default_pan;
+    int32_t     default_tilt;
+    uvc_error_t result;
+    const char* error;
+};
+void getAbsolutePanTiltInfo(struct UVCDevice*           uvcDevice,
+                            struct AbsolutePanTiltInfo* absolutePanTiltInfo);
+
+struct AbsolutePanTilt {
+    int32_t     pan;
+    int32_t     tilt;
+    uvc_error_t result;
+    const char* error;
+};
+void setAbsolutePanTilt(struct UVCDevice* uvcDevice, struct AbsolutePanTilt* absolutePanTilt);
+// the current pan and tilt alone, one transfer where the info read takes five
+uvc_error_t getCurrentPanTilt(struct UVCDevice* uvcDevice, int32_t* pan, int32_t* tilt);
+
+// relative pan tilt operations
+struct RelativePanTiltInfo {
+    int8_t      pan_direction;
+    int8_t      tilt_direction;
+    uint8_t     min_pan_speed;
+    uint8_t     min_tilt_speed;
+    uint8_t     max_pan_speed;
+    uint8_t     max_tilt_speed;
+    uint8_t     resolution_pan_speed;
+    uint8_t     resolution_tilt_speed;
+    uint8_t     default_pan_speed;
+    uint8_t     default_tilt_speed;
+    uint8_t     current_pan_speed;
+    uint8_t     current_tilt_speed;
+    uvc_error_t result;
+    const char* error;
+};
+void getRelativePanTiltInfo(struct UVCDevice*           uvcDevice,
+                            struct RelativePanTiltInfo* relativePanTiltInfo);
+
+struct RelativePanTilt {
+    int8_t      pan_direction;
+    uint8_t     pan_speed;
+    int8_t      tilt_direction;
+    uint8_t     tilt_speed;
+    uvc_error_t result;
+    const char* error;
+};
+void setRelativePanTilt(struct UVCDevice* uvcDevice, struct RelativePanTilt* relativePanTilt);
+
+}  // namespace ptz
+
+#endif  // PTZ_DEVICE_H
@@ -0,0 +1,305 @@
+#include "device_index.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include "simulator.h"
+#include "stats.h"
+
+namespace ptz {
+
+// a miss rebuilds the index at most this often, so a camera that is not
+// there does not turn every open back into a full enumeration
+#define DEVICE_INDEX_MISS_REFRESH_NS 250000000ULL
+
+// usb allows at most 7 tiers of hubs
+#define DEVICE_PORT_DEPTH 7
+
+// the interface camera terminal requests go to, from the uvc spec
+#define DEVICE_CLASS_VIDEO 0x0e
+#define DEVICE_SUBCLASS_VIDEO_CONTROL 0x01
+
+struct IndexedDevice {
+    struct DeviceInfo info;
+    uvc_device_t*     device;  // the index holds one reference
+    uint8_t           controlInterface;
+};
+
+struct DeviceIndex {
+    std::mutex mutex;
+    // created on first use and kept, indexed devices belong to it. published
+    // once set up, transfers read it without the lock.
+    std::atomic<libusb_context*> usb;
+    uvc_context_t*               ctx;
+    uint64_t                     refreshedAt;
+
+    std::vector<struct IndexedDevice> devices;
+};
+
+static struct DeviceIndex deviceIndex;
+
+static void copyString(char* out, size_t size, const char* value) {
+    snprintf(out, size, "%s", value != NULL ? value : "");
+}
+
+// "bus-port.port...", the same path linux shows under /sys/bus/usb/devices
+static void formatPort(libusb_device* device, char* out, size_t size) {
+    uint8_t ports[DEVICE_PORT_DEPTH];
+    int     count = libusb_get_port_numbers(device, ports, DEVICE_PORT_DEPTH);
+    int     used  = snprintf(out, size, "%d", libusb_get_bus_number(device));
+    for (int i = 0; i < count && used > 0 && (size_t)used < size; i++) {
+        used += snprintf(out + used, size - used, "%c%d", i == 0 ? '-' : '.', ports[i]);
+    }
+}
+
+// the first video control interface, as libuvc picks it
+static uint8_t findControlInterface(libusb_device* device) {
+    struct libusb_config_descriptor* config;
+    if (libusb_get_active_config_descriptor(device, &config) != 0) {
+        return 0;
+    }
+    uint8_t number = 0;
+    for (int i = 0; i < config->bNumInterfaces; i++) {
+        const struct libusb_interface* interface = &config->interface[i];
+        if (interface->num_altsetting > 0 &&
+            interface->altsetting[0].bInterfaceClass == DEVICE_CLASS_VIDEO &&
+            interface->altsetting[0].bInterfaceSubClass == DEVICE_SUBCLASS_VIDEO_CONTROL) {
+            number = interface->altsetting[0].bInterfaceNumber;
+            break;
+        }
+    }
+    libusb_free_config_descriptor(config);
+    return number;
+}
+
+static uvc_error_t refreshLocked(struct DeviceIndex* index) {
+    if (index->ctx == NULL) {
+        libusb_context* usb;
+        if (libusb_init(&usb) != 0) {
+            return UVC_ERROR_OTHER;
+        }
+        // handing libuvc our own context keeps it from starting an event
+        // thread, control transfers run their own events
+        uvc_error_t result = uvc_init(&index->ctx, usb);
+        if (result != 0) {
+            libusb_exit(usb);
+            index->ctx = NULL;
+            return result;
+        }
+        index->usb.store(usb, std::memory_order_release);
+    }
+
+    uvc_device_t** list;
+    uvc_error_t    result = uvc_get_device_list(index->ctx, &list);
+    if (result != 0) {
+        return result;
+    }
+    libusb_context* usb = index->usb.load(std::memory_order_relaxed);
+    libusb_device** usbList;
+    ssize_t         usbCount = libusb_get_device_list(usb, &usbList);
+
+    std::vector<struct IndexedDevice> devices;
+    for (int i = 0; list[i] != NULL; i++) {
+        uvc_device_descriptor_t* descriptor;
+        if (uvc_get_device_descriptor(list[i], &descriptor) != UVC_SUCCESS) {
+            continue;  // gone again already, or not ours to read
+        }
+
+        struct IndexedDevice indexed;
+        memset(&indexed.info, 0, sizeof(indexed.info));
+        indexed.device           = list[i];
+        indexed.controlInterface = 0;
+        indexed.info.vendorId  = descriptor->idVendor;
+        indexed.info.productId = descriptor->idProduct;
+        indexed.info.bus       = uvc_get_bus_number(list[i]);
+        indexed.info.address   = uvc_get_device_address(list[i]);
+        copyString(indexed.info.serial, sizeof(indexed.info.serial), descriptor->serialNumber);
+        copyString(
+            indexed.info.manufacturer, sizeof(indexed.info.manufacturer), descriptor->manufacturer);
+        copyString(indexed.info.product, sizeof(indexed.info.product), descriptor->product);
+        uvc_free_device_descriptor(descriptor);
+
+        for (ssize_t j = 0; j < usbCount; j++) {
+            if (libusb_get_bus_number(usbList[j]) == indexed.info.bus &&
+                libusb_get_device_address(usbList[j]) == indexed.info.address) {
+                formatPort(usbList[j], indexed.info.port, sizeof(indexed.info.port));
+                indexed.controlInterface = findControlInterface(usbList[j]);
+                struct libusb_device_descriptor usbDescriptor;
+                if (libusb_get_device_descriptor(usbList[j], &usbDescriptor) == 0) {
+                    indexed.info.firmware = usbDescriptor.bcdDevice;
+                }
+                break;
+            }
+        }
+        uvc_ref_device(indexed.device);
+        devices.push_back(indexed);
+    }
+    if (usbCount >= 0) {
+        libusb_free_device_list(usbList, 1);
+    }
+    uvc_free_device_list(list, 1);
+
+    std::sort(devices.begin(),
+              devices.end(),
+              [](const struct IndexedDevice& a, const struct IndexedDevice& b) {
+                  return a.info.bus != b.info.bus ? a.info.bus < b.info.bus
+                                                  : strcmp(a.info.port, b.info.port) < 0;
+              });
+
+    // open handles hold their own references
+    for (struct IndexedDevice& indexed : index->devices) {
+        uvc_unref_device(indexed.device);
+    }
+    index->devices.swap(devices);
+    index->refreshedAt = monotonicNanos();
+    return UVC_SUCCESS;
+}
+
+bool deviceMatches(const struct UVCDevice* uvcDevice, const struct DeviceInfo* info) {
+    return (uvcDevice->vendorId == 0 || uvcDevice->vendorId == info->vendorId) &&
+           (uvcDevice->productId == 0 || uvcDevice->productId == info->productId) &&
+           (uvcDevice->serial[0] == 0 || strcmp(uvcDevice->serial, info->serial) == 0) &&
+           (uvcDevice->port[0] == 0 || strcmp(uvcDevice->port, info->port) == 0);
+}
+
+static struct IndexedDevice* findLocked(struct DeviceIndex*     index,
+                                        const struct UVCDevice* uvcDevice) {
+    for (struct IndexedDevice& indexed : index->devices) {
+        if (deviceMatches(uvcDevice, &indexed.info)) {
+            return &indexed;
+        }
+    }
+    return NULL;
+}
+
+// set up before the first open and kept, so whoever holds an open camera
+// can read it without the lock
+libusb_context* deviceIndexContext() {
+    return deviceIndex.usb.load(std::memory_order_acquire);
+}
+
+uvc_error_t deviceIndexRefresh() {
+    std::lock_guard<std::mutex> lock(deviceIndex.mutex);
+    return refreshLocked(&deviceIndex);
+}
+
+uvc_error_t deviceIndexList(std::vector<struct DeviceInfo>* devices) {
+    std::lock_guard<std::mutex> lock(deviceIndex.mutex);
+    uvc_error_t                 result = refreshLocked(&deviceIndex);
+    devices->clear();
+    for (const struct IndexedDevice& indexed : deviceIndex.devices) {
+        devices->push_back(indexed.info);
+    }
+    return result;
+}
+
+bool deviceIdentify(const struct UVCDevice* uvcDevice, struct DeviceInfo* info) {
+    if (uvcDevice->simulated) {
+        struct SimConfig config;
+        simGetConfig(&config);
+        memset(info, 0, sizeof(*info));
+        info->vendorId  = uvcDevice->vendorId;
+        info->productId = uvcDevice->productId;
+        info->firmware  = config.firmware;
+        copyString(info->serial, sizeof(info->serial), uvcDevice->serial);
+        copyString(info->port, sizeof(info->port), uvcDevice->port);
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(deviceIndex.mutex);
+    struct IndexedDevice*       indexed = findLocked(&deviceIndex, uvcDevice);
+    if (indexed == NULL && (deviceIndex.ctx == NULL || monotonicNanos() - deviceIndex.refreshedAt >=
+                                                           DEVICE_INDEX_MISS_REFRESH_NS)) {
+        if (refreshLocked(&deviceIndex) == 0) {
+            indexed = findLocked(&deviceIndex, uvcDevice);
+        }
+    }
+    if (indexed == NULL) {
+        return false;
+    }
+    *info = indexed->info;
+    return true;
+}
+
+static uint32_t deviceAttachment(const struct DeviceInfo* info) {
+    return (uint32_t)info->bus << 8 | info->address;
+}
+
+bool deviceIndexPresent(const struct UVCDevice* uvcDevice) {
+    // a simulated camera that is gone says so with UVC_ERROR_NO_DEVICE
+    if (uvcDevice->simulated) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(deviceIndex.mutex);
+    if (deviceIndex.ctx == NULL ||
+        monotonicNanos() - deviceIndex.refreshedAt >= DEVICE_INDEX_MISS_REFRESH_NS) {
+        if (refreshLocked(&deviceIndex) != 0) {
+            return false;
+        }
+    }
+    struct IndexedDevice* indexed = findLocked(&deviceIndex, uvcDevice);
+    return indexed != NULL && deviceAttachment(&indexed->info) == uvcDevice->attachment;
+}
+
+void deviceIndexOpen(struct UVCDevice* uvcDevice) {
+    std::lock_guard<std::mutex> lock(deviceIndex.mutex);
+    bool                        refreshed = false;
+    for (;;) {
+        struct IndexedDevice* indexed = findLocked(&deviceIndex, uvcDevice);
+        if (indexed == NULL) {
+            // plugged in since the last look, maybe
+            bool stale = deviceIndex.ctx == NULL ||
+                         monotonicNanos() - deviceIndex.refreshedAt >= DEVICE_INDEX_MISS_REFRESH_NS;
+            if (!refreshed && stale) {
+                refreshed         = true;
+                uvcDevice->result = refreshLocked(&deviceIndex);
+                if (uvcDevice->result != 0) {
+                    return;
+                }
+                continue;
+            }
+            uvcDevice->result = UVC_ERROR_NO_DEVICE;
+            return;
+        }
+
+        uvcDevice->ctx    = deviceIndex.ctx;
+        uvcDevice->result = uvc_open(indexed->device, &uvcDevice->devicehandle);
+        if (uvcDevice->result == 0) {
+            uvcDevice->transfer = libusb_alloc_transfer(0);
+            if (uvcDevice->transfer == NULL) {
+                uvc_close(uvcDevice->devicehandle);
+                uvcDevice->devicehandle = NULL;
+                uvcDevice->result       = UVC_ERROR_NO_MEM;
+                return;
+            }
+            uvcDevice->controlInterface = indexed->controlInterface;
+            uvcDevice->attachment       = deviceAttachment(&indexed->info);
+            uvcDevice->device           = indexed->device;
+            uvc_ref_device(uvcDevice->device);
+            return;
+        }
+        uvcDevice->devicehandle = NULL;
+
+        // unplugged or re-enumerated since it was indexed
+        if (uvcDevice->result != UVC_ERROR_NO_DEVICE || refreshed) {
+            return;
+        }
+        refreshed         = true;
+        uvcDevice->result = refreshLocked(&deviceIndex);
+        if (uvcDevice->result != 0) {
+            return;
+        }
+    }
+}
+
+void deviceIndexClose(struct UVCDevice* uvcDevice) {
+    std::lock_guard<std::mutex> lock(deviceIndex.mutex);
+    libusb_free_transfer(uvcDevice->transfer);
+    uvcDevice->transfer = NULL;
+    uvc_close(uvcDevice->devicehandle);
+    uvc_unref_device(uvcDevice->device);
+}
+
+}  // namespace ptz
@@ -0,0 +1,54 @@
+#ifndef PTZ_DEVICE_INDEX_H
+#define PTZ_DEVICE_INDEX_H
+
+#include <stdint.h>
+#include <vector>
+#include "device.h"
+
+namespace ptz {
+
+// every attached camera with its descriptor strings and usb location, read
+// once and kept, so picking a camera by serial or port is a lookup rather
+// than a descriptor read of every device on each open. rebuilt when a
+// lookup misses or an indexed camera has gone away.
+struct DeviceInfo {
+    int      vendorId;
+    int      productId;
+    char     serial[DEVICE_SERIAL_SIZE];
+    char     manufacturer[DEVICE_SERIAL_SIZE];
+    char     product[DEVICE_SERIAL_SIZE];
+    uint16_t firmware;  // bcdDevice, 0 when it could not be read
+    uint8_t  bus;
+    uint8_t  address;  // changes on every replug, port does not
+    char     port[DEVICE_PORT_SIZE];
+};
+
+// enumerate again now
+uvc_error_t deviceIndexRefresh();
+// the libusb context every indexed camera belongs to, NULL before the first
+// refresh. transfers on open cameras handle their events on it.
+libusb_context* deviceIndexContext();
+// refreshes, then copies out every camera in bus order
+uvc_error_t deviceIndexList(std::vector<struct DeviceInfo>* devices);
+
+// the camera uvcDevice's selectors pick, without opening it. simulated
+// cameras are described from the selectors and the simulator's firmware.
+// false when no such camera is attached.
+bool deviceIdentify(const struct UVCDevice* uvcDevice, struct DeviceInfo* info);
+
+// whether the camera uvcDevice last opened is still attached where it was,
+// enumerating again unless that was done a moment ago. for telling a
+// transfer error from a camera that dropped off the bus.
+bool deviceIndexPresent(const struct UVCDevice* uvcDevice);
+
+// open and close real cameras. every handle shares one libuvc context, so
+// opens and closes take turns.
+void deviceIndexOpen(struct UVCDevice* uvcDevice);
+void deviceIndexClose(struct UVCDevice* uvcDevice);
+
+// does the camera described by info answer to uvcDevice's selectors
+bool deviceMatches(const struct UVCDevice* uvcDevice, const struct DeviceInfo* info);
+
+}  // namespace ptz
+
+#endif  // PTZ_DEVICE_INDEX_H
@@ -0,0 +1,53 @@
+#include "error.h"
+
+namespace ptz {
+
+struct ErrorSpec {
+    int         result;
+    const char* code;
+    const char* message;
+};
+
+// the messages libuvc gives, so nothing callers see changes
+static const struct ErrorSpec errorSpecs[] = {
+    {UVC_SUCCESS, "UVC_SUCCESS", "Success (no error)"},
+    {UVC_ERROR_IO, "UVC_ERROR_IO", "Input/output error"},
+    {UVC_ERROR_INVALID_PARAM, "UVC_ERROR_INVALID_PARAM", "Invalid parameter"},
+    {UVC_ERROR_ACCESS, "UVC_ERROR_ACCESS", "Access denied"},
+    {UVC_ERROR_NO_DEVICE, "UVC_ERROR_NO_DEVICE", "No such device"},
+    {UVC_ERROR_NOT_FOUND, "UVC_ERROR_NOT_FOUND", "Not found"},
+    {UVC_ERROR_BUSY, "UVC_ERROR_BUSY", "Resource busy"},
+    {UVC_ERROR_TIMEOUT, "UVC_ERROR_TIMEOUT", "Operation timed out"},
+    {UVC_ERROR_OVERFLOW, "UVC_ERROR_OVERFLOW", "Overflow"},
+    {UVC_ERROR_PIPE, "UVC_ERROR_PIPE", "Pipe error"},
+    {UVC_ERROR_INTERRUPTED, "UVC_ERROR_INTERRUPTED", "System call interrupted"},
+    {UVC_ERROR_NO_MEM, "UVC_ERROR_NO_MEM", "Insufficient memory"},
+    {UVC_ERROR_NOT_SUPPORTED, "UVC_ERROR_NOT_SUPPORTED", "Operation not supported"},
+    {UVC_ERROR_INVALID_DEVICE, "UVC_ERROR_INVALID_DEVICE", "Device is not UVC-compliant"},
+    {UVC_ERROR_INVALID_MODE, "UVC_ERROR_INVALID_MODE", "Mode not supported"},
+    {UVC_ERROR_CALLBACK_EXISTS,
+     "UVC_ERROR_CALLBACK_EXISTS",
+     "Resource has a callback (can't use polling and async)"},
+    {UVC_ERROR_OTHER, "UVC_ERROR_OTHER", "Unknown error"},
+};
+
+#define ERROR_SPEC_COUNT (sizeof(errorSpecs) / sizeof(errorSpecs[0]))
+
+static const struct ErrorSpec* errorSpec(int result) {
+    for (size_t i = 0; i < ERROR_SPEC_COUNT; i++) {
+        if (errorSpecs[i].result == result) {
+            return &errorSpecs[i];
+        }
+    }
+    return &errorSpecs[ERROR_SPEC_COUNT - 1];
+}
+
+const char* errorCode(int result) {
+    return errorSpec(result)->code;
+}
+
+const char* errorMessage(int result) {
+    return errorSpec(result)->message;
+}
+
+}  // namespace ptz
@@ -0,0 +1,17 @@
+#ifndef PTZ_ERROR_H
+#define PTZ_ERROR_H
+
+#include "libuvc/libuvc.h"
+
+namespace ptz {
+
+// what a failure is called and what it says, both from static tables so a
+// failing command never allocates to report itself. codes are the libuvc
+// enum names, e.g. "UVC_ERROR_PIPE", and anything unknown is
+// UVC_ERROR_OTHER. the pointers live for the life of the process.
+const char* errorCode(int result);
+const char* errorMessage(int result);
+
+}  // namespace ptz
+
+#endif  // PTZ_ERROR_H
@@ -0,0 +1,367 @@
+#include "estimator.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace ptz {
+
+// span assumed for an axis whose range has never been read
+#define ESTIMATE_WIDE_PAN_TILT (360.0 * 3600)
+#define ESTIMATE_WIDE_ZOOM 16384.0
+
+// the error at which an axis is half trusted, as a fraction of its range,
+// or in its own units while the range is unknown
+#define ESTIMATE_TOLERANCE 0.01
+#define ESTIMATE_TOLERANCE_PAN_TILT 3600.0
+#define ESTIMATE_TOLERANCE_ZOOM 100.0
+
+void speedModelDefaults(struct SpeedModel* model) {
+    model->pan_speed   = 1800;
+    model->tilt_speed  = 1800;
+    model->zoom_speed  = 400;
+    model->pan_slew    = 1800 * 24;
+    model->tilt_slew   = 1800 * 20;
+    model->zoom_slew   = 400 * 7;
+    model->speed_error = 0.1;
+    model->read_lag_ms = 100;
+}
+
+static double relativeSpeed(const struct SpeedModel* model, int axis) {
+    return axis == ESTIMATE_PAN ? model->pan_speed
+                                : (axis == ESTIMATE_TILT ? model->tilt_speed : model->zoom_speed);
+}
+
+static double slewSpeed(const struct SpeedModel* model, int axis) {
+    return axis == ESTIMATE_PAN ? model->pan_slew
+                                : (axis == ESTIMATE_TILT ? model->tilt_slew : model->zoom_slew);
+}
+
+static double axisSpan(const struct EstimatorAxis* state, int axis) {
+    if (state->limited) {
+        return state->max - state->min;
+    }
+    return axis == ESTIMATE_ZOOM ? ESTIMATE_WIDE_ZOOM : ESTIMATE_WIDE_PAN_TILT;
+}
+
+// where the axis is at now and how far off that may be, false when it has
+// stopped moving
+static bool project(const struct EstimatorAxis* state,
+                    const struct SpeedModel*    model,
+                    int                         axis,
+                    uint64_t                    now,
+                    double*                     position,
+                    double*                     error) {
+    double seconds = now > state->since ? (double)(now - state->since) / 1e9 : 0;
+    bool   moving  = false;
+    *position      = state->position;
+    *error         = state->error;
+
+    if (state->seeking) {
+        double distance = fabs(state->target - state->position);
+        double traveled = std::min(distance, slewSpeed(model, axis) * seconds);
+        *position += state->target > state->position ? traveled : -traveled;
+        if (now >= state->arriveBy) {
+            *position = state->target;
+            *error    = 0;
+        } else {
+            *error += traveled * model->speed_error;
+            moving = true;
+        }
+    } else if (state->velocity != 0) {
+        *position += state->velocity * seconds;
+        *error += fabs(state->velocity) * seconds * model->speed_error;
+        moving = true;
+    }
+
+    // a camera driven into its end stop stays there
+    if (state->limited && (*position <= state->min || *position >= state->max)) {
+        *position = std::min(std::max(*position, state->min), state->max);
+        moving    = state->seeking && now < state->arriveBy;
+    }
+    *error = std::min(*error, axisSpan(state, axis));
+    return moving;
+}
+
+// move the axis' reference point up to at, before changing how it moves
+static void settle(struct EstimatorAxis*    state,
+                   const struct SpeedModel* model,
+                   int                      axis,
+                   uint64_t                 at) {
+    project(state, model, axis, at, &state->position, &state->error);
+    state->since = at;
+    if (state->seeking && at >= state->arriveBy) {
+        state->seeking = 0;
+    }
+}
+
+// arrival is promised for a camera running slow by the model's error
+static uint64_t arrivalTime(const struct SpeedModel* model,
+                            int                      axis,
+                            double                   distance,
+                            uint64_t                 at) {
+    double slow = slewSpeed(model, axis) * std::max(1 - model->speed_error, 0.01);
+    return at + (uint64_t)(distance / std::max(slow, 1e-9) * 1e9);
+}
+
+static void seek(struct EstimatorAxis*    state,
+                 const struct SpeedModel* model,
+                 int                      axis,
+                 double                   target,
+                 uint64_t                 at) {
+    settle(state, model, axis, at);
+    if (state->limited) {
+        target = std::min(std::max(target, state->min), state->max);
+    }
+
+    // from somewhere unknown it may have the whole range to cover
+    double distance = fabs(target - state->position);
+    if (!state->known) {
+        distance        = axisSpan(state, axis);
+        state->position = target;
+        state->error    = distance;
+        state->known    = 1;
+    }
+    state->seeking  = 1;
+    state->target   = target;
+    state->velocity = 0;
+    state->arriveBy = arrivalTime(model, axis, distance, at);
+}
+
+static void drive(struct EstimatorAxis*    state,
+                  const struct SpeedModel* model,
+                  int                      axis,
+                  int32_t                  direction,
+                  int32_t                  speed,
+                  uint64_t                 at) {
+    settle(state, model, axis, at);
+    state->seeking  = 0;
+    state->velocity = (double)direction * speed * relativeSpeed(model, axis);
+}
+
+static void limit(struct EstimatorAxis* state, double min, double max) {
+    if (max > min) {
+        state->limited = 1;
+        state->min     = min;
+        state->max     = max;
+    }
+}
+
+// fold a read into the estimate. a still camera's read is the truth, a
+// moving one's may be up to read_lag old, so the two are weighted by how
+// far off each may be.
+static void observe(struct EstimatorAxis*    state,
+                    const struct SpeedModel* model,
+                    int                      axis,
+                    double                   value,
+                    double                   min,
+                    double                   max,
+                    uint64_t                 at) {
+    limit(state, min, max);
+    settle(state, model, axis, at);
+
+    double speed = state->seeking ? slewSpeed(model, axis) : fabs(state->velocity);
+    double lag   = speed * model->read_lag_ms / 1000.0;
+    if (!state->known || lag == 0) {
+        state->position = value;
+        state->error    = lag;
+    } else {
+        double estimated = state->error * state->error;
+        double read      = lag * lag;
+        state->position  = (state->position * read + value * estimated) / (estimated + read);
+        state->error     = sqrt(estimated * read / (estimated + read));
+    }
+    state->known  = 1;
+    state->readAt = at;
+
+    if (state->seeking) {
+        double distance = fabs(state->target - state->position);
+        state->seeking  = distance >= 1;
+        state->arriveBy = arrivalTime(model, axis, distance, at);
+    }
+}
+
+void estimatorReset(struct Estimator* estimator) {
+    memset(estimator, 0, sizeof(*estimator));
+}
+
+// setControl on the zoom and pan/tilt controls moves the camera the same
+// way as the dedicated commands, only zoomRelative's speed sits after the
+// digital zoom flag
+static void controlCommand(struct Estimator*        estimator,
+                           const struct SpeedModel* model,
+                           const struct Command*    command,
+                           uint64_t                 at) {
+    struct EstimatorAxis* axes = estimator->axes;
+    const int32_t*        args = command->args;
+    switch (controlSpecs[commandControl(command->op)].selector) {
+        case UVC_CT_ZOOM_ABSOLUTE_CONTROL:
+            seek(&axes[ESTIMATE_ZOOM], model, ESTIMATE_ZOOM, args[0], at);
+            break;
+        case UVC_CT_ZOOM_RELATIVE_CONTROL:
+            drive(&axes[ESTIMATE_ZOOM], model, ESTIMATE_ZOOM, args[0], args[2], at);
+            break;
+        case UVC_CT_PANTILT_ABSOLUTE_CONTROL:
+            seek(&axes[ESTIMATE_PAN], model, ESTIMATE_PAN, args[0], at);
+            seek(&axes[ESTIMATE_TILT], model, ESTIMATE_TILT, args[1], at);
+            break;
+        case UVC_CT_PANTILT_RELATIVE_CONTROL:
+            drive(&axes[ESTIMATE_PAN], model, ESTIMATE_PAN, args[0], args[1], at);
+            drive(&axes[ESTIMATE_TILT], model, ESTIMATE_TILT, args[2], args[3], at);
+            break;
+        default:
+            break;
+    }
+}
+
+// getControl reads a position without its range, getRanges the range alone
+static void controlObserve(struct Estimator*           estimator,
+                           const struct SpeedModel*    model,
+                           const struct Command*       command,
+                           const struct CommandResult* commandResult,
+                           uint64_t                    at) {
+    struct EstimatorAxis*       axes    = estimator->axes;
+    const int32_t*              values  = commandResult->controlValues.values;
+    const struct ControlRanges* ranges  = &commandResult->controlRanges;
+    int                         request = commandControlRequest(command->op);
+    uint32_t                    bounds  = CONTROL_HAS_MIN | CONTROL_HAS_MAX;
+    bool                        range   = (ranges->requests & bounds) == bounds;
+    switch (controlSpecs[commandControl(command->op)].selector) {
+        case UVC_CT_ZOOM_ABSOLUTE_CONTROL:
+            if (request == CONTROL_GET) {
+                observe(&axes[ESTIMATE_ZOOM], model, ESTIMATE_ZOOM, values[0], 0, 0, at);
+                estimator->corrections++;
+            } else if (range) {
+                limit(&axes[ESTIMATE_ZOOM], ranges->min[0], ranges->max[0]);
+            }
+            break;
+        case UVC_CT_PANTILT_ABSOLUTE_CONTROL:
+            if (request == CONTROL_GET) {
+                observe(&axes[ESTIMATE_PAN], model, ESTIMATE_PAN, values[0], 0, 0, at);
+                observe(&axes[ESTIMATE_TILT], model, ESTIMATE_TILT, values[1], 0, 0, at);
+                estimator->corrections++;
+            } else if (range) {
+                limit(&axes[ESTIMATE_PAN], ranges->min[0], ranges->max[0]);
+                limit(&axes[ESTIMATE_TILT], ranges->min[1], ranges->max[1]);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void estimatorCommand(struct Estimator*        estimator,
+                      const struct SpeedModel* model,
+                      const struct Command*    command,
+                      uint64_t                 at) {
+    struct EstimatorAxis* axes = estimator->axes;
+    const int32_t*        args = command->args;
+    if (commandControl(command->op) >= 0) {
+        if (commandControlRequest(command->op) == CONTROL_SET) {
+            controlCommand(estimator, model, command, at);
+        }
+        return;
+    }
+    switch (command->op) {
+        case CMD_ABSOLUTE_PAN_TILT:
+            seek(&axes[ESTIMATE_PAN], model, ESTIMATE_PAN, args[0], at);
+            seek(&axes[ESTIMATE_TILT], model, ESTIMATE_TILT, args[1], at);
+            break;
+        case CMD_ABSOLUTE_ZOOM:
+            seek(&axes[ESTIMATE_ZOOM], model, ESTIMATE_ZOOM, args[0], at);
+            break;
+        case CMD_RELATIVE_PAN_TILT:
+            drive(&axes[ESTIMATE_PAN], model, ESTIMATE_PAN, args[0], args[1], at);
+            drive(&axes[ESTIMATE_TILT], model, ESTIMATE_TILT, args[2], args[3], at);
+            break;
+        case CMD_RELATIVE_ZOOM:
+            drive(&axes[ESTIMATE_ZOOM], model, ESTIMATE_ZOOM, args[0], args[1], at);
+            break;
+        default:
+            break;
+    }
+}
+
+void estimatorObserve(struct Estimator*           estimator,
+                      const struct SpeedModel*    model,
+                      const struct Command*       command,
+                      const struct CommandResult* commandResult,
+                      uint64_t                    at) {
+    struct EstimatorAxis* axes = estimator->axes;
+    if (commandControl(command->op) >= 0) {
+        controlObserve(estimator, model, command, commandResult, at);
+        return;
+    }
+    switch (command->op) {
+        case CMD_GET_ABSOLUTE_PAN_TILT: {
+            const struct AbsolutePanTiltInfo* info = &commandResult->absolutePanTiltInfo;
+            observe(&axes[ESTIMATE_PAN],
+                    model,
+                    ESTIMATE_PAN,
+                    info->current_pan,
+                    info->min_pan,
+                    info->max_pan,
+                    at);
+            observe(&axes[ESTIMATE_TILT],
+                    model,
+                    ESTIMATE_TILT,
+                    info->current_tilt,
+                    info->min_tilt,
+                    info->max_tilt,
+                    at);
+            estimator->corrections++;
+            break;
+        }
+        case CMD_GET_ABSOLUTE_ZOOM: {
+            const struct AbsoluteZoomInfo* info = &commandResult->absoluteZoomInfo;
+            observe(&axes[ESTIMATE_ZOOM],
+                    model,
+                    ESTIMATE_ZOOM,
+                    info->current,
+                    info->min,
+                    info->max,
+                    at);
+            estimator->corrections++;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void estimatorGet(const struct Estimator*  estimator,
+                  const struct SpeedModel* model,
+                  uint64_t                 now,
+                  struct Estimate*         estimate) {
+    uint64_t readAt = UINT64_MAX;
+    memset(estimate, 0, sizeof(*estimate));
+    estimate->confidence  = 1;
+    estimate->corrections = estimator->corrections;
+
+    int known = 0;
+    for (int axis = 0; axis < ESTIMATE_AXES; axis++) {
+        const struct EstimatorAxis* state = &estimator->axes[axis];
+        if (!state->known) {
+            continue;
+        }
+        known++;
+        estimate->known[axis] = 1;
+        if (project(state, model, axis, now, &estimate->position[axis], &estimate->error[axis])) {
+            estimate->moving = 1;
+        }
+        double tolerance = state->limited ? (state->max - state->min) * ESTIMATE_TOLERANCE
+                                          : (axis == ESTIMATE_ZOOM ? ESTIMATE_TOLERANCE_ZOOM
+                                                                   : ESTIMATE_TOLERANCE_PAN_TILT);
+        tolerance            = std::max(tolerance, 1.0);
+        estimate->confidence = std::min(estimate->confidence,
+                                        tolerance / (tolerance + estimate->error[axis]));
+        if (state->readAt != 0) {
+            readAt = std::min(readAt, state->readAt);
+        }
+    }
+    if (known == 0) {
+        estimate->confidence = 0;
+    }
+    estimate->age = readAt == UINT64_MAX ? UINT64_MAX : (now > readAt ? now - readAt : 0);
+}
+
+}  // namespace ptz
@@ -0,0 +1,79 @@
+#ifndef PTZ_ESTIMATOR_H
+#define PTZ_ESTIMATOR_H
+
+#include <stdint.h>
+#include "command.h"
+
+namespace ptz {
+
+// where a camera is between reads, without asking it. relative moves are
+// integrated from the commanded speed, absolute moves head for their target
+// at the camera's slew rate, and every pan/tilt or zoom read pulls the
+// estimate back to what the camera reported. reads taken mid-move are
+// blended rather than trusted, as some cameras report a stale position
+// while moving.
+struct SpeedModel {
+    double   pan_speed;    // arc seconds per second per relative speed step
+    double   tilt_speed;   // arc seconds per second per relative speed step
+    double   zoom_speed;   // zoom units per second per relative speed step
+    double   pan_slew;     // arc seconds per second during an absolute move
+    double   tilt_slew;    // arc seconds per second during an absolute move
+    double   zoom_slew;    // zoom units per second during an absolute move
+    double   speed_error;  // fraction the speeds above may be off by
+    uint32_t read_lag_ms;  // how stale a read taken mid-move may be
+};
+// matches the simulator, real cameras want their own
+void speedModelDefaults(struct SpeedModel* model);
+
+enum EstimateAxis { ESTIMATE_PAN = 0, ESTIMATE_TILT, ESTIMATE_ZOOM, ESTIMATE_AXES };
+
+struct EstimatorAxis {
+    int      known;     // read, or sent to an absolute position, at least once
+    double   position;  // as of since
+    double   error;     // how far off position may be, same units
+    uint64_t since;
+    double   velocity;  // relative move, units per second
+    int      seeking;   // absolute move in progress
+    double   target;
+    uint64_t arriveBy;  // when even a slow camera has reached target
+    int      limited;   // range known from a read
+    double   min;
+    double   max;
+    uint64_t readAt;  // 0 when never read
+};
+
+struct Estimator {
+    struct EstimatorAxis axes[ESTIMATE_AXES];
+    uint64_t             corrections;  // reads folded in
+};
+
+struct Estimate {
+    int      known[ESTIMATE_AXES];
+    double   position[ESTIMATE_AXES];
+    double   error[ESTIMATE_AXES];
+    double   confidence;  // 0 nothing known, 1 just read and still
+    int      moving;
+    uint64_t age;  // nanoseconds since the least recently read known axis was read
+    uint64_t corrections;
+};
+
+void estimatorReset(struct Estimator* estimator);
+// a write landed on the camera at time at
+void estimatorCommand(struct Estimator*        estimator,
+                      const struct SpeedModel* model,
+                      const struct Command*    command,
+                      uint64_t                 at);
+// a read came back from the camera at time at
+void estimatorObserve(struct Estimator*           estimator,
+                      const struct SpeedModel*    model,
+                      const struct Command*       command,
+                      const struct CommandResult* commandResult,
+                      uint64_t                    at);
+void estimatorGet(const struct Estimator*  estimator,
+                  const struct SpeedModel* model,
+                  uint64_t                 now,
+                  struct Estimate*         estimate);
+
+}  // namespace ptz
+
+#endif  // PTZ_ESTIMATOR_H
@@ -0,0 +1,342 @@
+#include "group.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include "session.h"
+#include "stats.h"
+#include "watchdog.h"
+
+namespace ptz {
+
+// the barrier opens this far ahead of the last arrival, so every thread is
+// awake by then. they sleep to within the last stretch of it and spin the
+// rest of the way to the same instant.
+#define GROUP_RELEASE_LEAD_NS 300000ULL
+#define GROUP_RELEASE_SPIN_NS 50000ULL
+// how often a member waiting at the barrier looks for a cancel
+#define GROUP_CANCEL_POLL_NS 10000000ULL
+
+enum SlotState {
+    SLOT_PENDING = 0,  // not at the barrier yet
+    SLOT_ARRIVED,      // at the barrier, or finished without getting there
+    SLOT_MISSED,       // the barrier opened without it, it sends nothing
+};
+
+struct GroupSlot {
+    struct Group* group;
+    uint32_t      index;
+    bool          reached;  // been to the barrier, only touched on the member's thread
+    int           state;    // under the group's mutex
+};
+
+// fires at the group's deadline, holding a reference until it has
+struct GroupTimer {
+    struct WatchdogTimer timer;
+    struct Group*        group;
+};
+
+struct Group {
+    std::vector<struct GroupMember> members;
+    std::vector<struct GroupSlot>   slots;
+    std::mutex                      mutex;
+    std::condition_variable         opened;
+    uint32_t                        waiting;  // members yet to reach the barrier
+    uint32_t                        running;  // members yet to finish or be missed
+    uint32_t                        refs;     // the caller, every queued member and the timer
+    bool                            released;
+    uint64_t                        releaseAt;
+    struct GroupTimer               deadline;
+    bool                            timed;  // the deadline was scheduled
+    GroupCompletion                 done;
+    void*                           context;
+};
+
+// groups sharing a camera queue on it in the order they were started, so
+// none waits on a camera the other holds at its barrier
+static std::mutex groupsMutex;
+
+static void release(struct Group* group) {
+    bool last;
+    {
+        std::lock_guard<std::mutex> lock(group->mutex);
+        last = --group->refs == 0;
+    }
+    if (last) {
+        delete group;
+    }
+}
+
+static void openLocked(struct Group* group) {
+    group->releaseAt = monotonicNanos() + GROUP_RELEASE_LEAD_NS;
+    group->released  = true;
+    group->opened.notify_all();
+}
+
+// the group's time is up, whoever is at the barrier goes without the rest.
+// returns true when that leaves nothing running.
+static bool missLocked(struct Group* group) {
+    if (group->released) {
+        return false;
+    }
+    for (struct GroupSlot& slot : group->slots) {
+        if (slot.state != SLOT_PENDING) {
+            continue;
+        }
+        struct GroupMember* member   = &group->members[slot.index];
+        slot.state                   = SLOT_MISSED;
+        member->commandResult.result = UVC_ERROR_TIMEOUT;
+        member->commandResult.error  = "Group started without this camera";
+        member->finished             = monotonicNanos();
+        group->running--;
+    }
+    group->waiting = 0;
+    openLocked(group);
+    return group->running == 0;
+}
+
+static void deadlineExpired(struct WatchdogTimer* timer) {
+    struct Group* group = ((struct GroupTimer*)timer)->group;
+    bool          last;
+    {
+        std::lock_guard<std::mutex> lock(group->mutex);
+        last = missLocked(group);
+    }
+    if (last) {
+        group->done(group->context);
+    }
+    release(group);
+}
+
+// the gate, called once the member's device is open. uvcDevice is NULL when
+// the member finished without opening it. a cancel on the member's camera
+// takes it out of the barrier without holding up the others.
+static uvc_error_t arrive(void* context, const struct UVCDevice* uvcDevice) {
+    struct GroupSlot* slot  = (struct GroupSlot*)context;
+    struct Group*     group = slot->group;
+    slot->reached           = true;
+
+    std::unique_lock<std::mutex> lock(group->mutex);
+    if (slot->state == SLOT_MISSED) {
+        return UVC_ERROR_TIMEOUT;
+    }
+    slot->state = SLOT_ARRIVED;
+    if (--group->waiting == 0) {
+        openLocked(group);
+    }
+    while (!group->released) {
+        if (uvcDevice != NULL && uvcDevice->cancels != NULL &&
+            uvcDevice->cancels->load(std::memory_order_acquire) != uvcDevice->cancelMark) {
+            return UVC_ERROR_INTERRUPTED;
+        }
+        group->opened.wait_for(lock, std::chrono::nanoseconds(GROUP_CANCEL_POLL_NS));
+    }
+    uint64_t releaseAt = group->releaseAt;
+    lock.unlock();
+
+    if (monotonicNanos() + GROUP_RELEASE_SPIN_NS < releaseAt) {
+        sleepUntil(releaseAt - GROUP_RELEASE_SPIN_NS);
+    }
+    while (monotonicNanos() < releaseAt) {
+    }
+    group->members[slot->index].started = monotonicNanos();
+    return UVC_SUCCESS;
+}
+
+// runs on the member camera's session thread
+static void runMember(void* context, struct CommandResult* commandResult) {
+    struct GroupSlot*     slot    = (struct GroupSlot*)context;
+    struct GroupMember*   member  = &slot->group->members[slot->index];
+    struct CameraSession* session = sessionFind(&member->uvcDevice);
+    struct CommandGate    gate    = {arrive, slot};
+    {
+        std::lock_guard<std::mutex> lock(slot->group->mutex);
+        if (slot->state == SLOT_MISSED) {
+            *commandResult = member->commandResult;
+            return;
+        }
+    }
+
+    // a command skipped as a no-op never opens the device, the next one waits instead
+    for (uint32_t i = 0; i < member->count; i++) {
+        sessionRunGated(session,
+                        &member->uvcDevice,
+                        &member->commands[i],
+                        slot->reached ? NULL : &gate,
+                        commandResult);
+        if (commandResult->result != 0) {
+            break;
+        }
+    }
+    if (!slot->reached) {
+        arrive(slot, NULL);
+    }
+}
+
+static void onMemberDone(void*                       context,
+                         const struct CommandResult* commandResult,
+                         uint32_t                    pending) {
+    struct GroupSlot*   slot   = (struct GroupSlot*)context;
+    struct Group*       group  = slot->group;
+    struct GroupMember* member = &group->members[slot->index];
+    (void)pending;
+
+    bool last = false;
+    {
+        std::lock_guard<std::mutex> lock(group->mutex);
+        // a missed member was reported when the barrier opened without it
+        if (slot->state != SLOT_MISSED) {
+            member->commandResult = *commandResult;
+            member->finished      = monotonicNanos();
+
+            // never got to run, the queue was full or cancelled. the others go without it.
+            if (slot->state == SLOT_PENDING) {
+                slot->state = SLOT_ARRIVED;
+                if (--group->waiting == 0) {
+                    openLocked(group);
+                }
+            }
+            last = --group->running == 0;
+        }
+    }
+    if (last) {
+        // nothing left for the deadline to miss. one already on its way
+        // drops its own reference.
+        if (group->timed && watchdogCancel(&group->deadline.timer)) {
+            release(group);
+        }
+        group->done(group->context);
+    }
+    release(group);
+}
+
+// the longest any member's commands may take, 0 when one of them waits forever
+static uint32_t membersTimeout(const std::vector<struct GroupMember>& members) {
+    uint32_t timeoutMs = 0;
+    for (const struct GroupMember& member : members) {
+        struct SessionConfig config;
+        sessionGetConfig(sessionFind(&member.uvcDevice), &config);
+        if (config.timeout_ms == 0) {
+            return 0;
+        }
+        timeoutMs = std::max(timeoutMs, config.timeout_ms);
+    }
+    return timeoutMs;
+}
+
+struct Group* groupStart(const std::vector<struct GroupMember>& members,
+                         uint32_t                               timeoutMs,
+                         GroupCompletion                        done,
+                         void*                                  context) {
+    std::set<struct CameraSession*> sessions;
+    for (const struct GroupMember& member : members) {
+        if (member.count == 0 || member.count > GROUP_MEMBER_COMMANDS ||
+            !sessions.insert(sessionFind(&member.uvcDevice)).second) {
+            return NULL;
+        }
+    }
+    if (members.empty()) {
+        return NULL;
+    }
+    if (timeoutMs == 0) {
+        timeoutMs = membersTimeout(members);
+    }
+
+    struct Group* group = new Group();
+    group->members      = members;
+    group->slots.resize(members.size());
+    group->waiting   = (uint32_t)members.size();
+    group->running   = (uint32_t)members.size();
+    group->refs      = (uint32_t)members.size() + 1;
+    group->released  = false;
+    group->releaseAt = 0;
+    group->done      = done;
+    group->context   = context;
+    for (uint32_t i = 0; i < members.size(); i++) {
+        group->members[i].started  = 0;
+        group->members[i].finished = 0;
+        group->slots[i].group      = group;
+        group->slots[i].index      = i;
+        group->slots[i].reached    = false;
+        group->slots[i].state      = SLOT_PENDING;
+    }
+    group->deadline.group = group;
+    watchdogTimerInit(&group->deadline.timer, deadlineExpired);
+    group->timed = timeoutMs != 0;
+    if (group->timed) {
+        group->refs++;
+        watchdogSchedule(&group->deadline.timer, monotonicNanos() + (uint64_t)timeoutMs * 1000000);
+    }
+
+    // the slots vector is never resized again, so pointers into it hold.
+    // cameras are queued on in one order, whoever starts the group.
+    std::vector<uint32_t> order(members.size());
+    for (uint32_t i = 0; i < members.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&members](uint32_t a, uint32_t b) {
+        return sessionFind(&members[a].uvcDevice) < sessionFind(&members[b].uvcDevice);
+    });
+    std::lock_guard<std::mutex> lock(groupsMutex);
+    for (uint32_t i : order) {
+        sessionSubmitTask(sessionFind(&members[i].uvcDevice),
+                          runMember,
+                          onMemberDone,
+                          &group->slots[i]);
+    }
+    return group;
+}
+
+void groupGetResults(struct Group*                    group,
+                     std::vector<struct GroupMember>* members,
+                     struct GroupStats*               stats) {
+    *members = group->members;
+
+    uint64_t first = UINT64_MAX;
+    uint64_t last  = 0;
+    for (const struct GroupMember& member : group->members) {
+        if (member.started != 0) {
+            first = std::min(first, member.started);
+            last  = std::max(last, member.started);
+        }
+    }
+    stats->released = group->releaseAt;
+    stats->skew     = last >= first ? last - first : 0;
+}
+
+void groupFree(struct Group* group) {
+    release(group);
+}
+
+struct GroupWait {
+    std::mutex              mutex;
+    std::condition_variable finished;
+    bool                    done;
+};
+
+static void onGroupDone(void* context) {
+    struct GroupWait*           wait = (struct GroupWait*)context;
+    std::lock_guard<std::mutex> lock(wait->mutex);
+    wait->done = true;
+    wait->finished.notify_all();
+}
+
+bool groupRun(std::vector<struct GroupMember>* members,
+              uint32_t                         timeoutMs,
+              struct GroupStats*               stats) {
+    struct GroupWait wait;
+    wait.done           = false;
+    struct Group* group = groupStart(*members, timeoutMs, onGroupDone, &wait);
+    if (group == NULL) {
+        return false;
+    }
+    {
+        std::unique_lock<std::mutex> lock(wait.mutex);
+        wait.finished.wait(lock, [&wait] { return wait.done; });
+    }
+    groupGetResults(group, members, stats);
+    groupFree(group);
+    return true;
+}
+
+}  // namespace ptz
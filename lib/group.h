@@ -0,0 +1,60 @@
+#ifndef PTZ_GROUP_H
+#define PTZ_GROUP_H
+
+#include <stdint.h>
+#include <vector>
+#include "command.h"
+#include "device.h"
+
+namespace ptz {
+
+// one command set sent to many cameras at once. each camera runs its part
+// on its own session thread, in line with its queued commands, opens its
+// device and then waits at a barrier. once every camera is ready they are
+// all released together, so device open times do not turn into start skew.
+// the barrier waits for timeoutMs at most, by default the longest of the
+// members' timeout_ms, then releases whoever has arrived and fails the rest
+// with UVC_ERROR_TIMEOUT. a member whose camera is cancelled leaves it with
+// UVC_ERROR_INTERRUPTED. groups sharing cameras queue on them in one order.
+#define GROUP_MEMBER_COMMANDS 4
+
+struct GroupMember {
+    struct UVCDevice uvcDevice;
+    struct Command   commands[GROUP_MEMBER_COMMANDS];  // run in order, the first is synchronized
+    uint32_t         count;
+
+    // filled in by the run
+    struct CommandResult commandResult;  // the first failure, else the last command's
+    uint64_t             started;        // monotonicNanos() when released, 0 if never
+    uint64_t             finished;
+};
+
+struct GroupStats {
+    uint64_t released;  // monotonicNanos() the barrier opened
+    uint64_t skew;      // last camera start minus first, nanoseconds
+};
+
+// returns false, running nothing, when a camera appears twice or a member
+// has no commands. done is called once on whichever thread finishes last,
+// or when the deadline leaves nothing running, after which members and
+// stats may be read. a camera missed by the barrier may still be running
+// the group's task, the group stays allocated for it past groupFree.
+typedef void (*GroupCompletion)(void* context);
+struct Group;
+struct Group* groupStart(const std::vector<struct GroupMember>& members,
+                         uint32_t                               timeoutMs,
+                         GroupCompletion                        done,
+                         void*                                  context);
+void groupGetResults(struct Group*                    group,
+                     std::vector<struct GroupMember>* members,
+                     struct GroupStats*               stats);
+void groupFree(struct Group* group);
+
+// groupStart and wait for it
+bool groupRun(std::vector<struct GroupMember>* members,
+              uint32_t                         timeoutMs,
+              struct GroupStats*               stats);
+
+}  // namespace ptz
+
+#endif  // PTZ_GROUP_H
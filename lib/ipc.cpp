@@ -0,0 +1,235 @@
+#include "ipc.h"
+#include <errno.h>
+#include <string.h>
+
+namespace ptz {
+
+// explicit little endian, so the js side can read frames with readInt32LE
+static uint8_t* put16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    return out + 2;
+}
+
+static uint8_t* put32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+    return out + 4;
+}
+
+static uint16_t get16(const uint8_t* in) {
+    return (uint16_t)(in[0] | in[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* in) {
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+static uint8_t* putString(uint8_t* out, const char* value, size_t limit) {
+    size_t length = strnlen(value, limit - 1);
+    *out++        = (uint8_t)length;
+    memcpy(out, value, length);
+    return out + length;
+}
+
+// a length prefixed string into a buffer of size bytes, false when it doesn't
+// fit in either
+static bool getString(const uint8_t** in, const uint8_t* end, char* out, size_t size) {
+    if (*in >= end) {
+        return false;
+    }
+    size_t length = **in;
+    if (length >= size || (size_t)(end - *in - 1) < length) {
+        return false;
+    }
+    memcpy(out, *in + 1, length);
+    out[length] = 0;
+    *in += 1 + length;
+    return true;
+}
+
+int ipcFrameLength(const uint8_t* data, size_t available) {
+    if (available < 4) {
+        return 0;
+    }
+    uint32_t length = get32(data);
+    if (length > IPC_MAX_FRAME - 4) {
+        return -1;
+    }
+    return available < 4 + length ? 0 : (int)(4 + length);
+}
+
+size_t ipcEncodeRequest(const struct IpcRequest* request, uint8_t* out) {
+    const struct UVCDevice* device = &request->uvcDevice;
+    uint8_t*                at     = put32(out + 4, request->id);
+    *at++                          = request->command.op;
+    *at++                          = request->command.flags;
+    *at++                          = (uint8_t)device->simulated;
+    *at++                          = 0;
+    at                             = put16(at, (uint16_t)device->vendorId);
+    at                             = put16(at, (uint16_t)device->productId);
+    for (int i = 0; i < 4; i++) {
+        at = put32(at, (uint32_t)request->command.args[i]);
+    }
+    at = putString(at, device->serial, sizeof(device->serial));
+    at = putString(at, device->port, sizeof(device->port));
+    put32(out, (uint32_t)(at - out - 4));
+    return at - out;
+}
+
+int ipcDecodeRequest(const uint8_t* frame, size_t length, struct IpcRequest* request) {
+    const uint8_t* at  = frame + 4;
+    const uint8_t* end = frame + length;
+    if (length < 4 + IPC_REQUEST_SIZE) {
+        return EINVAL;
+    }
+    memset(request, 0, sizeof(*request));
+    struct UVCDevice* device = &request->uvcDevice;
+    request->id              = get32(at);
+    request->command.op      = at[4];
+    request->command.flags   = at[5];
+    device->simulated        = at[6] != 0;
+    device->vendorId         = get16(at + 8);
+    device->productId        = get16(at + 10);
+    for (int i = 0; i < 4; i++) {
+        request->command.args[i] = (int32_t)get32(at + 12 + i * 4);
+    }
+    at += IPC_REQUEST_SIZE;
+    if (commandSpec(request->command.op) == NULL ||
+        !getString(&at, end, device->serial, sizeof(device->serial)) ||
+        !getString(&at, end, device->port, sizeof(device->port))) {
+        return EINVAL;
+    }
+    return 0;
+}
+
+// getControl's fields, or getRanges' answered requests then min, max,
+// resolution and default for every field
+static uint32_t controlValues(const struct Command*       command,
+                              const struct CommandResult* r,
+                              int32_t*                    values) {
+    int control = commandControl(command->op);
+    if (control < 0 || commandControlRequest(command->op) == CONTROL_SET) {
+        return 0;
+    }
+    int fields = controlFieldCount(controlSpecs[control]);
+    if (commandControlRequest(command->op) == CONTROL_GET) {
+        memcpy(values, r->controlValues.values, sizeof(int32_t) * fields);
+        return fields;
+    }
+    const struct ControlRanges* ranges = &r->controlRanges;
+    values[0]                          = (int32_t)ranges->requests;
+    memcpy(values + 1, ranges->min, sizeof(int32_t) * fields);
+    memcpy(values + 1 + fields, ranges->max, sizeof(int32_t) * fields);
+    memcpy(values + 1 + 2 * fields, ranges->resolution, sizeof(int32_t) * fields);
+    memcpy(values + 1 + 3 * fields, ranges->def, sizeof(int32_t) * fields);
+    return 1 + 4 * fields;
+}
+
+// a command's result as the values the addon reports, in the same order
+static uint32_t resultValues(const struct Command*       command,
+                             const struct CommandResult* r,
+                             int32_t*                    values) {
+    switch (command->op) {
+        case CMD_GET_CAPABILITIES:
+            values[0] = r->capability.absolute_zoom;
+            values[1] = r->capability.relative_zoom;
+            values[2] = r->capability.absolute_pan_tilt;
+            values[3] = r->capability.relative_pan_tilt;
+            values[4] = r->capability.absolute_roll;
+            values[5] = r->capability.relative_roll;
+            return 6;
+        case CMD_GET_ABSOLUTE_ZOOM:
+            values[0] = r->absoluteZoomInfo.min;
+            values[1] = r->absoluteZoomInfo.max;
+            values[2] = r->absoluteZoomInfo.resolution;
+            values[3] = r->absoluteZoomInfo.current;
+            values[4] = r->absoluteZoomInfo.def;
+            return 5;
+        case CMD_GET_RELATIVE_ZOOM:
+            values[0] = r->relativeZoomInfo.direction;
+            values[1] = r->relativeZoomInfo.digital_zoom;
+            values[2] = r->relativeZoomInfo.min_speed;
+            values[3] = r->relativeZoomInfo.max_speed;
+            values[4] = r->relativeZoomInfo.resolution_speed;
+            values[5] = r->relativeZoomInfo.current_speed;
+            values[6] = r->relativeZoomInfo.default_speed;
+            return 7;
+        case CMD_GET_ABSOLUTE_PAN_TILT:
+            values[0] = r->absolutePanTiltInfo.min_pan;
+            values[1] = r->absolutePanTiltInfo.min_tilt;
+            values[2] = r->absolutePanTiltInfo.max_pan;
+            values[3] = r->absolutePanTiltInfo.max_tilt;
+            values[4] = r->absolutePanTiltInfo.resolution_pan;
+            values[5] = r->absolutePanTiltInfo.resolution_tilt;
+            values[6] = r->absolutePanTiltInfo.current_pan;
+            values[7] = r->absolutePanTiltInfo.current_tilt;
+            values[8] = r->absolutePanTiltInfo.default_pan;
+            values[9] = r->absolutePanTiltInfo.default_tilt;
+            return 10;
+        case CMD_GET_RELATIVE_PAN_TILT:
+            values[0]  = r->relativePanTiltInfo.pan_direction;
+            values[1]  = r->relativePanTiltInfo.tilt_direction;
+            values[2]  = r->relativePanTiltInfo.min_pan_speed;
+            values[3]  = r->relativePanTiltInfo.min_tilt_speed;
+            values[4]  = r->relativePanTiltInfo.max_pan_speed;
+            values[5]  = r->relativePanTiltInfo.max_tilt_speed;
+            values[6]  = r->relativePanTiltInfo.resolution_pan_speed;
+            values[7]  = r->relativePanTiltInfo.resolution_tilt_speed;
+            values[8]  = r->relativePanTiltInfo.default_pan_speed;
+            values[9]  = r->relativePanTiltInfo.default_tilt_speed;
+            values[10] = r->relativePanTiltInfo.current_pan_speed;
+            values[11] = r->relativePanTiltInfo.current_tilt_speed;
+            return 12;
+        default:
+            return controlValues(command, r, values);
+    }
+}
+
+size_t ipcEncodeResponse(uint32_t                    id,
+                         const struct Command*       command,
+                         const struct CommandResult* commandResult,
+                         uint32_t                    pending,
+                         uint8_t*                    out) {
+    int32_t  values[IPC_MAX_VALUES];
+    uint32_t count = commandResult->result == 0 ? resultValues(command, commandResult, values) : 0;
+
+    uint8_t* at = put32(out + 4, id);
+    at          = put32(at, (uint32_t)commandResult->result);
+    at          = put32(at, pending);
+    *at++       = (uint8_t)count;
+    for (uint32_t i = 0; i < count; i++) {
+        at = put32(at, (uint32_t)values[i]);
+    }
+    at = putString(at, commandResult->error != NULL ? commandResult->error : "", 64);
+    put32(out, (uint32_t)(at - out - 4));
+    return at - out;
+}
+
+int ipcDecodeResponse(const uint8_t* frame, size_t length, struct IpcResponse* response) {
+    const uint8_t* at  = frame + 4;
+    const uint8_t* end = frame + length;
+    if (length < 4 + 13) {
+        return EINVAL;
+    }
+    response->id      = get32(at);
+    response->result  = (int32_t)get32(at + 4);
+    response->pending = get32(at + 8);
+    response->count   = at[12];
+    at += 13;
+    if (response->count > IPC_MAX_VALUES || (size_t)(end - at) < response->count * 4) {
+        return EINVAL;
+    }
+    for (uint32_t i = 0; i < response->count; i++) {
+        response->values[i] = (int32_t)get32(at);
+        at += 4;
+    }
+    if (!getString(&at, end, response->error, sizeof(response->error))) {
+        return EINVAL;
+    }
+    return 0;
+}
+
+}  // namespace ptz
@@ -0,0 +1,64 @@
+#ifndef PTZ_IPC_H
+#define PTZ_IPC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "command.h"
+#include "device.h"
+
+namespace ptz {
+
+// ptzd's wire protocol over a unix socket. every frame is a little endian
+// u32 length of the body, then the body. requests carry an id that their
+// response echoes, so a client can pipeline as many as it likes on one
+// connection. responses for one camera come back in the order sent, across
+// cameras they may not.
+//
+// request:  u32 id, u8 op, u8 flags, u8 simulated, u8 0, u16 vendorId,
+//           u16 productId, i32 args[4], u8 serial length, serial,
+//           u8 port length, port
+// response: u32 id, i32 result, u32 pending, u8 value count, i32 values,
+//           u8 error length, error
+//
+// the values are the command's result fields in the order the addon names
+// them, e.g. minPan, minTilt, maxPan, ... for getAbsolutePanTilt. getRanges
+// sends the CONTROL_HAS_* bits answered, then each range's fields in turn.
+#define IPC_MAX_FRAME 512
+#define IPC_MAX_VALUES (1 + 4 * CONTROL_MAX_FIELDS)
+#define IPC_REQUEST_SIZE 28  // body without the strings
+
+struct IpcRequest {
+    uint32_t         id;
+    struct UVCDevice uvcDevice;
+    struct Command   command;
+};
+
+struct IpcResponse {
+    uint32_t id;
+    int32_t  result;  // uvc_error_t
+    uint32_t pending;
+    uint32_t count;
+    int32_t  values[IPC_MAX_VALUES];
+    char     error[64];
+};
+
+// bytes of data taken up by the first whole frame, 0 while it is still
+// arriving, or -1 for a frame too large to be one of ours
+int ipcFrameLength(const uint8_t* data, size_t available);
+
+// encoders write a whole frame to out, which needs IPC_MAX_FRAME bytes, and
+// return its length
+size_t ipcEncodeRequest(const struct IpcRequest* request, uint8_t* out);
+size_t ipcEncodeResponse(uint32_t                    id,
+                         const struct Command*       command,
+                         const struct CommandResult* commandResult,
+                         uint32_t                    pending,
+                         uint8_t*                    out);
+
+// decoders take a whole frame and return 0, or EINVAL when it is malformed
+int ipcDecodeRequest(const uint8_t* frame, size_t length, struct IpcRequest* request);
+int ipcDecodeResponse(const uint8_t* frame, size_t length, struct IpcResponse* response);
+
+}  // namespace ptz
+
+#endif  // PTZ_IPC_H
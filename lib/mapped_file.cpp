@@ -0,0 +1,61 @@
+#include "mapped_file.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ptz {
+
+int mapFile(struct MappedFile* file, const char* path, size_t size) {
+    file->fd   = -1;
+    file->data = NULL;
+    file->size = 0;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return errno;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ((size_t)st.st_size < size && ftruncate(fd, (off_t)size) != 0)) {
+        int error = errno;
+        close(fd);
+        return error;
+    }
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        int error = errno;
+        close(fd);
+        return error;
+    }
+
+    file->fd   = fd;
+    file->data = (uint8_t*)data;
+    file->size = size;
+    return 0;
+}
+
+void unmapFile(struct MappedFile* file, size_t used) {
+    if (file->data != NULL) {
+        munmap(file->data, file->size);
+    }
+    if (file->fd >= 0) {
+        // best effort, readers only trust the header's record count anyway
+        if (used > 0 && used < file->size) {
+            int truncated = ftruncate(file->fd, (off_t)used);
+            (void)truncated;
+        }
+        close(file->fd);
+    }
+    file->fd   = -1;
+    file->data = NULL;
+    file->size = 0;
+}
+
+void syncFile(struct MappedFile* file) {
+    if (file->data != NULL) {
+        msync(file->data, file->size, MS_ASYNC);
+    }
+}
+
+}  // namespace ptz
@@ -0,0 +1,26 @@
+#ifndef PTZ_MAPPED_FILE_H
+#define PTZ_MAPPED_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ptz {
+
+// a file mapped read/write into memory
+struct MappedFile {
+    int      fd;
+    uint8_t* data;
+    size_t   size;
+};
+
+// map path at exactly size bytes, creating or growing it as needed. returns 0
+// or an errno value.
+int mapFile(struct MappedFile* file, const char* path, size_t size);
+// unmap, optionally truncating the file to the bytes actually used
+void unmapFile(struct MappedFile* file, size_t used);
+// flush dirty pages to disk
+void syncFile(struct MappedFile* file);
+
+}  // namespace ptz
+
+#endif  // PTZ_MAPPED_FILE_H
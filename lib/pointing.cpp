@@ -0,0 +1,162 @@
+#include "pointing.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "session.h"
+
+namespace ptz {
+
+// the lens assumed without a table, wide end to tele end
+#define FOV_GUESS_WIDE 70.0
+#define FOV_GUESS_TELE 7.0
+#define FOV_ASPECT (9.0 / 16.0)
+
+#define DEGREES (M_PI / 180.0)
+#define ARC_SECONDS 3600.0
+
+static double focalLength(double degrees) {
+    return 1 / tan(degrees * DEGREES / 2);
+}
+
+static double fieldOfView(double focal) {
+    return 2 * atan(1 / focal) / DEGREES;
+}
+
+static double verticalFor(double horizontal) {
+    return fieldOfView(focalLength(horizontal) / FOV_ASPECT);
+}
+
+void fovTableNormalize(struct FovTable* table) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < std::min(table->count, (uint32_t)FOV_TABLE_SIZE); i++) {
+        struct FovPoint point = table->points[i];
+        if (!(point.horizontal > 0 && point.horizontal < 180)) {
+            continue;
+        }
+        if (!(point.vertical > 0 && point.vertical < 180)) {
+            point.vertical = (float)verticalFor(point.horizontal);
+        }
+        table->points[kept++] = point;
+    }
+    table->count = kept;
+    std::sort(table->points,
+              table->points + kept,
+              [](const struct FovPoint& a, const struct FovPoint& b) { return a.zoom < b.zoom; });
+}
+
+void fovLookup(const struct FovTable* table,
+               double                 zoom,
+               double                 min,
+               double                 max,
+               double*                horizontal,
+               double*                vertical) {
+    struct FovPoint guess[2] = {
+        {(uint16_t)min, (float)FOV_GUESS_WIDE, (float)verticalFor(FOV_GUESS_WIDE)},
+        {(uint16_t)max, (float)FOV_GUESS_TELE, (float)verticalFor(FOV_GUESS_TELE)}};
+    const struct FovPoint* points = table->count > 0 ? table->points : guess;
+    uint32_t               count  = table->count > 0 ? table->count : (max > min ? 2 : 1);
+
+    // clamp outside the table, interpolate focal length inside it
+    uint32_t upper = 0;
+    while (upper < count && points[upper].zoom < zoom) {
+        upper++;
+    }
+    if (upper == 0 || upper == count) {
+        const struct FovPoint* end = &points[upper == 0 ? 0 : count - 1];
+        *horizontal                = end->horizontal;
+        *vertical                  = end->vertical;
+        return;
+    }
+    const struct FovPoint* a = &points[upper - 1];
+    const struct FovPoint* b = &points[upper];
+    double                 t = (zoom - a->zoom) / (double)(b->zoom - a->zoom);
+    *horizontal =
+        fieldOfView(focalLength(a->horizontal) * (1 - t) + focalLength(b->horizontal) * t);
+    *vertical = fieldOfView(focalLength(a->vertical) * (1 - t) + focalLength(b->vertical) * t);
+}
+
+void pointingAim(const struct PointingView* view, double x, double y, int32_t* pan, int32_t* tilt) {
+    // the ray through the point, with the lens at 1 looking down z
+    double right = (x - 0.5) * 2 * tan(view->horizontal * DEGREES / 2);
+    double up    = (0.5 - y) * 2 * tan(view->vertical * DEGREES / 2);
+
+    // tilted with the camera, so a point off to the side of a camera looking
+    // up or down needs more pan than its offset in the picture suggests
+    double tilted  = view->tilt / ARC_SECONDS * DEGREES;
+    double height  = up * cos(tilted) + sin(tilted);
+    double forward = cos(tilted) - up * sin(tilted);
+    double turn    = atan2(right, forward) / DEGREES * ARC_SECONDS;
+    double raise   = atan2(height, sqrt(right * right + forward * forward)) / DEGREES * ARC_SECONDS;
+
+    double panTo  = view->pan + turn;
+    double tiltTo = raise;
+    if (view->max_pan > view->min_pan) {
+        panTo = std::min(std::max(panTo, view->min_pan), view->max_pan);
+    }
+    if (view->max_tilt > view->min_tilt) {
+        tiltTo = std::min(std::max(tiltTo, view->min_tilt), view->max_tilt);
+    }
+    *pan  = (int32_t)lround(panTo);
+    *tilt = (int32_t)lround(tiltTo);
+}
+
+void pointingView(struct CameraSession* session,
+                  struct UVCDevice*     uvcDevice,
+                  struct PointingView*  view,
+                  struct CommandResult* commandResult) {
+    struct Command command;
+    memset(&command, 0, sizeof(command));
+    command.op = CMD_GET_ABSOLUTE_PAN_TILT;
+    sessionRun(session, uvcDevice, &command, commandResult);
+    if (commandResult->result != 0) {
+        return;
+    }
+    const struct AbsolutePanTiltInfo* panTilt = &commandResult->absolutePanTiltInfo;
+    view->pan                                 = panTilt->current_pan;
+    view->tilt                                = panTilt->current_tilt;
+    view->min_pan                             = panTilt->min_pan;
+    view->max_pan                             = panTilt->max_pan;
+    view->min_tilt                            = panTilt->min_tilt;
+    view->max_tilt                            = panTilt->max_tilt;
+
+    // a camera without absolute zoom is taken to be at its wide end
+    struct CommandResult zoomResult;
+    command.op = CMD_GET_ABSOLUTE_ZOOM;
+    sessionRun(session, uvcDevice, &command, &zoomResult);
+    double zoom = 0;
+    double min  = 0;
+    double max  = 0;
+    if (zoomResult.result == 0) {
+        zoom = zoomResult.absoluteZoomInfo.current;
+        min  = zoomResult.absoluteZoomInfo.min;
+        max  = zoomResult.absoluteZoomInfo.max;
+    }
+
+    struct SessionConfig config;
+    sessionGetConfig(session, &config);
+    fovLookup(&config.fov, zoom, min, max, &view->horizontal, &view->vertical);
+}
+
+void pointingCenter(struct CameraSession* session,
+                    struct UVCDevice*     uvcDevice,
+                    double                x,
+                    double                y,
+                    int32_t*              pan,
+                    int32_t*              tilt,
+                    struct CommandResult* commandResult) {
+    struct PointingView view;
+    pointingView(session, uvcDevice, &view, commandResult);
+    if (commandResult->result != 0) {
+        return;
+    }
+    pointingAim(&view, x, y, pan, tilt);
+
+    struct Command command;
+    memset(&command, 0, sizeof(command));
+    command.op      = CMD_ABSOLUTE_PAN_TILT;
+    command.args[0] = *pan;
+    command.args[1] = *tilt;
+    sessionRun(session, uvcDevice, &command, commandResult);
+}
+
+}  // namespace ptz
@@ -0,0 +1,73 @@
+#ifndef PTZ_POINTING_H
+#define PTZ_POINTING_H
+
+#include <stdint.h>
+#include "command.h"
+#include "device.h"
+
+namespace ptz {
+
+struct CameraSession;
+
+// click to center: the pan/tilt that brings a point in the picture to its
+// middle, worked out from the field of view at the current zoom, so one
+// absolute move lands where a run of corrections used to. the field of view
+// comes from a per camera table of measured zoom positions, interpolated by
+// focal length since zoom units usually track it.
+#define FOV_TABLE_SIZE 16
+
+struct FovPoint {
+    uint16_t zoom;
+    float    horizontal;  // degrees
+    float    vertical;    // degrees, 0 for horizontal at 16:9
+};
+
+struct FovTable {
+    uint32_t        count;  // 0 guesses a 70 to 7 degree lens across the zoom range
+    struct FovPoint points[FOV_TABLE_SIZE];
+};
+
+// sorts by zoom, fills in missing verticals and drops unusable points
+void fovTableNormalize(struct FovTable* table);
+// field of view in degrees at zoom, for a camera zooming over min..max
+void fovLookup(const struct FovTable* table,
+               double                 zoom,
+               double                 min,
+               double                 max,
+               double*                horizontal,
+               double*                vertical);
+
+// where the camera points and what it sees, in its own units
+struct PointingView {
+    double pan;         // arc seconds
+    double tilt;        // arc seconds
+    double horizontal;  // field of view, degrees
+    double vertical;
+    double min_pan;
+    double max_pan;
+    double min_tilt;
+    double max_tilt;
+};
+
+// the pan/tilt that puts x, y, from 0,0 at the top left of the picture to
+// 1,1 at the bottom right, in the middle. clamped to the camera's range.
+void pointingAim(const struct PointingView* view, double x, double y, int32_t* pan, int32_t* tilt);
+
+// read pose and zoom through the session, so cached reads are reused, and
+// look up the field of view in the session's table
+void pointingView(struct CameraSession* session,
+                  struct UVCDevice*     uvcDevice,
+                  struct PointingView*  view,
+                  struct CommandResult* commandResult);
+// aim at x, y with a single absolute move
+void pointingCenter(struct CameraSession* session,
+                    struct UVCDevice*     uvcDevice,
+                    double                x,
+                    double                y,
+                    int32_t*              pan,
+                    int32_t*              tilt,
+                    struct CommandResult* commandResult);
+
+}  // namespace ptz
+
+#endif  // PTZ_POINTING_H
@@ -0,0 +1,402 @@
+#include "preset.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <mutex>
+#include "mapped_file.h"
+#include "stats.h"
+
+namespace ptz {
+
+// smooth recalls send a step this often
+#define PRESET_STEP_NS 40000000ULL
+
+static std::mutex           presetMutex;
+static struct MappedFile    presetFile = {-1, NULL, 0};
+static struct PresetHeader* header     = NULL;
+static struct PresetEntry*  entries    = NULL;
+
+static size_t storeSize(uint32_t capacity) {
+    return sizeof(struct PresetHeader) + (size_t)capacity * sizeof(struct PresetEntry);
+}
+
+static void closeLocked() {
+    if (header != NULL) {
+        syncFile(&presetFile);
+    }
+    unmapFile(&presetFile, 0);
+    header  = NULL;
+    entries = NULL;
+}
+
+int presetOpen(const char* path, uint32_t capacity) {
+    std::lock_guard<std::mutex> lock(presetMutex);
+    closeLocked();
+
+    uint32_t slots = 64;
+    while (slots < capacity && slots < (1U << 24)) {
+        slots <<= 1;
+    }
+
+    // an existing store keeps the capacity it was made with, and anything
+    // else is left alone rather than grown into one
+    struct PresetHeader existing;
+    bool                fresh = true;
+    int                 fd    = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        struct stat st;
+        bool        valid = fstat(fd, &st) == 0;
+        if (valid && st.st_size > 0) {
+            fresh = false;
+            valid = read(fd, &existing, sizeof(existing)) == (ssize_t)sizeof(existing) &&
+                    memcmp(existing.magic, PTZ_PRESET_MAGIC, sizeof(existing.magic)) == 0 &&
+                    existing.version == PTZ_PRESET_VERSION &&
+                    existing.entrySize == sizeof(struct PresetEntry) && existing.capacity != 0 &&
+                    (existing.capacity & (existing.capacity - 1)) == 0 &&
+                    (size_t)st.st_size >= storeSize(existing.capacity);
+        }
+        close(fd);
+        if (!valid) {
+            return EINVAL;
+        }
+    }
+    if (!fresh) {
+        slots = existing.capacity;
+    }
+
+    int error = mapFile(&presetFile, path, storeSize(slots));
+    if (error != 0) {
+        return error;
+    }
+    header  = (struct PresetHeader*)presetFile.data;
+    entries = (struct PresetEntry*)(presetFile.data + sizeof(struct PresetHeader));
+    if (fresh) {
+        header->version   = PTZ_PRESET_VERSION;
+        header->entrySize = sizeof(struct PresetEntry);
+        header->capacity  = slots;
+        memcpy(header->magic, PTZ_PRESET_MAGIC, sizeof(header->magic));
+    }
+    return 0;
+}
+
+void presetClose() {
+    std::lock_guard<std::mutex> lock(presetMutex);
+    closeLocked();
+}
+
+// fnv-1a of a string and its terminator, so fields hashed in a row can't run
+// into each other
+static uint64_t hashString(uint64_t hash, const char* text) {
+    do {
+        hash = (hash ^ (uint8_t)*text) * 1099511628211ULL;
+    } while (*text++ != 0);
+    return hash;
+}
+
+// fnv-1a over the camera and the name
+static uint64_t presetHash(const struct UVCDevice* uvcDevice, const char* name) {
+    uint64_t       hash   = 14695981039346656037ULL;
+    const uint32_t key[3] = {(uint32_t)uvcDevice->vendorId,
+                             (uint32_t)uvcDevice->productId,
+                             (uint32_t)uvcDevice->simulated};
+    for (size_t i = 0; i < sizeof(key); i++) {
+        hash = (hash ^ ((const uint8_t*)key)[i]) * 1099511628211ULL;
+    }
+    hash = hashString(hash, uvcDevice->serial);
+    hash = hashString(hash, uvcDevice->port);
+    return hashString(hash, name);
+}
+
+static bool sameCamera(const struct PresetEntry* entry, const struct UVCDevice* uvcDevice) {
+    return entry->vendorId == (uint16_t)uvcDevice->vendorId &&
+           entry->productId == (uint16_t)uvcDevice->productId &&
+           entry->simulated == (uint8_t)uvcDevice->simulated &&
+           strncmp(entry->serial, uvcDevice->serial, sizeof(entry->serial)) == 0 &&
+           strncmp(entry->port, uvcDevice->port, sizeof(entry->port)) == 0;
+}
+
+static bool matches(const struct PresetEntry* entry,
+                    uint64_t                  hash,
+                    const struct UVCDevice*   uvcDevice,
+                    const char*               name) {
+    return entry->state == PRESET_ENTRY_USED && entry->hash == hash &&
+           sameCamera(entry, uvcDevice) && strncmp(entry->name, name, PRESET_NAME_SIZE) == 0;
+}
+
+// the live entry for a preset, or NULL. vacant is set to the first reusable
+// entry along the probe chain, when there is one.
+static struct PresetEntry* probe(const struct UVCDevice* uvcDevice,
+                                 const char*             name,
+                                 uint64_t                hash,
+                                 struct PresetEntry**    vacant) {
+    uint32_t mask = header->capacity - 1;
+    if (vacant != NULL) {
+        *vacant = NULL;
+    }
+    for (uint32_t i = 0; i <= mask; i++) {
+        struct PresetEntry* entry = &entries[(hash + i) & mask];
+        if (entry->state == PRESET_ENTRY_EMPTY) {
+            if (vacant != NULL && *vacant == NULL) {
+                *vacant = entry;
+            }
+            return NULL;
+        }
+        if (entry->state == PRESET_ENTRY_DELETED) {
+            if (vacant != NULL && *vacant == NULL) {
+                *vacant = entry;
+            }
+            continue;
+        }
+        if (matches(entry, hash, uvcDevice, name)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// put every live entry back where a probe would look first, dropping tombstones
+static void rebuild() {
+    std::vector<struct PresetEntry> live;
+    live.reserve(header->count);
+    for (uint32_t i = 0; i < header->capacity; i++) {
+        if (entries[i].state == PRESET_ENTRY_USED) {
+            live.push_back(entries[i]);
+        }
+    }
+    memset(entries, 0, (size_t)header->capacity * sizeof(struct PresetEntry));
+    uint32_t mask = header->capacity - 1;
+    for (const struct PresetEntry& entry : live) {
+        uint32_t at = (uint32_t)entry.hash & mask;
+        while (entries[at].state != PRESET_ENTRY_EMPTY) {
+            at = (at + 1) & mask;
+        }
+        entries[at] = entry;
+    }
+    header->tombstones = 0;
+}
+
+int presetSave(const struct UVCDevice* uvcDevice, const char* name, const struct Preset* preset) {
+    if (strlen(name) >= PRESET_NAME_SIZE) {
+        return ENAMETOOLONG;
+    }
+    std::lock_guard<std::mutex> lock(presetMutex);
+    if (header == NULL) {
+        return EBADF;
+    }
+
+    uint64_t            hash = presetHash(uvcDevice, name);
+    struct PresetEntry* vacant;
+    struct PresetEntry* entry = probe(uvcDevice, name, hash, &vacant);
+    if (entry == NULL) {
+        // keep probe chains short, at most three quarters of the table in use
+        uint32_t limit = header->capacity / 4 * 3;
+        if (header->count >= limit) {
+            return ENOSPC;
+        }
+        if (header->count + header->tombstones >= limit) {
+            rebuild();
+            probe(uvcDevice, name, hash, &vacant);
+        }
+        entry = vacant;
+        if (entry->state == PRESET_ENTRY_DELETED) {
+            header->tombstones--;
+        }
+        entry->hash      = hash;
+        entry->vendorId  = (uint16_t)uvcDevice->vendorId;
+        entry->productId = (uint16_t)uvcDevice->productId;
+        entry->simulated = (uint8_t)uvcDevice->simulated;
+        memset(entry->name, 0, sizeof(entry->name));
+        strcpy(entry->name, name);
+        memset(entry->serial, 0, sizeof(entry->serial));
+        strcpy(entry->serial, uvcDevice->serial);
+        memset(entry->port, 0, sizeof(entry->port));
+        strcpy(entry->port, uvcDevice->port);
+        header->count++;
+    }
+    entry->fields = (uint8_t)preset->fields;
+    entry->pan    = preset->pan;
+    entry->tilt   = preset->tilt;
+    entry->zoom   = preset->zoom;
+    entry->state  = PRESET_ENTRY_USED;
+    return 0;
+}
+
+int presetFind(const struct UVCDevice* uvcDevice, const char* name, struct Preset* preset) {
+    std::lock_guard<std::mutex> lock(presetMutex);
+    if (header == NULL) {
+        return EBADF;
+    }
+    struct PresetEntry* entry = probe(uvcDevice, name, presetHash(uvcDevice, name), NULL);
+    if (entry == NULL) {
+        return ENOENT;
+    }
+    preset->fields = entry->fields;
+    preset->pan    = entry->pan;
+    preset->tilt   = entry->tilt;
+    preset->zoom   = (uint16_t)entry->zoom;
+    return 0;
+}
+
+int presetDelete(const struct UVCDevice* uvcDevice, const char* name) {
+    std::lock_guard<std::mutex> lock(presetMutex);
+    if (header == NULL) {
+        return EBADF;
+    }
+    struct PresetEntry* entry = probe(uvcDevice, name, presetHash(uvcDevice, name), NULL);
+    if (entry == NULL) {
+        return ENOENT;
+    }
+    entry->state = PRESET_ENTRY_DELETED;
+    header->count--;
+    header->tombstones++;
+    return 0;
+}
+
+int presetList(const struct UVCDevice* uvcDevice, std::vector<std::string>* names) {
+    std::lock_guard<std::mutex> lock(presetMutex);
+    names->clear();
+    if (header == NULL) {
+        return EBADF;
+    }
+    for (uint32_t i = 0; i < header->capacity; i++) {
+        const struct PresetEntry* entry = &entries[i];
+        if (entry->state == PRESET_ENTRY_USED && sameCamera(entry, uvcDevice)) {
+            names->push_back(std::string(entry->name, strnlen(entry->name, PRESET_NAME_SIZE)));
+        }
+    }
+    return 0;
+}
+
+void presetGetStats(struct PresetStats* stats) {
+    std::lock_guard<std::mutex> lock(presetMutex);
+    stats->open     = header != NULL;
+    stats->capacity = header != NULL ? header->capacity : 0;
+    stats->count    = header != NULL ? header->count : 0;
+}
+
+void presetCapture(struct CameraSession* session,
+                   struct UVCDevice*     uvcDevice,
+                   struct Preset*        preset,
+                   struct CommandResult* commandResult) {
+    struct Command       command = {};
+    struct CommandResult zoomResult;
+    preset->fields = 0;
+    preset->pan    = 0;
+    preset->tilt   = 0;
+    preset->zoom   = 0;
+
+    command.op = CMD_GET_ABSOLUTE_PAN_TILT;
+    sessionRun(session, uvcDevice, &command, commandResult);
+    if (commandResult->result == 0) {
+        preset->fields |= PRESET_PAN_TILT;
+        preset->pan  = commandResult->absolutePanTiltInfo.current_pan;
+        preset->tilt = commandResult->absolutePanTiltInfo.current_tilt;
+    }
+    command.op = CMD_GET_ABSOLUTE_ZOOM;
+    sessionRun(session, uvcDevice, &command, &zoomResult);
+    if (zoomResult.result == 0) {
+        preset->fields |= PRESET_ZOOM;
+        preset->zoom = zoomResult.absoluteZoomInfo.current;
+    }
+
+    // either axis is enough, the camera may only have one of them
+    if (preset->fields != 0) {
+        commandResult->result = UVC_SUCCESS;
+        commandResult->error  = NULL;
+    }
+}
+
+static void moveTo(struct CameraSession* session,
+                   struct UVCDevice*     uvcDevice,
+                   int                   fields,
+                   int32_t               pan,
+                   int32_t               tilt,
+                   int32_t               zoom,
+                   int                   flags,
+                   struct CommandResult* commandResult) {
+    struct Command command = {};
+    command.flags          = (uint8_t)flags;
+    commandResult->result  = UVC_SUCCESS;
+    commandResult->error   = NULL;
+    if (fields & PRESET_PAN_TILT) {
+        command.op      = CMD_ABSOLUTE_PAN_TILT;
+        command.args[0] = pan;
+        command.args[1] = tilt;
+        sessionRun(session, uvcDevice, &command, commandResult);
+        if (commandResult->result != 0) {
+            return;
+        }
+    }
+    if (fields & PRESET_ZOOM) {
+        command.op      = CMD_ABSOLUTE_ZOOM;
+        command.args[0] = zoom;
+        command.args[1] = 0;
+        sessionRun(session, uvcDevice, &command, commandResult);
+    }
+}
+
+void presetRecall(struct CameraSession* session,
+                  struct UVCDevice*     uvcDevice,
+                  const struct Preset*  preset,
+                  uint32_t              durationMs,
+                  int                   flags,
+                  struct CommandResult* commandResult) {
+    uint64_t duration = (uint64_t)durationMs * 1000000;
+    if (duration < 2 * PRESET_STEP_NS) {
+        moveTo(session,
+               uvcDevice,
+               preset->fields,
+               preset->pan,
+               preset->tilt,
+               preset->zoom,
+               flags,
+               commandResult);
+        return;
+    }
+
+    // start from where the camera is now
+    struct Preset from;
+    presetCapture(session, uvcDevice, &from, commandResult);
+    if (commandResult->result != 0) {
+        return;
+    }
+    int fields = preset->fields & from.fields;
+
+    uint64_t start = monotonicNanos();
+    uint32_t steps = (uint32_t)(duration / PRESET_STEP_NS);
+    for (uint32_t step = 1; step <= steps; step++) {
+        sleepUntil(start + step * duration / steps);
+
+        // smoothstep, slow off the mark and slow into place
+        double t     = (double)step / steps;
+        double eased = t * t * (3 - 2 * t);
+        moveTo(session,
+               uvcDevice,
+               fields,
+               (int32_t)lround(from.pan + (preset->pan - from.pan) * eased),
+               (int32_t)lround(from.tilt + (preset->tilt - from.tilt) * eased),
+               (int32_t)lround(from.zoom + (preset->zoom - from.zoom) * eased),
+               flags,
+               commandResult);
+        if (commandResult->result != 0) {
+            return;
+        }
+    }
+
+    // axes the camera could not report its position for still get there
+    if (preset->fields & ~fields) {
+        moveTo(session,
+               uvcDevice,
+               preset->fields & ~fields,
+               preset->pan,
+               preset->tilt,
+               preset->zoom,
+               flags,
+               commandResult);
+    }
+}
+
+}  // namespace ptz
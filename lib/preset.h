@@ -0,0 +1,101 @@
+#ifndef PTZ_PRESET_H
+#define PTZ_PRESET_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "command.h"
+#include "device.h"
+#include "session.h"
+
+namespace ptz {
+
+// named camera positions for every camera, kept in one memory mapped file so
+// they survive restarts and need no parsing to load. the file is an open
+// addressed hash table of fixed size entries keyed by camera and name, so a
+// lookup touches one or two entries however many presets are stored. a
+// camera is its vendor, product, serial and port as it was addressed, so
+// identical cameras picked by serial or port keep presets of their own.
+#define PTZ_PRESET_MAGIC "PTZPRE1"
+#define PTZ_PRESET_VERSION 2
+#define PRESET_NAME_SIZE 32  // including the terminating NUL
+
+struct PresetHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint32_t capacity;    // entries, a power of two
+    uint32_t count;       // live presets
+    uint32_t tombstones;  // deleted entries still breaking probe chains
+    uint8_t  reserved[36];
+};
+
+#define PRESET_ENTRY_EMPTY 0
+#define PRESET_ENTRY_USED 1
+#define PRESET_ENTRY_DELETED 2
+
+#define PRESET_PAN_TILT 1
+#define PRESET_ZOOM 2
+
+struct PresetEntry {
+    uint64_t hash;
+    uint16_t vendorId;
+    uint16_t productId;
+    uint8_t  state;  // written last, an entry only counts once it is USED
+    uint8_t  simulated;
+    uint8_t  fields;  // PRESET_PAN_TILT | PRESET_ZOOM
+    uint8_t  reserved;
+    int32_t  pan;
+    int32_t  tilt;
+    int32_t  zoom;
+    uint32_t reserved2;
+    char     name[PRESET_NAME_SIZE];
+    char     serial[DEVICE_SERIAL_SIZE];  // empty when not picked by serial
+    char     port[DEVICE_PORT_SIZE];      // empty when not picked by port
+};
+
+struct Preset {
+    int      fields;
+    int32_t  pan;
+    int32_t  tilt;
+    uint16_t zoom;
+};
+
+struct PresetStats {
+    int      open;
+    uint32_t capacity;
+    uint32_t count;
+};
+
+// open or create the store, replacing any open one. capacity is only used
+// for a new file and is rounded up to a power of two. returns 0, an errno
+// value, or EINVAL when the file is not a preset store.
+int  presetOpen(const char* path, uint32_t capacity);
+void presetClose();
+// the functions below return 0, EBADF when no store is open, or as noted
+// ENAMETOOLONG, ENOSPC when the store is full
+int presetSave(const struct UVCDevice* uvcDevice, const char* name, const struct Preset* preset);
+// ENOENT when there is no such preset
+int  presetFind(const struct UVCDevice* uvcDevice, const char* name, struct Preset* preset);
+int  presetDelete(const struct UVCDevice* uvcDevice, const char* name);
+int  presetList(const struct UVCDevice* uvcDevice, std::vector<std::string>* names);
+void presetGetStats(struct PresetStats* stats);
+
+// read the camera's current position into a preset
+void presetCapture(struct CameraSession* session,
+                   struct UVCDevice*     uvcDevice,
+                   struct Preset*        preset,
+                   struct CommandResult* commandResult);
+// move to a preset. with a duration the camera is stepped there along an
+// eased path instead of jumping, blocking the caller until it arrives. flags
+// are set on every command sent.
+void presetRecall(struct CameraSession* session,
+                  struct UVCDevice*     uvcDevice,
+                  const struct Preset*  preset,
+                  uint32_t              durationMs,
+                  int                   flags,
+                  struct CommandResult* commandResult);
+
+}  // namespace ptz
+
+#endif  // PTZ_PRESET_H
@@ -0,0 +1,648 @@
+#include "profile.h"
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "error.h"
+#include "session.h"
+#include "stats.h"
+
+namespace ptz {
+
+// how much of an axis' range one measuring move may cover
+#define CALIBRATION_TRAVEL 0.6
+// longest wait for a camera to stop, or to finish an absolute move
+#define CALIBRATION_SETTLE_NS 3000000000ULL
+#define CALIBRATION_SLEW_NS 10000000000ULL
+
+static std::mutex                        profileMutex;
+static std::string                       profilePath;
+static bool                              profileIsOpen = false;
+static std::vector<struct MotionProfile> profiles;
+static std::atomic<uint64_t>             generation(0);
+
+int profileOpen(const char* path) {
+    std::vector<struct MotionProfile> loaded;
+    FILE*                             file = fopen(path, "rb");
+    if (file == NULL && errno != ENOENT) {
+        return errno;
+    }
+    if (file != NULL) {
+        struct ProfileHeader header;
+        size_t               read = fread(&header, 1, sizeof(header), file);
+        // an empty file is an empty store
+        if (read != 0) {
+            if (read != sizeof(header) ||
+                memcmp(header.magic, PTZ_PROFILE_MAGIC, sizeof(header.magic)) != 0 ||
+                header.version != PTZ_PROFILE_VERSION ||
+                header.entrySize != sizeof(struct MotionProfile)) {
+                fclose(file);
+                return EINVAL;
+            }
+            loaded.resize(header.count);
+            if (header.count > 0 &&
+                fread(loaded.data(), sizeof(struct MotionProfile), header.count, file) !=
+                    header.count) {
+                fclose(file);
+                return EINVAL;
+            }
+        }
+        fclose(file);
+    }
+
+    std::lock_guard<std::mutex> lock(profileMutex);
+    profilePath   = path;
+    profileIsOpen = true;
+    profiles.swap(loaded);
+    generation.fetch_add(1, std::memory_order_release);
+    return 0;
+}
+
+void profileClose() {
+    std::lock_guard<std::mutex> lock(profileMutex);
+    profileIsOpen = false;
+    profilePath.clear();
+    profiles.clear();
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+bool profileFind(const struct UVCDevice* uvcDevice, struct MotionProfile* profile) {
+    std::lock_guard<std::mutex> lock(profileMutex);
+    const struct MotionProfile* model = NULL;
+    for (const struct MotionProfile& candidate : profiles) {
+        if (candidate.vendorId != uvcDevice->vendorId ||
+            candidate.productId != uvcDevice->productId) {
+            continue;
+        }
+        if (strcmp(candidate.serial, uvcDevice->serial) == 0) {
+            *profile = candidate;
+            return true;
+        }
+        if (model == NULL) {
+            model = &candidate;
+        }
+    }
+    if (model != NULL) {
+        *profile = *model;
+        return true;
+    }
+    return false;
+}
+
+// written beside the store and renamed over it, so a crash mid-save leaves
+// the old profiles rather than half of the new ones
+static int writeStore(const std::string& path, const std::vector<struct MotionProfile>& entries) {
+    std::string temporary = path + ".tmp";
+    FILE*       file      = fopen(temporary.c_str(), "wb");
+    if (file == NULL) {
+        return errno;
+    }
+    struct ProfileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PTZ_PROFILE_MAGIC, sizeof(header.magic));
+    header.version   = PTZ_PROFILE_VERSION;
+    header.entrySize = sizeof(struct MotionProfile);
+    header.count     = (uint32_t)entries.size();
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   (entries.empty() ||
+                    fwrite(entries.data(), sizeof(struct MotionProfile), entries.size(), file) ==
+                        entries.size()) &&
+                   fflush(file) == 0 && fsync(fileno(file)) == 0;
+    int error = written ? 0 : errno;
+    if (fclose(file) != 0 && error == 0) {
+        error = errno;
+    }
+    if (error == 0 && rename(temporary.c_str(), path.c_str()) != 0) {
+        error = errno;
+    }
+    if (error != 0) {
+        unlink(temporary.c_str());
+    }
+    return error;
+}
+
+int profileSave(const struct MotionProfile* profile) {
+    std::lock_guard<std::mutex> lock(profileMutex);
+    if (!profileIsOpen) {
+        return EBADF;
+    }
+    std::vector<struct MotionProfile> updated(profiles);
+    bool                              replaced = false;
+    for (struct MotionProfile& existing : updated) {
+        if (existing.vendorId == profile->vendorId && existing.productId == profile->productId &&
+            strcmp(existing.serial, profile->serial) == 0) {
+            existing = *profile;
+            replaced = true;
+            break;
+        }
+    }
+    if (!replaced) {
+        updated.push_back(*profile);
+    }
+
+    int error = writeStore(profilePath, updated);
+    if (error != 0) {
+        return error;
+    }
+    profiles.swap(updated);
+    generation.fetch_add(1, std::memory_order_release);
+    return 0;
+}
+
+uint64_t profileGeneration() {
+    return generation.load(std::memory_order_acquire);
+}
+
+void profileApply(const struct MotionProfile* profile, struct SpeedModel* model) {
+    double* speeds[ESTIMATE_AXES] = {&model->pan_speed, &model->tilt_speed, &model->zoom_speed};
+    double* slews[ESTIMATE_AXES]  = {&model->pan_slew, &model->tilt_slew, &model->zoom_slew};
+    double  worst                 = 0;
+    bool    measured              = false;
+    for (int axis = 0; axis < ESTIMATE_AXES; axis++) {
+        const struct AxisProfile* axisProfile = &profile->axes[axis];
+        if (axisProfile->count > 0 && axisProfile->per_step > 0) {
+            *speeds[axis] = axisProfile->per_step;
+            worst         = std::max(worst, (double)axisProfile->linearity);
+            measured      = true;
+        }
+        if (axisProfile->slew > 0) {
+            *slews[axis] = axisProfile->slew;
+        }
+    }
+    // a measured camera is still off by a little, from one move to the next
+    if (measured) {
+        model->speed_error = std::max(worst, 0.02);
+    }
+}
+
+// the camera's ranges and speeds, and the reads calibration makes
+struct Probe {
+    struct UVCDevice*               uvcDevice;
+    const struct CalibrationConfig* config;
+    uint64_t                        timeout;  // per transfer, ns, 0 for none
+    bool                            axes[ESTIMATE_AXES];
+    double                          min[ESTIMATE_AXES];
+    double                          max[ESTIMATE_AXES];
+    uint8_t                         minSpeed[ESTIMATE_AXES];
+    uint8_t                         maxSpeed[ESTIMATE_AXES];
+    double                          position[ESTIMATE_AXES];  // as of the last read
+    std::vector<double>             transfers;                // read round trips, ms
+    struct CommandResult            failure;
+    bool                            failed;
+};
+
+static void probeFail(struct Probe* probe, uvc_error_t result) {
+    if (!probe->failed) {
+        probe->failed         = true;
+        probe->failure.result = result;
+        probe->failure.error  = errorMessage(result);
+    }
+}
+
+// every transfer gets the camera's timeout_ms of its own, like a command
+static void probeArm(struct Probe* probe) {
+    probe->uvcDevice->deadline = probe->timeout != 0 ? monotonicNanos() + probe->timeout : 0;
+}
+
+static bool probeRead(struct Probe* probe, int axis, uint64_t* at, double* value) {
+    probeArm(probe);
+    uint64_t    started = monotonicNanos();
+    uvc_error_t result;
+    if (axis == ESTIMATE_ZOOM) {
+        uint16_t zoom;
+        result = getCurrentZoom(probe->uvcDevice, &zoom);
+        if (result == 0) {
+            probe->position[ESTIMATE_ZOOM] = zoom;
+        }
+    } else {
+        int32_t pan;
+        int32_t tilt;
+        result = getCurrentPanTilt(probe->uvcDevice, &pan, &tilt);
+        if (result == 0) {
+            probe->position[ESTIMATE_PAN]  = pan;
+            probe->position[ESTIMATE_TILT] = tilt;
+        }
+    }
+    *at = monotonicNanos();
+    if (result != 0) {
+        probeFail(probe, result);
+        return false;
+    }
+    probe->transfers.push_back((double)(*at - started) / 1e6);
+    *value = probe->position[axis];
+    return true;
+}
+
+// direction 0 stops the axis. pan and tilt share a control, and the idle one
+// is sent its slowest speed, as some cameras refuse a speed of 0.
+static bool probeDrive(struct Probe* probe, int axis, int direction, uint8_t speed) {
+    struct Command command;
+    memset(&command, 0, sizeof(command));
+    if (axis == ESTIMATE_ZOOM) {
+        command.op      = CMD_RELATIVE_ZOOM;
+        command.args[0] = direction;
+        command.args[1] = speed;
+    } else {
+        int other                = axis == ESTIMATE_PAN ? ESTIMATE_TILT : ESTIMATE_PAN;
+        int first                = axis == ESTIMATE_PAN ? 0 : 2;
+        int second               = axis == ESTIMATE_PAN ? 2 : 0;
+        command.op               = CMD_RELATIVE_PAN_TILT;
+        command.args[first]      = direction;
+        command.args[first + 1]  = speed;
+        command.args[second]     = 0;
+        command.args[second + 1] = std::max(probe->minSpeed[other], (uint8_t)1);
+    }
+    // a stop still goes out once calibration has been cancelled, and only
+    // a further cancel gives up on it
+    uint32_t cancelMark = probe->uvcDevice->cancelMark;
+    if (direction == 0) {
+        probe->uvcDevice->cancelMark = probe->uvcDevice->cancels->load(std::memory_order_acquire);
+    }
+    probeArm(probe);
+    struct CommandResult commandResult;
+    executeCommand(probe->uvcDevice, &command, &commandResult);
+    probe->uvcDevice->cancelMark = cancelMark;
+    if (commandResult.result != 0) {
+        probeFail(probe, commandResult.result);
+        return false;
+    }
+    return true;
+}
+
+static bool probeSeek(struct Probe* probe, int axis, double target) {
+    struct Command command;
+    memset(&command, 0, sizeof(command));
+    if (axis == ESTIMATE_ZOOM) {
+        command.op      = CMD_ABSOLUTE_ZOOM;
+        command.args[0] = (int32_t)lround(target);
+    } else {
+        command.op      = CMD_ABSOLUTE_PAN_TILT;
+        command.args[0] = (int32_t)lround(axis == ESTIMATE_PAN ? target
+                                                               : probe->position[ESTIMATE_PAN]);
+        command.args[1] = (int32_t)lround(axis == ESTIMATE_TILT ? target
+                                                                : probe->position[ESTIMATE_TILT]);
+    }
+    probeArm(probe);
+    struct CommandResult commandResult;
+    executeCommand(probe->uvcDevice, &command, &commandResult);
+    if (commandResult.result != 0) {
+        probeFail(probe, commandResult.result);
+        return false;
+    }
+    return true;
+}
+
+static void sleepMs(uint32_t ms) {
+    sleepUntil(monotonicNanos() + (uint64_t)ms * 1000000ULL);
+}
+
+// wait for two reads in a row to agree
+static bool settle(struct Probe* probe, int axis, double* value) {
+    uint64_t deadline = monotonicNanos() + CALIBRATION_SETTLE_NS;
+    double   last     = NAN;
+    for (;;) {
+        uint64_t at;
+        if (!probeRead(probe, axis, &at, value)) {
+            return false;
+        }
+        if (*value == last || at >= deadline) {
+            return true;
+        }
+        last = *value;
+        sleepMs(probe->config->sample_ms);
+    }
+}
+
+// least squares line through samples of (seconds, position)
+static bool fitLine(const std::vector<std::pair<double, double>>& samples,
+                    double*                                        slope,
+                    double*                                        intercept) {
+    double n   = (double)samples.size();
+    double sx  = 0;
+    double sy  = 0;
+    double sxx = 0;
+    double sxy = 0;
+    for (const std::pair<double, double>& sample : samples) {
+        sx += sample.first;
+        sy += sample.second;
+        sxx += sample.first * sample.first;
+        sxy += sample.first * sample.second;
+    }
+    double denominator = n * sxx - sx * sx;
+    if (samples.size() < 2 || denominator <= 0) {
+        return false;
+    }
+    *slope     = (n * sxy - sx * sy) / denominator;
+    *intercept = (sy - *slope * sx) / n;
+    return true;
+}
+
+// run the axis at speed toward its farther end, sampling as it goes. the
+// rate is the slope of the samples once it moves, the start latency where
+// that line leaves the starting position.
+static bool measureRelative(struct Probe* probe,
+                            int           axis,
+                            uint8_t       speed,
+                            double*       rate,
+                            double*       latencyMs) {
+    double start;
+    if (!settle(probe, axis, &start)) {
+        return false;
+    }
+    double   span      = probe->max[axis] - probe->min[axis];
+    int      direction = start - probe->min[axis] < probe->max[axis] - start ? 1 : -1;
+    uint64_t sent      = monotonicNanos();
+    if (!probeDrive(probe, axis, direction, speed)) {
+        return false;
+    }
+
+    std::vector<std::pair<double, double>> samples;
+    uint64_t deadline = sent + (uint64_t)probe->config->move_ms * 1000000ULL;
+    uint64_t next     = sent;
+    while (monotonicNanos() < deadline) {
+        next += (uint64_t)probe->config->sample_ms * 1000000ULL;
+        sleepUntil(next);
+        uint64_t at;
+        double   value;
+        if (!probeRead(probe, axis, &at, &value)) {
+            break;
+        }
+        if (value != start) {
+            samples.push_back(std::make_pair((double)(at - sent) / 1e9, value));
+        }
+        if (fabs(value - start) >= CALIBRATION_TRAVEL * span) {
+            break;
+        }
+    }
+    // stop even after a failed read
+    probeDrive(probe, axis, 0, speed);
+    if (probe->failed) {
+        return false;
+    }
+
+    double slope;
+    double intercept;
+    if (!fitLine(samples, &slope, &intercept) || slope == 0) {
+        return false;
+    }
+    *rate      = fabs(slope);
+    *latencyMs = std::max((start - intercept) / slope, 0.0) * 1000;
+    return true;
+}
+
+// an absolute move over distance, timed through its middle so the ramps at
+// either end do not count
+static double measureSlew(struct Probe* probe, int axis, double distance) {
+    double start;
+    if (!settle(probe, axis, &start)) {
+        return 0;
+    }
+    int      direction = start - probe->min[axis] < probe->max[axis] - start ? 1 : -1;
+    double   target    = start + direction * distance;
+    double   tolerance = std::max((probe->max[axis] - probe->min[axis]) * 0.002, 1.0);
+    uint64_t sent      = monotonicNanos();
+    if (!probeSeek(probe, axis, target)) {
+        return 0;
+    }
+
+    std::vector<std::pair<double, double>> samples;
+    uint64_t                               arrived = 0;
+    uint64_t                               next    = sent;
+    while (monotonicNanos() - sent < CALIBRATION_SLEW_NS) {
+        next += (uint64_t)probe->config->sample_ms * 1000000ULL;
+        sleepUntil(next);
+        uint64_t at;
+        double   value;
+        if (!probeRead(probe, axis, &at, &value)) {
+            return 0;
+        }
+        double progress = (value - start) / (target - start);
+        if (progress >= 0.1 && progress <= 0.9) {
+            samples.push_back(std::make_pair((double)(at - sent) / 1e9, value));
+        }
+        if (fabs(value - target) <= tolerance) {
+            arrived = at;
+            break;
+        }
+    }
+
+    double slope;
+    double intercept;
+    if (fitLine(samples, &slope, &intercept) && slope != 0) {
+        return fabs(slope);
+    }
+    // too quick to sample mid-move
+    return arrived != 0 ? distance / ((double)(arrived - sent) / 1e9) : 0;
+}
+
+static void calibrateAxis(struct Probe* probe, int axis, struct AxisProfile* out) {
+    const struct CalibrationConfig* config = probe->config;
+    uint8_t  lo    = std::max(probe->minSpeed[axis], (uint8_t)1);
+    uint8_t  hi    = std::max(probe->maxSpeed[axis], lo);
+    uint32_t count = std::min(std::max(config->speeds, 2U), (uint32_t)PROFILE_SPEEDS);
+    count          = std::min(count, (uint32_t)(hi - lo + 1));
+
+    double latency = 0;
+    double fastest = 0;
+    for (uint32_t i = 0; i < count && !probe->failed; i++) {
+        uint8_t speed = count > 1 ? (uint8_t)lround(lo + (double)(hi - lo) * i / (count - 1)) : hi;
+        double  rate;
+        double  latencyMs;
+        if (!measureRelative(probe, axis, speed, &rate, &latencyMs)) {
+            continue;
+        }
+        out->speeds[out->count] = speed;
+        out->rates[out->count]  = (float)rate;
+        out->count++;
+        latency += latencyMs;
+        fastest = std::max(fastest, rate);
+    }
+    if (out->count == 0) {
+        return;
+    }
+
+    // one rate per step through the origin, and how far the worst speed
+    // strays from it
+    double sum    = 0;
+    double square = 0;
+    for (uint32_t i = 0; i < out->count; i++) {
+        sum += out->rates[i] * out->speeds[i];
+        square += (double)out->speeds[i] * out->speeds[i];
+    }
+    double perStep = sum / square;
+    double worst   = 0;
+    for (uint32_t i = 0; i < out->count; i++) {
+        double expected = perStep * out->speeds[i];
+        worst           = std::max(worst, fabs(out->rates[i] - expected) / expected);
+    }
+    out->per_step         = (float)perStep;
+    out->linearity        = (float)worst;
+    out->start_latency_ms = (float)(latency / out->count);
+
+    // about two moves' worth at top speed, so a wide axis does not take a
+    // minute to cross
+    double span     = probe->max[axis] - probe->min[axis];
+    double distance = std::min(CALIBRATION_TRAVEL * span, fastest * config->move_ms / 500.0);
+    if (!probe->failed && distance >= 1) {
+        out->slew = (float)measureSlew(probe, axis, distance);
+    }
+}
+
+static void restorePosition(struct CameraSession* session,
+                            struct UVCDevice*     uvcDevice,
+                            const struct Probe*   probe,
+                            const double*         start,
+                            struct CommandResult* commandResult) {
+    struct Command command;
+    memset(&command, 0, sizeof(command));
+    commandResult->result = UVC_SUCCESS;
+    commandResult->error  = NULL;
+    // through the session, so its cache and estimate follow the camera home
+    command.flags = COMMAND_FORCE;
+    if (probe->axes[ESTIMATE_PAN] || probe->axes[ESTIMATE_TILT]) {
+        command.op      = CMD_ABSOLUTE_PAN_TILT;
+        command.args[0] = (int32_t)start[ESTIMATE_PAN];
+        command.args[1] = (int32_t)start[ESTIMATE_TILT];
+        sessionRun(session, uvcDevice, &command, commandResult);
+    }
+    if (probe->axes[ESTIMATE_ZOOM] && commandResult->result == 0) {
+        command.op      = CMD_ABSOLUTE_ZOOM;
+        command.args[0] = (int32_t)start[ESTIMATE_ZOOM];
+        sessionRun(session, uvcDevice, &command, commandResult);
+    }
+}
+
+// hand the caller back the deadline and cancel it came with
+static void restoreDeadline(struct UVCDevice* uvcDevice, const struct UVCDevice* caller) {
+    uvcDevice->deadline   = caller->deadline;
+    uvcDevice->cancels    = caller->cancels;
+    uvcDevice->cancelMark = caller->cancelMark;
+}
+
+void profileCalibrate(struct CameraSession*           session,
+                      struct UVCDevice*               uvcDevice,
+                      const struct CalibrationConfig* config,
+                      struct MotionProfile*           profile,
+                      struct CommandResult*           commandResult) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    memset(profile, 0, sizeof(*profile));
+    profile->vendorId   = (uint16_t)uvcDevice->vendorId;
+    profile->productId  = (uint16_t)uvcDevice->productId;
+    profile->calibrated = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    snprintf(profile->serial, sizeof(profile->serial), "%s", uvcDevice->serial);
+
+    struct SessionConfig sessionConfig;
+    sessionGetConfig(session, &sessionConfig);
+    struct Probe probe;
+    probe.uvcDevice = uvcDevice;
+    probe.config    = config;
+    probe.timeout   = (uint64_t)sessionConfig.timeout_ms * 1000000;
+    probe.failed    = false;
+    for (int axis = 0; axis < ESTIMATE_AXES; axis++) {
+        probe.axes[axis]     = false;
+        probe.min[axis]      = 0;
+        probe.max[axis]      = 0;
+        probe.minSpeed[axis] = 0;
+        probe.maxSpeed[axis] = 0;
+        probe.position[axis] = 0;
+    }
+
+    openDevice(uvcDevice);
+    if (uvcDevice->result != 0) {
+        commandResult->result = uvcDevice->result;
+        commandResult->error  = errorMessage(uvcDevice->result);
+        return;
+    }
+    // a cancel on the camera stops calibration at its next transfer
+    struct UVCDevice caller = *uvcDevice;
+    uvcDevice->cancels      = sessionCancels(session);
+    uvcDevice->cancelMark   = uvcDevice->cancels->load(std::memory_order_acquire);
+
+    // an axis is measured when it has both a range and relative speeds
+    struct AbsolutePanTiltInfo absolutePanTilt;
+    struct RelativePanTiltInfo relativePanTilt;
+    probeArm(&probe);
+    getAbsolutePanTiltInfo(uvcDevice, &absolutePanTilt);
+    probeArm(&probe);
+    getRelativePanTiltInfo(uvcDevice, &relativePanTilt);
+    if (absolutePanTilt.result == 0 && relativePanTilt.result == 0) {
+        probe.min[ESTIMATE_PAN]       = absolutePanTilt.min_pan;
+        probe.max[ESTIMATE_PAN]       = absolutePanTilt.max_pan;
+        probe.min[ESTIMATE_TILT]      = absolutePanTilt.min_tilt;
+        probe.max[ESTIMATE_TILT]      = absolutePanTilt.max_tilt;
+        probe.position[ESTIMATE_PAN]  = absolutePanTilt.current_pan;
+        probe.position[ESTIMATE_TILT] = absolutePanTilt.current_tilt;
+        probe.minSpeed[ESTIMATE_PAN]  = relativePanTilt.min_pan_speed;
+        probe.maxSpeed[ESTIMATE_PAN]  = relativePanTilt.max_pan_speed;
+        probe.minSpeed[ESTIMATE_TILT] = relativePanTilt.min_tilt_speed;
+        probe.maxSpeed[ESTIMATE_TILT] = relativePanTilt.max_tilt_speed;
+    }
+    struct AbsoluteZoomInfo absoluteZoom;
+    struct RelativeZoomInfo relativeZoom;
+    probeArm(&probe);
+    getAbsoluteZoomInfo(uvcDevice, &absoluteZoom);
+    probeArm(&probe);
+    getRelativeZoomInfo(uvcDevice, &relativeZoom);
+    if (absoluteZoom.result == 0 && relativeZoom.result == 0) {
+        probe.min[ESTIMATE_ZOOM]      = absoluteZoom.min;
+        probe.max[ESTIMATE_ZOOM]      = absoluteZoom.max;
+        probe.position[ESTIMATE_ZOOM] = absoluteZoom.current;
+        probe.minSpeed[ESTIMATE_ZOOM] = relativeZoom.min_speed;
+        probe.maxSpeed[ESTIMATE_ZOOM] = relativeZoom.max_speed;
+    }
+
+    double start[ESTIMATE_AXES];
+    bool   any = false;
+    for (int axis = 0; axis < ESTIMATE_AXES; axis++) {
+        start[axis]      = probe.position[axis];
+        probe.axes[axis] = probe.max[axis] > probe.min[axis] && probe.maxSpeed[axis] > 0;
+        any              = any || probe.axes[axis];
+    }
+    if (!any) {
+        closeDevice(uvcDevice);
+        restoreDeadline(uvcDevice, &caller);
+        uvc_error_t result    = absolutePanTilt.result != 0 ? absolutePanTilt.result
+                                                            : relativePanTilt.result;
+        commandResult->result = result != 0 ? result : UVC_ERROR_NOT_SUPPORTED;
+        commandResult->error  = errorMessage(commandResult->result);
+        return;
+    }
+
+    for (int axis = 0; axis < ESTIMATE_AXES && !probe.failed; axis++) {
+        if (probe.axes[axis]) {
+            calibrateAxis(&probe, axis, &profile->axes[axis]);
+        }
+    }
+    closeDevice(uvcDevice);
+    restoreDeadline(uvcDevice, &caller);
+
+    if (!probe.transfers.empty()) {
+        std::vector<double>::iterator middle = probe.transfers.begin() + probe.transfers.size() / 2;
+        std::nth_element(probe.transfers.begin(), middle, probe.transfers.end());
+        profile->transfer_ms = (float)*middle;
+    }
+
+    // cancelled calibration leaves the camera where it stopped
+    if (!probe.failed || probe.failure.result != UVC_ERROR_INTERRUPTED) {
+        restorePosition(session, uvcDevice, &probe, start, commandResult);
+    }
+    if (probe.failed) {
+        *commandResult = probe.failure;
+        return;
+    }
+
+    sessionGetConfig(session, &sessionConfig);
+    profileApply(profile, &sessionConfig.speed_model);
+    sessionSetConfig(session, &sessionConfig);
+}
+
+}  // namespace ptz
@@ -0,0 +1,83 @@
+#ifndef PTZ_PROFILE_H
+#define PTZ_PROFILE_H
+
+#include <stdint.h>
+#include "command.h"
+#include "device.h"
+#include "estimator.h"
+
+namespace ptz {
+
+struct CameraSession;
+
+// measured motion profiles: how fast each axis really moves per relative
+// speed step and during absolute moves, and how long a camera takes to start
+// moving. calibration drives a camera through its ranges to measure them.
+// profiles are kept in a small file keyed by vendor, product and serial, and
+// a camera's session takes its speed model from its profile when it is
+// first used, so motion planning never has to probe.
+#define PTZ_PROFILE_MAGIC "PTZPRF1"
+#define PTZ_PROFILE_VERSION 1
+#define PROFILE_SPEEDS 8
+
+struct ProfileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint32_t count;
+    uint8_t  reserved[12];
+};
+
+struct AxisProfile {
+    uint32_t count;                   // speeds measured, 0 when the axis was not
+    uint8_t  speeds[PROFILE_SPEEDS];  // relative speed steps
+    float    rates[PROFILE_SPEEDS];   // units per second at each
+    float    per_step;                // rate per speed step, fitted over all of them
+    float    linearity;               // worst miss of that fit, as a fraction
+    float    slew;                    // units per second in an absolute move, 0 when unmeasured
+    float    start_latency_ms;        // from a relative command to the first motion
+};
+
+struct MotionProfile {
+    uint16_t           vendorId;
+    uint16_t           productId;
+    uint32_t           reserved;
+    char               serial[DEVICE_SERIAL_SIZE];  // empty for one shared by the model
+    uint64_t           calibrated;                  // CLOCK_REALTIME nanoseconds
+    float              transfer_ms;                 // median control transfer round trip
+    struct AxisProfile axes[ESTIMATE_AXES];
+};
+
+// load the profiles in path, which is created on the first save. returns 0,
+// an errno value, or EINVAL when the file is not a profile store.
+int  profileOpen(const char* path);
+void profileClose();
+// the camera's own profile, else one from another camera of the same model
+bool profileFind(const struct UVCDevice* uvcDevice, struct MotionProfile* profile);
+// replace the profile for its camera and rewrite the file. returns 0, an
+// errno value, or EBADF when no store is open.
+int profileSave(const struct MotionProfile* profile);
+// bumped whenever the loaded profiles change
+uint64_t profileGeneration();
+
+// the measured parts of profile, laid over model
+void profileApply(const struct MotionProfile* profile, struct SpeedModel* model);
+
+struct CalibrationConfig {
+    uint32_t speeds;     // relative speeds measured per axis, 2 to PROFILE_SPEEDS
+    uint32_t move_ms;    // longest one measuring move runs
+    uint32_t sample_ms;  // between position reads while moving
+};
+
+// drive the camera through its speed range on every axis it has, then put
+// it back where it was. takes a few seconds per axis and speed, and should
+// run on the camera's own thread so queued commands wait for it.
+void profileCalibrate(struct CameraSession*           session,
+                      struct UVCDevice*               uvcDevice,
+                      const struct CalibrationConfig* config,
+                      struct MotionProfile*           profile,
+                      struct CommandResult*           commandResult);
+
+}  // namespace ptz
+
+#endif  // PTZ_PROFILE_H
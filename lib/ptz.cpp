@@ -1,7 +1,29 @@
 #include <nan.h>
-#include <iostream>
-#include <ostream>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
 #include <string>
+#include <vector>
+#include "command.h"
+#include "control.h"
+#include "device.h"
+#include "device_index.h"
+#include "error.h"
+#include "group.h"
+#include "pointing.h"
+#include "preset.h"
+#include "profile.h"
+#include "realtime.h"
+#include "recorder.h"
+#include "session.h"
+#include "simulator.h"
+#include "stats.h"
+#include "tour.h"
+#include "tracker.h"
+#include "velocity.h"
+#include "warm_cache.h"
 #include "libuvc/libuvc.h"
 
 namespace ptz {
@@ -20,23 +42,13 @@ using v8::Integer;
 using v8::Isolate;
 using v8::Local;
 using v8::Null;
+using v8::Number;
 using v8::Object;
 using v8::String;
 using v8::Uint32;
 using v8::Undefined;
 using v8::Value;
 
-// open close device operations
-struct UVCDevice {
-    uvc_context_t*       ctx;
-    uvc_device_t*        device;
-    uvc_device_handle_t* devicehandle;
-    uvc_error_t          result;
-    const char*          error;
-    int                  vendorId;
-    int                  productId;
-};
-
 void trySetting(const Local<Object>& target, const std::string& key, const char* value) {
     Local<Value> v8Key = Nan::New<String>(key).ToLocalChecked();
 
@@ -46,1000 +58,2292 @@ void trySetting(const Local<Object>& target, const std::string& key, const char*
         Nan::Set(target, v8Key, Nan::Null());
     }
 }
-void openDevice(UVCDevice* uvcDevice) {
-    // initalize uvc
-    uvcDevice->result = uvc_init(&uvcDevice->ctx, NULL);
-    if (uvcDevice->result != 0) {
-        uvc_exit(uvcDevice->ctx);
-        std::string error(uvc_strerror(uvcDevice->result));
-        uvcDevice->error = error.c_str();
-    }
-
-    // get device
-    uvcDevice->result = uvc_find_device(
-        uvcDevice->ctx, &uvcDevice->device, uvcDevice->vendorId, uvcDevice->productId, NULL);
-    if (uvcDevice->result != 0) {
-        uvc_unref_device(uvcDevice->device);
-        uvc_exit(uvcDevice->ctx);
-        std::string error(uvc_strerror(uvcDevice->result));
-        uvcDevice->error = error.c_str();
-    }
-
-    // open device
-    uvcDevice->result = uvc_open(uvcDevice->device, &uvcDevice->devicehandle);
-    if (uvcDevice->result != 0) {
-        uvc_close(uvcDevice->devicehandle);
-        uvc_unref_device(uvcDevice->device);
-        uvc_exit(uvcDevice->ctx);
-        std::string error(uvc_strerror(uvcDevice->result));
-        uvcDevice->error = error.c_str();
-    }
-}
-void closeDevice(UVCDevice* uvcDevice) {
-    uvc_close(uvcDevice->devicehandle);
-    uvc_unref_device(uvcDevice->device);
-    uvc_exit(uvcDevice->ctx);
-}
-
-// device operation support check
-struct DeviceCapability {
-    int absolute_zoom;
-    int relative_zoom;
-    int absolute_pan_tilt;
-    int relative_pan_tilt;
-    int absolute_roll;
-    int relative_roll;
-};
-struct DeviceCapability getDeviceCapability(struct UVCDevice* uvcDevice) {
-    struct DeviceCapability deviceCapability;
-    enum uvc_req_code       requestCode;
-    uvc_error_t             res;
-    int32_t                 v1;
-    int32_t                 v2;
-    uint16_t                v3;
-    int8_t                  v4;
-    uint8_t                 v5;
-    uint8_t                 v6;
-    uint8_t                 v7;
-    int16_t                 v8;
-    int8_t                  v10;
-
-    requestCode                    = UVC_GET_DEF;
-    res                            = uvc_get_zoom_abs(uvcDevice->devicehandle, &v3, requestCode);
-    deviceCapability.absolute_zoom = res == 0 ? 1 : 0;
-
-    requestCode = UVC_GET_DEF;
-    res         = uvc_get_zoom_rel(uvcDevice->devicehandle, &v4, &v5, &v6, requestCode);
-    deviceCapability.relative_zoom = res == 0 ? 1 : 0;
-
-    requestCode = UVC_GET_DEF;
-    res         = uvc_get_pantilt_abs(uvcDevice->devicehandle, &v1, &v2, requestCode);
-    deviceCapability.absolute_pan_tilt = res == 0 ? 1 : 0;
-
-    requestCode = UVC_GET_DEF;
-    res         = uvc_get_pantilt_rel(uvcDevice->devicehandle, &v4, &v5, &v10, &v7, requestCode);
-    deviceCapability.relative_pan_tilt = res == 0 ? 1 : 0;
-
-    requestCode                    = UVC_GET_DEF;
-    res                            = uvc_get_roll_abs(uvcDevice->devicehandle, &v8, requestCode);
-    deviceCapability.absolute_roll = res == 0 ? 1 : 0;
-
-    requestCode = UVC_GET_DEF;
-    res         = uvc_get_roll_rel(uvcDevice->devicehandle, &v4, &v5, requestCode);
-    deviceCapability.relative_roll = res == 0 ? 1 : 0;
-
-    return deviceCapability;
-}
-
-// absolute zoom operations
-struct AbsoluteZoomInfo {
-    uint16_t    min;
-    uint16_t    max;
-    uint16_t    resolution;
-    uint16_t    current;
-    uint16_t    def;
-    uvc_error_t result;
-    const char* error;
-};
-void getAbsoluteZoomInfo(struct UVCDevice* uvcDevice, struct AbsoluteZoomInfo* absoluteZoomInfo) {
-    enum uvc_req_code requestCode;
-
-    requestCode              = UVC_GET_MIN;
-    absoluteZoomInfo->result = uvc_get_zoom_abs(
-        uvcDevice->devicehandle, &absoluteZoomInfo->min, requestCode);
-    if (absoluteZoomInfo->result != 0) {
-        std::string error(uvc_strerror(absoluteZoomInfo->result));
-        absoluteZoomInfo->error = error.c_str();
+
+// an Error for a failed command, its code from the static table, e.g.
+// "UVC_ERROR_PIPE", so callers can tell failures apart without the message
+static Local<Value> commandError(const struct CommandResult* commandResult) {
+    const char*   message = commandResult->error;
+    Local<Object> error =
+        Nan::Error(message != NULL ? message : errorMessage(commandResult->result)).As<Object>();
+    Nan::Set(error,
+             Nan::New<String>("code").ToLocalChecked(),
+             Nan::New<String>(errorCode(commandResult->result)).ToLocalChecked());
+    return error;
+}
+
+// descriptors without a string come back as null
+static const char* emptyToNull(const char* value) {
+    return value[0] != 0 ? value : NULL;
+}
+
+// node binding functions
+NAN_METHOD(listDevices) {
+    std::vector<struct DeviceInfo> devices;
+    uvc_error_t                    res = deviceIndexList(&devices);
+    if (res != 0) {
+        Nan::ThrowError(errorMessage(res));
         return;
     }
 
-    requestCode              = UVC_GET_MAX;
-    absoluteZoomInfo->result = uvc_get_zoom_abs(
-        uvcDevice->devicehandle, &absoluteZoomInfo->max, requestCode);
-    if (absoluteZoomInfo->result != 0) {
-        std::string error(uvc_strerror(absoluteZoomInfo->result));
-        absoluteZoomInfo->error = error.c_str();
-        return;
+    // create output result
+    Local<Array> jsDevices = Nan::New<Array>();
+    for (uint32_t i = 0; i < devices.size(); i++) {
+        const struct DeviceInfo* device   = &devices[i];
+        Local<Object>            jsDevice = Nan::New<Object>();
+        Nan::Set(jsDevice,
+                 Nan::New<String>("vendorId").ToLocalChecked(),
+                 Nan::New<Uint32>((uint32_t)device->vendorId));
+        Nan::Set(jsDevice,
+                 Nan::New<String>("productId").ToLocalChecked(),
+                 Nan::New<Uint32>((uint32_t)device->productId));
+
+        trySetting(jsDevice, "serialNumber", emptyToNull(device->serial));
+        trySetting(jsDevice, "manufacturer", emptyToNull(device->manufacturer));
+        trySetting(jsDevice, "product", emptyToNull(device->product));
+        trySetting(jsDevice, "port", emptyToNull(device->port));
+        Nan::Set(jsDevice,
+                 Nan::New<String>("firmware").ToLocalChecked(),
+                 Nan::New<Uint32>((uint32_t)device->firmware));
+        Nan::Set(jsDevice,
+                 Nan::New<String>("busNumber").ToLocalChecked(),
+                 Nan::New<Uint32>((uint32_t)device->bus));
+        Nan::Set(jsDevice,
+                 Nan::New<String>("deviceAddress").ToLocalChecked(),
+                 Nan::New<Uint32>((uint32_t)device->address));
+
+        Nan::Set(jsDevices, i, jsDevice);
     }
 
-    requestCode              = UVC_GET_RES;
-    absoluteZoomInfo->result = uvc_get_zoom_abs(
-        uvcDevice->devicehandle, &absoluteZoomInfo->resolution, requestCode);
-    if (absoluteZoomInfo->result != 0) {
-        std::string error(uvc_strerror(absoluteZoomInfo->result));
-        absoluteZoomInfo->error = error.c_str();
-        return;
+    info.GetReturnValue().Set(jsDevices);
+}
+
+// read an optional string into a fixed buffer, empty when it is missing
+static void readString(const Local<Object>& input, const char* key, char* out, size_t size) {
+    Local<Value> value = Nan::Get(input, Nan::New<String>(key).ToLocalChecked()).ToLocalChecked();
+    out[0]             = 0;
+    if (value->IsString()) {
+        Nan::Utf8String text(value);
+        snprintf(out, size, "%s", *text);
     }
+}
 
-    requestCode              = UVC_GET_DEF;
-    absoluteZoomInfo->result = uvc_get_zoom_abs(
-        uvcDevice->devicehandle, &absoluteZoomInfo->def, requestCode);
-    if (absoluteZoomInfo->result != 0) {
-        std::string error(uvc_strerror(absoluteZoomInfo->result));
-        absoluteZoomInfo->error = error.c_str();
-        return;
+// read the target camera from a js options object
+void readDevice(const Local<Object>& input, struct UVCDevice* uvcDevice) {
+    Local<Value> vendorId = Nan::Get(input, Nan::New<String>("vendorId").ToLocalChecked())
+                                .ToLocalChecked();
+    Local<Value> productId = Nan::Get(input, Nan::New<String>("productId").ToLocalChecked())
+                                 .ToLocalChecked();
+    Local<Value> simulated = Nan::Get(input, Nan::New<String>("simulated").ToLocalChecked())
+                                 .ToLocalChecked();
+
+    uvcDevice->vendorId  = Nan::To<int32_t>(vendorId).FromMaybe(0);
+    uvcDevice->productId = Nan::To<int32_t>(productId).FromMaybe(0);
+    uvcDevice->simulated = Nan::To<bool>(simulated).FromMaybe(false) ? 1 : 0;
+    readString(input, "serialNumber", uvcDevice->serial, sizeof(uvcDevice->serial));
+    readString(input, "port", uvcDevice->port, sizeof(uvcDevice->port));
+    uvcDevice->deadline   = 0;
+    uvcDevice->cancels    = NULL;
+    uvcDevice->cancelMark = 0;
+}
+
+// read a command's named arguments from a js options object
+void readCommand(const Local<Object>& input, int op, struct Command* command) {
+    const struct CommandSpec* spec = commandSpec(op);
+
+    Local<Value> force = Nan::Get(input, Nan::New<String>("force").ToLocalChecked())
+                             .ToLocalChecked();
+
+    command->op    = (uint8_t)op;
+    command->flags = Nan::To<bool>(force).FromMaybe(false) ? COMMAND_FORCE : 0;
+    for (int i = 0; i < 4; i++) {
+        command->args[i] = 0;
+        if (i < spec->argCount) {
+            Local<Value> arg = Nan::Get(input, Nan::New<String>(spec->argNames[i]).ToLocalChecked())
+                                   .ToLocalChecked();
+            command->args[i] = Nan::To<int32_t>(arg).FromMaybe(0);
+        }
+    }
+}
+
+// the command an input names: a dedicated command by name alone, or
+// getControl, setControl or getRanges with the control in input.control.
+// returns -1 when either is unknown.
+static int findCommand(const char* name, const Local<Object>& input) {
+    int op = commandFind(name);
+    if (op >= 0) {
+        return op;
+    }
+    char control[64];
+    readString(input, "control", control, sizeof(control));
+    return commandFindControl(name, control);
+}
+
+// read an optional number, keeping the current value when it is missing
+double readNumber(const Local<Object>& input, const char* key, double current) {
+    Local<Value> value = Nan::Get(input, Nan::New<String>(key).ToLocalChecked()).ToLocalChecked();
+    if (value->IsUndefined()) {
+        return current;
+    }
+    return Nan::To<double>(value).FromMaybe(current);
+}
+
+// a command's own deadline, from now, when input has a timeoutMs. queued
+// commands count their time in the queue.
+static void readDeadline(const Local<Object>& input, struct UVCDevice* uvcDevice) {
+    double timeoutMs = readNumber(input, "timeoutMs", 0);
+    if (timeoutMs > 0) {
+        uvcDevice->deadline = monotonicNanos() + (uint64_t)(timeoutMs * 1e6);
+    }
+}
+
+// a control's fields by the names in its table entry
+static Local<Value> controlFieldsToJs(const struct ControlSpec* spec, const int32_t* values) {
+    Local<Object> result = Nan::New<Object>();
+    for (int i = 0; i < controlFieldCount(*spec); i++) {
+        Nan::Set(result,
+                 Nan::New<String>(spec->fields[i].name).ToLocalChecked(),
+                 Nan::New<Integer>(values[i]));
+    }
+    return result;
+}
+
+// one of getRanges' ranges, null when the camera lacks it
+static Local<Value> controlRangeToJs(const struct ControlSpec*   spec,
+                                     const struct ControlRanges* ranges,
+                                     uint32_t                    request,
+                                     const int32_t*              values) {
+    if (!(ranges->requests & request)) {
+        return Nan::Null();
+    }
+    return controlFieldsToJs(spec, values);
+}
+
+static Local<Value> controlResultToJs(const struct Command*       command,
+                                      const struct CommandResult* r) {
+    int control = commandControl(command->op);
+    if (control < 0 || commandControlRequest(command->op) == CONTROL_SET) {
+        return Nan::Undefined();
+    }
+    const struct ControlSpec* spec = &controlSpecs[control];
+    if (commandControlRequest(command->op) == CONTROL_GET) {
+        return controlFieldsToJs(spec, r->controlValues.values);
     }
 
-    requestCode              = UVC_GET_CUR;
-    absoluteZoomInfo->result = uvc_get_zoom_abs(
-        uvcDevice->devicehandle, &absoluteZoomInfo->current, requestCode);
-    if (absoluteZoomInfo->result != 0) {
-        std::string error(uvc_strerror(absoluteZoomInfo->result));
-        absoluteZoomInfo->error = error.c_str();
+    const struct ControlRanges* ranges = &r->controlRanges;
+    Local<Object>               result = Nan::New<Object>();
+    Nan::Set(result,
+             Nan::New<String>("min").ToLocalChecked(),
+             controlRangeToJs(spec, ranges, CONTROL_HAS_MIN, ranges->min));
+    Nan::Set(result,
+             Nan::New<String>("max").ToLocalChecked(),
+             controlRangeToJs(spec, ranges, CONTROL_HAS_MAX, ranges->max));
+    Nan::Set(result,
+             Nan::New<String>("resolution").ToLocalChecked(),
+             controlRangeToJs(spec, ranges, CONTROL_HAS_RES, ranges->resolution));
+    Nan::Set(result,
+             Nan::New<String>("default").ToLocalChecked(),
+             controlRangeToJs(spec, ranges, CONTROL_HAS_DEF, ranges->def));
+    return result;
+}
+
+// create output result
+Local<Value> commandResultToJs(const struct Command* command, const struct CommandResult* r) {
+    // writes answer nothing, so they return without touching the js heap
+    if (!commandSpec(command->op)->read) {
+        return Nan::Undefined();
+    }
+    Local<Object> result = Nan::New<Object>();
+    switch (command->op) {
+        case CMD_GET_CAPABILITIES:
+            Nan::Set(result,
+                     Nan::New<String>("absoluteZoom").ToLocalChecked(),
+                     Nan::New<Boolean>(r->capability.absolute_zoom));
+            Nan::Set(result,
+                     Nan::New<String>("relativeZoom").ToLocalChecked(),
+                     Nan::New<Boolean>(r->capability.relative_zoom));
+            Nan::Set(result,
+                     Nan::New<String>("absolutePanTilt").ToLocalChecked(),
+                     Nan::New<Boolean>(r->capability.absolute_pan_tilt));
+            Nan::Set(result,
+                     Nan::New<String>("relativePanTilt").ToLocalChecked(),
+                     Nan::New<Boolean>(r->capability.relative_pan_tilt));
+            Nan::Set(result,
+                     Nan::New<String>("absoluteRoll").ToLocalChecked(),
+                     Nan::New<Boolean>(r->capability.absolute_roll));
+            Nan::Set(result,
+                     Nan::New<String>("relativeRoll").ToLocalChecked(),
+                     Nan::New<Boolean>(r->capability.relative_roll));
+            return result;
+        case CMD_GET_ABSOLUTE_ZOOM:
+            Nan::Set(result,
+                     Nan::New<String>("min").ToLocalChecked(),
+                     Nan::New<Integer>(r->absoluteZoomInfo.min));
+            Nan::Set(result,
+                     Nan::New<String>("max").ToLocalChecked(),
+                     Nan::New<Integer>(r->absoluteZoomInfo.max));
+            Nan::Set(result,
+                     Nan::New<String>("resolution").ToLocalChecked(),
+                     Nan::New<Integer>(r->absoluteZoomInfo.resolution));
+            Nan::Set(result,
+                     Nan::New<String>("current").ToLocalChecked(),
+                     Nan::New<Integer>(r->absoluteZoomInfo.current));
+            Nan::Set(result,
+                     Nan::New<String>("default").ToLocalChecked(),
+                     Nan::New<Integer>(r->absoluteZoomInfo.def));
+            return result;
+        case CMD_GET_RELATIVE_ZOOM:
+            Nan::Set(result,
+                     Nan::New<String>("direction").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativeZoomInfo.direction));
+            Nan::Set(result,
+                     Nan::New<String>("digitalZoom").ToLocalChecked(),
+                     Nan::New<Boolean>(r->relativeZoomInfo.digital_zoom));
+            Nan::Set(result,
+                     Nan::New<String>("minSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativeZoomInfo.min_speed));
+            Nan::Set(result,
+                     Nan::New<String>("maxSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativeZoomInfo.max_speed));
+            Nan::Set(result,
+                     Nan::New<String>("resolutionSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativeZoomInfo.resolution_speed));
+            Nan::Set(result,
+                     Nan::New<String>("currentSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativeZoomInfo.current_speed));
+            Nan::Set(result,
+                     Nan::New<String>("defaultSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativeZoomInfo.default_speed));
+            return result;
+        case CMD_GET_ABSOLUTE_PAN_TILT:
+            Nan::Set(result,
+                     Nan::New<String>("minPan").ToLocalChecked(),
+                     Nan::New<Integer>(r->absolutePanTiltInfo.min_pan));
+            Nan::Set(result,
+                     Nan::New<String>("minTilt").ToLocalChecked(),
+                     Nan::New<Integer>(r->absolutePanTiltInfo.min_tilt));
+            Nan::Set(result,
+                     Nan::New<String>("maxPan").ToLocalChecked(),
+                     Nan::New<Integer>(r->absolutePanTiltInfo.max_pan));
+            Nan::Set(result,
+                     Nan::New<String>("maxTilt").ToLocalChecked(),
+                     Nan::New<Integer>(r->absolutePanTiltInfo.max_tilt));
+            Nan::Set(result,
+                     Nan::New<String>("resolutionPan").ToLocalChecked(),
+                     Nan::New<Integer>(r->absolutePanTiltInfo.resolution_pan));
+            Nan::Set(result,
+                     Nan::New<String>("resolutionTilt").ToLocalChecked(),
+                     Nan::New<Integer>(r->absolutePanTiltInfo.resolution_tilt));
+            Nan::Set(result,
+                     Nan::New<String>("currentPan").ToLocalChecked(),
+                     Nan::New<Integer>(r->absolutePanTiltInfo.current_pan));
+            Nan::Set(result,
+                     Nan::New<String>("currentTilt").ToLocalChecked(),
+                     Nan::New<Integer>(r->absolutePanTiltInfo.current_tilt));
+            Nan::Set(result,
+                     Nan::New<String>("defaultPan").ToLocalChecked(),
+                     Nan::New<Integer>(r->absolutePanTiltInfo.default_pan));
+            Nan::Set(result,
+                     Nan::New<String>("defaultTilt").ToLocalChecked(),
+                     Nan::New<Integer>(r->absolutePanTiltInfo.default_tilt));
+            return result;
+        case CMD_GET_RELATIVE_PAN_TILT:
+            Nan::Set(result,
+                     Nan::New<String>("panDirection").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativePanTiltInfo.pan_direction));
+            Nan::Set(result,
+                     Nan::New<String>("tiltDirection").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativePanTiltInfo.tilt_direction));
+            Nan::Set(result,
+                     Nan::New<String>("minPanSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativePanTiltInfo.min_pan_speed));
+            Nan::Set(result,
+                     Nan::New<String>("minTiltSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativePanTiltInfo.min_tilt_speed));
+            Nan::Set(result,
+                     Nan::New<String>("maxPanSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativePanTiltInfo.max_pan_speed));
+            Nan::Set(result,
+                     Nan::New<String>("maxTiltSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativePanTiltInfo.max_tilt_speed));
+            Nan::Set(result,
+                     Nan::New<String>("resolutionPanSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativePanTiltInfo.resolution_pan_speed));
+            Nan::Set(result,
+                     Nan::New<String>("resolutionTiltSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativePanTiltInfo.resolution_tilt_speed));
+            Nan::Set(result,
+                     Nan::New<String>("defaultPanSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativePanTiltInfo.default_pan_speed));
+            Nan::Set(result,
+                     Nan::New<String>("defaultTiltSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativePanTiltInfo.default_tilt_speed));
+            Nan::Set(result,
+                     Nan::New<String>("currentPanSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativePanTiltInfo.current_pan_speed));
+            Nan::Set(result,
+                     Nan::New<String>("currentTiltSpeed").ToLocalChecked(),
+                     Nan::New<Integer>(r->relativePanTiltInfo.current_tilt_speed));
+            return result;
+        default:
+            return controlResultToJs(command, r);
+    }
+}
+
+// open the camera named in info[0], run one command and return its result
+void runFromJs(const FunctionCallbackInfo<Value>& info, int op) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
+
+    // get options
+    struct UVCDevice uvcDevice;
+    struct Command   command;
+    readDevice(input, &uvcDevice);
+    readDeadline(input, &uvcDevice);
+    readCommand(input, op, &command);
+
+    struct CommandResult commandResult;
+    sessionRun(sessionFind(&uvcDevice), &uvcDevice, &command, &commandResult);
+    if (commandResult.result != 0) {
+        Nan::ThrowException(commandError(&commandResult));
         return;
     }
+
+    // trigger callback
+    info.GetReturnValue().Set(commandResultToJs(&command, &commandResult));
+}
+
+// per camera outcome of a group run, in the order the cameras first appeared
+static Local<Value> groupResultToJs(const std::vector<struct GroupMember>& members,
+                                    const struct GroupStats&               stats) {
+    Local<Array> cameras = Nan::New<Array>();
+    for (uint32_t i = 0; i < members.size(); i++) {
+        const struct GroupMember* member = &members[i];
+        Local<Object>             camera = Nan::New<Object>();
+        Nan::Set(camera,
+                 Nan::New<String>("vendorId").ToLocalChecked(),
+                 Nan::New<Number>(member->uvcDevice.vendorId));
+        Nan::Set(camera,
+                 Nan::New<String>("productId").ToLocalChecked(),
+                 Nan::New<Number>(member->uvcDevice.productId));
+        Nan::Set(camera,
+                 Nan::New<String>("simulated").ToLocalChecked(),
+                 Nan::New<Boolean>(member->uvcDevice.simulated));
+        trySetting(camera,
+                   "error",
+                   member->commandResult.result != 0 ? member->commandResult.error : NULL);
+        if (member->started != 0) {
+            Nan::Set(camera,
+                     Nan::New<String>("startSkewMs").ToLocalChecked(),
+                     Nan::New<Number>((member->started - stats.released) / 1e6));
+            Nan::Set(camera,
+                     Nan::New<String>("durationMs").ToLocalChecked(),
+                     Nan::New<Number>((member->finished - member->started) / 1e6));
+        }
+        Nan::Set(cameras, i, camera);
+    }
+
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result,
+             Nan::New<String>("skewMs").ToLocalChecked(),
+             Nan::New<Number>(stats.skew / 1e6));
+    Nan::Set(result, Nan::New<String>("cameras").ToLocalChecked(), cameras);
+    return result;
+}
+
+// a calibrated camera, with null for any axis it does not have
+static Local<Value> profileToJs(const struct MotionProfile* profile) {
+    const char*   names[ESTIMATE_AXES] = {"pan", "tilt", "zoom"};
+    Local<Object> result               = Nan::New<Object>();
+    Nan::Set(result,
+             Nan::New<String>("vendorId").ToLocalChecked(),
+             Nan::New<Number>(profile->vendorId));
+    Nan::Set(result,
+             Nan::New<String>("productId").ToLocalChecked(),
+             Nan::New<Number>(profile->productId));
+    Nan::Set(result,
+             Nan::New<String>("serialNumber").ToLocalChecked(),
+             Nan::New<String>(profile->serial).ToLocalChecked());
+    Nan::Set(result,
+             Nan::New<String>("calibratedAt").ToLocalChecked(),
+             Nan::New<Number>(round((double)profile->calibrated / 1e6)));
+    Nan::Set(result,
+             Nan::New<String>("transferMs").ToLocalChecked(),
+             Nan::New<Number>(profile->transfer_ms));
+
+    for (int axis = 0; axis < ESTIMATE_AXES; axis++) {
+        const struct AxisProfile* axisProfile = &profile->axes[axis];
+        if (axisProfile->count == 0) {
+            Nan::Set(result, Nan::New<String>(names[axis]).ToLocalChecked(), Nan::Null());
+            continue;
+        }
+        Local<Array> speeds = Nan::New<Array>();
+        for (uint32_t i = 0; i < axisProfile->count; i++) {
+            Local<Object> speed = Nan::New<Object>();
+            Nan::Set(speed,
+                     Nan::New<String>("speed").ToLocalChecked(),
+                     Nan::New<Number>(axisProfile->speeds[i]));
+            Nan::Set(speed,
+                     Nan::New<String>("rate").ToLocalChecked(),
+                     Nan::New<Number>(axisProfile->rates[i]));
+            Nan::Set(speeds, i, speed);
+        }
+        Local<Object> value = Nan::New<Object>();
+        Nan::Set(value, Nan::New<String>("speeds").ToLocalChecked(), speeds);
+        Nan::Set(value,
+                 Nan::New<String>("perStep").ToLocalChecked(),
+                 Nan::New<Number>(axisProfile->per_step));
+        Nan::Set(value,
+                 Nan::New<String>("linearity").ToLocalChecked(),
+                 Nan::New<Number>(axisProfile->linearity));
+        if (axisProfile->slew > 0) {
+            Nan::Set(value,
+                     Nan::New<String>("slew").ToLocalChecked(),
+                     Nan::New<Number>(axisProfile->slew));
+        } else {
+            Nan::Set(value, Nan::New<String>("slew").ToLocalChecked(), Nan::Null());
+        }
+        Nan::Set(value,
+                 Nan::New<String>("startLatencyMs").ToLocalChecked(),
+                 Nan::New<Number>(axisProfile->start_latency_ms));
+        Nan::Set(result, Nan::New<String>(names[axis]).ToLocalChecked(), value);
+    }
+    return result;
 }
 
-struct AbsoluteZoom {
-    uint16_t    zoom;
-    uvc_error_t result;
-    const char* error;
+// async commands run on the camera's own thread, completions are handed
+// back to the js thread that asked through its uv_async handle
+struct JsThread;
+struct CommandBatch;
+struct AsyncCall {
+    Nan::Callback*        callback;
+    struct Command        command;
+    struct CommandResult  commandResult;
+    uint32_t              pending;
+    struct Group*         group;    // a group run, reported instead of command
+    struct MotionProfile* profile;  // a calibration, reported instead of command
+    struct CommandBatch*  batch;    // a stream write, reported per command
+    struct JsThread*      thread;   // where to deliver it
 };
-void setAbsoluteZoom(struct UVCDevice* uvcDevice, struct AbsoluteZoom* absoluteZoom) {
-    absoluteZoom->result = uvc_set_zoom_abs(uvcDevice->devicehandle, absoluteZoom->zoom);
-    if (absoluteZoom->result != 0) {
-        std::string error(uvc_strerror(absoluteZoom->result));
-        absoluteZoom->error = error.c_str();
-        return;
+
+// commands from one stream write, run back to back on the camera's thread as
+// a single queue entry and answered with a single callback
+struct CommandBatch {
+    struct CameraSession*             session;
+    struct UVCDevice                  uvcDevice;
+    std::vector<struct Command>       commands;
+    std::vector<struct CommandResult> results;
+    struct AsyncCall*                 call;
+};
+
+// one result per command, an Error for each that failed
+static Local<Value> batchResultsToJs(const struct CommandBatch* batch) {
+    Local<Array> results = Nan::New<Array>();
+    for (uint32_t i = 0; i < batch->commands.size(); i++) {
+        const struct CommandResult* result = &batch->results[i];
+        Nan::Set(results,
+                 i,
+                 result->result != 0 ? commandError(result)
+                                     : commandResultToJs(&batch->commands[i], result));
     }
+    return results;
 }
 
-// relative zoom operations
-struct RelativeZoomInfo {
-    int8_t      direction;
-    uint8_t     digital_zoom;
-    uint8_t     min_speed;
-    uint8_t     max_speed;
-    uint8_t     resolution_speed;
-    uint8_t     current_speed;
-    uint8_t     default_speed;
-    uvc_error_t result;
-    const char* error;
+// every isolate the addon loads into, the main thread or a worker, gets one
+// of these on its own loop. sessions, stores and camera threads underneath
+// are process wide and shared by all of them.
+struct JsThread {
+    uv_async_t                     completionAsync;
+    uint32_t                       callsInFlight;  // js thread only
+    std::mutex                     completedMutex;
+    std::vector<struct AsyncCall*> completed;
+    bool                           exited;  // the isolate is gone, calls still out are dropped
+    uint32_t                       holds;   // the handle plus calls still out after exit
 };
-void getRelativeZoomInfo(struct UVCDevice* uvcDevice, struct RelativeZoomInfo* relativeZoomInfo) {
-    enum uvc_req_code requestCode;
-
-    requestCode              = UVC_GET_MIN;
-    relativeZoomInfo->result = uvc_get_zoom_rel(uvcDevice->devicehandle,
-                                                &relativeZoomInfo->direction,
-                                                &relativeZoomInfo->digital_zoom,
-                                                &relativeZoomInfo->min_speed,
-                                                requestCode);
-    if (relativeZoomInfo->result != 0) {
-        std::string error(uvc_strerror(relativeZoomInfo->result));
-        relativeZoomInfo->error = error.c_str();
+static thread_local struct JsThread* jsThread = NULL;
+
+// a call the camera finished after its worker exited. its callback belongs
+// to a dead isolate, so it can only be leaked.
+static void dropCall(struct AsyncCall* call) {
+    if (call->group != NULL) {
+        groupFree(call->group);
+    }
+    delete call->profile;
+    delete call->batch;
+    delete call;
+}
+
+static void releaseJsThread(struct JsThread* thread) {
+    bool last;
+    {
+        std::lock_guard<std::mutex> lock(thread->completedMutex);
+        last = --thread->holds == 0;
+    }
+    if (last) {
+        delete thread;
+    }
+}
+
+static void onCommandDone(void*                       context,
+                          const struct CommandResult* commandResult,
+                          uint32_t                    pending) {
+    struct AsyncCall* call   = (struct AsyncCall*)context;
+    struct JsThread*  thread = call->thread;
+    call->commandResult      = *commandResult;
+    call->pending            = pending;
+    {
+        std::lock_guard<std::mutex> lock(thread->completedMutex);
+        if (!thread->exited) {
+            thread->completed.push_back(call);
+            uv_async_send(&thread->completionAsync);
+            return;
+        }
+    }
+    dropCall(call);
+    releaseJsThread(thread);
+}
+
+static void deliverCompletions(uv_async_t* handle) {
+    struct JsThread*               thread = (struct JsThread*)handle->data;
+    std::vector<struct AsyncCall*> calls;
+    {
+        std::lock_guard<std::mutex> lock(thread->completedMutex);
+        calls.swap(thread->completed);
+    }
+
+    Nan::HandleScope   scope;
+    Nan::AsyncResource resource("ptz:command");
+    for (struct AsyncCall* call : calls) {
+        Local<Value> argv[3];
+        if (call->commandResult.result != 0) {
+            argv[0] = commandError(&call->commandResult);
+            argv[1] = Nan::Undefined();
+        } else {
+            argv[0] = Nan::Null();
+            argv[1] = commandResultToJs(&call->command, &call->commandResult);
+        }
+        if (call->group != NULL) {
+            std::vector<struct GroupMember> members;
+            struct GroupStats               stats;
+            groupGetResults(call->group, &members, &stats);
+            groupFree(call->group);
+            argv[1] = groupResultToJs(members, stats);
+        }
+        if (call->profile != NULL) {
+            if (call->commandResult.result == 0) {
+                argv[1] = profileToJs(call->profile);
+            }
+            delete call->profile;
+        }
+        if (call->batch != NULL) {
+            if (call->commandResult.result == 0) {
+                argv[1] = batchResultsToJs(call->batch);
+            }
+            delete call->batch;
+        }
+        argv[2] = Nan::New<Number>(call->pending);
+        call->callback->Call(3, argv, &resource);
+        delete call->callback;
+        delete call;
+
+        // only keep the loop alive while commands are out
+        if (--thread->callsInFlight == 0) {
+            uv_unref((uv_handle_t*)&thread->completionAsync);
+        }
+    }
+}
+
+static void onJsThreadClosed(uv_handle_t* handle) {
+    releaseJsThread((struct JsThread*)handle->data);
+}
+
+// the isolate is being torn down, with the worker exiting or the process
+// ending. completions already back are released here while the isolate
+// still exists, those still out are dropped as they land.
+static void exitJsThread(void* arg) {
+    struct JsThread* thread = (struct JsThread*)arg;
+    {
+        std::lock_guard<std::mutex> lock(thread->completedMutex);
+        for (struct AsyncCall* call : thread->completed) {
+            delete call->callback;
+            dropCall(call);
+        }
+        thread->holds += thread->callsInFlight - (uint32_t)thread->completed.size();
+        thread->completed.clear();
+        thread->exited = true;
+    }
+    if (jsThread == thread) {
+        jsThread = NULL;
+    }
+    uv_close((uv_handle_t*)&thread->completionAsync, onJsThreadClosed);
+}
+
+static void startJsThread() {
+    if (jsThread != NULL) {
         return;
     }
+    struct JsThread* thread = new JsThread();
+    thread->callsInFlight   = 0;
+    thread->exited          = false;
+    thread->holds           = 1;
+    uv_async_init(Nan::GetCurrentEventLoop(), &thread->completionAsync, deliverCompletions);
+    thread->completionAsync.data = thread;
+    uv_unref((uv_handle_t*)&thread->completionAsync);
+    node::AddEnvironmentCleanupHook(Isolate::GetCurrent(), exitJsThread, thread);
+    jsThread = thread;
+}
+
+// keep this js thread's loop alive for one more call out on a camera thread
+static void beginAsyncCall(struct AsyncCall* call) {
+    call->thread = jsThread;
+    if (jsThread->callsInFlight++ == 0) {
+        uv_ref((uv_handle_t*)&jsThread->completionAsync);
+    }
+}
+
+// queue a command on the camera's thread: executeAsync(name, input, callback)
+// calls back with (err, result, pending) and returns the pending count
+NAN_METHOD(executeAsync) {
+    Nan::Utf8String name(info[0]);
+    Local<Object>   input = Local<Object>::Cast(info[1]);
 
-    requestCode              = UVC_GET_MAX;
-    relativeZoomInfo->result = uvc_get_zoom_rel(uvcDevice->devicehandle,
-                                                &relativeZoomInfo->direction,
-                                                &relativeZoomInfo->digital_zoom,
-                                                &relativeZoomInfo->max_speed,
-                                                requestCode);
-    if (relativeZoomInfo->result != 0) {
-        std::string error(uvc_strerror(relativeZoomInfo->result));
-        relativeZoomInfo->error = error.c_str();
+    int op = findCommand(*name, input);
+    if (op < 0) {
+        Nan::ThrowError("unknown command");
         return;
     }
 
-    requestCode              = UVC_GET_RES;
-    relativeZoomInfo->result = uvc_get_zoom_rel(uvcDevice->devicehandle,
-                                                &relativeZoomInfo->direction,
-                                                &relativeZoomInfo->digital_zoom,
-                                                &relativeZoomInfo->resolution_speed,
-                                                requestCode);
-    if (relativeZoomInfo->result != 0) {
-        std::string error(uvc_strerror(relativeZoomInfo->result));
-        relativeZoomInfo->error = error.c_str();
+    // get options
+    struct UVCDevice uvcDevice;
+    readDevice(input, &uvcDevice);
+    readDeadline(input, &uvcDevice);
+    struct AsyncCall* call = new AsyncCall();
+    call->callback         = new Nan::Callback(Local<Function>::Cast(info[2]));
+    call->group            = NULL;
+    readCommand(input, op, &call->command);
+
+    beginAsyncCall(call);
+    uint32_t pending =
+        sessionSubmit(sessionFind(&uvcDevice), &uvcDevice, &call->command, onCommandDone, call);
+    info.GetReturnValue().Set(Nan::New<Number>(pending));
+}
+
+static void runBatch(void* context, struct CommandResult* commandResult) {
+    struct CommandBatch* batch = (struct CommandBatch*)context;
+    for (size_t i = 0; i < batch->commands.size(); i++) {
+        if (batch->commands[i].op < CMD_COUNT) {
+            sessionRun(batch->session, &batch->uvcDevice, &batch->commands[i], &batch->results[i]);
+        }
+    }
+    commandResult->result = UVC_SUCCESS;
+    commandResult->error  = NULL;
+}
+
+static void onBatchDone(void*                       context,
+                        const struct CommandResult* commandResult,
+                        uint32_t                    pending) {
+    struct CommandBatch* batch = (struct CommandBatch*)context;
+    onCommandDone(batch->call, commandResult, pending);
+}
+
+// executeBatch(input, entries, callback) queues entries, command inputs naming
+// their command, as one job on input's camera. the callback gets (err,
+// results, pending), with an Error in results for each command that failed,
+// and err only when the camera refused the whole batch.
+NAN_METHOD(executeBatch) {
+    Local<Object> input   = Local<Object>::Cast(info[0]);
+    Local<Array>  entries = Local<Array>::Cast(info[1]);
+
+    struct CommandBatch* batch = new CommandBatch();
+    readDevice(input, &batch->uvcDevice);
+    readDeadline(input, &batch->uvcDevice);
+    batch->session = sessionFind(&batch->uvcDevice);
+    batch->commands.resize(entries->Length());
+    batch->results.resize(entries->Length());
+    for (uint32_t i = 0; i < entries->Length(); i++) {
+        Local<Object>   entry = Local<Object>::Cast(Nan::Get(entries, i).ToLocalChecked());
+        Nan::Utf8String name(
+            Nan::Get(entry, Nan::New<String>("command").ToLocalChecked()).ToLocalChecked());
+        int op = findCommand(*name, entry);
+        if (op < 0) {
+            batch->commands[i].op    = CMD_COUNT;
+            batch->results[i].result = UVC_ERROR_INVALID_PARAM;
+            batch->results[i].error  = "unknown command";
+            continue;
+        }
+        readCommand(entry, op, &batch->commands[i]);
+    }
+
+    batch->call           = new AsyncCall();
+    batch->call->callback = new Nan::Callback(Local<Function>::Cast(info[2]));
+    batch->call->batch    = batch;
+
+    beginAsyncCall(batch->call);
+    uint32_t pending = sessionSubmitTask(batch->session, runBatch, onBatchDone, batch);
+    info.GetReturnValue().Set(Nan::New<Number>(pending));
+}
+
+NAN_METHOD(getCapabilities) {
+    runFromJs(info, CMD_GET_CAPABILITIES);
+}
+NAN_METHOD(getAbsoluteZoom) {
+    runFromJs(info, CMD_GET_ABSOLUTE_ZOOM);
+}
+NAN_METHOD(absoluteZoom) {
+    runFromJs(info, CMD_ABSOLUTE_ZOOM);
+}
+NAN_METHOD(getRelativeZoom) {
+    runFromJs(info, CMD_GET_RELATIVE_ZOOM);
+}
+NAN_METHOD(relativeZoom) {
+    runFromJs(info, CMD_RELATIVE_ZOOM);
+}
+NAN_METHOD(getAbsolutePanTilt) {
+    runFromJs(info, CMD_GET_ABSOLUTE_PAN_TILT);
+}
+NAN_METHOD(absolutePanTilt) {
+    runFromJs(info, CMD_ABSOLUTE_PAN_TILT);
+}
+NAN_METHOD(getRelativePanTilt) {
+    runFromJs(info, CMD_GET_RELATIVE_PAN_TILT);
+}
+NAN_METHOD(relativePanTilt) {
+    runFromJs(info, CMD_RELATIVE_PAN_TILT);
+}
+
+// any control in control.h, named by input.control
+static void runControlFromJs(const FunctionCallbackInfo<Value>& info, int request) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
+    char          control[64];
+    readString(input, "control", control, sizeof(control));
+    int index = controlFind(control);
+    if (index < 0) {
+        Nan::ThrowError("unknown control");
         return;
     }
+    runFromJs(info, controlOp(index, request));
+}
+NAN_METHOD(getControl) {
+    runControlFromJs(info, CONTROL_GET);
+}
+NAN_METHOD(setControl) {
+    runControlFromJs(info, CONTROL_SET);
+}
+NAN_METHOD(getRanges) {
+    runControlFromJs(info, CONTROL_RANGES);
+}
 
-    requestCode              = UVC_GET_DEF;
-    relativeZoomInfo->result = uvc_get_zoom_rel(uvcDevice->devicehandle,
-                                                &relativeZoomInfo->direction,
-                                                &relativeZoomInfo->digital_zoom,
-                                                &relativeZoomInfo->default_speed,
-                                                requestCode);
-    if (relativeZoomInfo->result != 0) {
-        std::string error(uvc_strerror(relativeZoomInfo->result));
-        relativeZoomInfo->error = error.c_str();
+// command capture
+Local<Object> recorderStatsToJs() {
+    struct RecorderStats stats;
+    recorderGetStats(&stats);
+
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result, Nan::New<String>("active").ToLocalChecked(), Nan::New<Boolean>(stats.active));
+    Nan::Set(result,
+             Nan::New<String>("records").ToLocalChecked(),
+             Nan::New<Number>((double)stats.records));
+    Nan::Set(result,
+             Nan::New<String>("rotations").ToLocalChecked(),
+             Nan::New<Number>((double)stats.rotations));
+    Nan::Set(result,
+             Nan::New<String>("failed").ToLocalChecked(),
+             Nan::New<Number>((double)stats.failed));
+    return result;
+}
+NAN_METHOD(startRecording) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
+
+    // get options
+    Local<Value> path = Nan::Get(input, Nan::New<String>("path").ToLocalChecked()).ToLocalChecked();
+    Local<Value> maxBytes = Nan::Get(input, Nan::New<String>("maxBytes").ToLocalChecked())
+                                .ToLocalChecked();
+    Local<Value> maxFiles = Nan::Get(input, Nan::New<String>("maxFiles").ToLocalChecked())
+                                .ToLocalChecked();
+
+    Nan::Utf8String       recordPath(path);
+    struct RecorderConfig config;
+    config.path     = *recordPath;
+    config.maxBytes = (uint64_t)Nan::To<double>(maxBytes).FromMaybe(64 << 20);
+    config.maxFiles = Nan::To<uint32_t>(maxFiles).FromMaybe(4);
+
+    int error = recorderStart(&config);
+    if (error != 0) {
+        Nan::ThrowError(strerror(error));
         return;
     }
+    info.GetReturnValue().Set(Nan::Undefined());
+}
+NAN_METHOD(stopRecording) {
+    recorderStop();
+    info.GetReturnValue().Set(recorderStatsToJs());
+}
+NAN_METHOD(getRecordingStats) {
+    info.GetReturnValue().Set(recorderStatsToJs());
+}
+
+// per camera session settings and stats
+static const char* rateClassNames[RATE_CLASS_COUNT] = {"reads", "absolute", "relative"};
+
+// speedModel: { panSpeed, tiltSpeed, zoomSpeed, panSlew, tiltSlew, zoomSlew,
+// speedError, readLagMs }, anything left out is kept
+static void readSpeedModel(const Local<Object>& input, struct SpeedModel* model) {
+    model->pan_speed   = readNumber(input, "panSpeed", model->pan_speed);
+    model->tilt_speed  = readNumber(input, "tiltSpeed", model->tilt_speed);
+    model->zoom_speed  = readNumber(input, "zoomSpeed", model->zoom_speed);
+    model->pan_slew    = readNumber(input, "panSlew", model->pan_slew);
+    model->tilt_slew   = readNumber(input, "tiltSlew", model->tilt_slew);
+    model->zoom_slew   = readNumber(input, "zoomSlew", model->zoom_slew);
+    model->speed_error = readNumber(input, "speedError", model->speed_error);
+    model->read_lag_ms = (uint32_t)readNumber(input, "readLagMs", model->read_lag_ms);
+}
+
+static Local<Value> speedModelToJs(const struct SpeedModel* model) {
+    const char*  names[]  = {"panSpeed",
+                             "tiltSpeed",
+                             "zoomSpeed",
+                             "panSlew",
+                             "tiltSlew",
+                             "zoomSlew",
+                             "speedError",
+                             "readLagMs"};
+    const double values[] = {model->pan_speed,
+                             model->tilt_speed,
+                             model->zoom_speed,
+                             model->pan_slew,
+                             model->tilt_slew,
+                             model->zoom_slew,
+                             model->speed_error,
+                             (double)model->read_lag_ms};
+
+    Local<Object> result = Nan::New<Object>();
+    for (int i = 0; i < 8; i++) {
+        Nan::Set(result, Nan::New<String>(names[i]).ToLocalChecked(), Nan::New<Number>(values[i]));
+    }
+    return result;
+}
+
+
+// fovTable: [{ zoom, horizontal, vertical }] in degrees, replacing the table
+static void readFovTable(const Local<Array>& input, struct FovTable* table) {
+    table->count = std::min(input->Length(), (uint32_t)FOV_TABLE_SIZE);
+    for (uint32_t i = 0; i < table->count; i++) {
+        Local<Value> entry = Nan::Get(input, i).ToLocalChecked();
+        if (!entry->IsObject()) {
+            table->points[i] = {0, 0, 0};
+            continue;
+        }
+        Local<Object> point         = Local<Object>::Cast(entry);
+        table->points[i].zoom       = (uint16_t)readNumber(point, "zoom", 0);
+        table->points[i].horizontal = (float)readNumber(point, "horizontal", 0);
+        table->points[i].vertical   = (float)readNumber(point, "vertical", 0);
+    }
+    fovTableNormalize(table);
+}
+
+static Local<Value> fovTableToJs(const struct FovTable* table) {
+    Local<Array> result = Nan::New<Array>();
+    for (uint32_t i = 0; i < table->count; i++) {
+        Local<Object> point = Nan::New<Object>();
+        Nan::Set(point,
+                 Nan::New<String>("zoom").ToLocalChecked(),
+                 Nan::New<Number>(table->points[i].zoom));
+        Nan::Set(point,
+                 Nan::New<String>("horizontal").ToLocalChecked(),
+                 Nan::New<Number>(table->points[i].horizontal));
+        Nan::Set(point,
+                 Nan::New<String>("vertical").ToLocalChecked(),
+                 Nan::New<Number>(table->points[i].vertical));
+        Nan::Set(result, i, point);
+    }
+    return result;
+}
+
+NAN_METHOD(configureCamera) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
+
+    struct UVCDevice uvcDevice;
+    readDevice(input, &uvcDevice);
+    struct CameraSession* session = sessionFind(&uvcDevice);
+
+    struct SessionConfig config;
+    sessionGetConfig(session, &config);
+    config.read_cache_ms = (uint32_t)readNumber(input, "readCacheMs", config.read_cache_ms);
+    config.suppress_writes =
+        readNumber(input, "suppressWrites", config.suppress_writes) != 0 ? 1 : 0;
+    config.max_pending = (uint32_t)readNumber(input, "maxPending", config.max_pending);
+    config.watchdog_ms = (uint32_t)readNumber(input, "watchdogMs", config.watchdog_ms);
+    config.timeout_ms  = (uint32_t)readNumber(input, "timeoutMs", config.timeout_ms);
+    config.recover_ms  = (uint32_t)readNumber(input, "recoverMs", config.recover_ms);
+
+    // rateLimits: { reads: { rate, burst }, absolute: ..., relative: ... }
+    Local<Value> rateLimits = Nan::Get(input, Nan::New<String>("rateLimits").ToLocalChecked())
+                                  .ToLocalChecked();
+    if (rateLimits->IsObject()) {
+        Local<Object> limits = Local<Object>::Cast(rateLimits);
+        for (int rateClass = 0; rateClass < RATE_CLASS_COUNT; rateClass++) {
+            Local<String> key   = Nan::New<String>(rateClassNames[rateClass]).ToLocalChecked();
+            Local<Value>  limit = Nan::Get(limits, key).ToLocalChecked();
+            if (limit->IsObject()) {
+                struct RateLimit* rateLimit = &config.rate_limits[rateClass];
+                Local<Object>     values    = Local<Object>::Cast(limit);
+                rateLimit->rate             = readNumber(values, "rate", rateLimit->rate);
+                rateLimit->burst            = readNumber(values, "burst", rateLimit->burst);
+            }
+        }
+    }
+    Local<Value> ratePolicy = Nan::Get(input, Nan::New<String>("ratePolicy").ToLocalChecked())
+                                  .ToLocalChecked();
+    if (ratePolicy->IsString()) {
+        Nan::Utf8String policy(ratePolicy);
+        config.rate_policy =
+            strcmp(*policy, "reject") == 0 ? RATE_POLICY_REJECT : RATE_POLICY_QUEUE;
+    }
+    Local<Value> speedModel = Nan::Get(input, Nan::New<String>("speedModel").ToLocalChecked())
+                                  .ToLocalChecked();
+    if (speedModel->IsObject()) {
+        readSpeedModel(Local<Object>::Cast(speedModel), &config.speed_model);
+    }
+    Local<Value> fovTable =
+        Nan::Get(input, Nan::New<String>("fovTable").ToLocalChecked()).ToLocalChecked();
+    if (fovTable->IsArray()) {
+        readFovTable(Local<Array>::Cast(fovTable), &config.fov);
+    }
+    sessionSetConfig(session, &config);
+
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result,
+             Nan::New<String>("readCacheMs").ToLocalChecked(),
+             Nan::New<Number>(config.read_cache_ms));
+    Nan::Set(result,
+             Nan::New<String>("suppressWrites").ToLocalChecked(),
+             Nan::New<Boolean>(config.suppress_writes));
+    Local<Object> limits = Nan::New<Object>();
+    for (int rateClass = 0; rateClass < RATE_CLASS_COUNT; rateClass++) {
+        Local<Object> limit = Nan::New<Object>();
+        Nan::Set(limit,
+                 Nan::New<String>("rate").ToLocalChecked(),
+                 Nan::New<Number>(config.rate_limits[rateClass].rate));
+        Nan::Set(limit,
+                 Nan::New<String>("burst").ToLocalChecked(),
+                 Nan::New<Number>(config.rate_limits[rateClass].burst));
+        Nan::Set(limits, Nan::New<String>(rateClassNames[rateClass]).ToLocalChecked(), limit);
+    }
+    Nan::Set(result, Nan::New<String>("rateLimits").ToLocalChecked(), limits);
+    Nan::Set(result,
+             Nan::New<String>("ratePolicy").ToLocalChecked(),
+             Nan::New<String>(config.rate_policy == RATE_POLICY_REJECT ? "reject" : "queue")
+                 .ToLocalChecked());
+    Nan::Set(result,
+             Nan::New<String>("maxPending").ToLocalChecked(),
+             Nan::New<Number>(config.max_pending));
+    Nan::Set(result,
+             Nan::New<String>("watchdogMs").ToLocalChecked(),
+             Nan::New<Number>(config.watchdog_ms));
+    Nan::Set(result,
+             Nan::New<String>("timeoutMs").ToLocalChecked(),
+             Nan::New<Number>(config.timeout_ms));
+    Nan::Set(result,
+             Nan::New<String>("recoverMs").ToLocalChecked(),
+             Nan::New<Number>(config.recover_ms));
+    Nan::Set(result,
+             Nan::New<String>("speedModel").ToLocalChecked(),
+             speedModelToJs(&config.speed_model));
+    Nan::Set(result, Nan::New<String>("fovTable").ToLocalChecked(), fovTableToJs(&config.fov));
+    info.GetReturnValue().Set(result);
+}
+NAN_METHOD(getCameraStats) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
+
+    struct UVCDevice uvcDevice;
+    readDevice(input, &uvcDevice);
+    struct SessionStats stats;
+    sessionGetStats(sessionFind(&uvcDevice), &stats);
+
+    double hitRate = 0;
+    if (stats.reads != 0) {
+        hitRate = (double)(stats.cache_hits + stats.shared_reads) / (double)stats.reads;
+    }
 
-    requestCode              = UVC_GET_CUR;
-    relativeZoomInfo->result = uvc_get_zoom_rel(uvcDevice->devicehandle,
-                                                &relativeZoomInfo->direction,
-                                                &relativeZoomInfo->digital_zoom,
-                                                &relativeZoomInfo->current_speed,
-                                                requestCode);
-    if (relativeZoomInfo->result != 0) {
-        std::string error(uvc_strerror(relativeZoomInfo->result));
-        relativeZoomInfo->error = error.c_str();
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result,
+             Nan::New<String>("reads").ToLocalChecked(),
+             Nan::New<Number>((double)stats.reads));
+    Nan::Set(result,
+             Nan::New<String>("cacheHits").ToLocalChecked(),
+             Nan::New<Number>((double)stats.cache_hits));
+    Nan::Set(result,
+             Nan::New<String>("sharedReads").ToLocalChecked(),
+             Nan::New<Number>((double)stats.shared_reads));
+    Nan::Set(result,
+             Nan::New<String>("deviceReads").ToLocalChecked(),
+             Nan::New<Number>((double)stats.device_reads));
+    Nan::Set(result, Nan::New<String>("hitRate").ToLocalChecked(), Nan::New<Number>(hitRate));
+    Nan::Set(result,
+             Nan::New<String>("writes").ToLocalChecked(),
+             Nan::New<Number>((double)stats.writes));
+    Nan::Set(result,
+             Nan::New<String>("suppressedWrites").ToLocalChecked(),
+             Nan::New<Number>((double)stats.suppressed_writes));
+    Nan::Set(result,
+             Nan::New<String>("rateDelayed").ToLocalChecked(),
+             Nan::New<Number>((double)stats.rate_delayed));
+    Nan::Set(result,
+             Nan::New<String>("rateRejected").ToLocalChecked(),
+             Nan::New<Number>((double)stats.rate_rejected));
+    Nan::Set(result,
+             Nan::New<String>("pending").ToLocalChecked(),
+             Nan::New<Number>(stats.pending));
+    Nan::Set(result,
+             Nan::New<String>("watchdogStops").ToLocalChecked(),
+             Nan::New<Number>((double)stats.watchdog_stops));
+    Nan::Set(result,
+             Nan::New<String>("operatorWrites").ToLocalChecked(),
+             Nan::New<Number>((double)stats.operator_writes));
+    Nan::Set(result,
+             Nan::New<String>("warmHits").ToLocalChecked(),
+             Nan::New<Number>((double)stats.warm_hits));
+    Nan::Set(result,
+             Nan::New<String>("timeouts").ToLocalChecked(),
+             Nan::New<Number>((double)stats.timeouts));
+    Nan::Set(result,
+             Nan::New<String>("fastFailures").ToLocalChecked(),
+             Nan::New<Number>((double)stats.fast_failures));
+    Nan::Set(result,
+             Nan::New<String>("cancelled").ToLocalChecked(),
+             Nan::New<Number>((double)stats.cancelled));
+    Nan::Set(result,
+             Nan::New<String>("disconnects").ToLocalChecked(),
+             Nan::New<Number>((double)stats.disconnects));
+    Nan::Set(result,
+             Nan::New<String>("recoveries").ToLocalChecked(),
+             Nan::New<Number>((double)stats.recoveries));
+    Nan::Set(result,
+             Nan::New<String>("recoveryFailures").ToLocalChecked(),
+             Nan::New<Number>((double)stats.recovery_failures));
+    Nan::Set(result,
+             Nan::New<String>("recoveryAttempts").ToLocalChecked(),
+             Nan::New<Number>((double)stats.recovery_attempts));
+    Nan::Set(result,
+             Nan::New<String>("replayed").ToLocalChecked(),
+             Nan::New<Number>((double)stats.replayed));
+    Nan::Set(result,
+             Nan::New<String>("lastRecoveryMs").ToLocalChecked(),
+             Nan::New<Number>(stats.last_recovery_ms));
+    info.GetReturnValue().Set(result);
+}
+// fail the camera's queued commands and abort its transfers in flight,
+// returning how many queued commands were dropped
+NAN_METHOD(cancelCamera) {
+    struct UVCDevice uvcDevice;
+    readDevice(Local<Object>::Cast(info[0]), &uvcDevice);
+    uint32_t dropped = sessionCancel(sessionFind(&uvcDevice));
+    info.GetReturnValue().Set(Nan::New<Number>(dropped));
+}
+// where the camera should be, without asking it. axes never read or sent to
+// an absolute position are null.
+NAN_METHOD(estimatePosition) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
+
+    struct UVCDevice uvcDevice;
+    readDevice(input, &uvcDevice);
+    struct Estimate estimate;
+    sessionEstimate(sessionFind(&uvcDevice), &estimate);
+
+    const char*   names[ESTIMATE_AXES]  = {"pan", "tilt", "zoom"};
+    const char*   errors[ESTIMATE_AXES] = {"panError", "tiltError", "zoomError"};
+    Local<Object> result                = Nan::New<Object>();
+    for (int axis = 0; axis < ESTIMATE_AXES; axis++) {
+        if (estimate.known[axis]) {
+            Nan::Set(result,
+                     Nan::New<String>(names[axis]).ToLocalChecked(),
+                     Nan::New<Number>(round(estimate.position[axis])));
+            Nan::Set(result,
+                     Nan::New<String>(errors[axis]).ToLocalChecked(),
+                     Nan::New<Number>(estimate.error[axis]));
+        } else {
+            Nan::Set(result, Nan::New<String>(names[axis]).ToLocalChecked(), Nan::Null());
+            Nan::Set(result, Nan::New<String>(errors[axis]).ToLocalChecked(), Nan::Null());
+        }
+    }
+    Nan::Set(result,
+             Nan::New<String>("confidence").ToLocalChecked(),
+             Nan::New<Number>(estimate.confidence));
+    Nan::Set(result,
+             Nan::New<String>("moving").ToLocalChecked(),
+             Nan::New<Boolean>(estimate.moving != 0));
+    if (estimate.age == UINT64_MAX) {
+        Nan::Set(result, Nan::New<String>("ageMs").ToLocalChecked(), Nan::Null());
+    } else {
+        Nan::Set(result,
+                 Nan::New<String>("ageMs").ToLocalChecked(),
+                 Nan::New<Number>((double)estimate.age / 1e6));
+    }
+    Nan::Set(result,
+             Nan::New<String>("corrections").ToLocalChecked(),
+             Nan::New<Number>((double)estimate.corrections));
+    info.GetReturnValue().Set(result);
+}
+
+// motion profiles: openProfiles({ path }) loads a store, and cameras take
+// their speed model from it as they are next used
+NAN_METHOD(openProfiles) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
+
+    Nan::Utf8String path(
+        Nan::Get(input, Nan::New<String>("path").ToLocalChecked()).ToLocalChecked());
+    int error = profileOpen(*path);
+    if (error != 0) {
+        Nan::ThrowError(error == EINVAL ? "not a profile store" : strerror(error));
         return;
     }
+    info.GetReturnValue().Set(Nan::Undefined());
+}
+NAN_METHOD(closeProfiles) {
+    profileClose();
+    info.GetReturnValue().Set(Nan::Undefined());
 }
+NAN_METHOD(getProfile) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
 
-struct RelativeZoom {
-    int8_t      direction;
-    int8_t      speed;
-    uvc_error_t result;
-    const char* error;
-};
-void setRelativeZoom(struct UVCDevice* uvcDevice, struct RelativeZoom* relativeZoom) {
-    relativeZoom->result = uvc_set_zoom_rel(
-        uvcDevice->devicehandle, relativeZoom->direction, 1, relativeZoom->speed);
-    if (relativeZoom->result != 0) {
-        std::string error(uvc_strerror(relativeZoom->result));
-        relativeZoom->error = error.c_str();
+    struct UVCDevice uvcDevice;
+    readDevice(input, &uvcDevice);
+    struct MotionProfile profile;
+    if (!profileFind(&uvcDevice, &profile)) {
+        info.GetReturnValue().Set(Nan::Null());
         return;
     }
+    info.GetReturnValue().Set(profileToJs(&profile));
 }
 
-// absolute pan tilt operations
-struct AbsolutePanTiltInfo {
-    int32_t     min_pan;
-    int32_t     min_tilt;
-    int32_t     max_pan;
-    int32_t     max_tilt;
-    int32_t     resolution_pan;
-    int32_t     resolution_tilt;
-    int32_t     current_pan;
-    int32_t     current_tilt;
-    int32_t     default_pan;
-    int32_t     default_tilt;
-    uvc_error_t result;
-    const char* error;
+// a calibration queued behind the camera's other async commands
+struct CalibrationCall {
+    struct CameraSession*    session;
+    struct UVCDevice         uvcDevice;
+    struct CalibrationConfig config;
+    struct AsyncCall*        call;
 };
-void getAbsolutePanTiltInfo(struct UVCDevice*           uvcDevice,
-                            struct AbsolutePanTiltInfo* absolutePanTiltInfo) {
-    enum uvc_req_code requestCode;
-
-    requestCode                 = UVC_GET_MIN;
-    absolutePanTiltInfo->result = uvc_get_pantilt_abs(uvcDevice->devicehandle,
-                                                      &absolutePanTiltInfo->min_pan,
-                                                      &absolutePanTiltInfo->min_tilt,
-                                                      requestCode);
-    if (absolutePanTiltInfo->result != 0) {
-        std::string error(uvc_strerror(absolutePanTiltInfo->result));
-        absolutePanTiltInfo->error = error.c_str();
+
+static void runCalibration(void* context, struct CommandResult* commandResult) {
+    struct CalibrationCall* calibration = (struct CalibrationCall*)context;
+    profileCalibrate(calibration->session,
+                     &calibration->uvcDevice,
+                     &calibration->config,
+                     calibration->call->profile,
+                     commandResult);
+    if (commandResult->result != 0) {
         return;
     }
 
-    requestCode                 = UVC_GET_MAX;
-    absolutePanTiltInfo->result = uvc_get_pantilt_abs(uvcDevice->devicehandle,
-                                                      &absolutePanTiltInfo->max_pan,
-                                                      &absolutePanTiltInfo->max_pan,
-                                                      requestCode);
-    if (absolutePanTiltInfo->result != 0) {
-        std::string error(uvc_strerror(absolutePanTiltInfo->result));
-        absolutePanTiltInfo->error = error.c_str();
-        return;
+    // kept for next time when a store is open
+    int error = profileSave(calibration->call->profile);
+    if (error != 0 && error != EBADF) {
+        commandResult->result = UVC_ERROR_OTHER;
+        commandResult->error  = strerror(error);
     }
+}
+
+static void onCalibrationDone(void*                       context,
+                              const struct CommandResult* commandResult,
+                              uint32_t                    pending) {
+    struct CalibrationCall* calibration = (struct CalibrationCall*)context;
+    onCommandDone(calibration->call, commandResult, pending);
+    delete calibration;
+}
 
-    requestCode                 = UVC_GET_RES;
-    absolutePanTiltInfo->result = uvc_get_pantilt_abs(uvcDevice->devicehandle,
-                                                      &absolutePanTiltInfo->resolution_pan,
-                                                      &absolutePanTiltInfo->resolution_tilt,
-                                                      requestCode);
-    if (absolutePanTiltInfo->result != 0) {
-        std::string error(uvc_strerror(absolutePanTiltInfo->result));
-        absolutePanTiltInfo->error = error.c_str();
+// calibrateCamera(input, callback) measures the camera's speeds, with
+// optional speeds, moveMs and sampleMs, then calls back with (err, profile)
+NAN_METHOD(calibrateCamera) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
+    if (!info[1]->IsFunction()) {
+        Nan::ThrowError("calibrateCamera needs a callback");
         return;
     }
 
-    requestCode                 = UVC_GET_DEF;
-    absolutePanTiltInfo->result = uvc_get_pantilt_abs(uvcDevice->devicehandle,
-                                                      &absolutePanTiltInfo->default_pan,
-                                                      &absolutePanTiltInfo->default_tilt,
-                                                      requestCode);
-    if (absolutePanTiltInfo->result != 0) {
-        std::string error(uvc_strerror(absolutePanTiltInfo->result));
-        absolutePanTiltInfo->error = error.c_str();
+    struct CalibrationCall* calibration = new CalibrationCall();
+    readDevice(input, &calibration->uvcDevice);
+    calibration->session          = sessionFind(&calibration->uvcDevice);
+    calibration->config.speeds    = (uint32_t)readNumber(input, "speeds", 4);
+    calibration->config.move_ms   = (uint32_t)readNumber(input, "moveMs", 1000);
+    calibration->config.sample_ms = std::max((uint32_t)readNumber(input, "sampleMs", 50), 1U);
+    calibration->call             = new AsyncCall();
+    calibration->call->callback   = new Nan::Callback(Local<Function>::Cast(info[1]));
+    calibration->call->command    = Command();
+    calibration->call->group      = NULL;
+    calibration->call->profile    = new MotionProfile();
+
+    beginAsyncCall(calibration->call);
+    uint32_t pending = sessionSubmitTask(
+        calibration->session, runCalibration, onCalibrationDone, calibration);
+    info.GetReturnValue().Set(Nan::New<Number>(pending));
+}
+
+// joystick velocity channels, handed to js as integer ids. the ids are
+// process wide, so a channel opened on one js thread can be fed from another.
+// the lock is held across each use, so a close can't free a channel in use
+// and pushes from several js threads reach the ring one at a time.
+static std::mutex handlesMutex;
+
+// an id is its slot plus one in the low 16 bits and the slot's generation
+// above, bumped on every close, so an id kept past its close never reaches
+// whatever opened into the slot since
+struct Handle {
+    void*    object;
+    uint32_t generation;
+};
+#define HANDLE_SLOTS 0xffff
+
+// the new id, or 0 when every slot is taken
+static uint32_t handleOpen(std::vector<struct Handle>* handles, void* object) {
+    uint32_t index = 0;
+    while (index < handles->size() && (*handles)[index].object != NULL) {
+        index++;
+    }
+    if (index == HANDLE_SLOTS) {
+        return 0;
+    }
+    if (index == handles->size()) {
+        handles->push_back({NULL, 0});
+    }
+    (*handles)[index].object = object;
+    return (*handles)[index].generation << 16 | (index + 1);
+}
+
+// the slot an id names, NULL once it was closed
+static struct Handle* handleSlot(std::vector<struct Handle>* handles, const Local<Value>& id) {
+    uint32_t value = Nan::To<uint32_t>(id).FromMaybe(0);
+    uint32_t index = value & HANDLE_SLOTS;
+    if (index == 0 || index > handles->size()) {
+        return NULL;
+    }
+    struct Handle* handle = &(*handles)[index - 1];
+    return handle->object != NULL && handle->generation == value >> 16 ? handle : NULL;
+}
+
+static void* handleFind(std::vector<struct Handle>* handles, const Local<Value>& id) {
+    struct Handle* handle = handleSlot(handles, id);
+    return handle != NULL ? handle->object : NULL;
+}
+
+// the object the id held, NULL when it was already closed
+static void* handleClose(std::vector<struct Handle>* handles, const Local<Value>& id) {
+    struct Handle* handle = handleSlot(handles, id);
+    if (handle == NULL) {
+        return NULL;
+    }
+    void* object       = handle->object;
+    handle->object     = NULL;
+    handle->generation = (handle->generation + 1) & 0xffff;
+    return object;
+}
+
+static std::vector<struct Handle> velocityChannels;
+
+static struct VelocityChannel* findVelocityChannel(const Local<Value>& id) {
+    return (struct VelocityChannel*)handleFind(&velocityChannels, id);
+}
+NAN_METHOD(openVelocity) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
+
+    // get options
+    struct UVCDevice      uvcDevice;
+    struct VelocityConfig config;
+    readDevice(input, &uvcDevice);
+    config.interval_us  = (uint32_t)(readNumber(input, "intervalMs", 10) * 1000);
+    config.deadband     = readNumber(input, "deadband", 0.1);
+    config.zoom_scaling = readNumber(input, "zoomScaling", 0.8);
+
+    struct VelocityChannel* channel = velocityOpen(&uvcDevice, &config);
+    uint32_t                id;
+    {
+        std::lock_guard<std::mutex> lock(handlesMutex);
+        id = handleOpen(&velocityChannels, channel);
+    }
+    if (id == 0) {
+        velocityClose(channel);
+        Nan::ThrowError("too many velocity channels are open");
+        return;
+    }
+    info.GetReturnValue().Set(Nan::New<Number>(id));
+}
+NAN_METHOD(pushVelocity) {
+    std::lock_guard<std::mutex> lock(handlesMutex);
+    struct VelocityChannel*     channel = findVelocityChannel(info[0]);
+    if (channel == NULL) {
+        Nan::ThrowError("velocity channel is closed");
         return;
     }
 
-    requestCode                 = UVC_GET_CUR;
-    absolutePanTiltInfo->result = uvc_get_pantilt_abs(uvcDevice->devicehandle,
-                                                      &absolutePanTiltInfo->current_pan,
-                                                      &absolutePanTiltInfo->current_tilt,
-                                                      requestCode);
-    if (absolutePanTiltInfo->result != 0) {
-        std::string error(uvc_strerror(absolutePanTiltInfo->result));
-        absolutePanTiltInfo->error = error.c_str();
+    struct VelocitySample sample;
+    sample.pan  = (float)Nan::To<double>(info[1]).FromMaybe(0);
+    sample.tilt = (float)Nan::To<double>(info[2]).FromMaybe(0);
+    sample.zoom = (float)Nan::To<double>(info[3]).FromMaybe(0);
+    info.GetReturnValue().Set(Nan::New<Boolean>(velocityPush(channel, &sample)));
+}
+NAN_METHOD(getVelocityStats) {
+    struct VelocityStats stats;
+    {
+        std::lock_guard<std::mutex> lock(handlesMutex);
+        struct VelocityChannel*     channel = findVelocityChannel(info[0]);
+        if (channel == NULL) {
+            Nan::ThrowError("velocity channel is closed");
+            return;
+        }
+        velocityGetStats(channel, &stats);
+    }
+
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result,
+             Nan::New<String>("samples").ToLocalChecked(),
+             Nan::New<Number>((double)stats.samples));
+    Nan::Set(result,
+             Nan::New<String>("dropped").ToLocalChecked(),
+             Nan::New<Number>((double)stats.dropped));
+    Nan::Set(result,
+             Nan::New<String>("ticks").ToLocalChecked(),
+             Nan::New<Number>((double)stats.ticks));
+    Nan::Set(result,
+             Nan::New<String>("panTiltCommands").ToLocalChecked(),
+             Nan::New<Number>((double)stats.pan_tilt_commands));
+    Nan::Set(result,
+             Nan::New<String>("zoomCommands").ToLocalChecked(),
+             Nan::New<Number>((double)stats.zoom_commands));
+    Nan::Set(result,
+             Nan::New<String>("errors").ToLocalChecked(),
+             Nan::New<Number>((double)stats.errors));
+    info.GetReturnValue().Set(result);
+}
+NAN_METHOD(closeVelocity) {
+    struct VelocityChannel* channel;
+    {
+        std::lock_guard<std::mutex> lock(handlesMutex);
+        channel = (struct VelocityChannel*)handleClose(&velocityChannels, info[0]);
+    }
+    if (channel != NULL) {
+        velocityClose(channel);
+    }
+    info.GetReturnValue().Set(Nan::Undefined());
+}
+
+// auto-tracking loops, handed to js as process wide ids like velocity
+// channels, under the same lock
+static std::vector<struct Handle> trackers;
+
+static struct Tracker* findTracker(const Local<Value>& id) {
+    return (struct Tracker*)handleFind(&trackers, id);
+}
+
+// { kp, ki, kd, kf }, anything left out is kept
+static void readGains(const Local<Object>& input, const char* key, struct PidGains* gains) {
+    Local<Value> value = Nan::Get(input, Nan::New<String>(key).ToLocalChecked()).ToLocalChecked();
+    if (!value->IsObject()) {
         return;
     }
+    Local<Object> values = Local<Object>::Cast(value);
+    gains->kp            = readNumber(values, "kp", gains->kp);
+    gains->ki            = readNumber(values, "ki", gains->ki);
+    gains->kd            = readNumber(values, "kd", gains->kd);
+    gains->kf            = readNumber(values, "kf", gains->kf);
 }
 
-struct AbsolutePanTilt {
-    int32_t     pan;
-    int32_t     tilt;
-    uvc_error_t result;
-    const char* error;
-};
-void setAbsolutePanTilt(struct UVCDevice* uvcDevice, struct AbsolutePanTilt* absolutePanTilt) {
-    absolutePanTilt->result = uvc_set_pantilt_abs(
-        uvcDevice->devicehandle, absolutePanTilt->pan, absolutePanTilt->tilt);
-    if (absolutePanTilt->result != 0) {
-        std::string error(uvc_strerror(absolutePanTilt->result));
-        absolutePanTilt->error = error.c_str();
+NAN_METHOD(openTracker) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
+
+    struct UVCDevice     uvcDevice;
+    struct TrackerConfig config;
+    readDevice(input, &uvcDevice);
+    trackerDefaults(&config);
+    config.interval_us =
+        (uint32_t)(readNumber(input, "intervalMs", config.interval_us / 1e3) * 1e3);
+    config.command_interval_us =
+        (uint32_t)(readNumber(input, "commandIntervalMs", config.command_interval_us / 1e3) * 1e3);
+    config.lost_ms     = (uint32_t)readNumber(input, "lostMs", config.lost_ms);
+    config.lead_ms     = (uint32_t)readNumber(input, "leadMs", config.lead_ms);
+    config.deadband    = readNumber(input, "deadband", config.deadband);
+    config.max_output  = readNumber(input, "maxOutput", config.max_output);
+    config.target_size = readNumber(input, "targetSize", config.target_size);
+    readGains(input, "pan", &config.pan);
+    readGains(input, "tilt", &config.tilt);
+    readGains(input, "zoom", &config.zoom);
+
+    struct Tracker* tracker = trackerOpen(&uvcDevice, &config);
+    uint32_t        id;
+    {
+        std::lock_guard<std::mutex> lock(handlesMutex);
+        id = handleOpen(&trackers, tracker);
+    }
+    if (id == 0) {
+        trackerClose(tracker);
+        Nan::ThrowError("too many trackers are open");
         return;
     }
+    info.GetReturnValue().Set(Nan::New<Number>(id));
+}
+// pushTracking(id, x, y, size), or pushTracking(id) once the subject is lost
+NAN_METHOD(pushTracking) {
+    std::lock_guard<std::mutex> lock(handlesMutex);
+    struct Tracker*             tracker = findTracker(info[0]);
+    if (tracker == NULL) {
+        Nan::ThrowError("tracker is closed");
+        return;
+    }
+
+    struct TrackerSample sample;
+    sample.visible = info[1]->IsNumber() && info[2]->IsNumber();
+    sample.x       = (float)Nan::To<double>(info[1]).FromMaybe(0);
+    sample.y       = (float)Nan::To<double>(info[2]).FromMaybe(0);
+    sample.size    = (float)Nan::To<double>(info[3]).FromMaybe(0);
+    sample.at      = 0;
+    info.GetReturnValue().Set(Nan::New<Boolean>(trackerPush(tracker, &sample)));
+}
+NAN_METHOD(getTrackerStats) {
+    struct TrackerStats* stats = new TrackerStats();
+    {
+        std::lock_guard<std::mutex> lock(handlesMutex);
+        struct Tracker*             tracker = findTracker(info[0]);
+        if (tracker == NULL) {
+            delete stats;
+            Nan::ThrowError("tracker is closed");
+            return;
+        }
+        trackerGetStats(tracker, stats);
+    }
+
+    const char*  names[]  = {"samples",
+                             "dropped",
+                             "ticks",
+                             "panTiltCommands",
+                             "zoomCommands",
+                             "rateLimited",
+                             "errors",
+                             "panError",
+                             "tiltError",
+                             "zoomError",
+                             "rmsError",
+                             "maxError",
+                             "jitterP50Ms",
+                             "jitterP99Ms",
+                             "latencyP50Ms",
+                             "latencyP99Ms"};
+    const double values[] = {(double)stats->samples,
+                             (double)stats->dropped,
+                             (double)stats->ticks,
+                             (double)stats->pan_tilt_commands,
+                             (double)stats->zoom_commands,
+                             (double)stats->rate_limited,
+                             (double)stats->errors,
+                             stats->error[0],
+                             stats->error[1],
+                             stats->error[2],
+                             stats->rms_error,
+                             stats->max_error,
+                             histogramPercentile(&stats->jitter, 50) / 1e6,
+                             histogramPercentile(&stats->jitter, 99) / 1e6,
+                             histogramPercentile(&stats->latency, 50) / 1e6,
+                             histogramPercentile(&stats->latency, 99) / 1e6};
+
+    Local<Object> result = Nan::New<Object>();
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        Nan::Set(result, Nan::New<String>(names[i]).ToLocalChecked(), Nan::New<Number>(values[i]));
+    }
+    Nan::Set(result,
+             Nan::New<String>("tracking").ToLocalChecked(),
+             Nan::New<Boolean>(stats->tracking != 0));
+    delete stats;
+    info.GetReturnValue().Set(result);
+}
+NAN_METHOD(closeTracker) {
+    struct Tracker* tracker;
+    {
+        std::lock_guard<std::mutex> lock(handlesMutex);
+        tracker = (struct Tracker*)handleClose(&trackers, info[0]);
+    }
+    if (tracker != NULL) {
+        trackerClose(tracker);
+    }
+    info.GetReturnValue().Set(Nan::Undefined());
+}
+
+// named presets, kept in one store file for every camera
+static const char* presetError(int error) {
+    switch (error) {
+        case EBADF:
+            return "no preset store is open";
+        case ENOENT:
+            return "no such preset";
+        case ENOSPC:
+            return "preset store is full";
+        case ENAMETOOLONG:
+            return "preset name is too long";
+        default:
+            return strerror(error);
+    }
+}
+
+static Local<Value> presetStatsToJs() {
+    struct PresetStats stats;
+    presetGetStats(&stats);
+
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result,
+             Nan::New<String>("open").ToLocalChecked(),
+             Nan::New<Boolean>(stats.open));
+    Nan::Set(result,
+             Nan::New<String>("capacity").ToLocalChecked(),
+             Nan::New<Number>(stats.capacity));
+    Nan::Set(result,
+             Nan::New<String>("count").ToLocalChecked(),
+             Nan::New<Number>(stats.count));
+    return result;
 }
 
-// relative pan tilt operations
-struct RelativePanTiltInfo {
-    int8_t      pan_direction;
-    int8_t      tilt_direction;
-    uint8_t     min_pan_speed;
-    uint8_t     min_tilt_speed;
-    uint8_t     max_pan_speed;
-    uint8_t     max_tilt_speed;
-    uint8_t     resolution_pan_speed;
-    uint8_t     resolution_tilt_speed;
-    uint8_t     default_pan_speed;
-    uint8_t     default_tilt_speed;
-    uint8_t     current_pan_speed;
-    uint8_t     current_tilt_speed;
-    uvc_error_t result;
-    const char* error;
-};
-void getRelativePanTiltInfo(struct UVCDevice*           uvcDevice,
-                            struct RelativePanTiltInfo* relativePanTiltInfo) {
-    enum uvc_req_code requestCode;
-
-    requestCode                 = UVC_GET_MIN;
-    relativePanTiltInfo->result = uvc_get_pantilt_rel(uvcDevice->devicehandle,
-                                                      &relativePanTiltInfo->pan_direction,
-                                                      &relativePanTiltInfo->min_pan_speed,
-                                                      &relativePanTiltInfo->tilt_direction,
-                                                      &relativePanTiltInfo->min_tilt_speed,
-                                                      requestCode);
-    if (relativePanTiltInfo->result != 0) {
-        std::string error(uvc_strerror(relativePanTiltInfo->result));
-        relativePanTiltInfo->error = error.c_str();
-        return;
+static Local<Value> presetToJs(const struct Preset* preset) {
+    Local<Object> result = Nan::New<Object>();
+    if (preset->fields & PRESET_PAN_TILT) {
+        Nan::Set(result,
+                 Nan::New<String>("pan").ToLocalChecked(),
+                 Nan::New<Integer>(preset->pan));
+        Nan::Set(result,
+                 Nan::New<String>("tilt").ToLocalChecked(),
+                 Nan::New<Integer>(preset->tilt));
     }
-
-    requestCode                 = UVC_GET_MAX;
-    relativePanTiltInfo->result = uvc_get_pantilt_rel(uvcDevice->devicehandle,
-                                                      &relativePanTiltInfo->pan_direction,
-                                                      &relativePanTiltInfo->max_pan_speed,
-                                                      &relativePanTiltInfo->tilt_direction,
-                                                      &relativePanTiltInfo->max_tilt_speed,
-                                                      requestCode);
-    if (relativePanTiltInfo->result != 0) {
-        std::string error(uvc_strerror(relativePanTiltInfo->result));
-        relativePanTiltInfo->error = error.c_str();
-        return;
+    if (preset->fields & PRESET_ZOOM) {
+        Nan::Set(result,
+                 Nan::New<String>("zoom").ToLocalChecked(),
+                 Nan::New<Integer>(preset->zoom));
     }
+    return result;
+}
 
-    requestCode                 = UVC_GET_RES;
-    relativePanTiltInfo->result = uvc_get_pantilt_rel(uvcDevice->devicehandle,
-                                                      &relativePanTiltInfo->pan_direction,
-                                                      &relativePanTiltInfo->resolution_pan_speed,
-                                                      &relativePanTiltInfo->tilt_direction,
-                                                      &relativePanTiltInfo->resolution_tilt_speed,
-                                                      requestCode);
-    if (relativePanTiltInfo->result != 0) {
-        std::string error(uvc_strerror(relativePanTiltInfo->result));
-        relativePanTiltInfo->error = error.c_str();
-        return;
-    }
+NAN_METHOD(openPresets) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
 
-    requestCode                 = UVC_GET_DEF;
-    relativePanTiltInfo->result = uvc_get_pantilt_rel(uvcDevice->devicehandle,
-                                                      &relativePanTiltInfo->pan_direction,
-                                                      &relativePanTiltInfo->default_pan_speed,
-                                                      &relativePanTiltInfo->tilt_direction,
-                                                      &relativePanTiltInfo->default_tilt_speed,
-                                                      requestCode);
-    if (relativePanTiltInfo->result != 0) {
-        std::string error(uvc_strerror(relativePanTiltInfo->result));
-        relativePanTiltInfo->error = error.c_str();
-        return;
-    }
+    Nan::Utf8String path(
+        Nan::Get(input, Nan::New<String>("path").ToLocalChecked()).ToLocalChecked());
+    uint32_t capacity = (uint32_t)readNumber(input, "capacity", 4096);
 
-    requestCode                 = UVC_GET_CUR;
-    relativePanTiltInfo->result = uvc_get_pantilt_rel(uvcDevice->devicehandle,
-                                                      &relativePanTiltInfo->pan_direction,
-                                                      &relativePanTiltInfo->current_pan_speed,
-                                                      &relativePanTiltInfo->tilt_direction,
-                                                      &relativePanTiltInfo->current_tilt_speed,
-                                                      requestCode);
-    if (relativePanTiltInfo->result != 0) {
-        std::string error(uvc_strerror(relativePanTiltInfo->result));
-        relativePanTiltInfo->error = error.c_str();
+    int error = presetOpen(*path, capacity);
+    if (error != 0) {
+        Nan::ThrowError(error == EINVAL ? "not a preset store" : strerror(error));
         return;
     }
+    info.GetReturnValue().Set(presetStatsToJs());
+}
+NAN_METHOD(closePresets) {
+    presetClose();
+    info.GetReturnValue().Set(Nan::Undefined());
+}
+NAN_METHOD(getPresetStats) {
+    info.GetReturnValue().Set(presetStatsToJs());
 }
 
-struct RelativePanTilt {
-    int8_t      pan_direction;
-    uint8_t     pan_speed;
-    int8_t      tilt_direction;
-    uint8_t     tilt_speed;
-    uvc_error_t result;
-    const char* error;
-};
-void setRelativePanTilt(struct UVCDevice* uvcDevice, struct RelativePanTilt* relativePanTilt) {
-    relativePanTilt->result = uvc_set_pantilt_rel(uvcDevice->devicehandle,
-                                                  relativePanTilt->pan_direction,
-                                                  relativePanTilt->pan_speed,
-                                                  relativePanTilt->tilt_direction,
-                                                  relativePanTilt->tilt_speed);
-    if (relativePanTilt->result != 0) {
-        std::string error(uvc_strerror(relativePanTilt->result));
-        relativePanTilt->error = error.c_str();
-        return;
-    }
+static Local<Value> warmCacheStatsToJs() {
+    struct WarmCacheStats stats;
+    warmCacheGetStats(&stats);
+
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result,
+             Nan::New<String>("open").ToLocalChecked(),
+             Nan::New<Boolean>(stats.open));
+    Nan::Set(result,
+             Nan::New<String>("capacity").ToLocalChecked(),
+             Nan::New<Number>(stats.capacity));
+    Nan::Set(result,
+             Nan::New<String>("count").ToLocalChecked(),
+             Nan::New<Number>(stats.count));
+    Nan::Set(result,
+             Nan::New<String>("hits").ToLocalChecked(),
+             Nan::New<Number>((double)stats.hits));
+    Nan::Set(result,
+             Nan::New<String>("misses").ToLocalChecked(),
+             Nan::New<Number>((double)stats.misses));
+    Nan::Set(result,
+             Nan::New<String>("validated").ToLocalChecked(),
+             Nan::New<Number>((double)stats.validated));
+    Nan::Set(result,
+             Nan::New<String>("invalidated").ToLocalChecked(),
+             Nan::New<Number>((double)stats.invalidated));
+    return result;
 }
 
-// node binding functions
-NAN_METHOD(listDevices) {
-    // get device list
-    uvc_context_t*           ctx;
-    uvc_device_t**           devices;
-    size_t                   device_count;
-    uvc_device_descriptor_t* descriptor;
-    uvc_error_t              res;
-
-    // initalize uvc
-    res = uvc_init(&ctx, NULL);
-    if (res != 0) {
-        uvc_exit(ctx);
-        std::string error(uvc_strerror(res));
-        Nan::ThrowError(error.c_str());
-        return;
-    }
+NAN_METHOD(openWarmCache) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
 
-    // get devices list
-    res = uvc_get_device_list(ctx, &devices);
+    Nan::Utf8String path(
+        Nan::Get(input, Nan::New<String>("path").ToLocalChecked()).ToLocalChecked());
+    uint32_t capacity = (uint32_t)readNumber(input, "capacity", 256);
 
-    if (res != 0) {
-        uvc_exit(ctx);
-        std::string error(uvc_strerror(res));
-        Nan::ThrowError(error.c_str());
+    int error = warmCacheOpen(*path, capacity);
+    if (error != 0) {
+        Nan::ThrowError(error == EINVAL ? "not a warm start cache" : strerror(error));
         return;
     }
+    info.GetReturnValue().Set(warmCacheStatsToJs());
+}
+NAN_METHOD(closeWarmCache) {
+    warmCacheClose();
+    info.GetReturnValue().Set(Nan::Undefined());
+}
+NAN_METHOD(getWarmCacheStats) {
+    info.GetReturnValue().Set(warmCacheStatsToJs());
+}
 
-    device_count = 0;
-    while (devices[device_count++] != NULL)
-        continue;
+// savePreset(input) stores pan/tilt/zoom from input, or the camera's current
+// position for any left out
+NAN_METHOD(savePreset) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
 
-    // create output result
-    Local<Array> jsDevices = Nan::New<Array>();
-    for (int i = 0; devices[i] != NULL; i++) {
-        std::cout << "i: " << i << std::endl;
-        uvc_device_t* device = devices[i];
-        std::cout << "device: " << device << std::endl << std::flush;
-        res = uvc_get_device_descriptor(device, &descriptor);
-        if (res != UVC_SUCCESS) {
-            uvc_free_device_list(devices, 1);
-            uvc_exit(ctx);
-            std::string error(uvc_strerror(res));
-            Nan::ThrowError(error.c_str());
+    struct UVCDevice uvcDevice;
+    readDevice(input, &uvcDevice);
+    Nan::Utf8String name(
+        Nan::Get(input, Nan::New<String>("name").ToLocalChecked()).ToLocalChecked());
+
+    struct Preset preset = {0, 0, 0, 0};
+    double        pan    = readNumber(input, "pan", NAN);
+    double        tilt   = readNumber(input, "tilt", NAN);
+    double        zoom   = readNumber(input, "zoom", NAN);
+    if (isnan(pan) || isnan(tilt) || isnan(zoom)) {
+        struct CommandResult commandResult;
+        presetCapture(sessionFind(&uvcDevice), &uvcDevice, &preset, &commandResult);
+        if (commandResult.result != 0) {
+            Nan::ThrowException(commandError(&commandResult));
             return;
         }
-        Local<Object> jsDevice = Nan::New<Object>();
-
-        std::cout << "vendorId: " << descriptor->idVendor << std::endl
-                  << "productId: " << descriptor->idProduct << std::endl
-                  << "serialNumber: " << descriptor->serialNumber << std::endl
-                  << "manufacturer: " << descriptor->manufacturer << std::endl
-                  << "product: " << descriptor->product << std::endl
-                  << std::flush;
-
-        Nan::Set(jsDevice,
-                 Nan::New<String>("vendorId").ToLocalChecked(),
-                 Nan::New<Uint32>((uint32_t)descriptor->idVendor));
-        Nan::Set(jsDevice,
-                 Nan::New<String>("productId").ToLocalChecked(),
-                 Nan::New<Uint32>((uint32_t)descriptor->idProduct));
-
-        trySetting(jsDevice, "serialNumber", descriptor->serialNumber);
-        trySetting(jsDevice, "manufacturer", descriptor->manufacturer);
-        trySetting(jsDevice, "product", descriptor->product);
-
-        Nan::Set(jsDevices, i, jsDevice);
-
-        uvc_free_device_descriptor(descriptor);
     }
-    uvc_free_device_list(devices, 1);
-    uvc_exit(ctx);
+    if (!isnan(pan) && !isnan(tilt)) {
+        preset.fields |= PRESET_PAN_TILT;
+        preset.pan  = (int32_t)pan;
+        preset.tilt = (int32_t)tilt;
+    }
+    if (!isnan(zoom)) {
+        preset.fields |= PRESET_ZOOM;
+        preset.zoom = (uint16_t)zoom;
+    }
 
-    info.GetReturnValue().Set(jsDevices);
+    int error = presetSave(&uvcDevice, *name, &preset);
+    if (error != 0) {
+        Nan::ThrowError(presetError(error));
+        return;
+    }
+    info.GetReturnValue().Set(presetToJs(&preset));
 }
-NAN_METHOD(getCapabilities) {
+NAN_METHOD(getPreset) {
     Local<Object> input = Local<Object>::Cast(info[0]);
 
-    // get options
-    Local<Value> vendorId = Nan::Get(input, Nan::New<String>("vendorId").ToLocalChecked())
-                                .ToLocalChecked();
-    Local<Value> productId = Nan::Get(input, Nan::New<String>("productId").ToLocalChecked())
-                                 .ToLocalChecked();
-
     struct UVCDevice uvcDevice;
-    uvcDevice.vendorId  = Nan::To<int32_t>(vendorId).FromMaybe(0);
-    uvcDevice.productId = Nan::To<int32_t>(productId).FromMaybe(0);
-
-    // open device
-    openDevice(&uvcDevice);
-    if (uvcDevice.result != 0) {
-        Nan::ThrowError(uvcDevice.error);
+    readDevice(input, &uvcDevice);
+    Nan::Utf8String name(
+        Nan::Get(input, Nan::New<String>("name").ToLocalChecked()).ToLocalChecked());
+
+    struct Preset preset;
+    int           error = presetFind(&uvcDevice, *name, &preset);
+    if (error != 0) {
+        Nan::ThrowError(presetError(error));
         return;
     }
-    // printf("==original2===%p====", uvcDevice.devicehandle);
-
-    // get capabilities
-    struct DeviceCapability deviceCapability;
-    deviceCapability = getDeviceCapability(&uvcDevice);
-
-    // create output result
-    Local<Object> jsDevice = Nan::New<Object>();
-    Nan::Set(jsDevice,
-             Nan::New<String>("absoluteZoom").ToLocalChecked(),
-             Nan::New<Boolean>(deviceCapability.absolute_zoom));
-    Nan::Set(jsDevice,
-             Nan::New<String>("relativeZoom").ToLocalChecked(),
-             Nan::New<Boolean>(deviceCapability.relative_zoom));
-    Nan::Set(jsDevice,
-             Nan::New<String>("absolutePanTilt").ToLocalChecked(),
-             Nan::New<Boolean>(deviceCapability.absolute_pan_tilt));
-    Nan::Set(jsDevice,
-             Nan::New<String>("relativePanTilt").ToLocalChecked(),
-             Nan::New<Boolean>(deviceCapability.relative_pan_tilt));
-    Nan::Set(jsDevice,
-             Nan::New<String>("absoluteRoll").ToLocalChecked(),
-             Nan::New<Boolean>(deviceCapability.absolute_roll));
-    Nan::Set(jsDevice,
-             Nan::New<String>("relativeRoll").ToLocalChecked(),
-             Nan::New<Boolean>(deviceCapability.relative_roll));
-
-    // cleanup
-    closeDevice(&uvcDevice);
-
-    // trigger callback
-    info.GetReturnValue().Set(jsDevice);
+    info.GetReturnValue().Set(presetToJs(&preset));
 }
-NAN_METHOD(getAbsoluteZoom) {
+NAN_METHOD(deletePreset) {
     Local<Object> input = Local<Object>::Cast(info[0]);
-    // get options
-    Local<Value> vendorId = Nan::Get(input, Nan::New<String>("vendorId").ToLocalChecked())
-                                .ToLocalChecked();
-    Local<Value> productId = Nan::Get(input, Nan::New<String>("productId").ToLocalChecked())
-                                 .ToLocalChecked();
 
     struct UVCDevice uvcDevice;
-    uvcDevice.vendorId  = Nan::To<int32_t>(vendorId).FromMaybe(0);
-    uvcDevice.productId = Nan::To<int32_t>(productId).FromMaybe(0);
+    readDevice(input, &uvcDevice);
+    Nan::Utf8String name(
+        Nan::Get(input, Nan::New<String>("name").ToLocalChecked()).ToLocalChecked());
 
-    // open device
-    openDevice(&uvcDevice);
-    if (uvcDevice.result != 0) {
-        Nan::ThrowError(uvcDevice.error);
+    int error = presetDelete(&uvcDevice, *name);
+    if (error != 0 && error != ENOENT) {
+        Nan::ThrowError(presetError(error));
         return;
     }
+    info.GetReturnValue().Set(Nan::New<Boolean>(error == 0));
+}
+NAN_METHOD(listPresets) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
+
+    struct UVCDevice uvcDevice;
+    readDevice(input, &uvcDevice);
 
-    // get zoom info
-    struct AbsoluteZoomInfo absoluteZoomInfo;
-    getAbsoluteZoomInfo(&uvcDevice, &absoluteZoomInfo);
-    if (absoluteZoomInfo.result != 0) {
-        closeDevice(&uvcDevice);
-        Nan::ThrowError(absoluteZoomInfo.error);
+    std::vector<std::string> names;
+    int                      error = presetList(&uvcDevice, &names);
+    if (error != 0) {
+        Nan::ThrowError(presetError(error));
         return;
     }
+    Local<Array> result = Nan::New<Array>();
+    for (size_t i = 0; i < names.size(); i++) {
+        Nan::Set(result, (uint32_t)i, Nan::New<String>(names[i]).ToLocalChecked());
+    }
+    info.GetReturnValue().Set(result);
+}
 
-    // create output result
-    Local<Object> jsDevice = Nan::New<Object>();
-    Nan::Set(jsDevice,
-             Nan::New<String>("min").ToLocalChecked(),
-             Nan::New<Integer>(absoluteZoomInfo.min));
-    Nan::Set(jsDevice,
-             Nan::New<String>("max").ToLocalChecked(),
-             Nan::New<Integer>(absoluteZoomInfo.max));
-    Nan::Set(jsDevice,
-             Nan::New<String>("resolution").ToLocalChecked(),
-             Nan::New<Integer>(absoluteZoomInfo.resolution));
-    Nan::Set(jsDevice,
-             Nan::New<String>("current").ToLocalChecked(),
-             Nan::New<Integer>(absoluteZoomInfo.current));
-    Nan::Set(jsDevice,
-             Nan::New<String>("default").ToLocalChecked(),
-             Nan::New<Integer>(absoluteZoomInfo.def));
+// a recall queued behind the camera's other async commands
+struct PresetRecallCall {
+    struct CameraSession* session;
+    struct UVCDevice      uvcDevice;
+    struct Preset         preset;
+    uint32_t              durationMs;
+    struct AsyncCall*     call;
+};
 
-    // cleanup
-    closeDevice(&uvcDevice);
+static void runPresetRecall(void* context, struct CommandResult* commandResult) {
+    struct PresetRecallCall* recall = (struct PresetRecallCall*)context;
+    presetRecall(recall->session,
+                 &recall->uvcDevice,
+                 &recall->preset,
+                 recall->durationMs,
+                 0,
+                 commandResult);
+}
 
-    // trigger callback
-    info.GetReturnValue().Set(jsDevice);
+static void onPresetRecallDone(void*                       context,
+                               const struct CommandResult* commandResult,
+                               uint32_t                    pending) {
+    struct PresetRecallCall* recall = (struct PresetRecallCall*)context;
+    onCommandDone(recall->call, commandResult, pending);
+    delete recall;
 }
-NAN_METHOD(absoluteZoom) {
-    Local<Object> input = Local<Object>::Cast(info[0]);
 
-    // get options
-    Local<Value> vendorId = Nan::Get(input, Nan::New<String>("vendorId").ToLocalChecked())
-                                .ToLocalChecked();
-    Local<Value> productId = Nan::Get(input, Nan::New<String>("productId").ToLocalChecked())
-                                 .ToLocalChecked();
-    Local<Value> zoom = Nan::Get(input, Nan::New<String>("zoom").ToLocalChecked()).ToLocalChecked();
+// recallPreset(input) moves to a preset, stepping there over durationMs when
+// given. with a callback the recall is queued on the camera's thread like
+// executeAsync, and calls back with (err, undefined, pending).
+NAN_METHOD(recallPreset) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
 
     struct UVCDevice uvcDevice;
-    uvcDevice.vendorId  = Nan::To<int32_t>(vendorId).FromMaybe(0);
-    uvcDevice.productId = Nan::To<int32_t>(productId).FromMaybe(0);
-
-    // open device
-    openDevice(&uvcDevice);
-    if (uvcDevice.result != 0) {
-        Nan::ThrowError(uvcDevice.error);
+    readDevice(input, &uvcDevice);
+    Nan::Utf8String name(
+        Nan::Get(input, Nan::New<String>("name").ToLocalChecked()).ToLocalChecked());
+    uint32_t durationMs = (uint32_t)readNumber(input, "durationMs", 0);
+
+    struct Preset preset;
+    int           error = presetFind(&uvcDevice, *name, &preset);
+    if (error != 0) {
+        Nan::ThrowError(presetError(error));
+        return;
+    }
+    struct CameraSession* session = sessionFind(&uvcDevice);
+
+    if (info[1]->IsFunction()) {
+        // completes like an absolute move, with no result
+        struct PresetRecallCall* recall = new PresetRecallCall();
+        recall->session                 = session;
+        recall->uvcDevice               = uvcDevice;
+        recall->preset                  = preset;
+        recall->durationMs              = durationMs;
+        recall->call                    = new AsyncCall();
+        recall->call->callback          = new Nan::Callback(Local<Function>::Cast(info[1]));
+        recall->call->command           = Command();
+        recall->call->command.op        = CMD_ABSOLUTE_PAN_TILT;
+        recall->call->group             = NULL;
+
+        beginAsyncCall(recall->call);
+        uint32_t pending = sessionSubmitTask(session, runPresetRecall, onPresetRecallDone, recall);
+        info.GetReturnValue().Set(Nan::New<Number>(pending));
         return;
     }
 
-    // get zoom info
-    struct AbsoluteZoom absoluteZoom;
-    absoluteZoom.zoom = Nan::To<int32_t>(zoom).FromMaybe(0);
-    setAbsoluteZoom(&uvcDevice, &absoluteZoom);
-    if (absoluteZoom.result != 0) {
-        closeDevice(&uvcDevice);
-        Nan::ThrowError(absoluteZoom.error);
+    struct CommandResult commandResult;
+    presetRecall(session, &uvcDevice, &preset, durationMs, 0, &commandResult);
+    if (commandResult.result != 0) {
+        Nan::ThrowException(commandError(&commandResult));
         return;
     }
+    info.GetReturnValue().Set(Nan::Undefined());
+}
 
-    // cleanup
-    closeDevice(&uvcDevice);
+// click to center, queued behind the camera's other async commands
+struct CenterCall {
+    struct CameraSession* session;
+    struct UVCDevice      uvcDevice;
+    double                x;
+    double                y;
+    struct AsyncCall*     call;
+};
 
-    info.GetReturnValue().Set(Nan::Undefined());
+static void runCenter(void* context, struct CommandResult* commandResult) {
+    struct CenterCall* center = (struct CenterCall*)context;
+    int32_t            pan;
+    int32_t            tilt;
+    pointingCenter(
+        center->session, &center->uvcDevice, center->x, center->y, &pan, &tilt, commandResult);
 }
-NAN_METHOD(getRelativeZoom) {
-    Local<Object> input = Local<Object>::Cast(info[0]);
 
-    // get options
-    Local<Value> vendorId = Nan::Get(input, Nan::New<String>("vendorId").ToLocalChecked())
-                                .ToLocalChecked();
-    Local<Value> productId = Nan::Get(input, Nan::New<String>("productId").ToLocalChecked())
-                                 .ToLocalChecked();
+static void onCenterDone(void*                       context,
+                         const struct CommandResult* commandResult,
+                         uint32_t                    pending) {
+    struct CenterCall* center = (struct CenterCall*)context;
+    onCommandDone(center->call, commandResult, pending);
+    delete center;
+}
 
-    struct UVCDevice uvcDevice;
-    uvcDevice.vendorId  = Nan::To<int32_t>(vendorId).FromMaybe(0);
-    uvcDevice.productId = Nan::To<int32_t>(productId).FromMaybe(0);
+// centerOn(input) turns the camera so input.x, input.y, from 0,0 at the top
+// left of the picture to 1,1 at the bottom right, ends up in the middle, and
+// returns the { pan, tilt } it was sent to. with a callback the move is
+// queued like executeAsync.
+NAN_METHOD(centerOn) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
 
-    // open device
-    openDevice(&uvcDevice);
-    if (uvcDevice.result != 0) {
-        Nan::ThrowError(uvcDevice.error);
+    struct UVCDevice uvcDevice;
+    readDevice(input, &uvcDevice);
+    double                x       = readNumber(input, "x", 0.5);
+    double                y       = readNumber(input, "y", 0.5);
+    struct CameraSession* session = sessionFind(&uvcDevice);
+
+    if (info[1]->IsFunction()) {
+        struct CenterCall* center = new CenterCall();
+        center->session           = session;
+        center->uvcDevice         = uvcDevice;
+        center->x                 = x;
+        center->y                 = y;
+        center->call              = new AsyncCall();
+        center->call->callback    = new Nan::Callback(Local<Function>::Cast(info[1]));
+        center->call->command     = Command();
+        center->call->command.op  = CMD_ABSOLUTE_PAN_TILT;
+        center->call->group       = NULL;
+
+        beginAsyncCall(center->call);
+        uint32_t pending = sessionSubmitTask(session, runCenter, onCenterDone, center);
+        info.GetReturnValue().Set(Nan::New<Number>(pending));
         return;
     }
 
-    // get zoom info
-    struct RelativeZoomInfo relativeZoomInfo;
-    getRelativeZoomInfo(&uvcDevice, &relativeZoomInfo);
-    if (relativeZoomInfo.result != 0) {
-        closeDevice(&uvcDevice);
-        Nan::ThrowError(relativeZoomInfo.error);
+    struct CommandResult commandResult;
+    int32_t              pan;
+    int32_t              tilt;
+    pointingCenter(session, &uvcDevice, x, y, &pan, &tilt, &commandResult);
+    if (commandResult.result != 0) {
+        Nan::ThrowException(commandError(&commandResult));
         return;
     }
-
-    // create output result
     Local<Object> result = Nan::New<Object>();
-    Nan::Set(result,
-             Nan::New<String>("direction").ToLocalChecked(),
-             Nan::New<Integer>(relativeZoomInfo.direction));
-    Nan::Set(result,
-             Nan::New<String>("digitalZoom").ToLocalChecked(),
-             Nan::New<Boolean>(relativeZoomInfo.digital_zoom));
-    Nan::Set(result,
-             Nan::New<String>("minSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativeZoomInfo.min_speed));
-    Nan::Set(result,
-             Nan::New<String>("maxSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativeZoomInfo.max_speed));
-    Nan::Set(result,
-             Nan::New<String>("resolutionSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativeZoomInfo.resolution_speed));
-    Nan::Set(result,
-             Nan::New<String>("currentSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativeZoomInfo.current_speed));
-    Nan::Set(result,
-             Nan::New<String>("defaultSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativeZoomInfo.default_speed));
-
-    // cleanup
-    closeDevice(&uvcDevice);
-
-    // trigger callback
+    Nan::Set(result, Nan::New<String>("pan").ToLocalChecked(), Nan::New<Integer>(pan));
+    Nan::Set(result, Nan::New<String>("tilt").ToLocalChecked(), Nan::New<Integer>(tilt));
     info.GetReturnValue().Set(result);
 }
-NAN_METHOD(relativeZoom) {
-    Local<Object> input = Local<Object>::Cast(info[0]);
 
-    // get options
-    Local<Value> vendorId = Nan::Get(input, Nan::New<String>("vendorId").ToLocalChecked())
-                                .ToLocalChecked();
-    Local<Value> productId = Nan::Get(input, Nan::New<String>("productId").ToLocalChecked())
-                                 .ToLocalChecked();
-    Local<Value> direction = Nan::Get(input, Nan::New<String>("direction").ToLocalChecked())
-                                 .ToLocalChecked();
-    Local<Value> speed = Nan::Get(input, Nan::New<String>("speed").ToLocalChecked())
-                             .ToLocalChecked();
+// pointsToPanTilt(input) converts input.points, x, y pairs as a Float64Array
+// or plain array, into a Float64Array of pan, tilt pairs for the camera's
+// current view, reading the camera once for the whole batch
+NAN_METHOD(pointsToPanTilt) {
+    Local<Object> input = Local<Object>::Cast(info[0]);
 
     struct UVCDevice uvcDevice;
-    uvcDevice.vendorId  = Nan::To<int32_t>(vendorId).FromMaybe(0);
-    uvcDevice.productId = Nan::To<int32_t>(productId).FromMaybe(0);
+    readDevice(input, &uvcDevice);
+    Local<Value> points =
+        Nan::Get(input, Nan::New<String>("points").ToLocalChecked()).ToLocalChecked();
+
+    std::vector<double> coordinates;
+    if (points->IsFloat64Array()) {
+        Nan::TypedArrayContents<double> contents(points);
+        coordinates.assign(*contents, *contents + contents.length());
+    } else if (points->IsArray()) {
+        Local<Array> values = Local<Array>::Cast(points);
+        coordinates.resize(values->Length());
+        for (uint32_t i = 0; i < values->Length(); i++) {
+            coordinates[i] = Nan::To<double>(Nan::Get(values, i).ToLocalChecked()).FromMaybe(0);
+        }
+    }
 
-    // open device
-    openDevice(&uvcDevice);
-    if (uvcDevice.result != 0) {
-        Nan::ThrowError(uvcDevice.error);
+    struct PointingView  view;
+    struct CommandResult commandResult;
+    pointingView(sessionFind(&uvcDevice), &uvcDevice, &view, &commandResult);
+    if (commandResult.result != 0) {
+        Nan::ThrowException(commandError(&commandResult));
         return;
     }
 
-    // get zoom info
-    struct RelativeZoom relativeZoom;
-    relativeZoom.direction = Nan::To<int32_t>(direction).FromMaybe(0);
-    relativeZoom.speed     = Nan::To<int32_t>(speed).FromMaybe(0);
-    setRelativeZoom(&uvcDevice, &relativeZoom);
-    if (relativeZoom.result != 0) {
-        closeDevice(&uvcDevice);
-        Nan::ThrowError(relativeZoom.error);
-        return;
+    size_t                          pairs = coordinates.size() / 2;
+    Local<v8::ArrayBuffer>          buffer =
+        v8::ArrayBuffer::New(Isolate::GetCurrent(), pairs * 2 * sizeof(double));
+    Local<v8::Float64Array>         result = v8::Float64Array::New(buffer, 0, pairs * 2);
+    Nan::TypedArrayContents<double> out(result);
+    for (size_t i = 0; i < pairs; i++) {
+        int32_t pan;
+        int32_t tilt;
+        pointingAim(&view, coordinates[i * 2], coordinates[i * 2 + 1], &pan, &tilt);
+        (*out)[i * 2]     = pan;
+        (*out)[i * 2 + 1] = tilt;
     }
+    info.GetReturnValue().Set(result);
+}
 
-    // cleanup
-    closeDevice(&uvcDevice);
+// patrol tours, one per camera
+static const char* tourStateNames[] = {
+    "idle", "moving", "dwelling", "paused", "interrupted", "finished", "failed"};
 
-    // trigger callback
-    info.GetReturnValue().Set(Nan::Undefined());
-}
-NAN_METHOD(getAbsolutePanTilt) {
+// startTour(input) with input.stops as [{ preset } or { pan, tilt, zoom },
+// plus dwellMs and moveMs], and optional laps and resumeAfterMs
+NAN_METHOD(startTour) {
     Local<Object> input = Local<Object>::Cast(info[0]);
 
-    // get options
-    Local<Value> vendorId = Nan::Get(input, Nan::New<String>("vendorId").ToLocalChecked())
-                                .ToLocalChecked();
-    Local<Value> productId = Nan::Get(input, Nan::New<String>("productId").ToLocalChecked())
-                                 .ToLocalChecked();
-
     struct UVCDevice uvcDevice;
-    uvcDevice.vendorId  = Nan::To<int32_t>(vendorId).FromMaybe(0);
-    uvcDevice.productId = Nan::To<int32_t>(productId).FromMaybe(0);
-
-    // open device
-    openDevice(&uvcDevice);
-    if (uvcDevice.result != 0) {
-        Nan::ThrowError(uvcDevice.error);
+    readDevice(input, &uvcDevice);
+    struct TourConfig config;
+    config.laps            = (uint32_t)readNumber(input, "laps", 0);
+    config.resume_after_ms = (uint32_t)readNumber(input, "resumeAfterMs", 0);
+
+    Local<Value> jsStops = Nan::Get(input, Nan::New<String>("stops").ToLocalChecked())
+                               .ToLocalChecked();
+    if (!jsStops->IsArray()) {
+        Nan::ThrowError("stops must be an array");
         return;
     }
+    Local<Array>                 stopArray = Local<Array>::Cast(jsStops);
+    std::vector<struct TourStop> stops(stopArray->Length());
+    for (uint32_t i = 0; i < stops.size(); i++) {
+        Local<Object>    jsStop = Local<Object>::Cast(Nan::Get(stopArray, i).ToLocalChecked());
+        struct TourStop* stop   = &stops[i];
+        memset(stop, 0, sizeof(*stop));
+        stop->dwell_ms = (uint32_t)readNumber(jsStop, "dwellMs", 0);
+        stop->move_ms  = (uint32_t)readNumber(jsStop, "moveMs", 0);
+
+        Local<Value> preset = Nan::Get(jsStop, Nan::New<String>("preset").ToLocalChecked())
+                                  .ToLocalChecked();
+        if (!preset->IsUndefined()) {
+            Nan::Utf8String name(preset);
+            if (strlen(*name) >= PRESET_NAME_SIZE) {
+                Nan::ThrowError(presetError(ENAMETOOLONG));
+                return;
+            }
+            strcpy(stop->preset, *name);
+            continue;
+        }
+        double pan  = readNumber(jsStop, "pan", NAN);
+        double tilt = readNumber(jsStop, "tilt", NAN);
+        double zoom = readNumber(jsStop, "zoom", NAN);
+        if (!isnan(pan) && !isnan(tilt)) {
+            stop->position.fields |= PRESET_PAN_TILT;
+            stop->position.pan  = (int32_t)pan;
+            stop->position.tilt = (int32_t)tilt;
+        }
+        if (!isnan(zoom)) {
+            stop->position.fields |= PRESET_ZOOM;
+            stop->position.zoom = (uint16_t)zoom;
+        }
+    }
 
-    // get pan tilt info
-    struct AbsolutePanTiltInfo absolutePanTiltInfo;
-    getAbsolutePanTiltInfo(&uvcDevice, &absolutePanTiltInfo);
-    if (absolutePanTiltInfo.result != 0) {
-        closeDevice(&uvcDevice);
-        Nan::ThrowError(absolutePanTiltInfo.error);
+    if (!tourStart(&uvcDevice, stops, &config)) {
+        Nan::ThrowError("a tour needs at least one stop");
         return;
     }
+    info.GetReturnValue().Set(Nan::Undefined());
+}
+NAN_METHOD(stopTour) {
+    struct UVCDevice uvcDevice;
+    readDevice(Local<Object>::Cast(info[0]), &uvcDevice);
+    tourStop(&uvcDevice);
+    info.GetReturnValue().Set(Nan::Undefined());
+}
+NAN_METHOD(pauseTour) {
+    struct UVCDevice uvcDevice;
+    readDevice(Local<Object>::Cast(info[0]), &uvcDevice);
+    tourPause(&uvcDevice);
+    info.GetReturnValue().Set(Nan::Undefined());
+}
+NAN_METHOD(resumeTour) {
+    struct UVCDevice uvcDevice;
+    readDevice(Local<Object>::Cast(info[0]), &uvcDevice);
+    tourResume(&uvcDevice);
+    info.GetReturnValue().Set(Nan::Undefined());
+}
+NAN_METHOD(getTourStats) {
+    struct UVCDevice uvcDevice;
+    readDevice(Local<Object>::Cast(info[0]), &uvcDevice);
+    struct TourStats stats;
+    tourGetStats(&uvcDevice, &stats);
 
-    // create output result
     Local<Object> result = Nan::New<Object>();
     Nan::Set(result,
-             Nan::New<String>("minPan").ToLocalChecked(),
-             Nan::New<Integer>(absolutePanTiltInfo.min_pan));
-    Nan::Set(result,
-             Nan::New<String>("minTilt").ToLocalChecked(),
-             Nan::New<Integer>(absolutePanTiltInfo.min_tilt));
+             Nan::New<String>("state").ToLocalChecked(),
+             Nan::New<String>(tourStateNames[stats.state]).ToLocalChecked());
     Nan::Set(result,
-             Nan::New<String>("maxPan").ToLocalChecked(),
-             Nan::New<Integer>(absolutePanTiltInfo.max_pan));
+             Nan::New<String>("stop").ToLocalChecked(),
+             Nan::New<Number>(stats.stop));
     Nan::Set(result,
-             Nan::New<String>("maxTilt").ToLocalChecked(),
-             Nan::New<Integer>(absolutePanTiltInfo.max_tilt));
+             Nan::New<String>("laps").ToLocalChecked(),
+             Nan::New<Number>((double)stats.laps));
     Nan::Set(result,
-             Nan::New<String>("resolutionPan").ToLocalChecked(),
-             Nan::New<Integer>(absolutePanTiltInfo.resolution_pan));
+             Nan::New<String>("moves").ToLocalChecked(),
+             Nan::New<Number>((double)stats.moves));
     Nan::Set(result,
-             Nan::New<String>("resolutionTilt").ToLocalChecked(),
-             Nan::New<Integer>(absolutePanTiltInfo.resolution_tilt));
+             Nan::New<String>("errors").ToLocalChecked(),
+             Nan::New<Number>((double)stats.errors));
     Nan::Set(result,
-             Nan::New<String>("currentPan").ToLocalChecked(),
-             Nan::New<Integer>(absolutePanTiltInfo.current_pan));
+             Nan::New<String>("interruptions").ToLocalChecked(),
+             Nan::New<Number>((double)stats.interruptions));
+    trySetting(result, "error", stats.error);
     Nan::Set(result,
-             Nan::New<String>("currentTilt").ToLocalChecked(),
-             Nan::New<Integer>(absolutePanTiltInfo.current_tilt));
+             Nan::New<String>("timingErrorMeanMs").ToLocalChecked(),
+             Nan::New<Number>(stats.timing_mean / 1e6));
     Nan::Set(result,
-             Nan::New<String>("defaultPan").ToLocalChecked(),
-             Nan::New<Integer>(absolutePanTiltInfo.default_pan));
+             Nan::New<String>("timingErrorP99Ms").ToLocalChecked(),
+             Nan::New<Number>(stats.timing_p99 / 1e6));
     Nan::Set(result,
-             Nan::New<String>("defaultTilt").ToLocalChecked(),
-             Nan::New<Integer>(absolutePanTiltInfo.default_tilt));
-
-    // cleanup
-    closeDevice(&uvcDevice);
-
-    // trigger callback
+             Nan::New<String>("timingErrorMaxMs").ToLocalChecked(),
+             Nan::New<Number>(stats.timing_max / 1e6));
     info.GetReturnValue().Set(result);
 }
-NAN_METHOD(absolutePanTilt) {
-    Local<Object> input = Local<Object>::Cast(info[0]);
 
-    // get options
-    Local<Value> vendorId = Nan::Get(input, Nan::New<String>("vendorId").ToLocalChecked())
-                                .ToLocalChecked();
-    Local<Value> productId = Nan::Get(input, Nan::New<String>("productId").ToLocalChecked())
-                                 .ToLocalChecked();
-    Local<Value> pan  = Nan::Get(input, Nan::New<String>("pan").ToLocalChecked()).ToLocalChecked();
-    Local<Value> tilt = Nan::Get(input, Nan::New<String>("tilt").ToLocalChecked()).ToLocalChecked();
+// runGroup(entries, timeoutMs, callback) sends moves to many cameras at once.
+// entries are command inputs naming their command, several may target one
+// camera and run there in order. timeoutMs bounds the wait at the barrier, 0
+// for the cameras' own. without a callback it blocks until every camera is done.
+static void onGroupDone(void* context) {
+    struct CommandResult commandResult;
+    commandResult.result = UVC_SUCCESS;
+    commandResult.error  = NULL;
+    onCommandDone(context, &commandResult, 0);
+}
 
-    struct UVCDevice uvcDevice;
-    uvcDevice.vendorId  = Nan::To<int32_t>(vendorId).FromMaybe(0);
-    uvcDevice.productId = Nan::To<int32_t>(productId).FromMaybe(0);
+NAN_METHOD(runGroup) {
+    Local<Array> entries = Local<Array>::Cast(info[0]);
+
+    std::vector<struct GroupMember>    members;
+    std::vector<struct CameraSession*> sessions;
+    for (uint32_t i = 0; i < entries->Length(); i++) {
+        Local<Object>   entry = Local<Object>::Cast(Nan::Get(entries, i).ToLocalChecked());
+        Nan::Utf8String name(
+            Nan::Get(entry, Nan::New<String>("command").ToLocalChecked()).ToLocalChecked());
+        int op = findCommand(*name, entry);
+        if (op < 0 || commandSpec(op)->read) {
+            Nan::ThrowError("group commands must be moves");
+            return;
+        }
 
-    // open device
-    openDevice(&uvcDevice);
-    if (uvcDevice.result != 0) {
-        Nan::ThrowError(uvcDevice.error);
-        return;
+        // commands for a camera already in the group join its list
+        struct UVCDevice uvcDevice;
+        readDevice(entry, &uvcDevice);
+        struct CameraSession* session = sessionFind(&uvcDevice);
+        size_t                index   = 0;
+        while (index < sessions.size() && sessions[index] != session) {
+            index++;
+        }
+        if (index == sessions.size()) {
+            sessions.push_back(session);
+            members.push_back(GroupMember());
+            members[index].uvcDevice = uvcDevice;
+            members[index].count     = 0;
+        }
+        struct GroupMember* member = &members[index];
+        if (member->count == GROUP_MEMBER_COMMANDS) {
+            Nan::ThrowError("too many group commands for one camera");
+            return;
+        }
+        readCommand(entry, op, &member->commands[member->count++]);
     }
-
-    // get zoom info
-    struct AbsolutePanTilt absolutePanTilt;
-    absolutePanTilt.pan  = Nan::To<int32_t>(pan).FromMaybe(0);
-    absolutePanTilt.tilt = Nan::To<int32_t>(tilt).FromMaybe(0);
-    setAbsolutePanTilt(&uvcDevice, &absolutePanTilt);
-    if (absolutePanTilt.result != 0) {
-        closeDevice(&uvcDevice);
-        Nan::ThrowError(absolutePanTilt.error);
+    if (members.empty()) {
+        Nan::ThrowError("a group needs at least one command");
         return;
     }
 
-    // cleanup
-    closeDevice(&uvcDevice);
-
-    // trigger callback
-    info.GetReturnValue().Set(Nan::Undefined());
-}
-NAN_METHOD(getRelativePanTilt) {
-    Local<Object> input = Local<Object>::Cast(info[0]);
-
-    // get options
-    Local<Value> vendorId = Nan::Get(input, Nan::New<String>("vendorId").ToLocalChecked())
-                                .ToLocalChecked();
-    Local<Value> productId = Nan::Get(input, Nan::New<String>("productId").ToLocalChecked())
-                                 .ToLocalChecked();
-
-    struct UVCDevice uvcDevice;
-    uvcDevice.vendorId  = Nan::To<int32_t>(vendorId).FromMaybe(0);
-    uvcDevice.productId = Nan::To<int32_t>(productId).FromMaybe(0);
-
-    // open device
-    openDevice(&uvcDevice);
-    if (uvcDevice.result != 0) {
-        Nan::ThrowError(uvcDevice.error);
+    uint32_t timeoutMs = (uint32_t)Nan::To<uint32_t>(info[1]).FromMaybe(0);
+    if (info[2]->IsFunction()) {
+        struct AsyncCall* call = new AsyncCall();
+        call->callback         = new Nan::Callback(Local<Function>::Cast(info[2]));
+        call->command          = Command();
+        call->pending          = 0;
+
+        // completions are delivered on this thread, after this returns
+        beginAsyncCall(call);
+        call->group = groupStart(members, timeoutMs, onGroupDone, call);
+        if (call->group == NULL) {
+            struct CommandResult commandResult;
+            commandResult.result = UVC_ERROR_INVALID_PARAM;
+            commandResult.error  = errorMessage(commandResult.result);
+            onCommandDone(call, &commandResult, 0);
+        }
+        info.GetReturnValue().Set(Nan::Undefined());
         return;
     }
 
-    // get zoom info
-    struct RelativePanTiltInfo relativePanTiltInfo;
-    getRelativePanTiltInfo(&uvcDevice, &relativePanTiltInfo);
-    if (relativePanTiltInfo.result != 0) {
-        closeDevice(&uvcDevice);
-        Nan::ThrowError(relativePanTiltInfo.error);
+    struct GroupStats stats;
+    if (!groupRun(&members, timeoutMs, &stats)) {
+        Nan::ThrowError(errorMessage(UVC_ERROR_INVALID_PARAM));
         return;
     }
+    info.GetReturnValue().Set(groupResultToJs(members, stats));
+}
+
+// device handle accounting
+NAN_METHOD(getDeviceStats) {
+    struct DeviceCounters counters;
+    getDeviceCounters(&counters);
 
-    // create output result
     Local<Object> result = Nan::New<Object>();
     Nan::Set(result,
-             Nan::New<String>("panDirection").ToLocalChecked(),
-             Nan::New<Integer>(relativePanTiltInfo.pan_direction));
+             Nan::New<String>("opens").ToLocalChecked(),
+             Nan::New<Number>((double)counters.opens));
     Nan::Set(result,
-             Nan::New<String>("tiltDirection").ToLocalChecked(),
-             Nan::New<Integer>(relativePanTiltInfo.tilt_direction));
+             Nan::New<String>("closes").ToLocalChecked(),
+             Nan::New<Number>((double)counters.closes));
     Nan::Set(result,
-             Nan::New<String>("minPanSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativePanTiltInfo.min_pan_speed));
+             Nan::New<String>("failures").ToLocalChecked(),
+             Nan::New<Number>((double)counters.failures));
     Nan::Set(result,
-             Nan::New<String>("minTiltSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativePanTiltInfo.min_tilt_speed));
+             Nan::New<String>("open").ToLocalChecked(),
+             Nan::New<Number>((double)counters.open));
+    info.GetReturnValue().Set(result);
+}
+
+// simulated camera behaviour, any field left out keeps its current value
+NAN_METHOD(configureSimulator) {
+    struct SimConfig config;
+    simGetConfig(&config);
+
+    if (info[0]->IsObject()) {
+        Local<Object> input = Local<Object>::Cast(info[0]);
+        config.transfer_latency_us =
+            (uint32_t)readNumber(input, "transferLatencyUs", config.transfer_latency_us);
+        config.transfer_jitter_us =
+            (uint32_t)readNumber(input, "transferJitterUs", config.transfer_jitter_us);
+        config.open_latency_us =
+            (uint32_t)readNumber(input, "openLatencyUs", config.open_latency_us);
+        config.error_rate = readNumber(input, "errorRate", config.error_rate);
+        config.pan_speed  = readNumber(input, "panSpeed", config.pan_speed);
+        config.tilt_speed = readNumber(input, "tiltSpeed", config.tilt_speed);
+        config.zoom_speed = readNumber(input, "zoomSpeed", config.zoom_speed);
+        config.firmware   = (uint16_t)readNumber(input, "firmware", config.firmware);
+        simSetConfig(&config);
+    }
+
+    Local<Object> result = Nan::New<Object>();
     Nan::Set(result,
-             Nan::New<String>("maxPanSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativePanTiltInfo.max_pan_speed));
+             Nan::New<String>("transferLatencyUs").ToLocalChecked(),
+             Nan::New<Number>(config.transfer_latency_us));
     Nan::Set(result,
-             Nan::New<String>("maxTiltSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativePanTiltInfo.max_tilt_speed));
+             Nan::New<String>("transferJitterUs").ToLocalChecked(),
+             Nan::New<Number>(config.transfer_jitter_us));
     Nan::Set(result,
-             Nan::New<String>("resolutionPanSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativePanTiltInfo.resolution_pan_speed));
+             Nan::New<String>("openLatencyUs").ToLocalChecked(),
+             Nan::New<Number>(config.open_latency_us));
     Nan::Set(result,
-             Nan::New<String>("resolutionTiltSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativePanTiltInfo.resolution_tilt_speed));
+             Nan::New<String>("errorRate").ToLocalChecked(),
+             Nan::New<Number>(config.error_rate));
     Nan::Set(result,
-             Nan::New<String>("defaultPanSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativePanTiltInfo.default_pan_speed));
+             Nan::New<String>("panSpeed").ToLocalChecked(),
+             Nan::New<Number>(config.pan_speed));
     Nan::Set(result,
-             Nan::New<String>("defaultTiltSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativePanTiltInfo.default_tilt_speed));
+             Nan::New<String>("tiltSpeed").ToLocalChecked(),
+             Nan::New<Number>(config.tilt_speed));
     Nan::Set(result,
-             Nan::New<String>("currentPanSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativePanTiltInfo.current_pan_speed));
+             Nan::New<String>("zoomSpeed").ToLocalChecked(),
+             Nan::New<Number>(config.zoom_speed));
     Nan::Set(result,
-             Nan::New<String>("currentTiltSpeed").ToLocalChecked(),
-             Nan::New<Integer>(relativePanTiltInfo.current_tilt_speed));
-
-    // cleanup
-    closeDevice(&uvcDevice);
-
-    // trigger callback
+             Nan::New<String>("firmware").ToLocalChecked(),
+             Nan::New<Number>(config.firmware));
     info.GetReturnValue().Set(result);
 }
-NAN_METHOD(relativePanTilt) {
-    Local<Object> input = Local<Object>::Cast(info[0]);
 
-    // get options
-    Local<Value> vendorId = Nan::Get(input, Nan::New<String>("vendorId").ToLocalChecked())
-                                .ToLocalChecked();
-    Local<Value> productId = Nan::Get(input, Nan::New<String>("productId").ToLocalChecked())
-                                 .ToLocalChecked();
-    Local<Value> panDirection = Nan::Get(input, Nan::New<String>("panDirection").ToLocalChecked())
-                                    .ToLocalChecked();
-    Local<Value> panSpeed = Nan::Get(input, Nan::New<String>("panSpeed").ToLocalChecked())
-                                .ToLocalChecked();
-    Local<Value> tiltDirection = Nan::Get(input, Nan::New<String>("tiltDirection").ToLocalChecked())
-                                     .ToLocalChecked();
-    Local<Value> tiltSpeed = Nan::Get(input, Nan::New<String>("tiltSpeed").ToLocalChecked())
-                                 .ToLocalChecked();
+// simulateHang(input) stops the simulated camera input names from answering
+// transfers while input.hung is true, like a wedged control endpoint
+NAN_METHOD(simulateHang) {
+    Local<Object>    input = Local<Object>::Cast(info[0]);
+    struct UVCDevice uvcDevice;
+    readDevice(input, &uvcDevice);
+    Local<Value> hung = Nan::Get(input, Nan::New<String>("hung").ToLocalChecked())
+                            .ToLocalChecked();
+    simSetHung(
+        simFindCamera(uvcDevice.vendorId, uvcDevice.productId, uvcDevice.serial, uvcDevice.port),
+        Nan::To<bool>(hung).FromMaybe(false));
+    info.GetReturnValue().Set(Nan::Undefined());
+}
 
+// simulateUnplug(input) takes the simulated camera input names off the bus
+// while input.unplugged is true. it comes back reset to home.
+NAN_METHOD(simulateUnplug) {
+    Local<Object>    input = Local<Object>::Cast(info[0]);
     struct UVCDevice uvcDevice;
-    uvcDevice.vendorId  = Nan::To<int32_t>(vendorId).FromMaybe(0);
-    uvcDevice.productId = Nan::To<int32_t>(productId).FromMaybe(0);
+    readDevice(input, &uvcDevice);
+    Local<Value> unplugged = Nan::Get(input, Nan::New<String>("unplugged").ToLocalChecked())
+                                 .ToLocalChecked();
+    simSetUnplugged(
+        simFindCamera(uvcDevice.vendorId, uvcDevice.productId, uvcDevice.serial, uvcDevice.port),
+        Nan::To<bool>(unplugged).FromMaybe(false));
+    info.GetReturnValue().Set(Nan::Undefined());
+}
 
-    // open device
-    openDevice(&uvcDevice);
-    if (uvcDevice.result != 0) {
-        Nan::ThrowError(uvcDevice.error);
-        return;
-    }
+static const char* realtimePolicyNames[] = {"other", "fifo", "rr"};
 
-    // get zoom info
-    struct RelativePanTilt relativePanTilt;
-    relativePanTilt.pan_direction  = Nan::To<int32_t>(panDirection).FromMaybe(0);
-    relativePanTilt.pan_speed      = Nan::To<int32_t>(panSpeed).FromMaybe(0);
-    relativePanTilt.tilt_direction = Nan::To<int32_t>(tiltDirection).FromMaybe(0);
-    relativePanTilt.tilt_speed     = Nan::To<int32_t>(tiltSpeed).FromMaybe(0);
-    setRelativePanTilt(&uvcDevice, &relativePanTilt);
-    if (relativePanTilt.result != 0) {
-        closeDevice(&uvcDevice);
-        Nan::ThrowError(relativePanTilt.error);
-        return;
+static Local<Value> errnoToJs(int error) {
+    if (error == 0) {
+        return Nan::Null();
     }
+    return Nan::New<String>(strerror(error)).ToLocalChecked();
+}
 
-    // cleanup
-    closeDevice(&uvcDevice);
+// scheduling for the addon's native threads, any field left out keeps its
+// current value. what the process isn't allowed comes back as an error
+// string on the result rather than a throw.
+NAN_METHOD(configureThreads) {
+    struct RealtimeStatus status;
+    realtimeGetStatus(&status);
+
+    if (info[0]->IsObject()) {
+        Local<Object>         input  = Local<Object>::Cast(info[0]);
+        struct RealtimeConfig config = {status.policy, status.priority, status.cpus,
+                                        status.memory_locked};
+        Local<Value> policy =
+            Nan::Get(input, Nan::New<String>("policy").ToLocalChecked()).ToLocalChecked();
+        if (policy->IsString()) {
+            Nan::Utf8String name(policy);
+            config.policy = REALTIME_OTHER;
+            for (int i = 0; i < 3; i++) {
+                if (strcmp(*name, realtimePolicyNames[i]) == 0) {
+                    config.policy = i;
+                }
+            }
+        }
+        config.priority = (int)readNumber(input, "priority", config.priority);
+        Local<Value> cpus =
+            Nan::Get(input, Nan::New<String>("cpus").ToLocalChecked()).ToLocalChecked();
+        if (cpus->IsArray()) {
+            Local<Array> list = Local<Array>::Cast(cpus);
+            config.cpus       = 0;
+            for (uint32_t i = 0; i < list->Length(); i++) {
+                int cpu = Nan::To<int32_t>(Nan::Get(list, i).ToLocalChecked()).FromMaybe(-1);
+                if (cpu >= 0 && cpu < 64) {
+                    config.cpus |= (uint64_t)1 << cpu;
+                }
+            }
+        }
+        config.lock_memory = readNumber(input, "lockMemory", config.lock_memory) != 0;
+        realtimeConfigure(&config, &status);
+    }
 
-    // trigger callback
-    info.GetReturnValue().Set(Nan::Undefined());
+    Local<Array> cpus = Nan::New<Array>();
+    for (int cpu = 0; cpu < 64; cpu++) {
+        if (status.cpus >> cpu & 1) {
+            Nan::Set(cpus, cpus->Length(), Nan::New<Number>(cpu));
+        }
+    }
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result,
+             Nan::New<String>("policy").ToLocalChecked(),
+             Nan::New<String>(realtimePolicyNames[status.policy]).ToLocalChecked());
+    Nan::Set(result,
+             Nan::New<String>("priority").ToLocalChecked(),
+             Nan::New<Number>(status.priority));
+    Nan::Set(result, Nan::New<String>("cpus").ToLocalChecked(), cpus);
+    Nan::Set(result,
+             Nan::New<String>("memoryLocked").ToLocalChecked(),
+             Nan::New<Boolean>(status.memory_locked));
+    Nan::Set(result,
+             Nan::New<String>("threads").ToLocalChecked(),
+             Nan::New<Number>(status.threads));
+    Nan::Set(result,
+             Nan::New<String>("policyError").ToLocalChecked(),
+             errnoToJs(status.policy_error));
+    Nan::Set(result,
+             Nan::New<String>("affinityError").ToLocalChecked(),
+             errnoToJs(status.affinity_error));
+    Nan::Set(result,
+             Nan::New<String>("lockError").ToLocalChecked(),
+             errnoToJs(status.lock_error));
+    info.GetReturnValue().Set(result);
 }
 
 NAN_MODULE_INIT(Init) {
+    startJsThread();
+
     NAN_EXPORT(target, listDevices);
     NAN_EXPORT(target, getCapabilities);
     NAN_EXPORT(target, getAbsoluteZoom);
@@ -1050,7 +2354,55 @@ NAN_MODULE_INIT(Init) {
     NAN_EXPORT(target, absolutePanTilt);
     NAN_EXPORT(target, getRelativePanTilt);
     NAN_EXPORT(target, relativePanTilt);
+    NAN_EXPORT(target, getControl);
+    NAN_EXPORT(target, setControl);
+    NAN_EXPORT(target, getRanges);
+    NAN_EXPORT(target, executeAsync);
+    NAN_EXPORT(target, executeBatch);
+    NAN_EXPORT(target, startRecording);
+    NAN_EXPORT(target, stopRecording);
+    NAN_EXPORT(target, getRecordingStats);
+    NAN_EXPORT(target, configureCamera);
+    NAN_EXPORT(target, getCameraStats);
+    NAN_EXPORT(target, cancelCamera);
+    NAN_EXPORT(target, estimatePosition);
+    NAN_EXPORT(target, openProfiles);
+    NAN_EXPORT(target, closeProfiles);
+    NAN_EXPORT(target, getProfile);
+    NAN_EXPORT(target, calibrateCamera);
+    NAN_EXPORT(target, openVelocity);
+    NAN_EXPORT(target, pushVelocity);
+    NAN_EXPORT(target, getVelocityStats);
+    NAN_EXPORT(target, closeVelocity);
+    NAN_EXPORT(target, openTracker);
+    NAN_EXPORT(target, pushTracking);
+    NAN_EXPORT(target, getTrackerStats);
+    NAN_EXPORT(target, closeTracker);
+    NAN_EXPORT(target, openPresets);
+    NAN_EXPORT(target, closePresets);
+    NAN_EXPORT(target, getPresetStats);
+    NAN_EXPORT(target, openWarmCache);
+    NAN_EXPORT(target, closeWarmCache);
+    NAN_EXPORT(target, getWarmCacheStats);
+    NAN_EXPORT(target, savePreset);
+    NAN_EXPORT(target, getPreset);
+    NAN_EXPORT(target, deletePreset);
+    NAN_EXPORT(target, listPresets);
+    NAN_EXPORT(target, recallPreset);
+    NAN_EXPORT(target, centerOn);
+    NAN_EXPORT(target, pointsToPanTilt);
+    NAN_EXPORT(target, startTour);
+    NAN_EXPORT(target, stopTour);
+    NAN_EXPORT(target, pauseTour);
+    NAN_EXPORT(target, resumeTour);
+    NAN_EXPORT(target, getTourStats);
+    NAN_EXPORT(target, runGroup);
+    NAN_EXPORT(target, getDeviceStats);
+    NAN_EXPORT(target, configureSimulator);
+    NAN_EXPORT(target, simulateHang);
+    NAN_EXPORT(target, simulateUnplug);
+    NAN_EXPORT(target, configureThreads);
 }
 
-NODE_MODULE(ptz, (node::addon_register_func)Init);
+NAN_MODULE_WORKER_ENABLED(ptz, Init)
 }  // namespace ptz
@@ -2,6 +2,7 @@
 
 const ptz = require("../build/Release/ptz");
 const Camera = require("./camera");
+const Client = require("./client");
 
 class PTZ {
   static listDevices(callback) {
@@ -16,6 +17,125 @@ class PTZ {
     options.productId = options.productId || 0;
     return new Camera(options);
   }
+
+  // a connection to a running ptzd, for cameras another process owns. its
+  // getCamera() returns cameras whose commands go through the daemon.
+  static connect(path) {
+    return new Client(path || process.env.PTZD_SOCKET || "/tmp/ptzd.sock");
+  }
+
+  static startRecording(options) {
+    if (!options) {
+      options = {};
+    }
+    options.maxBytes = options.maxBytes || 64 * 1024 * 1024;
+    options.maxFiles = options.maxFiles || 4;
+    return ptz.startRecording(options);
+  }
+
+  static stopRecording() {
+    return ptz.stopRecording();
+  }
+
+  static getRecordingStats() {
+    return ptz.getRecordingStats();
+  }
+
+  // commands are [{ camera, command: "absolutePanTilt", pan, tilt }, ...]. the
+  // cameras all start moving at the same instant. resolves, or with async
+  // false returns, { skewMs, cameras: [{ ..., error, startSkewMs, durationMs }] }.
+  // timeoutMs bounds the wait for every camera to be ready.
+  static runGroup(commands, options) {
+    const entries = commands.map((entry) => {
+      const { camera, ...command } = entry;
+      return Object.assign(command, camera.identity());
+    });
+    const timeoutMs = (options && options.timeoutMs) || 0;
+    if (options && options.async === false) {
+      return ptz.runGroup(entries, timeoutMs);
+    }
+    return new Promise((resolve, reject) => {
+      ptz.runGroup(entries, timeoutMs, (err, result) => {
+        if (err) {
+          return reject(err);
+        }
+        resolve(result);
+      });
+    });
+  }
+
+  static openPresets(options) {
+    if (typeof options === "string") {
+      options = { path: options };
+    }
+    options = Object.assign({ capacity: 4096 }, options);
+    return ptz.openPresets(options);
+  }
+
+  static closePresets() {
+    return ptz.closePresets();
+  }
+
+  static getPresetStats() {
+    return ptz.getPresetStats();
+  }
+
+  // capabilities, ranges and last positions of every camera, so reads after
+  // a restart are answered at once and checked against the camera behind
+  static openWarmCache(options) {
+    if (typeof options === "string") {
+      options = { path: options };
+    }
+    options = Object.assign({ capacity: 256 }, options);
+    return ptz.openWarmCache(options);
+  }
+
+  static closeWarmCache() {
+    return ptz.closeWarmCache();
+  }
+
+  static getWarmCacheStats() {
+    return ptz.getWarmCacheStats();
+  }
+
+  // measured camera speeds, loaded from path and picked up by each camera
+  // as it is next used
+  static openProfiles(options) {
+    if (typeof options === "string") {
+      options = { path: options };
+    }
+    return ptz.openProfiles(options);
+  }
+
+  static closeProfiles() {
+    return ptz.closeProfiles();
+  }
+
+  static getDeviceStats() {
+    return ptz.getDeviceStats();
+  }
+
+  static configureSimulator(options) {
+    return ptz.configureSimulator(options);
+  }
+
+  // stop a simulated camera answering its transfers, the way a wedged one
+  // does, or with hung false let it answer again
+  static simulateHang(camera, hung) {
+    return ptz.simulateHang(Object.assign({ hung: hung !== false }, camera.identity()));
+  }
+
+  // take a simulated camera off the bus, or with unplugged false plug it
+  // back in, reset to home
+  static simulateUnplug(camera, unplugged) {
+    return ptz.simulateUnplug(
+      Object.assign({ unplugged: unplugged !== false }, camera.identity())
+    );
+  }
+
+  static configureThreads(options) {
+    return ptz.configureThreads(options);
+  }
 }
 
 module.exports = PTZ;
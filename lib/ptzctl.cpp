@@ -0,0 +1,1132 @@
+/*
+   ptzctl: scripted control and load generation against one or many cameras.
+
+   ptzctl --sim 4 --rate 400 --duration 30 script.txt
+   ptzctl --device 0x54c:0xb7f --command "getAbsolutePanTilt" --rate 0 --count 1000
+   ptzctl --device 0x54c:0xb7f --replay capture.txt --speed 2
+
+   script lines are "[@camera] command [args...]", replay lines are prefixed
+   with a time offset in milliseconds. commands use the addon's names, e.g.
+   "absolutePanTilt 36000 0" or "relativeZoom 1 3". lines starting with # are
+   ignored. commands without @camera are spread round-robin over the cameras
+   when paced; with --rate 0 every camera runs all of them.
+
+   --record captures every command and its result into the addon's binary
+   format; --replay accepts those captures as well as text files, mapping each
+   recorded vendor/product to a camera in order of first appearance.
+
+   ptzctl --jitter 10 --jitter-load 4 --rt-policy fifo --rt-priority 80 --cpus 2
+
+   --jitter measures how late a periodic control thread wakes, first under the
+   default scheduler and then under the --rt-* / --cpus / --mlock settings,
+   which also apply to the worker threads of a normal run.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "command.h"
+#include "device.h"
+#include "error.h"
+#include "realtime.h"
+#include "recorder.h"
+#include "session.h"
+#include "simulator.h"
+#include "stats.h"
+
+using namespace ptz;
+
+#define SIM_VENDOR_ID 0x5054
+#define MAX_QUEUE_DEPTH 100000
+
+struct ScriptEntry {
+    uint64_t       at;      // offset from start in nanoseconds, replay only
+    int            camera;  // -1 for every camera
+    struct Command command;
+};
+
+struct Job {
+    struct Command command;
+    uint64_t       scheduled;  // when the command should have been sent, 0 when unpaced
+};
+
+struct Target {
+    struct UVCDevice        device;
+    int                     open;
+    std::mutex              mutex;
+    std::condition_variable ready;
+    std::deque<struct Job>  jobs;
+    int                     done;
+    uint64_t                completed;
+    uint64_t                failed;
+    uint64_t                dropped;
+    std::map<int, uint64_t> errors;
+    struct LatencyHistogram latency;  // scheduled send to completion
+    struct LatencyHistogram service;  // time spent on the bus
+    struct LatencyHistogram perCommand[CMD_COUNT];
+};
+
+struct Options {
+    double   rate;
+    uint64_t count;
+    double   duration;
+    double   speed;
+    int      reopen;
+    int      verbose;
+    int      replay;
+    uint32_t timeoutMs;
+};
+
+static std::atomic<int>      stopRequested(0);
+static std::atomic<uint64_t> closedLoopIssued(0);
+
+static void onSignal(int signal) {
+    stopRequested = 1;
+}
+
+// a command as scripts spell it
+static void commandName(int op, char* out, size_t size) {
+    int control = commandControl(op);
+    if (control < 0) {
+        snprintf(out, size, "%s", commandSpec(op)->name);
+    } else {
+        snprintf(out, size, "%s %s", commandSpec(op)->name, controlSpecs[control].name);
+    }
+}
+
+static void usage(FILE* out) {
+    fprintf(out,
+            "usage: ptzctl [options] [script]\n"
+            "\n"
+            "targets\n"
+            "  -d, --device VID:PID     drive a real camera (repeatable), add @SERIAL or\n"
+            "                           @port:1-2.3 to pick one of several identical ones\n"
+            "  -s, --sim N              drive N simulated cameras\n"
+            "\n"
+            "load\n"
+            "  -c, --command \"CMD ...\"  append a command to the script (repeatable)\n"
+            "  -r, --rate N             commands per second across all cameras, 0 for\n"
+            "                           as fast as the cameras allow (default 0)\n"
+            "  -n, --count N            stop after N commands\n"
+            "  -t, --duration SEC       stop after SEC seconds (default 10)\n"
+            "  -p, --replay FILE        replay a timed command file\n"
+            "  -x, --speed X            replay speed multiplier, 0 for as fast as possible\n"
+            "  -o, --reopen             open and close the device around every command,\n"
+            "                           like the node addon does\n"
+            "      --timeout MS         longest a command may take on the camera, 0 waits\n"
+            "                           forever (default 2000, as in the addon)\n"
+            "\n"
+            "capture\n"
+            "  -w, --record FILE        capture every command to a binary file\n"
+            "      --record-size BYTES  size of each capture file (default 64M)\n"
+            "      --record-files N     capture files kept while rotating (default 4)\n"
+            "      --dump FILE          print a binary capture as a replay file and exit\n"
+            "\n"
+            "simulation\n"
+            "      --sim-latency US     control transfer latency (default 1000)\n"
+            "      --sim-jitter US      control transfer jitter (default 200)\n"
+            "      --sim-open US        device open latency (default 2000)\n"
+            "      --sim-errors RATE    fraction of transfers that fail (default 0)\n"
+            "\n"
+            "scheduling\n"
+            "      --rt-policy POLICY   fifo, rr or other for the control threads\n"
+            "      --rt-priority N      real time priority, 1-99 (default 50)\n"
+            "      --cpus LIST          pin control threads to cpus, e.g. 2,3 or 2-3\n"
+            "      --mlock              lock the process' memory\n"
+            "      --jitter SEC         measure wakeup lateness with and without the\n"
+            "                           settings above and exit\n"
+            "      --jitter-period US   wakeup period (default 1000)\n"
+            "      --jitter-load N      busy threads competing for the cpus (default 0)\n"
+            "\n"
+            "  -v, --verbose            print every command result\n"
+            "  -h, --help\n");
+}
+
+// "2,3", "2-3" or a mix, into a bit per cpu
+static int parseCpus(const char* text, uint64_t* cpus) {
+    *cpus = 0;
+    while (*text != 0) {
+        char* end;
+        long  first = strtol(text, &end, 10);
+        long  last  = first;
+        if (end == text) {
+            return -1;
+        }
+        if (*end == '-') {
+            text = end + 1;
+            last = strtol(text, &end, 10);
+            if (end == text) {
+                return -1;
+            }
+        }
+        if (first < 0 || last > 63 || first > last) {
+            return -1;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            *cpus |= (uint64_t)1 << cpu;
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end != 0) {
+            return -1;
+        }
+        text = end;
+    }
+    return *cpus != 0 ? 0 : -1;
+}
+
+// "VID:PID", "VID:PID@SERIAL" or "VID:PID@port:1-2.3"
+static int parseDevice(const char* text, struct UVCDevice* device) {
+    char* end;
+    memset(device, 0, sizeof(*device));
+    device->vendorId = (int)strtol(text, &end, 0);
+    if (*end != ':') {
+        return -1;
+    }
+    device->productId = (int)strtol(end + 1, &end, 0);
+    if (*end == '@') {
+        if (strncmp(end + 1, "port:", 5) == 0) {
+            snprintf(device->port, sizeof(device->port), "%s", end + 6);
+        } else {
+            snprintf(device->serial, sizeof(device->serial), "%s", end + 1);
+        }
+        return 0;
+    }
+    return *end == '\0' ? 0 : -1;
+}
+
+// parse "[time] [@camera] command [args...]"
+static int parseLine(char* line, int timed, struct ScriptEntry* entry, char* error) {
+    char* tokens[8];
+    int   count = 0;
+    for (char* token = strtok(line, " \t\r\n"); token != NULL && count < 8;
+         token       = strtok(NULL, " \t\r\n")) {
+        tokens[count++] = token;
+    }
+    if (count == 0 || tokens[0][0] == '#') {
+        return 0;
+    }
+
+    int index     = 0;
+    entry->at     = 0;
+    entry->camera = -1;
+    if (timed) {
+        char*  end;
+        double ms = strtod(tokens[index], &end);
+        if (*end != '\0' || ms < 0) {
+            sprintf(error, "expected a time offset in ms, got '%s'", tokens[index]);
+            return -1;
+        }
+        entry->at = (uint64_t)(ms * 1e6);
+        index++;
+    }
+    if (index < count && tokens[index][0] == '@') {
+        entry->camera = atoi(tokens[index] + 1);
+        index++;
+    }
+    if (index >= count) {
+        sprintf(error, "missing command");
+        return -1;
+    }
+
+    // control commands name their control next, "setControl focusAbsolute 120"
+    int op = commandFind(tokens[index]);
+    if (op < 0 && index + 1 < count) {
+        op = commandFindControl(tokens[index], tokens[index + 1]);
+        index += op >= 0 ? 1 : 0;
+    }
+    if (op < 0) {
+        sprintf(error, "unknown command '%s'", tokens[index]);
+        return -1;
+    }
+    const struct CommandSpec* spec = commandSpec(op);
+    if (count - index - 1 != spec->argCount) {
+        sprintf(error, "%s takes %d arguments", tokens[index], spec->argCount);
+        return -1;
+    }
+    memset(&entry->command, 0, sizeof(entry->command));
+    entry->command.op = (uint8_t)op;
+    for (int i = 0; i < spec->argCount; i++) {
+        entry->command.args[i] = (int32_t)strtol(tokens[index + 1 + i], NULL, 0);
+    }
+    return 1;
+}
+
+static int loadScript(const char* path, int timed, std::vector<struct ScriptEntry>* script) {
+    FILE* file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "ptzctl: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char line[512];
+    char error[128];
+    int  number = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        number++;
+        struct ScriptEntry entry;
+        int                parsed = parseLine(line, timed, &entry, error);
+        if (parsed < 0) {
+            fprintf(stderr, "ptzctl: %s:%d: %s\n", path, number, error);
+            if (file != stdin) {
+                fclose(file);
+            }
+            return -1;
+        }
+        if (parsed > 0) {
+            script->push_back(entry);
+        }
+    }
+    if (file != stdin) {
+        fclose(file);
+    }
+    return 0;
+}
+
+// recorded cameras become @0, @1, ... in order of first appearance
+// identical cameras are told apart by the serial and port they were
+// addressed by, and a simulated camera never merges with a real one
+static uint64_t captureCamera(const struct RecordEntry& record) {
+    return (uint64_t)record.vendorId << 48 | (uint64_t)record.productId << 32 |
+           (uint64_t)record.camera << 16 | (record.flags & RECORD_SIMULATED);
+}
+
+static void loadCapture(const std::vector<struct RecordEntry>* entries,
+                        std::vector<struct ScriptEntry>*        script) {
+    // records land in completion order, so start times are only nearly sorted
+    uint64_t first = UINT64_MAX;
+    for (const struct RecordEntry& record : *entries) {
+        first = record.timestamp < first ? record.timestamp : first;
+    }
+
+    std::map<uint64_t, int> cameras;
+    for (const struct RecordEntry& record : *entries) {
+        const struct CommandSpec* spec = commandSpec(record.op);
+        if (spec == NULL) {
+            continue;
+        }
+        uint64_t key    = captureCamera(record);
+        auto     camera = cameras.find(key);
+        if (camera == cameras.end()) {
+            camera = cameras.insert(std::make_pair(key, (int)cameras.size())).first;
+        }
+
+        struct ScriptEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.at         = record.timestamp - first;
+        entry.camera     = camera->second;
+        entry.command.op = record.op;
+        if (!(record.flags & RECORD_READ_VALUES)) {
+            memcpy(entry.command.args, record.args, sizeof(entry.command.args));
+        }
+        script->push_back(entry);
+    }
+}
+
+static int dumpCapture(const char* path) {
+    struct RecordHeader             header;
+    std::vector<struct RecordEntry> entries;
+    int                             error = recordLoad(path, &header, &entries);
+    if (error != 0) {
+        fprintf(stderr,
+                "ptzctl: %s: %s\n",
+                path,
+                error == EINVAL ? "not a ptz capture" : strerror(error));
+        return 1;
+    }
+
+    time_t started = (time_t)(header.realtimeBase / 1000000000ull);
+    printf("# %s: %llu of %llu records, started %s",
+           path,
+           (unsigned long long)entries.size(),
+           (unsigned long long)header.capacity,
+           ctime(&started));
+
+    std::map<uint64_t, int> cameras;
+    for (const struct RecordEntry& record : entries) {
+        uint64_t key = captureCamera(record);
+        if (cameras.find(key) == cameras.end()) {
+            printf("# @%d is %04x:%04x camera %04x%s\n",
+                   (int)cameras.size(),
+                   record.vendorId,
+                   record.productId,
+                   record.camera,
+                   record.flags & RECORD_SIMULATED ? ", simulated" : "");
+            cameras[key] = (int)cameras.size();
+        }
+    }
+
+    uint64_t first = UINT64_MAX;
+    for (const struct RecordEntry& record : entries) {
+        first = record.timestamp < first ? record.timestamp : first;
+    }
+    for (const struct RecordEntry& record : entries) {
+        const struct CommandSpec* spec = commandSpec(record.op);
+        if (spec == NULL) {
+            continue;
+        }
+        uint64_t key  = captureCamera(record);
+        int      read = record.flags & RECORD_READ_VALUES;
+        char     name[64];
+        commandName(record.op, name, sizeof(name));
+        printf("%.6f @%d %s", (double)(record.timestamp - first) / 1e6, cameras[key], name);
+        for (int i = 0; !read && i < spec->argCount; i++) {
+            printf(" %d", record.args[i]);
+        }
+        printf("  # %.3f ms", (double)record.duration / 1e6);
+        if (record.result != 0) {
+            printf(" %s", errorMessage((uvc_error_t)record.result));
+        } else if (read) {
+            printf(" -> %d %d %d %d",
+                   record.args[0],
+                   record.args[1],
+                   record.args[2],
+                   record.args[3]);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+static void printResult(int index, const struct Command* command, const struct CommandResult* r) {
+    const struct CommandSpec* spec = commandSpec(command->op);
+    char                      name[64];
+    commandName(command->op, name, sizeof(name));
+    if (r->result != 0) {
+        printf("[%d] %s: %s\n", index, name, errorMessage(r->result));
+        return;
+    }
+    int control = commandControl(command->op);
+    if (control >= 0 && commandControlRequest(command->op) == CONTROL_GET) {
+        const struct ControlSpec* controlSpec = &controlSpecs[control];
+        printf("[%d] %s:", index, name);
+        for (int i = 0; i < controlFieldCount(*controlSpec); i++) {
+            printf(" %s=%d", controlSpec->fields[i].name, r->controlValues.values[i]);
+        }
+        printf("\n");
+        return;
+    }
+    switch (command->op) {
+        case CMD_GET_CAPABILITIES:
+            printf("[%d] %s: absoluteZoom=%d relativeZoom=%d absolutePanTilt=%d "
+                   "relativePanTilt=%d absoluteRoll=%d relativeRoll=%d\n",
+                   index,
+                   spec->name,
+                   r->capability.absolute_zoom,
+                   r->capability.relative_zoom,
+                   r->capability.absolute_pan_tilt,
+                   r->capability.relative_pan_tilt,
+                   r->capability.absolute_roll,
+                   r->capability.relative_roll);
+            break;
+        case CMD_GET_ABSOLUTE_ZOOM:
+            printf("[%d] %s: current=%d min=%d max=%d resolution=%d\n",
+                   index,
+                   spec->name,
+                   r->absoluteZoomInfo.current,
+                   r->absoluteZoomInfo.min,
+                   r->absoluteZoomInfo.max,
+                   r->absoluteZoomInfo.resolution);
+            break;
+        case CMD_GET_RELATIVE_ZOOM:
+            printf("[%d] %s: direction=%d speed=%d min=%d max=%d\n",
+                   index,
+                   spec->name,
+                   r->relativeZoomInfo.direction,
+                   r->relativeZoomInfo.current_speed,
+                   r->relativeZoomInfo.min_speed,
+                   r->relativeZoomInfo.max_speed);
+            break;
+        case CMD_GET_ABSOLUTE_PAN_TILT:
+            printf("[%d] %s: pan=%d tilt=%d\n",
+                   index,
+                   spec->name,
+                   r->absolutePanTiltInfo.current_pan,
+                   r->absolutePanTiltInfo.current_tilt);
+            break;
+        case CMD_GET_RELATIVE_PAN_TILT:
+            printf("[%d] %s: pan=%d/%d tilt=%d/%d\n",
+                   index,
+                   spec->name,
+                   r->relativePanTiltInfo.pan_direction,
+                   r->relativePanTiltInfo.current_pan_speed,
+                   r->relativePanTiltInfo.tilt_direction,
+                   r->relativePanTiltInfo.current_tilt_speed);
+            break;
+        default:
+            printf("[%d] %s: ok\n", index, name);
+            break;
+    }
+}
+
+static void runJob(struct Target*    target,
+                   int               index,
+                   const struct Job* job,
+                   const Options*    options) {
+    struct CommandResult result;
+    uint64_t             start = monotonicNanos();
+
+    // a camera that stops answering fails the command rather than the worker
+    target->device.deadline =
+        options->timeoutMs != 0 ? start + (uint64_t)options->timeoutMs * 1000000 : 0;
+    if (options->reopen) {
+        runCommand(&target->device, &job->command, &result);
+    } else {
+        executeCommand(&target->device, &job->command, &result);
+    }
+
+    uint64_t end = monotonicNanos();
+    if (!options->reopen && recorderActive()) {
+        recorderAppend(&target->device, &job->command, &result, start, end);
+    }
+    histogramRecord(&target->service, end - start);
+    histogramRecord(&target->latency, end - (job->scheduled != 0 ? job->scheduled : start));
+    histogramRecord(&target->perCommand[job->command.op], end - start);
+    target->completed++;
+    if (result.result != 0) {
+        target->failed++;
+        target->errors[result.result]++;
+    }
+    if (options->verbose) {
+        printResult(index, &job->command, &result);
+    }
+}
+
+// drains the target's queue until the dispatcher is done
+static void queueWorker(struct Target* target, int index, const Options* options) {
+    realtimeEnter();
+    while (true) {
+        struct Job job;
+        {
+            std::unique_lock<std::mutex> lock(target->mutex);
+            target->ready.wait(lock, [target] { return !target->jobs.empty() || target->done; });
+            if (target->jobs.empty()) {
+                break;
+            }
+            job = target->jobs.front();
+            target->jobs.pop_front();
+        }
+        runJob(target, index, &job, options);
+    }
+    realtimeLeave();
+}
+
+// issues this target's lines of the script back to back: those naming it
+// and every line naming no camera
+static void closedLoopWorker(struct Target*                          target,
+                             int                                     index,
+                             int                                     targetCount,
+                             const std::vector<struct ScriptEntry>* script,
+                             uint64_t                                deadline,
+                             const Options*                          options) {
+    std::vector<struct Command> mine;
+    for (size_t i = 0; i < script->size(); i++) {
+        int camera = (*script)[i].camera;
+        if (camera < 0 || camera % targetCount == index) {
+            mine.push_back((*script)[i].command);
+        }
+    }
+    if (mine.empty()) {
+        return;
+    }
+
+    realtimeEnter();
+    for (size_t i = 0; !stopRequested && monotonicNanos() < deadline; i++) {
+        if (++closedLoopIssued > options->count) {
+            break;
+        }
+        struct Job job;
+        job.command   = mine[i % mine.size()];
+        job.scheduled = 0;
+        runJob(target, index, &job, options);
+    }
+    realtimeLeave();
+}
+
+static void enqueue(struct Target* target, const struct Command* command, uint64_t scheduled) {
+    std::lock_guard<std::mutex> lock(target->mutex);
+    if (target->jobs.size() >= MAX_QUEUE_DEPTH) {
+        target->dropped++;
+        return;
+    }
+    struct Job job;
+    job.command   = *command;
+    job.scheduled = scheduled;
+    target->jobs.push_back(job);
+    target->ready.notify_one();
+}
+
+static double ms(uint64_t nanos) {
+    return (double)nanos / 1e6;
+}
+
+static void printHistogram(const char* label, const struct LatencyHistogram* h) {
+    printf("%-14s p50 %8.3f  p90 %8.3f  p99 %8.3f  p99.9 %8.3f  max %8.3f  mean %8.3f\n",
+           label,
+           ms(histogramPercentile(h, 50)),
+           ms(histogramPercentile(h, 90)),
+           ms(histogramPercentile(h, 99)),
+           ms(histogramPercentile(h, 99.9)),
+           ms(h->max),
+           ms(histogramMean(h)));
+}
+
+// a control loop that does nothing but wake on schedule, recording how late
+static void jitterLoop(uint64_t period, uint64_t deadline, struct LatencyHistogram* lateness) {
+    realtimeEnter();
+    uint64_t next = monotonicNanos();
+    while (!stopRequested) {
+        next += period;
+        if (next >= deadline) {
+            break;
+        }
+        sleepUntil(next);
+        uint64_t now = monotonicNanos();
+        histogramRecord(lateness, now > next ? now - next : 0);
+    }
+    realtimeLeave();
+}
+
+static void spin(uint64_t deadline) {
+    while (!stopRequested && monotonicNanos() < deadline) {
+    }
+}
+
+static void jitterPhase(const char*              label,
+                        uint64_t                 period,
+                        double                   seconds,
+                        int                      load,
+                        struct LatencyHistogram* lateness) {
+    histogramReset(lateness);
+    uint64_t                 deadline = monotonicNanos() + (uint64_t)(seconds * 1e9);
+    std::vector<std::thread> spinners;
+    for (int i = 0; i < load; i++) {
+        spinners.push_back(std::thread(spin, deadline));
+    }
+    std::thread loop(jitterLoop, period, deadline, lateness);
+    loop.join();
+    for (std::thread& spinner : spinners) {
+        spinner.join();
+    }
+    printHistogram(label, lateness);
+}
+
+static int runJitter(double seconds, uint32_t periodUs, int load, const RealtimeConfig* config) {
+    static const char* policies[] = {"other", "fifo", "rr"};
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    struct LatencyHistogram lateness;
+    printf("wakeup lateness every %u us for %.1f s, %d busy thread(s)\n\n",
+           periodUs,
+           seconds / 2,
+           load);
+    jitterPhase("default (ms)", (uint64_t)periodUs * 1000, seconds / 2, load, &lateness);
+
+    struct RealtimeStatus status;
+    realtimeConfigure(config, &status);
+    jitterPhase("realtime (ms)", (uint64_t)periodUs * 1000, seconds / 2, load, &lateness);
+
+    printf("\npolicy %s priority %d", policies[status.policy], status.priority);
+    if (status.policy_error != 0) {
+        printf(" (%s asked for: %s)", policies[config->policy], strerror(status.policy_error));
+    }
+    printf(", cpus %s", status.cpus != 0 ? "pinned" : "any");
+    if (status.affinity_error != 0) {
+        printf(" (%s)", strerror(status.affinity_error));
+    }
+    printf(", memory %s", status.memory_locked ? "locked" : "unlocked");
+    if (status.lock_error != 0) {
+        printf(" (%s)", strerror(status.lock_error));
+    }
+    printf("\n");
+    return 0;
+}
+
+static void report(std::vector<struct Target*>* targets, uint64_t sent, uint64_t elapsed) {
+    struct LatencyHistogram latency;
+    struct LatencyHistogram service;
+    struct LatencyHistogram perCommand[CMD_COUNT];
+    histogramReset(&latency);
+    histogramReset(&service);
+    for (int op = 0; op < CMD_COUNT; op++) {
+        histogramReset(&perCommand[op]);
+    }
+
+    uint64_t                completed = 0;
+    uint64_t                failed    = 0;
+    uint64_t                dropped   = 0;
+    std::map<int, uint64_t> errors;
+    for (struct Target* target : *targets) {
+        histogramMerge(&latency, &target->latency);
+        histogramMerge(&service, &target->service);
+        for (int op = 0; op < CMD_COUNT; op++) {
+            histogramMerge(&perCommand[op], &target->perCommand[op]);
+        }
+        completed += target->completed;
+        failed += target->failed;
+        dropped += target->dropped;
+        for (auto& error : target->errors) {
+            errors[error.first] += error.second;
+        }
+    }
+
+    double seconds = (double)elapsed / 1e9;
+    printf("\nsent %llu, completed %llu, errors %llu, dropped %llu in %.3f s\n",
+           (unsigned long long)sent,
+           (unsigned long long)completed,
+           (unsigned long long)failed,
+           (unsigned long long)dropped,
+           seconds);
+    printf("throughput %.1f commands/s\n\n", seconds > 0 ? (double)completed / seconds : 0.0);
+    printHistogram("latency (ms)", &latency);
+    printHistogram("service (ms)", &service);
+
+    printf("\n%-32s %10s %10s %10s %10s\n", "command", "count", "p50 ms", "p99 ms", "max ms");
+    for (int op = 0; op < CMD_COUNT; op++) {
+        if (perCommand[op].count == 0) {
+            continue;
+        }
+        char name[64];
+        commandName(op, name, sizeof(name));
+        printf("%-32s %10llu %10.3f %10.3f %10.3f\n",
+               name,
+               (unsigned long long)perCommand[op].count,
+               ms(histogramPercentile(&perCommand[op], 50)),
+               ms(histogramPercentile(&perCommand[op], 99)),
+               ms(perCommand[op].max));
+    }
+
+    printf("\n%-8s %-11s %10s %8s %10s %10s %10s\n",
+           "camera",
+           "device",
+           "completed",
+           "errors",
+           "cmd/s",
+           "p50 ms",
+           "p99 ms");
+    for (size_t i = 0; i < targets->size(); i++) {
+        struct Target* target = (*targets)[i];
+        char           device[16];
+        snprintf(device,
+                 sizeof(device),
+                 "%04x:%04x",
+                 target->device.vendorId & 0xffff,
+                 target->device.productId & 0xffff);
+        printf("%-8d %-11s %10llu %8llu %10.1f %10.3f %10.3f\n",
+               (int)i,
+               device,
+               (unsigned long long)target->completed,
+               (unsigned long long)target->failed,
+               seconds > 0 ? (double)target->completed / seconds : 0.0,
+               ms(histogramPercentile(&target->latency, 50)),
+               ms(histogramPercentile(&target->latency, 99)));
+    }
+
+    if (!errors.empty()) {
+        printf("\nerrors\n");
+        for (auto& error : errors) {
+            printf("  %6d %-40s %10llu\n",
+                   error.first,
+                   errorMessage((uvc_error_t)error.first),
+                   (unsigned long long)error.second);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    enum {
+        OPT_SIM_LATENCY = 256,
+        OPT_SIM_JITTER,
+        OPT_SIM_OPEN,
+        OPT_SIM_ERRORS,
+        OPT_RECORD_SIZE,
+        OPT_RECORD_FILES,
+        OPT_DUMP,
+        OPT_RT_POLICY,
+        OPT_RT_PRIORITY,
+        OPT_CPUS,
+        OPT_MLOCK,
+        OPT_JITTER,
+        OPT_JITTER_PERIOD,
+        OPT_JITTER_LOAD,
+        OPT_TIMEOUT
+    };
+    static const struct option longOptions[] = {
+        {"device", required_argument, NULL, 'd'},
+        {"sim", required_argument, NULL, 's'},
+        {"command", required_argument, NULL, 'c'},
+        {"rate", required_argument, NULL, 'r'},
+        {"count", required_argument, NULL, 'n'},
+        {"duration", required_argument, NULL, 't'},
+        {"replay", required_argument, NULL, 'p'},
+        {"speed", required_argument, NULL, 'x'},
+        {"reopen", no_argument, NULL, 'o'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"help", no_argument, NULL, 'h'},
+        {"sim-latency", required_argument, NULL, OPT_SIM_LATENCY},
+        {"sim-jitter", required_argument, NULL, OPT_SIM_JITTER},
+        {"sim-open", required_argument, NULL, OPT_SIM_OPEN},
+        {"sim-errors", required_argument, NULL, OPT_SIM_ERRORS},
+        {"record", required_argument, NULL, 'w'},
+        {"record-size", required_argument, NULL, OPT_RECORD_SIZE},
+        {"record-files", required_argument, NULL, OPT_RECORD_FILES},
+        {"dump", required_argument, NULL, OPT_DUMP},
+        {"rt-policy", required_argument, NULL, OPT_RT_POLICY},
+        {"rt-priority", required_argument, NULL, OPT_RT_PRIORITY},
+        {"cpus", required_argument, NULL, OPT_CPUS},
+        {"mlock", no_argument, NULL, OPT_MLOCK},
+        {"jitter", required_argument, NULL, OPT_JITTER},
+        {"jitter-period", required_argument, NULL, OPT_JITTER_PERIOD},
+        {"jitter-load", required_argument, NULL, OPT_JITTER_LOAD},
+        {"timeout", required_argument, NULL, OPT_TIMEOUT},
+        {NULL, 0, NULL, 0}};
+
+    Options options;
+    memset(&options, 0, sizeof(options));
+    options.count     = UINT64_MAX;
+    options.duration  = -1;
+    options.speed     = 1;
+    options.timeoutMs = SESSION_TIMEOUT_MS;
+
+    struct SimConfig simConfig;
+    simGetConfig(&simConfig);
+
+    struct RecorderConfig recorderConfig;
+    recorderConfig.path     = NULL;
+    recorderConfig.maxBytes = 64 << 20;
+    recorderConfig.maxFiles = 4;
+
+    struct RealtimeConfig realtimeConfig = {REALTIME_OTHER, 50, 0, 0};
+    int                   realtime       = 0;
+    double                jitterSeconds  = 0;
+    uint32_t              jitterPeriodUs = 1000;
+    int                   jitterLoad     = 0;
+
+    std::vector<struct UVCDevice>   devices;
+    std::vector<struct ScriptEntry> script;
+    const char*                     replayPath = NULL;
+    int                             simCount   = 0;
+    char                            error[128];
+
+    int option;
+    while ((option = getopt_long(argc, argv, "d:s:c:r:n:t:p:x:ow:vh", longOptions, NULL)) != -1) {
+        switch (option) {
+            case 'd': {
+                struct UVCDevice device;
+                if (parseDevice(optarg, &device) != 0) {
+                    fprintf(stderr, "ptzctl: bad device '%s', expected VID:PID[@SERIAL]\n", optarg);
+                    return 1;
+                }
+                devices.push_back(device);
+                break;
+            }
+            case 's':
+                simCount = atoi(optarg);
+                break;
+            case 'c': {
+                char               line[512];
+                struct ScriptEntry entry;
+                snprintf(line, sizeof(line), "%s", optarg);
+                if (parseLine(line, 0, &entry, error) <= 0) {
+                    fprintf(stderr, "ptzctl: --command '%s': %s\n", optarg, error);
+                    return 1;
+                }
+                script.push_back(entry);
+                break;
+            }
+            case 'r':
+                options.rate = atof(optarg);
+                break;
+            case 'n':
+                options.count = strtoull(optarg, NULL, 10);
+                break;
+            case 't':
+                options.duration = atof(optarg);
+                break;
+            case 'p':
+                replayPath     = optarg;
+                options.replay = 1;
+                break;
+            case 'x':
+                options.speed = atof(optarg);
+                break;
+            case 'o':
+                options.reopen = 1;
+                break;
+            case OPT_TIMEOUT:
+                options.timeoutMs = (uint32_t)atoi(optarg);
+                break;
+            case 'v':
+                options.verbose = 1;
+                break;
+            case 'h':
+                usage(stdout);
+                return 0;
+            case OPT_SIM_LATENCY:
+                simConfig.transfer_latency_us = (uint32_t)atoi(optarg);
+                break;
+            case OPT_SIM_JITTER:
+                simConfig.transfer_jitter_us = (uint32_t)atoi(optarg);
+                break;
+            case OPT_SIM_OPEN:
+                simConfig.open_latency_us = (uint32_t)atoi(optarg);
+                break;
+            case OPT_SIM_ERRORS:
+                simConfig.error_rate = atof(optarg);
+                break;
+            case 'w':
+                recorderConfig.path = optarg;
+                break;
+            case OPT_RECORD_SIZE:
+                recorderConfig.maxBytes = strtoull(optarg, NULL, 0);
+                break;
+            case OPT_RECORD_FILES:
+                recorderConfig.maxFiles = (uint32_t)atoi(optarg);
+                break;
+            case OPT_DUMP:
+                return dumpCapture(optarg);
+            case OPT_RT_POLICY:
+                if (strcmp(optarg, "fifo") == 0) {
+                    realtimeConfig.policy = REALTIME_FIFO;
+                } else if (strcmp(optarg, "rr") == 0) {
+                    realtimeConfig.policy = REALTIME_RR;
+                } else if (strcmp(optarg, "other") == 0) {
+                    realtimeConfig.policy = REALTIME_OTHER;
+                } else {
+                    fprintf(stderr,
+                            "ptzctl: bad policy '%s', expected fifo, rr or other\n",
+                            optarg);
+                    return 1;
+                }
+                realtime = 1;
+                break;
+            case OPT_RT_PRIORITY:
+                realtimeConfig.priority = atoi(optarg);
+                realtime                = 1;
+                break;
+            case OPT_CPUS:
+                if (parseCpus(optarg, &realtimeConfig.cpus) != 0) {
+                    fprintf(stderr, "ptzctl: bad cpu list '%s'\n", optarg);
+                    return 1;
+                }
+                realtime = 1;
+                break;
+            case OPT_MLOCK:
+                realtimeConfig.lock_memory = 1;
+                realtime                   = 1;
+                break;
+            case OPT_JITTER:
+                jitterSeconds = atof(optarg);
+                break;
+            case OPT_JITTER_PERIOD:
+                jitterPeriodUs = (uint32_t)atoi(optarg);
+                break;
+            case OPT_JITTER_LOAD:
+                jitterLoad = atoi(optarg);
+                break;
+            default:
+                usage(stderr);
+                return 1;
+        }
+    }
+    simSetConfig(&simConfig);
+
+    if (jitterSeconds > 0) {
+        return runJitter(jitterSeconds, std::max(jitterPeriodUs, 1u), jitterLoad, &realtimeConfig);
+    }
+    if (realtime) {
+        struct RealtimeStatus status;
+        realtimeConfigure(&realtimeConfig, &status);
+        if (status.policy_error != 0 || status.affinity_error != 0 || status.lock_error != 0) {
+            fprintf(stderr,
+                    "ptzctl: scheduling partly applied: %s\n",
+                    strerror(status.policy_error != 0     ? status.policy_error
+                             : status.affinity_error != 0 ? status.affinity_error
+                                                          : status.lock_error));
+        }
+    }
+
+    if (replayPath != NULL) {
+        if (!script.empty() || optind < argc) {
+            fprintf(stderr, "ptzctl: --replay cannot be combined with a script\n");
+            return 1;
+        }
+        struct RecordHeader             header;
+        std::vector<struct RecordEntry> entries;
+        int                             error = recordLoad(replayPath, &header, &entries);
+        if (error == 0) {
+            loadCapture(&entries, &script);
+        } else if (error != EINVAL || loadScript(replayPath, 1, &script) != 0) {
+            if (error != EINVAL) {
+                fprintf(stderr, "ptzctl: %s: %s\n", replayPath, strerror(error));
+            }
+            return 1;
+        }
+        std::stable_sort(script.begin(),
+                         script.end(),
+                         [](const struct ScriptEntry& a, const struct ScriptEntry& b) {
+                             return a.at < b.at;
+                         });
+    } else if (optind < argc && loadScript(argv[optind], 0, &script) != 0) {
+        return 1;
+    }
+    if (script.empty()) {
+        fprintf(stderr, "ptzctl: nothing to do, give a script, --command or --replay\n");
+        return 1;
+    }
+    if (devices.empty() && simCount == 0) {
+        fprintf(stderr, "ptzctl: no cameras, use --device or --sim\n");
+        return 1;
+    }
+    if (options.duration < 0) {
+        options.duration = options.replay || options.count != UINT64_MAX ? 0 : 10;
+    }
+
+    // set up targets, keeping devices open unless asked to mimic the addon
+    std::vector<struct Target*> targets;
+    for (auto& device : devices) {
+        struct Target* target = new Target();
+        target->device        = device;
+        targets.push_back(target);
+    }
+    for (int i = 0; i < simCount; i++) {
+        struct Target* target    = new Target();
+        target->device.vendorId  = SIM_VENDOR_ID;
+        target->device.productId = i + 1;
+        target->device.simulated = 1;
+        targets.push_back(target);
+    }
+    for (struct Target* target : targets) {
+        histogramReset(&target->latency);
+        histogramReset(&target->service);
+        for (int op = 0; op < CMD_COUNT; op++) {
+            histogramReset(&target->perCommand[op]);
+        }
+        if (!options.reopen) {
+            openDevice(&target->device);
+            if (target->device.result != 0) {
+                fprintf(stderr,
+                        "ptzctl: cannot open %04x:%04x: %s\n",
+                        target->device.vendorId,
+                        target->device.productId,
+                        errorMessage(target->device.result));
+                return 1;
+            }
+            target->open = 1;
+        }
+    }
+
+    if (recorderConfig.path != NULL) {
+        int error = recorderStart(&recorderConfig);
+        if (error != 0) {
+            fprintf(stderr,
+                    "ptzctl: cannot record to %s: %s\n",
+                    recorderConfig.path,
+                    strerror(error));
+            return 1;
+        }
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    int      targetCount = (int)targets.size();
+    uint64_t start       = monotonicNanos();
+    uint64_t deadline =
+        options.duration > 0 ? start + (uint64_t)(options.duration * 1e9) : UINT64_MAX;
+    uint64_t                 sent = 0;
+    std::vector<std::thread> workers;
+
+    if (!options.replay && options.rate <= 0) {
+        // closed loop: every camera runs flat out
+        for (int i = 0; i < targetCount; i++) {
+            workers.push_back(std::thread(
+                closedLoopWorker, targets[i], i, targetCount, &script, deadline, &options));
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        for (struct Target* target : targets) {
+            sent += target->completed;
+        }
+    } else {
+        for (int i = 0; i < targetCount; i++) {
+            workers.push_back(std::thread(queueWorker, targets[i], i, &options));
+        }
+
+        // open loop: commands go out on schedule whether or not the cameras keep up,
+        // so latency includes any queueing the cameras cause
+        for (uint64_t i = 0; i < options.count && !stopRequested; i++) {
+            const struct ScriptEntry* entry;
+            uint64_t                  scheduled;
+            if (options.replay) {
+                if (i >= script.size()) {
+                    break;
+                }
+                entry     = &script[i];
+                scheduled = options.speed > 0 ? start + (uint64_t)(entry->at / options.speed) : 0;
+            } else {
+                entry     = &script[i % script.size()];
+                scheduled = start + (uint64_t)((double)i * 1e9 / options.rate);
+            }
+            if (scheduled >= deadline) {
+                break;
+            }
+            if (scheduled != 0) {
+                sleepUntil(scheduled);
+            }
+            int camera = entry->camera < 0 ? (int)(i % targetCount) : entry->camera % targetCount;
+            enqueue(targets[camera], &entry->command, scheduled);
+            sent++;
+        }
+
+        for (struct Target* target : targets) {
+            std::lock_guard<std::mutex> lock(target->mutex);
+            target->done = 1;
+            target->ready.notify_one();
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+    uint64_t elapsed = monotonicNanos() - start;
+    if (recorderConfig.path != NULL) {
+        recorderStop();
+    }
+
+    for (struct Target* target : targets) {
+        if (target->open) {
+            closeDevice(&target->device);
+        }
+    }
+
+    printf("%d camera(s), %s",
+           targetCount,
+           options.replay ? "replay" : (options.rate > 0 ? "open loop" : "closed loop"));
+    if (options.rate > 0 && !options.replay) {
+        printf(" at %.1f commands/s", options.rate);
+    }
+    if (options.replay && options.speed > 0) {
+        printf(" at %.2fx", options.speed);
+    } else if (options.replay) {
+        printf(" as fast as possible");
+    }
+    printf(options.reopen ? ", reopening per command\n" : ", devices held open\n");
+    report(&targets, sent, elapsed);
+
+    for (struct Target* target : targets) {
+        delete target;
+    }
+    return 0;
+}
@@ -0,0 +1,563 @@
+/*
+   ptzd: owns the cameras on this machine and serves commands to any number
+   of local processes over a unix socket.
+
+   ptzd --socket /tmp/ptzd.sock
+   ptzd --bench 10000 --sim-latency 0 --sim-jitter 0 --sim-open 0
+
+   only one process can claim a uvc interface, so services that share cameras
+   go through one daemon instead of each opening them. commands run on each
+   camera's session thread exactly as they would in the addon, with the same
+   queueing, read cache and rate limits, shared by every client. the wire
+   protocol is in ipc.h; node clients use ptz.connect().
+
+   --bench measures what the socket adds to a call, against a simulated
+   camera, first one call at a time and then pipelined.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "command.h"
+#include "device.h"
+#include "ipc.h"
+#include "session.h"
+#include "simulator.h"
+#include "stats.h"
+
+using namespace ptz;
+
+#define DEFAULT_SOCKET "/tmp/ptzd.sock"
+#define SIM_VENDOR_ID 0x5054
+#define SIM_PRODUCT_ID 0x0100
+
+struct Connection {
+    int                  fd;
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;  // loop thread only
+    std::mutex           mutex;
+    std::vector<uint8_t> outbox;    // responses from camera threads, under mutex
+    uint32_t             inFlight;  // commands out on a camera, under mutex
+    bool                 closed;    // client gone, under mutex
+};
+
+struct Call {
+    struct Connection* connection;
+    uint32_t           id;
+    struct Command     command;
+};
+
+static std::atomic<int> stopRequested(0);
+static int              wakeFds[2] = {-1, -1};
+static int              verbose    = 0;
+
+static void wakeLoop() {
+    char byte = 1;
+    if (write(wakeFds[1], &byte, 1) < 0 && errno != EAGAIN) {
+        perror("ptzd: wake");
+    }
+}
+
+static void onSignal(int signal) {
+    stopRequested = 1;
+    wakeLoop();
+}
+
+static void usage(FILE* out) {
+    fprintf(out,
+            "usage: ptzd [options]\n"
+            "\n"
+            "  -s, --socket PATH        where to listen (default " DEFAULT_SOCKET ")\n"
+            "  -b, --bench N            measure N calls direct and through the socket, then exit\n"
+            "  -w, --window N           calls kept in flight by the pipelined bench (default 32)\n"
+            "\n"
+            "simulation\n"
+            "      --sim-latency US     control transfer latency (default 1000)\n"
+            "      --sim-jitter US      control transfer jitter (default 200)\n"
+            "      --sim-open US        device open latency (default 2000)\n"
+            "\n"
+            "  -v, --verbose            log connections\n"
+            "  -h, --help\n");
+}
+
+static void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+// the last one out of a closed connection frees it
+static void releaseConnection(struct Connection* connection) {
+    bool last;
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        last = connection->closed && connection->inFlight == 0;
+    }
+    if (last) {
+        delete connection;
+    }
+}
+
+// camera thread: hand the response to the loop
+static void onCommandDone(void*                       context,
+                          const struct CommandResult* commandResult,
+                          uint32_t                    pending) {
+    struct Call*       call       = (struct Call*)context;
+    struct Connection* connection = call->connection;
+    uint8_t            frame[IPC_MAX_FRAME];
+
+    size_t length = ipcEncodeResponse(call->id, &call->command, commandResult, pending, frame);
+    delete call;
+
+    bool live;
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        connection->inFlight--;
+        live = !connection->closed;
+        if (live) {
+            connection->outbox.insert(connection->outbox.end(), frame, frame + length);
+        }
+    }
+    if (live) {
+        wakeLoop();
+    } else {
+        releaseConnection(connection);
+    }
+}
+
+// run every whole request that has arrived, false when the client has to go
+static bool dispatch(struct Connection* connection) {
+    size_t offset = 0;
+    for (;;) {
+        int length = ipcFrameLength(connection->input.data() + offset,
+                                    connection->input.size() - offset);
+        if (length <= 0) {
+            connection->input.erase(connection->input.begin(),
+                                    connection->input.begin() + offset);
+            return length == 0;
+        }
+
+        struct IpcRequest request;
+        if (ipcDecodeRequest(connection->input.data() + offset, length, &request) != 0) {
+            fprintf(stderr, "ptzd: malformed request, closing connection %d\n", connection->fd);
+            return false;
+        }
+        offset += length;
+
+        struct Call* call = new Call();
+        call->connection  = connection;
+        call->id          = request.id;
+        call->command     = request.command;
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            connection->inFlight++;
+        }
+        struct CameraSession* session = sessionFind(&request.uvcDevice);
+        sessionSubmit(session, &request.uvcDevice, &request.command, onCommandDone, call);
+    }
+}
+
+// write what the client can take, false once it is gone
+static bool flush(struct Connection* connection) {
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        connection->output.insert(
+            connection->output.end(), connection->outbox.begin(), connection->outbox.end());
+        connection->outbox.clear();
+    }
+    size_t written = 0;
+    while (written < connection->output.size()) {
+        ssize_t n = send(connection->fd,
+                         connection->output.data() + written,
+                         connection->output.size() - written,
+                         MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+        written += n;
+    }
+    connection->output.erase(connection->output.begin(), connection->output.begin() + written);
+    return true;
+}
+
+static void closeConnection(struct Connection* connection) {
+    if (verbose) {
+        fprintf(stderr, "ptzd: connection %d closed\n", connection->fd);
+    }
+    close(connection->fd);
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        connection->closed = true;
+    }
+    releaseConnection(connection);
+}
+
+// bind path, taking over a socket file left behind by a daemon that died but
+// never one still answering
+static int listenOn(const char* path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "ptzd: socket path too long\n");
+        return -1;
+    }
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(probe, (struct sockaddr*)&address, sizeof(address)) == 0) {
+        fprintf(stderr, "ptzd: another daemon is listening on %s\n", path);
+        close(probe);
+        return -1;
+    }
+    close(probe);
+    unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(fd, 64) != 0) {
+        fprintf(stderr, "ptzd: %s: %s\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    setNonBlocking(fd);
+    return fd;
+}
+
+static void serve(int listenFd) {
+    std::vector<struct Connection*> connections;
+    std::vector<struct pollfd>      fds;
+    std::vector<uint8_t>            buffer(64 * 1024);
+
+    while (!stopRequested) {
+        fds.clear();
+        fds.push_back({listenFd, POLLIN, 0});
+        fds.push_back({wakeFds[0], POLLIN, 0});
+        for (struct Connection* connection : connections) {
+            short events = POLLIN | (connection->output.empty() ? 0 : POLLOUT);
+            fds.push_back({connection->fd, events, 0});
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("ptzd: poll");
+            break;
+        }
+
+        // drain the wake pipe, then send whatever the cameras have finished
+        if (fds[1].revents & POLLIN) {
+            while (read(wakeFds[0], buffer.data(), buffer.size()) > 0) {
+            }
+        }
+
+        std::vector<struct Connection*> live;
+        for (size_t i = 0; i < connections.size(); i++) {
+            struct Connection* connection = connections[i];
+            short              revents    = fds[i + 2].revents;
+            bool               open       = !(revents & (POLLERR | POLLNVAL));
+            if (open && (revents & (POLLIN | POLLHUP))) {
+                ssize_t n = recv(connection->fd, buffer.data(), buffer.size(), 0);
+                if (n > 0) {
+                    connection->input.insert(
+                        connection->input.end(), buffer.data(), buffer.data() + n);
+                    open = dispatch(connection);
+                } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    open = false;
+                }
+            }
+            if (open) {
+                open = flush(connection);
+            }
+            if (open) {
+                live.push_back(connection);
+            } else {
+                closeConnection(connection);
+            }
+        }
+        connections.swap(live);
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listenFd, NULL, NULL)) >= 0) {
+                setNonBlocking(fd);
+                struct Connection* connection = new Connection();
+                connection->fd                = fd;
+                connection->inFlight          = 0;
+                connection->closed            = false;
+                connections.push_back(connection);
+                if (verbose) {
+                    fprintf(stderr, "ptzd: connection %d opened\n", fd);
+                }
+            }
+        }
+    }
+
+    for (struct Connection* connection : connections) {
+        closeConnection(connection);
+    }
+}
+
+// a blocking client for the bench
+static int connectTo(const char* path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+struct BenchClient {
+    int                  fd;
+    std::vector<uint8_t> input;
+};
+
+static bool benchReceive(struct BenchClient* client, struct IpcResponse* response) {
+    uint8_t chunk[4096];
+    int     length;
+    while ((length = ipcFrameLength(client->input.data(), client->input.size())) == 0) {
+        ssize_t n = recv(client->fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        client->input.insert(client->input.end(), chunk, chunk + n);
+    }
+    if (length < 0 || ipcDecodeResponse(client->input.data(), length, response) != 0) {
+        return false;
+    }
+    client->input.erase(client->input.begin(), client->input.begin() + length);
+    return true;
+}
+
+struct DirectWait {
+    std::mutex              mutex;
+    std::condition_variable done;
+    bool                    finished;
+};
+
+static void onDirectDone(void*                       context,
+                         const struct CommandResult* commandResult,
+                         uint32_t                    pending) {
+    struct DirectWait*          wait = (struct DirectWait*)context;
+    std::lock_guard<std::mutex> lock(wait->mutex);
+    wait->finished = true;
+    wait->done.notify_one();
+}
+
+static double ms(uint64_t nanos) {
+    return (double)nanos / 1e6;
+}
+
+static void printHistogram(const char* label, const struct LatencyHistogram* h) {
+    printf("%-18s p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f  mean %8.3f\n",
+           label,
+           ms(histogramPercentile(h, 50)),
+           ms(histogramPercentile(h, 90)),
+           ms(histogramPercentile(h, 99)),
+           ms(h->max),
+           ms(histogramMean(h)));
+}
+
+// the same read queued on a simulated camera's thread, once in this process
+// and once through the daemon
+static int bench(uint64_t count, uint32_t window) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/ptzd-bench-%d.sock", (int)getpid());
+    int listenFd = listenOn(path);
+    if (listenFd < 0) {
+        return 1;
+    }
+    std::thread server(serve, listenFd);
+
+    struct IpcRequest request;
+    memset(&request, 0, sizeof(request));
+    request.uvcDevice.vendorId  = SIM_VENDOR_ID;
+    request.uvcDevice.productId = SIM_PRODUCT_ID;
+    request.uvcDevice.simulated = 1;
+    request.command.op          = CMD_GET_ABSOLUTE_PAN_TILT;
+    snprintf(request.uvcDevice.serial, sizeof(request.uvcDevice.serial), "bench");
+    struct CameraSession* session = sessionFind(&request.uvcDevice);
+
+    struct LatencyHistogram direct;
+    histogramReset(&direct);
+    for (uint64_t i = 0; i < count; i++) {
+        struct DirectWait wait;
+        wait.finished  = false;
+        uint64_t start = monotonicNanos();
+        sessionSubmit(session, &request.uvcDevice, &request.command, onDirectDone, &wait);
+        std::unique_lock<std::mutex> lock(wait.mutex);
+        wait.done.wait(lock, [&wait] { return wait.finished; });
+        histogramRecord(&direct, monotonicNanos() - start);
+    }
+
+    struct BenchClient client;
+    client.fd = connectTo(path);
+    if (client.fd < 0) {
+        fprintf(stderr, "ptzd: bench could not connect: %s\n", strerror(errno));
+        return 1;
+    }
+    uint8_t                 frame[IPC_MAX_FRAME];
+    struct IpcResponse      response;
+    struct LatencyHistogram daemon;
+    histogramReset(&daemon);
+    for (uint64_t i = 0; i < count; i++) {
+        request.id     = (uint32_t)i;
+        size_t   size  = ipcEncodeRequest(&request, frame);
+        uint64_t start = monotonicNanos();
+        if (send(client.fd, frame, size, 0) != (ssize_t)size || !benchReceive(&client, &response)) {
+            fprintf(stderr, "ptzd: bench lost the daemon\n");
+            return 1;
+        }
+        histogramRecord(&daemon, monotonicNanos() - start);
+    }
+
+    // keep window calls out, timing each from send to response
+    struct LatencyHistogram pipelined;
+    histogramReset(&pipelined);
+    std::vector<uint64_t> sentAt(count);
+    uint64_t              sent     = 0;
+    uint64_t              received = 0;
+    uint64_t              began    = monotonicNanos();
+    while (received < count) {
+        while (sent < count && sent - received < window) {
+            request.id   = (uint32_t)sent;
+            size_t size  = ipcEncodeRequest(&request, frame);
+            sentAt[sent] = monotonicNanos();
+            if (send(client.fd, frame, size, 0) != (ssize_t)size) {
+                fprintf(stderr, "ptzd: bench lost the daemon\n");
+                return 1;
+            }
+            sent++;
+        }
+        if (!benchReceive(&client, &response)) {
+            fprintf(stderr, "ptzd: bench lost the daemon\n");
+            return 1;
+        }
+        histogramRecord(&pipelined, monotonicNanos() - sentAt[response.id]);
+        received++;
+    }
+    uint64_t elapsed = monotonicNanos() - began;
+    close(client.fd);
+
+    printf("%llu getAbsolutePanTilt calls on a simulated camera, times in ms\n",
+           (unsigned long long)count);
+    printHistogram("direct", &direct);
+    printHistogram("daemon", &daemon);
+    printHistogram("daemon pipelined", &pipelined);
+    printf("overhead per call  mean %7.3f  p99 %8.3f\n",
+           histogramMean(&daemon) / 1e6 - histogramMean(&direct) / 1e6,
+           ms(histogramPercentile(&daemon, 99)) - ms(histogramPercentile(&direct, 99)));
+    printf("pipelined          %.0f calls/s with %u in flight\n",
+           count / (elapsed / 1e9),
+           window);
+
+    stopRequested = 1;
+    wakeLoop();
+    server.join();
+    close(listenFd);
+    unlink(path);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    enum { OPT_SIM_LATENCY = 256, OPT_SIM_JITTER, OPT_SIM_OPEN };
+    static const struct option longOptions[] = {
+        {"socket", required_argument, NULL, 's'},
+        {"bench", required_argument, NULL, 'b'},
+        {"window", required_argument, NULL, 'w'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"help", no_argument, NULL, 'h'},
+        {"sim-latency", required_argument, NULL, OPT_SIM_LATENCY},
+        {"sim-jitter", required_argument, NULL, OPT_SIM_JITTER},
+        {"sim-open", required_argument, NULL, OPT_SIM_OPEN},
+        {NULL, 0, NULL, 0}};
+
+    const char* path   = DEFAULT_SOCKET;
+    uint64_t    count  = 0;
+    uint32_t    window = 32;
+
+    struct SimConfig simConfig;
+    simGetConfig(&simConfig);
+
+    int option;
+    while ((option = getopt_long(argc, argv, "s:b:w:vh", longOptions, NULL)) != -1) {
+        switch (option) {
+            case 's':
+                path = optarg;
+                break;
+            case 'b':
+                count = strtoull(optarg, NULL, 10);
+                break;
+            case 'w':
+                window = std::max(1, atoi(optarg));
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'h':
+                usage(stdout);
+                return 0;
+            case OPT_SIM_LATENCY:
+                simConfig.transfer_latency_us = (uint32_t)atoi(optarg);
+                break;
+            case OPT_SIM_JITTER:
+                simConfig.transfer_jitter_us = (uint32_t)atoi(optarg);
+                break;
+            case OPT_SIM_OPEN:
+                simConfig.open_latency_us = (uint32_t)atoi(optarg);
+                break;
+            default:
+                usage(stderr);
+                return 1;
+        }
+    }
+    simSetConfig(&simConfig);
+
+    if (pipe(wakeFds) != 0) {
+        perror("ptzd: pipe");
+        return 1;
+    }
+    setNonBlocking(wakeFds[0]);
+    setNonBlocking(wakeFds[1]);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (count > 0) {
+        return bench(count, window);
+    }
+
+    int listenFd = listenOn(path);
+    if (listenFd < 0) {
+        return 1;
+    }
+    if (verbose) {
+        fprintf(stderr, "ptzd: listening on %s\n", path);
+    }
+    serve(listenFd);
+    close(listenFd);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "realtime.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ptz {
+
+static std::mutex             realtimeMutex;
+static int                    configured = 0;
+static struct RealtimeConfig  current;
+static struct RealtimeStatus  status;
+static cpu_set_t              processCpus;  // affinity before anything was pinned
+static std::vector<pthread_t> threads;
+
+static int schedPolicy(int policy) {
+    switch (policy) {
+        case REALTIME_FIFO:
+            return SCHED_FIFO;
+        case REALTIME_RR:
+            return SCHED_RR;
+        default:
+            return SCHED_OTHER;
+    }
+}
+
+// put one thread under the current settings, settling for a lower priority
+// when RLIMIT_RTPRIO allows some but not the one asked for, and for the
+// normal scheduler when it allows none. the caller holds realtimeMutex.
+static void applyTo(pthread_t thread) {
+    cpu_set_t cpus = processCpus;
+    if (current.cpus != 0) {
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < 64; cpu++) {
+            if (current.cpus >> cpu & 1) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+    }
+    int error = pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+    if (error != 0) {
+        status.affinity_error = error;
+        status.cpus           = 0;
+    }
+
+    struct sched_param param;
+    param.sched_priority = status.policy == REALTIME_OTHER ? 0 : status.priority;
+    error                = pthread_setschedparam(thread, schedPolicy(status.policy), &param);
+    if (error == EPERM && status.policy != REALTIME_OTHER) {
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur > 0) {
+            status.priority      = std::min(status.priority, (int)limit.rlim_cur);
+            param.sched_priority = status.priority;
+            error = pthread_setschedparam(thread, schedPolicy(status.policy), &param);
+        }
+    }
+    if (error != 0) {
+        status.policy_error  = error;
+        status.policy        = REALTIME_OTHER;
+        status.priority      = 0;
+        param.sched_priority = 0;
+        pthread_setschedparam(thread, SCHED_OTHER, &param);
+    }
+}
+
+// locks pages as they are touched rather than all at once, since node
+// reserves far more address space than it ever uses
+static void applyMemoryLock() {
+    if (current.lock_memory && !status.memory_locked) {
+        int result = mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT);
+        if (result != 0 && errno == EINVAL) {
+            result = mlockall(MCL_CURRENT | MCL_FUTURE);
+        }
+        status.memory_locked = result == 0;
+        status.lock_error    = result == 0 ? 0 : errno;
+    } else if (!current.lock_memory && status.memory_locked) {
+        munlockall();
+        status.memory_locked = 0;
+    }
+}
+
+void realtimeConfigure(const struct RealtimeConfig* config, struct RealtimeStatus* result) {
+    std::lock_guard<std::mutex> lock(realtimeMutex);
+    if (!configured) {
+        sched_getaffinity(0, sizeof(processCpus), &processCpus);
+        status.memory_locked = 0;
+        configured           = 1;
+    }
+    current               = *config;
+    status.policy         = config->policy;
+    status.priority       = config->policy == REALTIME_OTHER ? 0 : std::max(config->priority, 1);
+    status.cpus           = config->cpus;
+    status.policy_error   = 0;
+    status.affinity_error = 0;
+    status.lock_error     = 0;
+    applyMemoryLock();
+
+    // try the settings on a thread of our own first, so what isn't allowed
+    // shows up now rather than when the next camera thread starts. it does
+    // the work itself while we wait, so it can't have exited under us.
+    std::thread probe([] { applyTo(pthread_self()); });
+    probe.join();
+    for (pthread_t thread : threads) {
+        applyTo(thread);
+    }
+    status.threads = (uint32_t)threads.size();
+    *result        = status;
+}
+
+void realtimeGetStatus(struct RealtimeStatus* result) {
+    std::lock_guard<std::mutex> lock(realtimeMutex);
+    status.threads = (uint32_t)threads.size();
+    *result        = status;
+}
+
+void realtimeEnter() {
+    std::lock_guard<std::mutex> lock(realtimeMutex);
+    threads.push_back(pthread_self());
+    if (configured) {
+        applyTo(pthread_self());
+    }
+}
+
+void realtimeLeave() {
+    std::lock_guard<std::mutex> lock(realtimeMutex);
+    threads.erase(std::remove(threads.begin(), threads.end(), pthread_self()), threads.end());
+}
+
+}  // namespace ptz
@@ -0,0 +1,48 @@
+#ifndef PTZ_REALTIME_H
+#define PTZ_REALTIME_H
+
+#include <stdint.h>
+
+namespace ptz {
+
+// scheduling for the native threads that drive cameras: session workers,
+// velocity channels, trackers, the tour scheduler and the watchdog. they can
+// be pinned to chosen cores, run under a real time policy and have the
+// process' memory locked, so encoders sharing the machine don't show up as
+// uneven camera motion. anything the process isn't allowed is left as it was
+// and reported, never fatal.
+#define REALTIME_OTHER 0  // the normal time sharing scheduler
+#define REALTIME_FIFO 1
+#define REALTIME_RR 2
+
+struct RealtimeConfig {
+    int      policy;       // REALTIME_OTHER, REALTIME_FIFO or REALTIME_RR
+    int      priority;     // 1..99 under FIFO and RR
+    uint64_t cpus;         // bit n allows cpu n, 0 leaves affinity alone
+    int      lock_memory;  // mlockall current and future pages
+};
+
+struct RealtimeStatus {
+    int      policy;          // what the threads actually run under
+    int      priority;        // lowered to RLIMIT_RTPRIO when that is all that's allowed
+    uint64_t cpus;            // 0 when unpinned
+    int      memory_locked;   // mlockall took
+    int      policy_error;    // errno of the last refusal, 0 when it took
+    int      affinity_error;  // the same for pinning
+    int      lock_error;      // and for locking memory
+    uint32_t threads;         // native threads running under these settings
+};
+
+// applies config to every native thread now running and every one started
+// after, and reports how it went
+void realtimeConfigure(const struct RealtimeConfig* config, struct RealtimeStatus* status);
+void realtimeGetStatus(struct RealtimeStatus* status);
+
+// each native control thread calls enter first thing and leave before it
+// returns
+void realtimeEnter();
+void realtimeLeave();
+
+}  // namespace ptz
+
+#endif  // PTZ_REALTIME_H
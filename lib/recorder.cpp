@@ -0,0 +1,244 @@
+#include "recorder.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include "mapped_file.h"
+#include "stats.h"
+
+namespace ptz {
+
+static std::mutex           recorderMutex;
+static std::atomic<int>     recording(0);
+static struct MappedFile    recordFile = {-1, NULL, 0};
+static std::string          recordPath;
+static uint64_t             recordMaxBytes;
+static uint32_t             recordMaxFiles;
+static struct RecorderStats recordStats;
+
+static std::string rotatedPath(uint32_t index) {
+    return index == 0 ? recordPath : recordPath + "." + std::to_string(index);
+}
+
+// shift path -> path.1 -> path.2 ..., dropping the oldest
+static void rotateFiles() {
+    if (recordMaxFiles <= 1) {
+        unlink(recordPath.c_str());
+        return;
+    }
+    for (uint32_t i = recordMaxFiles - 1; i > 0; i--) {
+        rename(rotatedPath(i - 1).c_str(), rotatedPath(i).c_str());
+    }
+}
+
+static struct RecordHeader* header() {
+    return (struct RecordHeader*)recordFile.data;
+}
+
+static int openRecordFile() {
+    int error = mapFile(&recordFile, recordPath.c_str(), recordMaxBytes);
+    if (error != 0) {
+        return error;
+    }
+
+    struct timespec realtime;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    struct RecordHeader* h = header();
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, PTZ_RECORD_MAGIC, sizeof(h->magic));
+    h->version       = PTZ_RECORD_VERSION;
+    h->recordSize    = sizeof(struct RecordEntry);
+    h->realtimeBase  = (uint64_t)realtime.tv_sec * 1000000000ull + (uint64_t)realtime.tv_nsec;
+    h->monotonicBase = monotonicNanos();
+    h->capacity = (recordMaxBytes - sizeof(struct RecordHeader)) / sizeof(struct RecordEntry);
+    h->count    = 0;
+    return 0;
+}
+
+static void closeRecordFile() {
+    if (recordFile.data == NULL) {
+        return;
+    }
+    size_t used = sizeof(struct RecordHeader) + header()->count * sizeof(struct RecordEntry);
+    syncFile(&recordFile);
+    unmapFile(&recordFile, used);
+}
+
+int recorderStart(const struct RecorderConfig* config) {
+    if (config->maxBytes < sizeof(struct RecordHeader) + sizeof(struct RecordEntry)) {
+        return EINVAL;
+    }
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    if (recording) {
+        return EBUSY;
+    }
+    recordPath     = config->path;
+    recordMaxBytes = config->maxBytes;
+    recordMaxFiles = config->maxFiles > 0 ? config->maxFiles : 1;
+    memset(&recordStats, 0, sizeof(recordStats));
+
+    // never append to or clobber an earlier capture
+    if (access(recordPath.c_str(), F_OK) == 0) {
+        rotateFiles();
+    }
+    int error = openRecordFile();
+    if (error != 0) {
+        return error;
+    }
+    recordStats.active = 1;
+    recording          = 1;
+    return 0;
+}
+
+void recorderStop() {
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    recording          = 0;
+    recordStats.active = 0;
+    closeRecordFile();
+}
+
+int recorderActive() {
+    return recording.load(std::memory_order_relaxed);
+}
+
+// for reads, keep the values that came back instead of the unused arguments
+static void readValues(const struct Command*       command,
+                       const struct CommandResult* commandResult,
+                       int32_t*                    values) {
+    switch (command->op) {
+        case CMD_GET_CAPABILITIES:
+            values[0] = commandResult->capability.absolute_zoom |
+                        commandResult->capability.relative_zoom << 1 |
+                        commandResult->capability.absolute_pan_tilt << 2 |
+                        commandResult->capability.relative_pan_tilt << 3 |
+                        commandResult->capability.absolute_roll << 4 |
+                        commandResult->capability.relative_roll << 5;
+            break;
+        case CMD_GET_ABSOLUTE_ZOOM:
+            values[0] = commandResult->absoluteZoomInfo.current;
+            break;
+        case CMD_GET_RELATIVE_ZOOM:
+            values[0] = commandResult->relativeZoomInfo.direction;
+            values[1] = commandResult->relativeZoomInfo.current_speed;
+            break;
+        case CMD_GET_ABSOLUTE_PAN_TILT:
+            values[0] = commandResult->absolutePanTiltInfo.current_pan;
+            values[1] = commandResult->absolutePanTiltInfo.current_tilt;
+            break;
+        case CMD_GET_RELATIVE_PAN_TILT:
+            values[0] = commandResult->relativePanTiltInfo.pan_direction;
+            values[1] = commandResult->relativePanTiltInfo.current_pan_speed;
+            values[2] = commandResult->relativePanTiltInfo.tilt_direction;
+            values[3] = commandResult->relativePanTiltInfo.current_tilt_speed;
+            break;
+        default:
+            // getControl keeps its fields, getRanges has too many to keep
+            if (commandControl(command->op) >= 0 &&
+                commandControlRequest(command->op) == CONTROL_GET) {
+                memcpy(values, commandResult->controlValues.values, sizeof(int32_t) * 4);
+            }
+            break;
+    }
+}
+
+// fnv-1a of the serial and port, terminators included, folded to 16 bits.
+// tells identical cameras apart; a clash only merges them on replay.
+static uint16_t cameraKey(const struct UVCDevice* uvcDevice) {
+    uint32_t    hash = 2166136261u;
+    const char* text = uvcDevice->serial;
+    do {
+        hash = (hash ^ (uint8_t)*text) * 16777619u;
+    } while (*text++ != 0);
+    text = uvcDevice->port;
+    do {
+        hash = (hash ^ (uint8_t)*text) * 16777619u;
+    } while (*text++ != 0);
+    return (uint16_t)(hash ^ hash >> 16);
+}
+
+void recorderAppend(const struct UVCDevice*     uvcDevice,
+                    const struct Command*       command,
+                    const struct CommandResult* commandResult,
+                    uint64_t                    start,
+                    uint64_t                    end) {
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    if (!recording) {
+        return;
+    }
+    if (header()->count >= header()->capacity) {
+        closeRecordFile();
+        rotateFiles();
+        recordStats.rotations++;
+        if (openRecordFile() != 0) {
+            // nowhere to write; stop rather than fail every later command
+            recordStats.failed++;
+            recordStats.active = 0;
+            recording          = 0;
+            return;
+        }
+    }
+
+    struct RecordHeader*      h        = header();
+    struct RecordEntry*       entries  = (struct RecordEntry*)(recordFile.data + sizeof(*h));
+    struct RecordEntry*       entry    = &entries[h->count];
+    uint64_t                  duration = end - start;
+    const struct CommandSpec* spec     = commandSpec(command->op);
+
+    memset(entry, 0, sizeof(*entry));
+    entry->timestamp = start > h->monotonicBase ? start - h->monotonicBase : 0;
+    entry->duration  = duration > UINT32_MAX ? UINT32_MAX : (uint32_t)duration;
+    entry->vendorId  = (uint16_t)uvcDevice->vendorId;
+    entry->productId = (uint16_t)uvcDevice->productId;
+    entry->result    = commandResult->result;
+    entry->op        = command->op;
+    entry->flags     = uvcDevice->simulated ? RECORD_SIMULATED : 0;
+    entry->camera    = cameraKey(uvcDevice);
+    if (spec != NULL && spec->read) {
+        entry->flags |= RECORD_READ_VALUES;
+        if (commandResult->result == 0) {
+            readValues(command, commandResult, entry->args);
+        }
+    } else {
+        memcpy(entry->args, command->args, sizeof(entry->args));
+    }
+
+    // publish the record only once it is complete
+    __atomic_store_n(&h->count, h->count + 1, __ATOMIC_RELEASE);
+    recordStats.records++;
+}
+
+void recorderGetStats(struct RecorderStats* stats) {
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    *stats = recordStats;
+}
+
+int recordLoad(const char*                       path,
+               struct RecordHeader*              header,
+               std::vector<struct RecordEntry>* entries) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return errno;
+    }
+    if (fread(header, sizeof(*header), 1, file) != 1 ||
+        memcmp(header->magic, PTZ_RECORD_MAGIC, sizeof(header->magic)) != 0 ||
+        header->recordSize != sizeof(struct RecordEntry)) {
+        fclose(file);
+        return EINVAL;
+    }
+
+    // the count in the header may trail what is on disk if the writer died
+    // mid-record, so never read past it
+    entries->resize(header->count);
+    size_t read = header->count > 0
+                      ? fread(entries->data(), sizeof(struct RecordEntry), header->count, file)
+                      : 0;
+    entries->resize(read);
+    fclose(file);
+    return 0;
+}
+
+}  // namespace ptz
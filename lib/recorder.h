@@ -0,0 +1,75 @@
+#ifndef PTZ_RECORDER_H
+#define PTZ_RECORDER_H
+
+#include <stdint.h>
+#include <vector>
+#include "command.h"
+#include "device.h"
+
+namespace ptz {
+
+// append-only binary capture of every command sent to a camera. files are
+// memory mapped at a fixed size; when one fills up it is truncated to what
+// was written and rotated to path.1, path.2, ... keeping at most maxFiles.
+#define PTZ_RECORD_MAGIC "PTZREC1"
+#define PTZ_RECORD_VERSION 1
+
+struct RecordHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t realtimeBase;   // CLOCK_REALTIME nanoseconds when the file was started
+    uint64_t monotonicBase;  // monotonicNanos() at that same instant
+    uint64_t capacity;       // records that fit in the file
+    uint64_t count;          // records written so far, bumped after each record lands
+    uint8_t  reserved[16];
+};
+
+#define RECORD_READ_VALUES 1  // args hold the CUR values read back, not arguments
+#define RECORD_SIMULATED 2
+
+struct RecordEntry {
+    uint64_t timestamp;  // nanoseconds since monotonicBase when the command started
+    uint32_t duration;   // nanoseconds until it completed, saturating
+    uint16_t vendorId;
+    uint16_t productId;
+    int32_t  args[4];
+    int32_t  result;  // uvc_error_t
+    uint8_t  op;
+    uint8_t  flags;
+    uint16_t camera;  // hash of the serial and port it was addressed by, 0 in older captures
+};
+
+struct RecorderConfig {
+    const char* path;
+    uint64_t    maxBytes;  // size of each file
+    uint32_t    maxFiles;  // files kept including the live one
+};
+
+struct RecorderStats {
+    int      active;
+    uint64_t records;  // since the recorder started
+    uint64_t rotations;
+    uint64_t failed;  // records lost to file errors
+};
+
+// returns 0 or an errno value
+int  recorderStart(const struct RecorderConfig* config);
+void recorderStop();
+int  recorderActive();
+void recorderAppend(const struct UVCDevice*     uvcDevice,
+                    const struct Command*       command,
+                    const struct CommandResult* commandResult,
+                    uint64_t                    start,
+                    uint64_t                    end);
+void recorderGetStats(struct RecorderStats* stats);
+
+// load a capture file. returns 0, an errno value, or EINVAL when the file is
+// not a capture.
+int recordLoad(const char*                       path,
+               struct RecordHeader*              header,
+               std::vector<struct RecordEntry>* entries);
+
+}  // namespace ptz
+
+#endif  // PTZ_RECORDER_H
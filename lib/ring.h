@@ -0,0 +1,49 @@
+#ifndef PTZ_RING_H
+#define PTZ_RING_H
+
+#include <stdint.h>
+#include <atomic>
+
+namespace ptz {
+
+// fixed size single producer, single consumer queue. push and pop never
+// block or allocate, so the js thread can hand samples to a native thread
+// without taking a lock. Size must be a power of two.
+template <typename T, uint32_t Size>
+struct SpscRing {
+    static_assert((Size & (Size - 1)) == 0, "ring size must be a power of two");
+
+    alignas(64) std::atomic<uint32_t> head{0};  // next slot to read, owned by the consumer
+    alignas(64) std::atomic<uint32_t> tail{0};  // next slot to write, owned by the producer
+    T items[Size];
+
+    // false when full
+    bool push(const T& item) {
+        uint32_t at = tail.load(std::memory_order_relaxed);
+        if (at - head.load(std::memory_order_acquire) == Size) {
+            return false;
+        }
+        items[at & (Size - 1)] = item;
+        tail.store(at + 1, std::memory_order_release);
+        return true;
+    }
+
+    // false when empty
+    bool pop(T* item) {
+        uint32_t at = head.load(std::memory_order_relaxed);
+        if (at == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        *item = items[at & (Size - 1)];
+        head.store(at + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint32_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+};
+
+}  // namespace ptz
+
+#endif  // PTZ_RING_H
@@ -0,0 +1,1170 @@
+#include "session.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "device_index.h"
+#include "error.h"
+#include "profile.h"
+#include "realtime.h"
+#include "stats.h"
+#include "warm_cache.h"
+#include "watchdog.h"
+
+namespace ptz {
+
+// how long a camera that dropped off the bus is waited for, and the pauses
+// between reopens while it is away
+#define SESSION_RECOVER_MS 10000
+#define SESSION_RECOVER_BACKOFF_MIN_NS 50000000ULL
+#define SESSION_RECOVER_BACKOFF_MAX_NS 1000000000ULL
+#define SESSION_CANCEL_POLL_NS 10000000ULL
+
+// dead-man stop for one relative axis. armed counts every arm and disarm,
+// so a stop queued for one arm can tell the axis has moved on since.
+struct SessionWatchdog {
+    struct WatchdogTimer  timer;
+    struct CameraSession* session;
+    struct UVCDevice      uvcDevice;
+    struct Command        stop;
+    uint64_t              armed;
+    uint64_t              due;     // monotonicNanos() the stop goes out, 0 when disarmed
+    uint64_t              queued;  // the arm a queued stop is for, 0 for none
+};
+
+struct SessionJob {
+    struct UVCDevice  uvcDevice;
+    struct Command    command;
+    SessionTask       task;  // run instead of command when set
+    CommandCompletion done;
+    void*             context;
+    bool              replayed;  // already run once and lost with the camera
+};
+
+// how far each read has got with the warm start cache
+enum WarmState {
+    WARM_COLD = 0,  // not looked up yet
+    WARM_CHECKING,  // answered from the cache, a device read is on its way to check
+    WARM_DONE,      // the device has answered since, or the cache had nothing
+};
+
+// a device read checking an answer the warm start cache gave
+struct WarmCheck {
+    struct CameraSession* session;
+    struct UVCDevice      uvcDevice;
+    struct Command        command;
+};
+
+// one read on the bus, and everyone waiting for its answer. it lives on the
+// leading reader's stack, which stays until every waiter has its copy.
+struct Flight {
+    uint64_t             generation;
+    bool                 finished;
+    uint32_t             waiters;
+    struct CommandResult result;
+};
+
+struct CameraSession {
+    std::mutex              mutex;
+    std::condition_variable landed;
+    struct SessionConfig    config;
+    struct SessionStats     stats;
+
+    // bumped by every write, reads started before it are stale
+    uint64_t                generation;
+    struct Flight*       flights[CMD_COUNT];
+    struct CommandResult cached[CMD_COUNT];
+    uint64_t             cachedAt[CMD_COUNT];  // 0 when empty
+    uint64_t             cachedGeneration[CMD_COUNT];
+
+    // last value each write op put on the bus, while it still holds
+    int32_t commanded[CMD_COUNT][4];
+    int     hasCommanded[CMD_COUNT];
+
+    // last absolute value the camera took on each axis, what a reopened
+    // camera is sent back to. a write in flight leaves it alone.
+    int32_t acknowledged[CMD_COUNT][4];
+    int     hasAcknowledged[CMD_COUNT];
+
+    // token buckets, tokens go negative while callers wait on a reservation
+    double   tokens[RATE_CLASS_COUNT];
+    uint64_t refilledAt[RATE_CLASS_COUNT];
+
+    // relative motion keeps going until told otherwise, one per axis
+    struct SessionWatchdog watchdogs[CONTROL_AXIS_COUNT];
+    struct Estimator       estimator;
+
+    // the profile store generation config.speed_model was last taken from
+    std::atomic<uint64_t> profileGeneration;
+
+    // who the camera is to the warm start cache, found on first use
+    int               warmState[CMD_COUNT];
+    struct WarmCamera warmCamera;
+    std::atomic<int>  warmIdentified;
+
+    // transfers in flight give up when this moves, see sessionCancel
+    std::atomic<uint32_t> cancels;
+    // set once a command let the camera run out its timeout. until probeAt
+    // commands fail without going near it.
+    bool     unresponsive;
+    uint64_t probeAt;
+    // set while the camera's thread reopens a camera that dropped off the
+    // bus, commands fail straight away until it is back. attachment is
+    // where it was last opened, 0 before the first open.
+    bool             recovering;
+    uint64_t         lostAt;
+    struct UVCDevice recoveryDevice;
+    uint32_t         attachment;
+
+    // async commands, run in order by worker
+    std::deque<struct SessionJob> jobs;
+    std::condition_variable       queued;
+    std::thread                   worker;
+};
+
+static void watchdogExpired(struct WatchdogTimer* timer);
+static void runWatchdogStop(void* context, struct CommandResult* commandResult);
+static void recoverCamera(void* context, struct CommandResult* commandResult);
+static void onRecovered(void*                       context,
+                        const struct CommandResult* commandResult,
+                        uint32_t                    pending);
+static void sessionWorker(struct CameraSession* session);
+static void enqueueFirst(struct CameraSession* session, const struct SessionJob* job);
+
+// fixed size, so finding the session of a camera already seen never allocates
+struct SessionKey {
+    int  vendorId;
+    int  productId;
+    int  simulated;
+    char serial[DEVICE_SERIAL_SIZE];
+    char port[DEVICE_PORT_SIZE];
+
+    bool operator<(const struct SessionKey& other) const {
+        if (vendorId != other.vendorId || productId != other.productId ||
+            simulated != other.simulated) {
+            return std::tie(vendorId, productId, simulated) <
+                   std::tie(other.vendorId, other.productId, other.simulated);
+        }
+        int serialOrder = strcmp(serial, other.serial);
+        return serialOrder != 0 ? serialOrder < 0 : strcmp(port, other.port) < 0;
+    }
+};
+
+static std::mutex                                         sessionsMutex;
+static std::map<struct SessionKey, struct CameraSession*> sessions;
+
+static struct CameraSession* sessionLookup(const struct UVCDevice* uvcDevice) {
+    struct SessionKey key;
+    key.vendorId  = uvcDevice->vendorId;
+    key.productId = uvcDevice->productId;
+    key.simulated = uvcDevice->simulated;
+    memcpy(key.serial, uvcDevice->serial, sizeof(key.serial));
+    memcpy(key.port, uvcDevice->port, sizeof(key.port));
+
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    auto                        found = sessions.find(key);
+    if (found != sessions.end()) {
+        return found->second;
+    }
+
+    struct CameraSession* session = new CameraSession();
+    session->config.read_cache_ms   = 0;
+    session->config.suppress_writes = 1;
+    session->config.rate_policy     = RATE_POLICY_QUEUE;
+    session->config.max_pending     = 0;
+    session->config.watchdog_ms     = 0;
+    session->config.timeout_ms      = SESSION_TIMEOUT_MS;
+    session->config.recover_ms      = SESSION_RECOVER_MS;
+    session->config.fov.count       = 0;
+    session->stats                  = SessionStats();
+    session->generation             = 0;
+    session->profileGeneration      = 0;
+    session->warmIdentified         = 0;
+    session->cancels                = 0;
+    session->unresponsive           = false;
+    session->probeAt                = 0;
+    session->recovering             = false;
+    session->lostAt                 = 0;
+    session->attachment             = 0;
+    speedModelDefaults(&session->config.speed_model);
+    estimatorReset(&session->estimator);
+    for (int op = 0; op < CMD_COUNT; op++) {
+        session->flights[op]          = NULL;
+        session->cachedAt[op]         = 0;
+        session->cachedGeneration[op] = 0;
+        session->hasCommanded[op]     = 0;
+        session->hasAcknowledged[op]  = 0;
+        session->warmState[op]        = WARM_COLD;
+    }
+    for (int axis = 0; axis < CONTROL_AXIS_COUNT; axis++) {
+        watchdogTimerInit(&session->watchdogs[axis].timer, watchdogExpired);
+        session->watchdogs[axis].session = session;
+        session->watchdogs[axis].armed   = 0;
+        session->watchdogs[axis].due     = 0;
+        session->watchdogs[axis].queued  = 0;
+    }
+    for (int rateClass = 0; rateClass < RATE_CLASS_COUNT; rateClass++) {
+        session->config.rate_limits[rateClass].rate  = 0;
+        session->config.rate_limits[rateClass].burst = 1;
+        session->tokens[rateClass]                   = 1;
+        session->refilledAt[rateClass]               = 0;
+    }
+    sessions[key] = session;
+    return session;
+}
+
+struct CameraSession* sessionFind(const struct UVCDevice* uvcDevice) {
+    struct CameraSession* session = sessionLookup(uvcDevice);
+
+    // take up a profile loaded or saved since the camera was last used
+    uint64_t current = profileGeneration();
+    if (session->profileGeneration.load(std::memory_order_acquire) != current) {
+        struct MotionProfile profile;
+        bool                 found = profileFind(uvcDevice, &profile);
+
+        std::lock_guard<std::mutex> lock(session->mutex);
+        if (found) {
+            profileApply(&profile, &session->config.speed_model);
+        }
+        session->profileGeneration.store(current, std::memory_order_release);
+    }
+    return session;
+}
+
+void sessionGetConfig(struct CameraSession* session, struct SessionConfig* config) {
+    std::lock_guard<std::mutex> lock(session->mutex);
+    *config = session->config;
+}
+
+void sessionSetConfig(struct CameraSession* session, const struct SessionConfig* config) {
+    std::lock_guard<std::mutex> lock(session->mutex);
+    session->config = *config;
+
+    // start every bucket full under the new limits
+    for (int rateClass = 0; rateClass < RATE_CLASS_COUNT; rateClass++) {
+        session->tokens[rateClass]     = std::max(config->rate_limits[rateClass].burst, 1.0);
+        session->refilledAt[rateClass] = monotonicNanos();
+    }
+}
+
+// a control set, or NULL for every other command
+static const struct ControlSpec* controlSetSpec(int op) {
+    int control = commandControl(op);
+    if (control < 0 || commandControlRequest(op) != CONTROL_SET) {
+        return NULL;
+    }
+    return &controlSpecs[control];
+}
+
+int commandRateClass(int op) {
+    switch (op) {
+        case CMD_ABSOLUTE_ZOOM:
+        case CMD_ABSOLUTE_PAN_TILT:
+            return RATE_ABSOLUTE;
+        case CMD_RELATIVE_ZOOM:
+        case CMD_RELATIVE_PAN_TILT:
+            return RATE_RELATIVE;
+        default: {
+            const struct ControlSpec* spec = controlSetSpec(op);
+            if (spec == NULL) {
+                return RATE_READ;
+            }
+            return spec->kind == CONTROL_RELATIVE ? RATE_RELATIVE : RATE_ABSOLUTE;
+        }
+    }
+}
+
+// take a token for a command about to reach the device. returns the time to
+// wait for it, 0 when there is one now, or UINT64_MAX when the policy says
+// reject. called with the session locked.
+static uint64_t takeToken(struct CameraSession* session, int op) {
+    int                     rateClass = commandRateClass(op);
+    const struct RateLimit* limit     = &session->config.rate_limits[rateClass];
+    if (limit->rate <= 0) {
+        return 0;
+    }
+
+    uint64_t now    = monotonicNanos();
+    double   burst  = std::max(limit->burst, 1.0);
+    double   tokens = session->tokens[rateClass];
+    tokens += (double)(now - session->refilledAt[rateClass]) * limit->rate / 1e9;
+    session->tokens[rateClass]     = std::min(tokens, burst);
+    session->refilledAt[rateClass] = now;
+
+    if (session->tokens[rateClass] >= 1) {
+        session->tokens[rateClass] -= 1;
+        return 0;
+    }
+    if (session->config.rate_policy == RATE_POLICY_REJECT) {
+        session->stats.rate_rejected++;
+        return UINT64_MAX;
+    }
+
+    // reserve the next token, later callers queue up behind this one
+    session->tokens[rateClass] -= 1;
+    session->stats.rate_delayed++;
+    return (uint64_t)(-session->tokens[rateClass] / limit->rate * 1e9);
+}
+
+// wait for a token outside the lock, false when rejected
+static bool waitForToken(struct CameraSession*         session,
+                         std::unique_lock<std::mutex>& lock,
+                         int                           op,
+                         struct CommandResult*         commandResult) {
+    uint64_t wait = takeToken(session, op);
+    if (wait == UINT64_MAX) {
+        commandResult->result = UVC_ERROR_BUSY;
+        commandResult->error  = "Rate limit exceeded";
+        return false;
+    }
+    if (wait != 0) {
+        lock.unlock();
+        sleepUntil(monotonicNanos() + wait);
+        lock.lock();
+    }
+    return true;
+}
+
+void sessionGetStats(struct CameraSession* session, struct SessionStats* stats) {
+    std::lock_guard<std::mutex> lock(session->mutex);
+    *stats = session->stats;
+}
+
+const std::atomic<uint32_t>* sessionCancels(struct CameraSession* session) {
+    return &session->cancels;
+}
+
+void sessionEstimate(struct CameraSession* session, struct Estimate* estimate) {
+    std::lock_guard<std::mutex> lock(session->mutex);
+    estimatorGet(&session->estimator, &session->config.speed_model, monotonicNanos(), estimate);
+}
+
+// which motor a command moves, commands on the same axis undo each other
+static int commandAxis(int op) {
+    switch (op) {
+        case CMD_ABSOLUTE_ZOOM:
+        case CMD_RELATIVE_ZOOM:
+            return 1;
+        case CMD_ABSOLUTE_PAN_TILT:
+        case CMD_RELATIVE_PAN_TILT:
+            return 2;
+        default: {
+            const struct ControlSpec* spec = controlSetSpec(op);
+            return spec != NULL ? spec->axis : 0;
+        }
+    }
+}
+
+// a control set within the resolution of the last one sent for every field.
+// settings have no resolution, they must match.
+static bool isNoOpControlSet(struct CameraSession* session, const struct Command* command) {
+    const struct ControlSpec* spec = controlSetSpec(command->op);
+    if (spec == NULL || spec->kind == CONTROL_RELATIVE) {
+        return false;
+    }
+    int                         rangesOp = controlOp(commandControl(command->op), CONTROL_RANGES);
+    const struct ControlRanges* ranges   = &session->cached[rangesOp].controlRanges;
+    const int32_t*              last     = session->commanded[command->op];
+
+    bool known = spec->kind == CONTROL_ABSOLUTE && session->cachedAt[rangesOp] != 0 &&
+                 (ranges->requests & CONTROL_HAS_RES);
+    for (int i = 0; i < controlFieldCount(*spec); i++) {
+        int32_t resolution = known ? ranges->resolution[i] : 1;
+        if (abs(command->args[i] - last[i]) >= std::max(resolution, 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// true when an absolute set would leave the camera where it was last sent.
+// the resolution comes from the range info when a read has fetched it.
+static bool isNoOpWrite(struct CameraSession* session, const struct Command* command) {
+    int op = command->op;
+    if (!session->hasCommanded[op]) {
+        return false;
+    }
+
+    const int32_t* last = session->commanded[op];
+    switch (op) {
+        case CMD_ABSOLUTE_ZOOM: {
+            int32_t resolution = 1;
+            if (session->cachedAt[CMD_GET_ABSOLUTE_ZOOM] != 0) {
+                resolution = session->cached[CMD_GET_ABSOLUTE_ZOOM].absoluteZoomInfo.resolution;
+            }
+            return abs(command->args[0] - last[0]) < std::max(resolution, 1);
+        }
+        case CMD_ABSOLUTE_PAN_TILT: {
+            int32_t panResolution  = 1;
+            int32_t tiltResolution = 1;
+            if (session->cachedAt[CMD_GET_ABSOLUTE_PAN_TILT] != 0) {
+                const struct AbsolutePanTiltInfo* info =
+                    &session->cached[CMD_GET_ABSOLUTE_PAN_TILT].absolutePanTiltInfo;
+                panResolution  = info->resolution_pan;
+                tiltResolution = info->resolution_tilt;
+            }
+            return abs(command->args[0] - last[0]) < std::max(panResolution, 1) &&
+                   abs(command->args[1] - last[1]) < std::max(tiltResolution, 1);
+        }
+        default:
+            // relative moves are never skipped, a repeated stop must still stop.
+            // control sets go by their kind.
+            return isNoOpControlSet(session, command);
+    }
+}
+
+static bool isRelativeStop(const struct Command* command) {
+    switch (command->op) {
+        case CMD_RELATIVE_ZOOM:
+            return command->args[0] == 0;
+        case CMD_RELATIVE_PAN_TILT:
+            return command->args[0] == 0 && command->args[2] == 0;
+        default: {
+            // a relative control's signed fields are its directions
+            const struct ControlSpec* spec = controlSetSpec(command->op);
+            if (spec == NULL || spec->kind != CONTROL_RELATIVE) {
+                return false;
+            }
+            for (int i = 0; i < controlFieldCount(*spec); i++) {
+                if (controlTypeSigned(spec->fields[i].type) && command->args[i] != 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+}
+
+// a set that keeps the camera moving once it has been sent
+static bool isMotion(int op) {
+    if (op == CMD_RELATIVE_ZOOM || op == CMD_RELATIVE_PAN_TILT) {
+        return true;
+    }
+    const struct ControlSpec* spec = controlSetSpec(op);
+    return spec != NULL && controlIsMotion(*spec);
+}
+
+// a relative move arms its axis' deadline, every further move pushes it
+// back, and a stop disarms it. called with the session locked.
+static void armWatchdog(struct CameraSession*   session,
+                        const struct UVCDevice* uvcDevice,
+                        const struct Command*   command) {
+    struct SessionWatchdog* watchdog = &session->watchdogs[commandAxis(command->op)];
+    watchdog->armed++;
+    if (isRelativeStop(command) || session->config.watchdog_ms == 0) {
+        watchdog->due = 0;
+        watchdogCancel(&watchdog->timer);
+        return;
+    }
+
+    // the stop keeps the speeds, some cameras reject 0. it gets a deadline
+    // of its own when it goes out, not the one of the move that armed it.
+    watchdog->uvcDevice          = *uvcDevice;
+    watchdog->uvcDevice.deadline = 0;
+    watchdog->stop       = *command;
+    watchdog->stop.flags = COMMAND_SCHEDULED;
+    switch (command->op) {
+        case CMD_RELATIVE_ZOOM:
+            watchdog->stop.args[0] = 0;
+            break;
+        case CMD_RELATIVE_PAN_TILT:
+            watchdog->stop.args[0] = 0;
+            watchdog->stop.args[2] = 0;
+            break;
+        default: {
+            const struct ControlSpec* spec = controlSetSpec(command->op);
+            for (int i = 0; i < controlFieldCount(*spec); i++) {
+                if (controlTypeSigned(spec->fields[i].type)) {
+                    watchdog->stop.args[i] = 0;
+                }
+            }
+            break;
+        }
+    }
+    watchdog->due = monotonicNanos() + (uint64_t)session->config.watchdog_ms * 1000000;
+    watchdogSchedule(&watchdog->timer, watchdog->due);
+}
+
+static void onWatchdogStopped(void*                       context,
+                              const struct CommandResult* commandResult,
+                              uint32_t                    pending) {}
+
+// the wheel's thread, shared by every camera, never waits on one. the stop
+// goes to the camera's own thread, ahead of what is queued there.
+static void watchdogExpired(struct WatchdogTimer* timer) {
+    struct SessionWatchdog*     watchdog = (struct SessionWatchdog*)timer;
+    struct CameraSession*       session  = watchdog->session;
+    std::lock_guard<std::mutex> lock(session->mutex);
+
+    // moved again or stopped after the wheel took the timer
+    if (watchdog->due == 0 || monotonicNanos() < watchdog->due) {
+        return;
+    }
+    watchdog->queued      = watchdog->armed;
+    struct SessionJob job = {};
+    job.task              = runWatchdogStop;
+    job.done              = onWatchdogStopped;
+    job.context           = watchdog;
+    enqueueFirst(session, &job);
+}
+
+static void runWatchdogStop(void* context, struct CommandResult* commandResult) {
+    struct SessionWatchdog* watchdog = (struct SessionWatchdog*)context;
+    struct CameraSession*   session  = watchdog->session;
+    struct UVCDevice        uvcDevice;
+    struct Command          stop;
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        bool                        current = watchdog->queued == watchdog->armed;
+        watchdog->queued                    = 0;
+        if (!current) {
+            commandResult->result = UVC_SUCCESS;
+            commandResult->error  = NULL;
+            return;
+        }
+        session->stats.watchdog_stops++;
+        uvcDevice = watchdog->uvcDevice;
+        stop      = watchdog->stop;
+    }
+    sessionRun(session, &uvcDevice, &stop, commandResult);
+}
+
+// the camera as the warm start cache knows it, NULL while no cache is open
+// or the camera can't be found
+static const struct WarmCamera* warmCamera(struct CameraSession*   session,
+                                           const struct UVCDevice* uvcDevice) {
+    if (!warmCacheIsOpen()) {
+        return NULL;
+    }
+    if (!session->warmIdentified.load(std::memory_order_acquire)) {
+        struct WarmCamera camera;
+        if (!warmCameraIdentify(uvcDevice, &camera)) {
+            return NULL;
+        }
+        std::lock_guard<std::mutex> lock(session->mutex);
+        if (!session->warmIdentified.load(std::memory_order_relaxed)) {
+            session->warmCamera = camera;
+            session->warmIdentified.store(1, std::memory_order_release);
+        }
+    }
+    return &session->warmCamera;
+}
+
+static void runWarmCheck(void* context, struct CommandResult* commandResult) {
+    struct WarmCheck* check = (struct WarmCheck*)context;
+    sessionRun(check->session, &check->uvcDevice, &check->command, commandResult);
+}
+
+static void onWarmChecked(void*                       context,
+                          const struct CommandResult* commandResult,
+                          uint32_t                    pending) {
+    delete (struct WarmCheck*)context;
+}
+
+// once an axis has moved relatively, what the cache says about where it is
+// and how it moves no longer holds. called with the session locked.
+static void settleWarmReads(struct CameraSession* session, int op) {
+    if (op == CMD_RELATIVE_ZOOM) {
+        session->warmState[CMD_GET_ABSOLUTE_ZOOM] = WARM_DONE;
+        session->warmState[CMD_GET_RELATIVE_ZOOM] = WARM_DONE;
+    } else if (op == CMD_RELATIVE_PAN_TILT) {
+        session->warmState[CMD_GET_ABSOLUTE_PAN_TILT] = WARM_DONE;
+        session->warmState[CMD_GET_RELATIVE_PAN_TILT] = WARM_DONE;
+    }
+}
+
+// put a job at the head of the camera's queue, behind only a recovery that
+// has to run first. the queue limit doesn't apply. called with the session
+// locked.
+static void enqueueFirst(struct CameraSession* session, const struct SessionJob* job) {
+    if (!session->worker.joinable()) {
+        session->worker = std::thread(sessionWorker, session);
+    }
+    auto at = session->jobs.begin();
+    if (at != session->jobs.end() && at->task == recoverCamera) {
+        ++at;
+    }
+    session->jobs.insert(at, *job);
+    session->stats.pending++;
+    session->queued.notify_one();
+}
+
+// have the camera's thread bring back a camera seen before that has gone,
+// ahead of everything queued. called with the session locked.
+static void startRecovery(struct CameraSession* session, const struct UVCDevice* uvcDevice) {
+    if (session->recovering || session->config.recover_ms == 0) {
+        return;
+    }
+    session->recovering                = true;
+    session->lostAt                    = monotonicNanos();
+    session->recoveryDevice            = *uvcDevice;
+    session->recoveryDevice.deadline   = 0;
+    session->recoveryDevice.cancels    = NULL;
+    session->recoveryDevice.cancelMark = 0;
+    session->stats.disconnects++;
+
+    struct SessionJob job = {};
+    job.task              = recoverCamera;
+    job.done              = onRecovered;
+    job.context           = session;
+    enqueueFirst(session, &job);
+}
+
+// the caller's gate, with the time spent at it kept out of the command's
+// deadline. a command the gate fails says nothing about the camera.
+struct SessionGate {
+    struct CommandGate        gate;
+    const struct CommandGate* inner;
+    struct UVCDevice*         uvcDevice;
+    bool                      refused;
+};
+
+static uvc_error_t sessionGateWait(void* context, const struct UVCDevice* uvcDevice) {
+    struct SessionGate* gate   = (struct SessionGate*)context;
+    uint64_t            start  = monotonicNanos();
+    uvc_error_t         result = gate->inner->wait(gate->inner->context, uvcDevice);
+    if (gate->uvcDevice->deadline != 0) {
+        gate->uvcDevice->deadline += monotonicNanos() - start;
+    }
+    gate->refused = result != 0;
+    return result;
+}
+
+// runCommandGated under a deadline, cancellable by sessionCancel, unless
+// the camera is not responding or away. called with the session locked, which is
+// dropped for the transfer.
+static void sessionTransfer(struct CameraSession*         session,
+                            std::unique_lock<std::mutex>& lock,
+                            struct UVCDevice*             uvcDevice,
+                            const struct Command*         command,
+                            const struct CommandGate*     gate,
+                            struct CommandResult*         commandResult) {
+    uint64_t now     = monotonicNanos();
+    uint64_t timeout = (uint64_t)session->config.timeout_ms * 1000000;
+
+    // spent its time waiting in a queue or for a token
+    if (uvcDevice->deadline != 0 && now >= uvcDevice->deadline) {
+        session->stats.timeouts++;
+        commandResult->result = UVC_ERROR_TIMEOUT;
+        commandResult->error  = errorMessage(UVC_ERROR_TIMEOUT);
+        return;
+    }
+    if (session->recovering) {
+        session->stats.fast_failures++;
+        commandResult->result = UVC_ERROR_NO_DEVICE;
+        commandResult->error  = "Camera reconnecting";
+        return;
+    }
+    if (session->unresponsive) {
+        if (now < session->probeAt) {
+            session->stats.fast_failures++;
+            commandResult->result = UVC_ERROR_TIMEOUT;
+            commandResult->error  = "Camera not responding";
+            return;
+        }
+        // this one goes through, the rest keep failing until it is back
+        session->probeAt = now + timeout;
+    }
+
+    struct SessionGate sessionGate;
+    sessionGate.gate.wait    = sessionGateWait;
+    sessionGate.gate.context = &sessionGate;
+    sessionGate.inner        = gate;
+    sessionGate.uvcDevice    = uvcDevice;
+    sessionGate.refused      = false;
+
+    uint64_t                     callerDeadline = uvcDevice->deadline;
+    const std::atomic<uint32_t>* callerCancels  = uvcDevice->cancels;
+    uint32_t                     callerMark     = uvcDevice->cancelMark;
+    if (callerDeadline == 0 && timeout != 0) {
+        uvcDevice->deadline = now + timeout;
+    }
+    uvcDevice->cancels    = &session->cancels;
+    uvcDevice->cancelMark = session->cancels.load(std::memory_order_acquire);
+    uint64_t budget       = uvcDevice->deadline != 0 ? uvcDevice->deadline - now : UINT64_MAX;
+    lock.unlock();
+
+    runCommandGated(uvcDevice, command, gate != NULL ? &sessionGate.gate : NULL, commandResult);
+    // an io error is as often the camera leaving as a bad transfer
+    bool gone = commandResult->result == UVC_ERROR_NO_DEVICE ||
+                (commandResult->result == UVC_ERROR_IO && uvcDevice->attachment != 0 &&
+                 !deviceIndexPresent(uvcDevice));
+
+    lock.lock();
+    uvcDevice->deadline   = callerDeadline;
+    uvcDevice->cancels    = callerCancels;
+    uvcDevice->cancelMark = callerMark;
+    if (commandResult->result == UVC_ERROR_INTERRUPTED) {
+        session->stats.cancelled++;
+    } else if (sessionGate.refused) {
+        // never sent, the camera may be fine or not
+    } else if (commandResult->result == UVC_ERROR_TIMEOUT) {
+        session->stats.timeouts++;
+        // a caller's own shorter deadline fails only its command
+        if (timeout != 0 && budget >= timeout) {
+            session->unresponsive = true;
+            session->probeAt      = monotonicNanos() + timeout;
+        }
+    } else {
+        session->unresponsive = false;
+    }
+
+    // gone, or answering from a new attachment after resetting between
+    // two commands. either way it has lost its pose.
+    bool reset = commandResult->result == 0 && uvcDevice->attachment != session->attachment;
+    if (session->attachment != 0 && (gone || reset)) {
+        startRecovery(session, uvcDevice);
+    }
+    if (commandResult->result == 0) {
+        session->attachment = uvcDevice->attachment;
+    }
+}
+
+static void sessionWrite(struct CameraSession*     session,
+                         struct UVCDevice*         uvcDevice,
+                         const struct Command*     command,
+                         const struct CommandGate* gate,
+                         const struct WarmCamera*  warm,
+                         struct CommandResult*     commandResult) {
+    int op   = command->op;
+    int axis = commandAxis(op);
+
+    std::unique_lock<std::mutex> lock(session->mutex);
+    session->stats.writes++;
+    if (!(command->flags & COMMAND_SCHEDULED)) {
+        session->stats.operator_writes++;
+    }
+    if (session->config.suppress_writes && !(command->flags & COMMAND_FORCE) &&
+        isNoOpWrite(session, command)) {
+        session->stats.suppressed_writes++;
+        commandResult->result = UVC_SUCCESS;
+        commandResult->error  = NULL;
+        return;
+    }
+    // stops always go out straight away
+    if (!isRelativeStop(command) && !waitForToken(session, lock, op, commandResult)) {
+        return;
+    }
+    session->generation++;
+
+    // until this lands the axis is somewhere unknown
+    for (int other = 0; other < CMD_COUNT; other++) {
+        if (commandAxis(other) == axis) {
+            session->hasCommanded[other] = 0;
+        }
+    }
+
+    sessionTransfer(session, lock, uvcDevice, command, gate, commandResult);
+
+    // a read that raced the write may have cached the old pose
+    session->generation++;
+    if (commandResult->result == 0) {
+        memcpy(session->commanded[op], command->args, sizeof(command->args));
+        session->hasCommanded[op] = 1;
+        for (int other = 0; other < CMD_COUNT; other++) {
+            if (commandAxis(other) == axis) {
+                session->hasAcknowledged[other] = 0;
+            }
+        }
+        if (commandRateClass(op) == RATE_ABSOLUTE) {
+            memcpy(session->acknowledged[op], command->args, sizeof(command->args));
+            session->hasAcknowledged[op] = 1;
+        }
+        estimatorCommand(
+            &session->estimator, &session->config.speed_model, command, monotonicNanos());
+        if (isMotion(op)) {
+            armWatchdog(session, uvcDevice, command);
+        }
+        if (op == CMD_RELATIVE_ZOOM || op == CMD_RELATIVE_PAN_TILT) {
+            settleWarmReads(session, op);
+        }
+    }
+    lock.unlock();
+    if (commandResult->result == 0 && warm != NULL && commandRateClass(op) == RATE_ABSOLUTE) {
+        warmCacheStorePose(warm, command);
+    }
+}
+
+void sessionRun(struct CameraSession* session,
+                struct UVCDevice*     uvcDevice,
+                const struct Command* command,
+                struct CommandResult* commandResult) {
+    sessionRunGated(session, uvcDevice, command, NULL, commandResult);
+}
+
+void sessionRunGated(struct CameraSession*     session,
+                     struct UVCDevice*         uvcDevice,
+                     const struct Command*     command,
+                     const struct CommandGate* gate,
+                     struct CommandResult*     commandResult) {
+    int                      op   = command->op;
+    const struct WarmCamera* warm = warmCamera(session, uvcDevice);
+    if (!commandSpec(op)->read) {
+        sessionWrite(session, uvcDevice, command, gate, warm, commandResult);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(session->mutex);
+    session->stats.reads++;
+
+    // fresh enough cached value
+    uint64_t now = monotonicNanos();
+    if (session->config.read_cache_ms != 0 && session->cachedAt[op] != 0 &&
+        session->cachedGeneration[op] == session->generation &&
+        now - session->cachedAt[op] < (uint64_t)session->config.read_cache_ms * 1000000) {
+        session->stats.cache_hits++;
+        *commandResult = session->cached[op];
+        return;
+    }
+
+    // the first read of its kind since the cache was opened is answered from
+    // it straight away, and checked against the device in the background
+    if (warm != NULL && session->warmState[op] == WARM_COLD) {
+        session->warmState[op] = WARM_DONE;
+        if (warmCacheFind(warm, op, commandResult)) {
+            session->warmState[op] = WARM_CHECKING;
+            session->stats.warm_hits++;
+            lock.unlock();
+
+            struct WarmCheck* check = new WarmCheck();
+            check->session          = session;
+            check->uvcDevice        = *uvcDevice;
+            check->command          = *command;
+            // the caller has its answer, the check runs on the camera's time
+            check->uvcDevice.deadline = 0;
+            sessionSubmitTask(session, runWarmCheck, onWarmChecked, check);
+            return;
+        }
+    }
+
+    // join the read already on the bus, unless a write went out since it started
+    struct Flight* flight = session->flights[op];
+    if (flight != NULL && flight->generation == session->generation) {
+        session->stats.shared_reads++;
+        flight->waiters++;
+        session->landed.wait(lock, [flight] { return flight->finished; });
+        *commandResult = flight->result;
+        if (--flight->waiters == 0) {
+            session->landed.notify_all();
+        }
+        return;
+    }
+
+    // lead a new read
+    struct Flight lead;
+    lead.generation      = session->generation;
+    lead.finished        = false;
+    lead.waiters         = 0;
+    session->flights[op] = &lead;
+    session->stats.device_reads++;
+
+    // callers arriving while this waits for a token join it
+    if (waitForToken(session, lock, op, commandResult)) {
+        sessionTransfer(session, lock, uvcDevice, command, gate, commandResult);
+    }
+    lead.result   = *commandResult;
+    lead.finished = true;
+    if (session->flights[op] == &lead) {
+        session->flights[op] = NULL;
+    }
+    if (commandResult->result == 0) {
+        estimatorObserve(&session->estimator,
+                         &session->config.speed_model,
+                         command,
+                         commandResult,
+                         monotonicNanos());
+    }
+    if (commandResult->result == 0 && lead.generation == session->generation) {
+        session->cached[op]           = *commandResult;
+        session->cachedAt[op]         = monotonicNanos();
+        session->cachedGeneration[op] = lead.generation;
+    }
+    bool checking = session->warmState[op] == WARM_CHECKING;
+    if (commandResult->result == 0) {
+        session->warmState[op] = WARM_DONE;
+    }
+    lock.unlock();
+    session->landed.notify_all();
+
+    // the waiters copy their answer out of this frame before it goes
+    lock.lock();
+    session->landed.wait(lock, [&lead] { return lead.waiters == 0; });
+    lock.unlock();
+
+    if (warm != NULL && commandResult->result == 0) {
+        warmCacheStore(warm, op, commandResult, checking);
+    }
+}
+
+// fail every queued job. called with the session locked, which is dropped
+// for their callbacks.
+static uint32_t failQueued(struct CameraSession*         session,
+                           std::unique_lock<std::mutex>& lock,
+                           uvc_error_t                   result,
+                           const char*                   error) {
+    // watchdog stops stay, the camera would otherwise keep moving
+    std::vector<struct SessionJob> dropped;
+    for (auto job = session->jobs.begin(); job != session->jobs.end();) {
+        if (job->task == runWatchdogStop) {
+            ++job;
+        } else {
+            dropped.push_back(*job);
+            job = session->jobs.erase(job);
+        }
+    }
+    session->stats.pending -= (uint32_t)dropped.size();
+    uint32_t pending = session->stats.pending;
+    lock.unlock();
+
+    struct CommandResult commandResult;
+    commandResult.result = result;
+    commandResult.error  = error;
+    for (const struct SessionJob& job : dropped) {
+        job.done(job.context, &commandResult, pending);
+    }
+    return (uint32_t)dropped.size();
+}
+
+// sleep until, false as soon as the camera is cancelled instead
+static bool recoveryWait(struct CameraSession* session, uint32_t cancelMark, uint64_t until) {
+    for (;;) {
+        if (session->cancels.load(std::memory_order_acquire) != cancelMark) {
+            return false;
+        }
+        uint64_t now = monotonicNanos();
+        if (now >= until) {
+            return true;
+        }
+        sleepUntil(std::min<uint64_t>(until, now + SESSION_CANCEL_POLL_NS));
+    }
+}
+
+// reopen a camera that dropped off the bus, backing off between tries, and
+// send it back to the absolute positions and settings it was last told. the
+// enumeration a reopen needs happens here, on the camera's thread, so the
+// commands queued behind find it indexed and run as if nothing happened.
+static void recoverCamera(void* context, struct CommandResult* commandResult) {
+    struct CameraSession* session = (struct CameraSession*)context;
+    struct UVCDevice      uvcDevice;
+    uint64_t              giveUpAt;
+    uint64_t              timeout;
+    uint32_t              cancelMark = session->cancels.load(std::memory_order_acquire);
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        uvcDevice = session->recoveryDevice;
+        giveUpAt  = session->lostAt + (uint64_t)session->config.recover_ms * 1000000;
+        timeout   = (uint64_t)session->config.timeout_ms * 1000000;
+    }
+
+    uint64_t backoff = SESSION_RECOVER_BACKOFF_MIN_NS;
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            session->stats.recovery_attempts++;
+        }
+        openDevice(&uvcDevice);
+        if (uvcDevice.result == 0) {
+            break;
+        }
+        uint64_t now = monotonicNanos();
+        if (now >= giveUpAt ||
+            !recoveryWait(session, cancelMark, std::min(now + backoff, giveUpAt))) {
+            std::unique_lock<std::mutex> lock(session->mutex);
+            session->recovering = false;
+            session->stats.recovery_failures++;
+            commandResult->result = UVC_ERROR_NO_DEVICE;
+            commandResult->error  = "Camera did not come back";
+            // cancelled, what was queued since runs and finds out for itself
+            if (now >= giveUpAt) {
+                failQueued(session, lock, commandResult->result, commandResult->error);
+            }
+            return;
+        }
+        backoff = std::min<uint64_t>(backoff * 2, SESSION_RECOVER_BACKOFF_MAX_NS);
+    }
+
+    // what the camera held before it went, reads from before are stale
+    struct Command restore[CMD_COUNT];
+    int            count = 0;
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        session->generation++;
+        for (int op = 0; op < CMD_COUNT; op++) {
+            if (session->hasAcknowledged[op]) {
+                restore[count].op    = (uint8_t)op;
+                restore[count].flags = COMMAND_FORCE | COMMAND_SCHEDULED;
+                memcpy(
+                    restore[count].args, session->acknowledged[op], sizeof(restore[count].args));
+                count++;
+            }
+        }
+    }
+    uvcDevice.cancels    = &session->cancels;
+    uvcDevice.cancelMark = cancelMark;
+    for (int i = 0; i < count; i++) {
+        struct CommandResult restored;
+        uvcDevice.deadline = timeout != 0 ? monotonicNanos() + timeout : 0;
+        executeCommand(&uvcDevice, &restore[i], &restored);
+        if (restored.result == 0) {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            memcpy(session->commanded[restore[i].op], restore[i].args, sizeof(restore[i].args));
+            session->hasCommanded[restore[i].op] = 1;
+            estimatorCommand(
+                &session->estimator, &session->config.speed_model, &restore[i], monotonicNanos());
+        }
+    }
+    closeDevice(&uvcDevice);
+
+    std::lock_guard<std::mutex> lock(session->mutex);
+    session->generation++;
+    session->recovering             = false;
+    session->unresponsive           = false;
+    session->attachment             = uvcDevice.attachment;
+    session->stats.recoveries++;
+    session->stats.last_recovery_ms = (uint32_t)((monotonicNanos() - session->lostAt) / 1000000);
+    commandResult->result           = UVC_SUCCESS;
+    commandResult->error            = NULL;
+}
+
+static void onRecovered(void*                       context,
+                        const struct CommandResult* commandResult,
+                        uint32_t                    pending) {}
+
+// the camera's own thread, draining its queue of async commands
+static void sessionWorker(struct CameraSession* session) {
+    realtimeEnter();
+    std::vector<struct SessionJob> batch;
+    std::unique_lock<std::mutex>   lock(session->mutex);
+    for (;;) {
+        session->queued.wait(lock, [session] { return !session->jobs.empty(); });
+
+        // identical reads queued before the next write share one run
+        batch.clear();
+        batch.push_back(session->jobs.front());
+        session->jobs.pop_front();
+        const struct Command* command = &batch[0].command;
+        if (batch[0].task == NULL && commandSpec(command->op)->read) {
+            for (auto job = session->jobs.begin(); job != session->jobs.end();) {
+                if (job->task != NULL || !commandSpec(job->command.op)->read) {
+                    break;
+                }
+                if (job->command.op == command->op) {
+                    batch.push_back(*job);
+                    job = session->jobs.erase(job);
+                } else {
+                    ++job;
+                }
+            }
+            session->stats.reads += batch.size() - 1;
+            session->stats.shared_reads += batch.size() - 1;
+        }
+        lock.unlock();
+
+        struct CommandResult commandResult;
+        if (batch[0].task != NULL) {
+            batch[0].task(batch[0].context, &commandResult);
+        } else {
+            sessionRun(session, &batch[0].uvcDevice, command, &commandResult);
+        }
+
+        lock.lock();
+        // lost with the camera, they run again once it is back
+        if (batch[0].task == NULL && !batch[0].replayed && session->recovering &&
+            commandResult.result == UVC_ERROR_NO_DEVICE) {
+            auto at = session->jobs.begin();
+            if (at != session->jobs.end() && at->task == recoverCamera) {
+                ++at;
+            }
+            for (struct SessionJob& job : batch) {
+                job.replayed = true;
+            }
+            session->jobs.insert(at, batch.begin(), batch.end());
+            session->stats.replayed += batch.size();
+            continue;
+        }
+        session->stats.pending -= (uint32_t)batch.size();
+        uint32_t pending = session->stats.pending;
+        lock.unlock();
+
+        for (const struct SessionJob& job : batch) {
+            job.done(job.context, &commandResult, pending);
+        }
+        lock.lock();
+    }
+}
+
+static uint32_t enqueue(struct CameraSession* session, const struct SessionJob* job) {
+    std::unique_lock<std::mutex> lock(session->mutex);
+    if (session->config.max_pending != 0 && session->stats.pending >= session->config.max_pending) {
+        session->stats.rate_rejected++;
+        uint32_t pending = session->stats.pending;
+        lock.unlock();
+
+        struct CommandResult commandResult;
+        commandResult.result = UVC_ERROR_BUSY;
+        commandResult.error  = "Too many pending commands";
+        job->done(job->context, &commandResult, pending);
+        return pending;
+    }
+
+    if (!session->worker.joinable()) {
+        session->worker = std::thread(sessionWorker, session);
+    }
+
+    session->jobs.push_back(*job);
+    session->stats.pending++;
+    session->queued.notify_one();
+    return session->stats.pending;
+}
+
+uint32_t sessionSubmit(struct CameraSession*   session,
+                       const struct UVCDevice* uvcDevice,
+                       const struct Command*   command,
+                       CommandCompletion       done,
+                       void*                   context) {
+    struct SessionJob job;
+    job.uvcDevice = *uvcDevice;
+    job.command   = *command;
+    job.task      = NULL;
+    job.done      = done;
+    job.context   = context;
+    job.replayed  = false;
+    return enqueue(session, &job);
+}
+
+uint32_t sessionSubmitTask(struct CameraSession* session,
+                           SessionTask           task,
+                           CommandCompletion     done,
+                           void*                 context) {
+    struct SessionJob job = {};
+    job.task              = task;
+    job.done              = done;
+    job.context           = context;
+    return enqueue(session, &job);
+}
+
+uint32_t sessionCancel(struct CameraSession* session) {
+    std::unique_lock<std::mutex> lock(session->mutex);
+    session->cancels.fetch_add(1, std::memory_order_release);
+    // a recovery that has not started goes too, the next command to find
+    // the camera gone starts another
+    if (!session->jobs.empty() && session->jobs.front().task == recoverCamera) {
+        session->jobs.pop_front();
+        session->stats.pending--;
+        session->recovering = false;
+    }
+    session->stats.cancelled += std::count_if(
+        session->jobs.begin(), session->jobs.end(), [](const struct SessionJob& job) {
+            return job.task != runWatchdogStop;
+        });
+    return failQueued(session, lock, UVC_ERROR_INTERRUPTED, "Command cancelled");
+}
+
+}  // namespace ptz
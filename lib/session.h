@@ -0,0 +1,145 @@
+#ifndef PTZ_SESSION_H
+#define PTZ_SESSION_H
+
+#include <stdint.h>
+#include "command.h"
+#include "estimator.h"
+#include "pointing.h"
+
+namespace ptz {
+
+// process wide state per camera, shared by every caller that talks to it.
+// sessions are keyed by vendor/product, serial and port as passed in (0:0 is
+// its own key) and live for the life of the process.
+struct CameraSession;
+struct CameraSession* sessionFind(const struct UVCDevice* uvcDevice);
+
+// token buckets limiting what reaches the device, one per class of command
+enum RateClass { RATE_READ = 0, RATE_ABSOLUTE, RATE_RELATIVE, RATE_CLASS_COUNT };
+int commandRateClass(int op);
+
+struct RateLimit {
+    double rate;   // commands per second, 0 is unlimited
+    double burst;  // commands allowed back to back after a quiet spell
+};
+
+enum RatePolicy {
+    RATE_POLICY_QUEUE = 0,  // wait for a token
+    RATE_POLICY_REJECT,     // fail with UVC_ERROR_BUSY
+};
+
+// the longest a command may take on the device unless configured otherwise
+#define SESSION_TIMEOUT_MS 2000
+
+struct SessionConfig {
+    uint32_t          read_cache_ms;    // serve reads from the last result this young, 0 disables
+    int               suppress_writes;  // skip absolute sets matching the last one, on by default
+    struct RateLimit  rate_limits[RATE_CLASS_COUNT];
+    int               rate_policy;
+    uint32_t          max_pending;  // queued async commands before submits fail, 0 is unbounded
+    uint32_t          watchdog_ms;  // stop relative motion this long after its last command, 0 off
+    uint32_t          timeout_ms;   // longest a command may take on the device, 0 waits forever
+    uint32_t          recover_ms;   // how long to keep reopening a camera gone from the bus, 0 off
+    struct SpeedModel speed_model;  // for estimating position between reads
+    struct FovTable   fov;          // field of view by zoom, for pointing
+};
+void sessionGetConfig(struct CameraSession* session, struct SessionConfig* config);
+void sessionSetConfig(struct CameraSession* session, const struct SessionConfig* config);
+
+struct SessionStats {
+    uint64_t reads;              // read commands asked for
+    uint64_t cache_hits;         // answered from the cache
+    uint64_t shared_reads;       // joined a read already in flight
+    uint64_t device_reads;       // went to the device
+    uint64_t writes;             // write commands asked for
+    uint64_t suppressed_writes;  // absolute sets skipped as no-ops
+    uint64_t rate_delayed;       // commands that waited for a token
+    uint64_t rate_rejected;      // commands failed for lack of a token or queue space
+    uint32_t pending;            // async commands queued or running
+    uint64_t watchdog_stops;     // relative moves stopped by the watchdog
+    uint64_t operator_writes;    // writes not sent by a native scheduler
+    uint64_t warm_hits;          // reads answered from the warm start cache
+    uint64_t timeouts;           // commands that ran out of time, queued or on the device
+    uint64_t fast_failures;      // failed at once while the camera was not responding or away
+    uint64_t cancelled;          // queued or in flight when the camera was cancelled
+    uint64_t disconnects;        // times the camera dropped off the bus or reset
+    uint64_t recoveries;         // times it was reopened and sent back where it was
+    uint64_t recovery_failures;  // times it stayed away for all of recover_ms
+    uint64_t recovery_attempts;  // reopens tried while it was away
+    uint64_t replayed;           // queued commands run again once it was back
+    uint32_t last_recovery_ms;   // from losing it to having it back, the last time
+};
+void sessionGetStats(struct CameraSession* session, struct SessionStats* stats);
+
+// what sessionCancel bumps. transfers made outside sessionRun, on a device a
+// task opened itself, point uvcDevice->cancels here with cancelMark taken
+// when they start, and give up on the next cancel.
+const std::atomic<uint32_t>* sessionCancels(struct CameraSession* session);
+
+// where the camera should be now, from what was last read and every move
+// sent since, without touching the device
+void sessionEstimate(struct CameraSession* session, struct Estimate* estimate);
+
+// runCommand with the session in front of it. a command without a deadline
+// of its own gets the camera's timeout_ms. once a command has let the
+// camera run out that timeout, the camera counts as not responding: every
+// command fails straight away with UVC_ERROR_TIMEOUT, except for one per
+// timeout_ms that goes through to see whether it answers again. a camera
+// seen before that fails with UVC_ERROR_NO_DEVICE, or with UVC_ERROR_IO and
+// is no longer where it was, or that answers from a new bus address after a
+// reset, is recovered on its own thread: reopened with backoff for up to
+// recover_ms, sent back to its last absolute pan/tilt, zoom and control
+// values, and then the commands queued behind it run, the one lost with it
+// included. until then commands fail at once with UVC_ERROR_NO_DEVICE, and
+// if it never comes back the queue fails with it. identical reads issued while
+// one is in flight wait for it and share its result instead of opening the
+// device again. writes invalidate the cache and never join anything. an
+// absolute set equal to the last one sent, or within the control's
+// resolution of it, succeeds without touching the device unless forced.
+// with a warm start cache open, the first read of each kind is answered
+// from it and the device read that checks it is queued behind.
+void sessionRun(struct CameraSession* session,
+                struct UVCDevice*     uvcDevice,
+                const struct Command* command,
+                struct CommandResult* commandResult);
+// sessionRun, passing gate to runCommandGated. the gate is skipped when the
+// command never reaches the device. time spent at the gate is not taken out
+// of the command's deadline, and a command the gate fails never counts
+// against the camera.
+void sessionRunGated(struct CameraSession*     session,
+                     struct UVCDevice*         uvcDevice,
+                     const struct Command*     command,
+                     const struct CommandGate* gate,
+                     struct CommandResult*     commandResult);
+
+// queue a command for the camera's own thread, which runs queued commands in
+// order. done is called on that thread, or right away when the queue is full,
+// with the number of commands still pending. queued reads identical to the
+// one being run share its result. returns the pending count after queueing.
+typedef void (*CommandCompletion)(void*                       context,
+                                  const struct CommandResult* commandResult,
+                                  uint32_t                    pending);
+uint32_t sessionSubmit(struct CameraSession*   session,
+                       const struct UVCDevice* uvcDevice,
+                       const struct Command*   command,
+                       CommandCompletion       done,
+                       void*                   context);
+
+// queue work of the caller's own, such as a move made of several commands,
+// in line with the camera's commands. task runs on the camera's thread and
+// fills in the result handed to done.
+typedef void (*SessionTask)(void* context, struct CommandResult* commandResult);
+uint32_t sessionSubmitTask(struct CameraSession* session,
+                           SessionTask           task,
+                           CommandCompletion     done,
+                           void*                 context);
+
+// fail every queued command with UVC_ERROR_INTERRUPTED and abort the
+// transfers in flight on the camera. tasks already running carry on with
+// their next command. stops the watchdog has queued still go out. returns
+// the number of queued commands dropped.
+uint32_t sessionCancel(struct CameraSession* session);
+
+}  // namespace ptz
+
+#endif  // PTZ_SESSION_H
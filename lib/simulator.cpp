@@ -0,0 +1,741 @@
+#include "simulator.h"
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include "control.h"
+#include "device.h"
+#include "stats.h"
+
+namespace ptz {
+
+// limits reported by the simulated camera terminal
+#define SIM_PAN_MIN (-170 * 3600)
+#define SIM_PAN_MAX (170 * 3600)
+#define SIM_TILT_MIN (-30 * 3600)
+#define SIM_TILT_MAX (90 * 3600)
+#define SIM_PAN_TILT_RES 3600
+#define SIM_ZOOM_MIN 0
+#define SIM_ZOOM_MAX 16384
+#define SIM_PAN_SPEED_MAX 24
+#define SIM_TILT_SPEED_MAX 20
+#define SIM_ZOOM_SPEED_MAX 7
+#define SIM_ROLL_MIN (-180)
+#define SIM_ROLL_MAX 180
+#define SIM_ROLL_SPEED_MAX 10
+#define SIM_ROLL_SPEED 3.0  // degrees per second per relative speed step
+
+// the rest of the camera terminal, one value each that takes effect at once.
+// a control with a mode bitmap accepts one of its resolution's bits.
+struct SimRegister {
+    uint8_t selector;
+    int     bitmap;
+    int32_t min;
+    int32_t max;
+    int32_t resolution;
+    int32_t def;
+};
+
+static const struct SimRegister simRegisters[] = {
+    {UVC_CT_AE_MODE_CONTROL, 1, 0, 0, 0x09, 0x08},  // manual or aperture priority
+    {UVC_CT_AE_PRIORITY_CONTROL, 0, 0, 1, 1, 0},
+    {UVC_CT_EXPOSURE_TIME_ABSOLUTE_CONTROL, 0, 3, 2047, 1, 156},
+    {UVC_CT_FOCUS_ABSOLUTE_CONTROL, 0, 0, 250, 5, 0},
+    {UVC_CT_FOCUS_AUTO_CONTROL, 0, 0, 1, 1, 1},
+    {UVC_CT_IRIS_ABSOLUTE_CONTROL, 0, 180, 1600, 10, 280},
+    {UVC_CT_PRIVACY_CONTROL, 0, 0, 1, 1, 0},
+};
+#define SIM_REGISTER_COUNT (int)(sizeof(simRegisters) / sizeof(simRegisters[0]))
+
+struct SimCamera {
+    std::mutex mutex;  // held for the duration of a transfer, like the control endpoint
+    int        vendorId;
+    int        productId;
+    uint64_t   rng;
+    uint64_t   updated;  // monotonicNanos() of the last physics step
+    double     pan;
+    double     tilt;
+    double     zoom;
+    double     target_pan;  // absolute move in progress when moving_abs is set
+    double     target_tilt;
+    double     target_zoom;
+    int        moving_pan_tilt_abs;
+    int        moving_zoom_abs;
+    int8_t     pan_direction;  // relative move in progress
+    uint8_t    pan_speed;
+    int8_t     tilt_direction;
+    uint8_t    tilt_speed;
+    int8_t     zoom_direction;
+    uint8_t    zoom_speed;
+    double     roll;
+    double     target_roll;
+    int        moving_roll_abs;
+    int8_t     roll_direction;
+    uint8_t    roll_speed;
+    int32_t    registers[SIM_REGISTER_COUNT];
+    bool       unplugged;
+    uint32_t   attachment;  // bumped by every replug
+
+    std::atomic<bool> hung;
+};
+
+// fixed size, so opening a camera already made never allocates
+struct SimKey {
+    int  vendorId;
+    int  productId;
+    char serial[DEVICE_SERIAL_SIZE];
+    char port[DEVICE_PORT_SIZE];
+
+    bool operator<(const struct SimKey& other) const {
+        if (vendorId != other.vendorId || productId != other.productId) {
+            return std::tie(vendorId, productId) < std::tie(other.vendorId, other.productId);
+        }
+        int serialOrder = strcmp(serial, other.serial);
+        return serialOrder != 0 ? serialOrder < 0 : strcmp(port, other.port) < 0;
+    }
+};
+
+static std::mutex                                 simMutex;
+static std::map<struct SimKey, struct SimCamera*> simCameras;
+static struct SimConfig simConfig = {1000, 200, 2000, 0.0, 1800.0, 1800.0, 400.0, 0x0100};
+
+void simGetConfig(struct SimConfig* config) {
+    std::lock_guard<std::mutex> lock(simMutex);
+    *config = simConfig;
+}
+
+void simSetConfig(const struct SimConfig* config) {
+    std::lock_guard<std::mutex> lock(simMutex);
+    simConfig = *config;
+}
+
+struct SimCamera* simFindCamera(int         vendorId,
+                                int         productId,
+                                const char* serial,
+                                const char* port) {
+    struct SimKey key;
+    key.vendorId  = vendorId;
+    key.productId = productId;
+    snprintf(key.serial, sizeof(key.serial), "%s", serial);
+    snprintf(key.port, sizeof(key.port), "%s", port);
+
+    std::lock_guard<std::mutex> lock(simMutex);
+    auto                        it = simCameras.find(key);
+    if (it != simCameras.end()) {
+        return it->second;
+    }
+
+    struct SimCamera* camera = new SimCamera();
+    camera->vendorId         = vendorId;
+    camera->productId        = productId;
+    camera->rng              = 0x9e3779b97f4a7c15ull ^ ((uint64_t)vendorId << 16 | productId);
+    camera->updated          = monotonicNanos();
+    camera->hung             = false;
+    camera->unplugged        = false;
+    camera->attachment       = 1;
+    for (int i = 0; i < SIM_REGISTER_COUNT; i++) {
+        camera->registers[i] = simRegisters[i].def;
+    }
+    simCameras[key] = camera;
+    return camera;
+}
+
+static uint64_t nextRandom(struct SimCamera* camera) {
+    // xorshift64
+    camera->rng ^= camera->rng << 13;
+    camera->rng ^= camera->rng >> 7;
+    camera->rng ^= camera->rng << 17;
+    return camera->rng;
+}
+
+static double clamp(double value, double min, double max) {
+    return value < min ? min : (value > max ? max : value);
+}
+
+static double approach(double value, double target, double step) {
+    if (value < target) {
+        return value + step > target ? target : value + step;
+    }
+    return value - step < target ? target : value - step;
+}
+
+// advance the motion model to now
+static void step(struct SimCamera* camera, const struct SimConfig* config) {
+    uint64_t now     = monotonicNanos();
+    double   seconds = (double)(now - camera->updated) / 1e9;
+    camera->updated  = now;
+
+    if (camera->moving_pan_tilt_abs) {
+        camera->pan  = approach(camera->pan,
+                               camera->target_pan,
+                               config->pan_speed * SIM_PAN_SPEED_MAX * seconds);
+        camera->tilt = approach(camera->tilt,
+                                camera->target_tilt,
+                                config->tilt_speed * SIM_TILT_SPEED_MAX * seconds);
+        camera->moving_pan_tilt_abs =
+            camera->pan != camera->target_pan || camera->tilt != camera->target_tilt;
+    } else {
+        camera->pan += camera->pan_direction * camera->pan_speed * config->pan_speed * seconds;
+        camera->tilt += camera->tilt_direction * camera->tilt_speed * config->tilt_speed * seconds;
+        camera->pan  = clamp(camera->pan, SIM_PAN_MIN, SIM_PAN_MAX);
+        camera->tilt = clamp(camera->tilt, SIM_TILT_MIN, SIM_TILT_MAX);
+    }
+
+    if (camera->moving_zoom_abs) {
+        camera->zoom = approach(
+            camera->zoom, camera->target_zoom, config->zoom_speed * SIM_ZOOM_SPEED_MAX * seconds);
+        camera->moving_zoom_abs = camera->zoom != camera->target_zoom;
+    } else {
+        camera->zoom += camera->zoom_direction * camera->zoom_speed * config->zoom_speed * seconds;
+        camera->zoom = clamp(camera->zoom, SIM_ZOOM_MIN, SIM_ZOOM_MAX);
+    }
+
+    if (camera->moving_roll_abs) {
+        camera->roll = approach(
+            camera->roll, camera->target_roll, SIM_ROLL_SPEED * SIM_ROLL_SPEED_MAX * seconds);
+        camera->moving_roll_abs = camera->roll != camera->target_roll;
+    } else {
+        camera->roll += camera->roll_direction * camera->roll_speed * SIM_ROLL_SPEED * seconds;
+        camera->roll = clamp(camera->roll, SIM_ROLL_MIN, SIM_ROLL_MAX);
+    }
+}
+
+// occupy the control endpoint for one transfer, then maybe fail it
+static uvc_error_t transfer(struct SimCamera* camera, struct SimConfig* config) {
+    simGetConfig(config);
+    if (camera->unplugged) {
+        return UVC_ERROR_NO_DEVICE;
+    }
+    uint64_t latency = (uint64_t)config->transfer_latency_us * 1000;
+    if (config->transfer_jitter_us > 0) {
+        uint64_t jitter = (uint64_t)config->transfer_jitter_us * 1000;
+        latency += nextRandom(camera) % (2 * jitter + 1);
+        latency = latency > jitter ? latency - jitter : 0;
+    }
+    sleepUntil(monotonicNanos() + latency);
+    step(camera, config);
+    if (config->error_rate > 0 &&
+        (double)(nextRandom(camera) % 1000000) < config->error_rate * 1000000.0) {
+        return UVC_ERROR_IO;
+    }
+    return UVC_SUCCESS;
+}
+
+uvc_error_t simOpen(struct SimCamera* camera) {
+    struct SimConfig config;
+    simGetConfig(&config);
+    sleepUntil(monotonicNanos() + (uint64_t)config.open_latency_us * 1000);
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    return camera->unplugged ? UVC_ERROR_NO_DEVICE : UVC_SUCCESS;
+}
+
+void simClose(struct SimCamera* camera) {}
+
+void simSetHung(struct SimCamera* camera, bool hung) {
+    camera->hung.store(hung, std::memory_order_release);
+}
+
+bool simIsHung(struct SimCamera* camera) {
+    return camera->hung.load(std::memory_order_acquire);
+}
+
+void simSetUnplugged(struct SimCamera* camera, bool unplugged) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    if (camera->unplugged && !unplugged) {
+        // powered up again at home, with every register at its default
+        camera->attachment++;
+        camera->updated             = monotonicNanos();
+        camera->pan                 = 0;
+        camera->tilt                = 0;
+        camera->zoom                = 0;
+        camera->roll                = 0;
+        camera->moving_pan_tilt_abs = 0;
+        camera->moving_zoom_abs     = 0;
+        camera->moving_roll_abs     = 0;
+        camera->pan_direction       = 0;
+        camera->tilt_direction      = 0;
+        camera->zoom_direction      = 0;
+        camera->roll_direction      = 0;
+        for (int i = 0; i < SIM_REGISTER_COUNT; i++) {
+            camera->registers[i] = simRegisters[i].def;
+        }
+    }
+    camera->unplugged = unplugged;
+}
+
+uint32_t simAttachment(struct SimCamera* camera) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    return camera->attachment;
+}
+
+uvc_error_t simGetZoomAbs(struct SimCamera* camera,
+                          uint16_t*         focal_length,
+                          enum uvc_req_code requestCode) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    switch (requestCode) {
+        case UVC_GET_MIN:
+            *focal_length = SIM_ZOOM_MIN;
+            break;
+        case UVC_GET_MAX:
+            *focal_length = SIM_ZOOM_MAX;
+            break;
+        case UVC_GET_RES:
+            *focal_length = 1;
+            break;
+        case UVC_GET_DEF:
+            *focal_length = SIM_ZOOM_MIN;
+            break;
+        default:
+            *focal_length = (uint16_t)(camera->zoom + 0.5);
+            break;
+    }
+    return UVC_SUCCESS;
+}
+
+uvc_error_t simSetZoomAbs(struct SimCamera* camera, uint16_t focal_length) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    camera->target_zoom     = clamp(focal_length, SIM_ZOOM_MIN, SIM_ZOOM_MAX);
+    camera->moving_zoom_abs = 1;
+    camera->zoom_direction  = 0;
+    return UVC_SUCCESS;
+}
+
+uvc_error_t simGetZoomRel(struct SimCamera* camera,
+                          int8_t*           zoom_rel,
+                          uint8_t*          digital_zoom,
+                          uint8_t*          speed,
+                          enum uvc_req_code requestCode) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    *zoom_rel     = camera->zoom_direction;
+    *digital_zoom = 0;
+    switch (requestCode) {
+        case UVC_GET_MIN:
+        case UVC_GET_RES:
+        case UVC_GET_DEF:
+            *speed = 1;
+            break;
+        case UVC_GET_MAX:
+            *speed = SIM_ZOOM_SPEED_MAX;
+            break;
+        default:
+            *speed = camera->zoom_speed;
+            break;
+    }
+    return UVC_SUCCESS;
+}
+
+uvc_error_t simSetZoomRel(struct SimCamera* camera,
+                          int8_t            zoom_rel,
+                          uint8_t           digital_zoom,
+                          uint8_t           speed) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    if (speed > SIM_ZOOM_SPEED_MAX) {
+        return UVC_ERROR_PIPE;
+    }
+    camera->moving_zoom_abs = 0;
+    camera->zoom_direction  = zoom_rel > 0 ? 1 : (zoom_rel < 0 ? -1 : 0);
+    camera->zoom_speed      = speed;
+    return UVC_SUCCESS;
+}
+
+uvc_error_t simGetPanTiltAbs(struct SimCamera* camera,
+                             int32_t*          pan,
+                             int32_t*          tilt,
+                             enum uvc_req_code requestCode) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    switch (requestCode) {
+        case UVC_GET_MIN:
+            *pan  = SIM_PAN_MIN;
+            *tilt = SIM_TILT_MIN;
+            break;
+        case UVC_GET_MAX:
+            *pan  = SIM_PAN_MAX;
+            *tilt = SIM_TILT_MAX;
+            break;
+        case UVC_GET_RES:
+            *pan  = SIM_PAN_TILT_RES;
+            *tilt = SIM_PAN_TILT_RES;
+            break;
+        case UVC_GET_DEF:
+            *pan  = 0;
+            *tilt = 0;
+            break;
+        default:
+            *pan  = (int32_t)(camera->pan < 0 ? camera->pan - 0.5 : camera->pan + 0.5);
+            *tilt = (int32_t)(camera->tilt < 0 ? camera->tilt - 0.5 : camera->tilt + 0.5);
+            break;
+    }
+    return UVC_SUCCESS;
+}
+
+uvc_error_t simSetPanTiltAbs(struct SimCamera* camera, int32_t pan, int32_t tilt) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    camera->target_pan          = clamp(pan, SIM_PAN_MIN, SIM_PAN_MAX);
+    camera->target_tilt         = clamp(tilt, SIM_TILT_MIN, SIM_TILT_MAX);
+    camera->moving_pan_tilt_abs = 1;
+    camera->pan_direction       = 0;
+    camera->tilt_direction      = 0;
+    return UVC_SUCCESS;
+}
+
+uvc_error_t simGetPanTiltRel(struct SimCamera* camera,
+                             int8_t*           pan_rel,
+                             uint8_t*          pan_speed,
+                             int8_t*           tilt_rel,
+                             uint8_t*          tilt_speed,
+                             enum uvc_req_code requestCode) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    *pan_rel  = camera->pan_direction;
+    *tilt_rel = camera->tilt_direction;
+    switch (requestCode) {
+        case UVC_GET_MIN:
+        case UVC_GET_RES:
+        case UVC_GET_DEF:
+            *pan_speed  = 1;
+            *tilt_speed = 1;
+            break;
+        case UVC_GET_MAX:
+            *pan_speed  = SIM_PAN_SPEED_MAX;
+            *tilt_speed = SIM_TILT_SPEED_MAX;
+            break;
+        default:
+            *pan_speed  = camera->pan_speed;
+            *tilt_speed = camera->tilt_speed;
+            break;
+    }
+    return UVC_SUCCESS;
+}
+
+uvc_error_t simSetPanTiltRel(struct SimCamera* camera,
+                             int8_t            pan_rel,
+                             uint8_t           pan_speed,
+                             int8_t            tilt_rel,
+                             uint8_t           tilt_speed) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    if (pan_speed > SIM_PAN_SPEED_MAX || tilt_speed > SIM_TILT_SPEED_MAX) {
+        return UVC_ERROR_PIPE;
+    }
+    camera->moving_pan_tilt_abs = 0;
+    camera->pan_direction       = pan_rel > 0 ? 1 : (pan_rel < 0 ? -1 : 0);
+    camera->pan_speed           = pan_speed;
+    camera->tilt_direction      = tilt_rel > 0 ? 1 : (tilt_rel < 0 ? -1 : 0);
+    camera->tilt_speed          = tilt_speed;
+    return UVC_SUCCESS;
+}
+
+uvc_error_t simGetRollAbs(struct SimCamera* camera, int16_t* roll, enum uvc_req_code requestCode) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    switch (requestCode) {
+        case UVC_GET_MIN:
+            *roll = SIM_ROLL_MIN;
+            break;
+        case UVC_GET_MAX:
+            *roll = SIM_ROLL_MAX;
+            break;
+        case UVC_GET_RES:
+            *roll = 1;
+            break;
+        case UVC_GET_DEF:
+            *roll = 0;
+            break;
+        default:
+            *roll = (int16_t)(camera->roll < 0 ? camera->roll - 0.5 : camera->roll + 0.5);
+            break;
+    }
+    return UVC_SUCCESS;
+}
+
+static uvc_error_t simSetRollAbs(struct SimCamera* camera, int16_t roll) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    camera->target_roll     = clamp(roll, SIM_ROLL_MIN, SIM_ROLL_MAX);
+    camera->moving_roll_abs = 1;
+    camera->roll_direction  = 0;
+    return UVC_SUCCESS;
+}
+
+uvc_error_t simGetRollRel(struct SimCamera* camera,
+                          int8_t*           roll_rel,
+                          uint8_t*          speed,
+                          enum uvc_req_code requestCode) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    *roll_rel = camera->roll_direction;
+    switch (requestCode) {
+        case UVC_GET_MIN:
+        case UVC_GET_RES:
+        case UVC_GET_DEF:
+            *speed = 1;
+            break;
+        case UVC_GET_MAX:
+            *speed = SIM_ROLL_SPEED_MAX;
+            break;
+        default:
+            *speed = camera->roll_speed;
+            break;
+    }
+    return UVC_SUCCESS;
+}
+
+static uvc_error_t simSetRollRel(struct SimCamera* camera, int8_t roll_rel, uint8_t speed) {
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    if (speed > SIM_ROLL_SPEED_MAX) {
+        return UVC_ERROR_PIPE;
+    }
+    camera->moving_roll_abs = 0;
+    camera->roll_direction  = roll_rel > 0 ? 1 : (roll_rel < 0 ? -1 : 0);
+    camera->roll_speed      = speed;
+    return UVC_SUCCESS;
+}
+
+// index of the register behind a selector, -1 when the camera has none
+static int findRegister(uint8_t selector) {
+    for (int i = 0; i < SIM_REGISTER_COUNT; i++) {
+        if (simRegisters[i].selector == selector) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// a range request the control doesn't have stalls, as it does on hardware
+static bool answers(const struct ControlSpec* spec, enum uvc_req_code requestCode) {
+    switch (requestCode) {
+        case UVC_GET_MIN:
+            return spec->ranges & CONTROL_HAS_MIN;
+        case UVC_GET_MAX:
+            return spec->ranges & CONTROL_HAS_MAX;
+        case UVC_GET_RES:
+            return spec->ranges & CONTROL_HAS_RES;
+        case UVC_GET_DEF:
+            return spec->ranges & CONTROL_HAS_DEF;
+        default:
+            return true;
+    }
+}
+
+static void put16(uint8_t* data, uint16_t value) {
+    data[0] = (uint8_t)value;
+    data[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t* data, uint32_t value) {
+    put16(data, (uint16_t)value);
+    put16(data + 2, (uint16_t)(value >> 16));
+}
+
+static uint16_t get16(const uint8_t* data) {
+    return (uint16_t)(data[0] | data[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* data) {
+    return get16(data) | (uint32_t)get16(data + 2) << 16;
+}
+
+static uvc_error_t getRegister(struct SimCamera*         camera,
+                               const struct ControlSpec* spec,
+                               uint8_t*                  data,
+                               enum uvc_req_code         requestCode) {
+    int                         index = findRegister(spec->selector);
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    if (index < 0) {
+        return UVC_ERROR_PIPE;
+    }
+    const struct SimRegister* reg = &simRegisters[index];
+    int32_t value;
+    switch (requestCode) {
+        case UVC_GET_MIN:
+            value = reg->min;
+            break;
+        case UVC_GET_MAX:
+            value = reg->max;
+            break;
+        case UVC_GET_RES:
+            value = reg->resolution;
+            break;
+        case UVC_GET_DEF:
+            value = reg->def;
+            break;
+        default:
+            value = camera->registers[index];
+            break;
+    }
+    // registers are one field, little endian truncates to its width
+    uint8_t bytes[4];
+    put32(bytes, (uint32_t)value);
+    memcpy(data, bytes, controlLength(*spec));
+    return UVC_SUCCESS;
+}
+
+static uvc_error_t setRegister(struct SimCamera*         camera,
+                               const struct ControlSpec* spec,
+                               const uint8_t*            data) {
+    int                         index = findRegister(spec->selector);
+    std::lock_guard<std::mutex> lock(camera->mutex);
+    struct SimConfig            config;
+    uvc_error_t                 result = transfer(camera, &config);
+    if (result != 0) {
+        return result;
+    }
+    if (index < 0) {
+        return UVC_ERROR_PIPE;
+    }
+    const struct SimRegister* reg = &simRegisters[index];
+    uint8_t padded[4] = {0, 0, 0, 0};
+    memcpy(padded, data, controlLength(*spec));
+    int32_t value = (int32_t)get32(padded);
+    bool    valid = reg->bitmap ? value != 0 && (value & (value - 1)) == 0 &&
+                                   (value & reg->resolution) == value
+                                : value >= reg->min && value <= reg->max;
+    if (!valid) {
+        return UVC_ERROR_PIPE;
+    }
+    camera->registers[index] = value;
+    return UVC_SUCCESS;
+}
+
+uvc_error_t simGetControl(struct SimCamera* camera,
+                          uint8_t           selector,
+                          uint8_t*          data,
+                          int               length,
+                          enum uvc_req_code requestCode) {
+    const struct ControlSpec* spec = controlBySelector(selector);
+    if (spec == NULL || controlLength(*spec) != length) {
+        return UVC_ERROR_INVALID_PARAM;
+    }
+    if (!answers(spec, requestCode)) {
+        return UVC_ERROR_PIPE;
+    }
+
+    uvc_error_t result;
+    switch (selector) {
+        case UVC_CT_ZOOM_ABSOLUTE_CONTROL: {
+            uint16_t zoom = 0;
+            result = simGetZoomAbs(camera, &zoom, requestCode);
+            put16(data, zoom);
+            break;
+        }
+        case UVC_CT_ZOOM_RELATIVE_CONTROL:
+            result = simGetZoomRel(camera, (int8_t*)&data[0], &data[1], &data[2], requestCode);
+            break;
+        case UVC_CT_PANTILT_ABSOLUTE_CONTROL: {
+            int32_t pan  = 0;
+            int32_t tilt = 0;
+            result = simGetPanTiltAbs(camera, &pan, &tilt, requestCode);
+            put32(data, (uint32_t)pan);
+            put32(data + 4, (uint32_t)tilt);
+            break;
+        }
+        case UVC_CT_PANTILT_RELATIVE_CONTROL:
+            result = simGetPanTiltRel(
+                camera, (int8_t*)&data[0], &data[1], (int8_t*)&data[2], &data[3], requestCode);
+            break;
+        case UVC_CT_ROLL_ABSOLUTE_CONTROL: {
+            int16_t roll = 0;
+            result = simGetRollAbs(camera, &roll, requestCode);
+            put16(data, (uint16_t)roll);
+            break;
+        }
+        case UVC_CT_ROLL_RELATIVE_CONTROL:
+            result = simGetRollRel(camera, (int8_t*)&data[0], &data[1], requestCode);
+            break;
+        default:
+            result = getRegister(camera, spec, data, requestCode);
+            break;
+    }
+    return result;
+}
+
+uvc_error_t simSetControl(struct SimCamera* camera,
+                          uint8_t           selector,
+                          const uint8_t*    data,
+                          int               length) {
+    const struct ControlSpec* spec = controlBySelector(selector);
+    if (spec == NULL || controlLength(*spec) != length) {
+        return UVC_ERROR_INVALID_PARAM;
+    }
+
+    switch (selector) {
+        case UVC_CT_ZOOM_ABSOLUTE_CONTROL:
+            return simSetZoomAbs(camera, get16(data));
+        case UVC_CT_ZOOM_RELATIVE_CONTROL:
+            return simSetZoomRel(camera, (int8_t)data[0], data[1], data[2]);
+        case UVC_CT_PANTILT_ABSOLUTE_CONTROL:
+            return simSetPanTiltAbs(camera, (int32_t)get32(data), (int32_t)get32(data + 4));
+        case UVC_CT_PANTILT_RELATIVE_CONTROL:
+            return simSetPanTiltRel(camera, (int8_t)data[0], data[1], (int8_t)data[2], data[3]);
+        case UVC_CT_ROLL_ABSOLUTE_CONTROL:
+            return simSetRollAbs(camera, (int16_t)get16(data));
+        case UVC_CT_ROLL_RELATIVE_CONTROL:
+            return simSetRollRel(camera, (int8_t)data[0], data[1]);
+        default:
+            return setRegister(camera, spec, data);
+    }
+}
+
+}  // namespace ptz
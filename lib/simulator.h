@@ -0,0 +1,96 @@
+#ifndef PTZ_SIMULATOR_H
+#define PTZ_SIMULATOR_H
+
+#include <stdint.h>
+#include "libuvc/libuvc.h"
+
+namespace ptz {
+
+// simulated camera backend, used by ptzctl and the soak tests when no
+// hardware is attached. cameras are created on first use per vendor,
+// product, serial and port, and keep their pose across open/close like a
+// real device would.
+struct SimConfig {
+    uint32_t transfer_latency_us;  // time the control endpoint is busy per transfer
+    uint32_t transfer_jitter_us;   // uniform +/- jitter added to each transfer
+    uint32_t open_latency_us;      // cost of opening the device
+    double   error_rate;           // fraction of transfers failing with UVC_ERROR_IO
+    double   pan_speed;            // arc seconds per second per relative speed step
+    double   tilt_speed;           // arc seconds per second per relative speed step
+    double   zoom_speed;           // zoom units per second per relative speed step
+    uint16_t firmware;             // reported as bcdDevice
+};
+void simGetConfig(struct SimConfig* config);
+void simSetConfig(const struct SimConfig* config);
+
+struct SimCamera;
+struct SimCamera* simFindCamera(int         vendorId,
+                                int         productId,
+                                const char* serial,
+                                const char* port);
+uvc_error_t       simOpen(struct SimCamera* camera);
+void              simClose(struct SimCamera* camera);
+
+// a hung camera stops answering control transfers, the way a wedged one
+// does, until it is let go again
+void simSetHung(struct SimCamera* camera, bool hung);
+bool simIsHung(struct SimCamera* camera);
+
+// an unplugged camera fails opens and transfers with UVC_ERROR_NO_DEVICE.
+// plugged back in, it comes up at home with a new attachment number, the
+// way a real one re-enumerates at a new bus address after a reset.
+void     simSetUnplugged(struct SimCamera* camera, bool unplugged);
+uint32_t simAttachment(struct SimCamera* camera);
+
+// mirrors of the libuvc camera terminal accessors
+uvc_error_t simGetZoomAbs(struct SimCamera* camera,
+                          uint16_t*         focal_length,
+                          enum uvc_req_code requestCode);
+uvc_error_t simSetZoomAbs(struct SimCamera* camera, uint16_t focal_length);
+uvc_error_t simGetZoomRel(struct SimCamera* camera,
+                          int8_t*           zoom_rel,
+                          uint8_t*          digital_zoom,
+                          uint8_t*          speed,
+                          enum uvc_req_code requestCode);
+uvc_error_t simSetZoomRel(struct SimCamera* camera,
+                          int8_t            zoom_rel,
+                          uint8_t           digital_zoom,
+                          uint8_t           speed);
+uvc_error_t simGetPanTiltAbs(struct SimCamera* camera,
+                             int32_t*          pan,
+                             int32_t*          tilt,
+                             enum uvc_req_code requestCode);
+uvc_error_t simSetPanTiltAbs(struct SimCamera* camera, int32_t pan, int32_t tilt);
+uvc_error_t simGetPanTiltRel(struct SimCamera* camera,
+                             int8_t*           pan_rel,
+                             uint8_t*          pan_speed,
+                             int8_t*           tilt_rel,
+                             uint8_t*          tilt_speed,
+                             enum uvc_req_code requestCode);
+uvc_error_t simSetPanTiltRel(struct SimCamera* camera,
+                             int8_t            pan_rel,
+                             uint8_t           pan_speed,
+                             int8_t            tilt_rel,
+                             uint8_t           tilt_speed);
+uvc_error_t simGetRollAbs(struct SimCamera* camera, int16_t* roll, enum uvc_req_code requestCode);
+uvc_error_t simGetRollRel(struct SimCamera* camera,
+                          int8_t*           roll_rel,
+                          uint8_t*          speed,
+                          enum uvc_req_code requestCode);
+
+// mirrors of uvc_get_ctrl/uvc_set_ctrl for every control in control.h.
+// focus, iris and exposure take effect at once; controls the simulated
+// terminal lacks stall.
+uvc_error_t simGetControl(struct SimCamera* camera,
+                          uint8_t           selector,
+                          uint8_t*          data,
+                          int               length,
+                          enum uvc_req_code requestCode);
+uvc_error_t simSetControl(struct SimCamera* camera,
+                          uint8_t           selector,
+                          const uint8_t*    data,
+                          int               length);
+
+}  // namespace ptz
+
+#endif  // PTZ_SIMULATOR_H
@@ -0,0 +1,103 @@
+#include "stats.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+namespace ptz {
+
+uint64_t monotonicNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void sleepUntil(uint64_t deadline) {
+    struct timespec ts;
+    ts.tv_sec  = (time_t)(deadline / 1000000000ull);
+    ts.tv_nsec = (long)(deadline % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        continue;
+}
+
+static int bucketIndex(uint64_t value) {
+    if (value < 16) {
+        return (int)value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    return (msb - 3) * 16 + (int)((value >> (msb - 4)) & 15);
+}
+
+static uint64_t bucketLowerBound(int index) {
+    if (index < 16) {
+        return (uint64_t)index;
+    }
+    int msb = index / 16 + 3;
+    return (uint64_t)(16 + index % 16) << (msb - 4);
+}
+
+void histogramReset(struct LatencyHistogram* histogram) {
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+void histogramRecord(struct LatencyHistogram* histogram, uint64_t value) {
+    if (histogram->count == 0 || value < histogram->min) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+    histogram->count++;
+    histogram->sum += value;
+    histogram->buckets[bucketIndex(value)]++;
+}
+
+void histogramMerge(struct LatencyHistogram* into, const struct LatencyHistogram* from) {
+    if (from->count == 0) {
+        return;
+    }
+    if (into->count == 0 || from->min < into->min) {
+        into->min = from->min;
+    }
+    if (from->max > into->max) {
+        into->max = from->max;
+    }
+    into->count += from->count;
+    into->sum += from->sum;
+    for (int i = 0; i < PTZ_HISTOGRAM_BUCKETS; i++) {
+        into->buckets[i] += from->buckets[i];
+    }
+}
+
+uint64_t histogramPercentile(const struct LatencyHistogram* histogram, double percentile) {
+    if (histogram->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)histogram->count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < PTZ_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            // report the middle of the bucket, clamped to what was observed
+            uint64_t low   = bucketLowerBound(i);
+            uint64_t high  = i + 1 < PTZ_HISTOGRAM_BUCKETS ? bucketLowerBound(i + 1) : low;
+            uint64_t value = low + (high - low) / 2;
+            if (value < histogram->min) {
+                value = histogram->min;
+            }
+            if (value > histogram->max) {
+                value = histogram->max;
+            }
+            return value;
+        }
+    }
+    return histogram->max;
+}
+
+uint64_t histogramMean(const struct LatencyHistogram* histogram) {
+    return histogram->count == 0 ? 0 : histogram->sum / histogram->count;
+}
+
+}  // namespace ptz
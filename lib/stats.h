@@ -0,0 +1,31 @@
+#ifndef PTZ_STATS_H
+#define PTZ_STATS_H
+
+#include <stdint.h>
+
+namespace ptz {
+
+// monotonic clock in nanoseconds
+uint64_t monotonicNanos();
+// sleep until an absolute monotonicNanos() deadline
+void sleepUntil(uint64_t deadline);
+
+// log-linear latency histogram: 16 sub-buckets per power of two, so any
+// recorded value is reported within ~6%. fixed size, never allocates.
+#define PTZ_HISTOGRAM_BUCKETS 976
+struct LatencyHistogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[PTZ_HISTOGRAM_BUCKETS];
+};
+void     histogramReset(struct LatencyHistogram* histogram);
+void     histogramRecord(struct LatencyHistogram* histogram, uint64_t value);
+void     histogramMerge(struct LatencyHistogram* into, const struct LatencyHistogram* from);
+uint64_t histogramPercentile(const struct LatencyHistogram* histogram, double percentile);
+uint64_t histogramMean(const struct LatencyHistogram* histogram);
+
+}  // namespace ptz
+
+#endif  // PTZ_STATS_H
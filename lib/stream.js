@@ -0,0 +1,79 @@
+"use strict";
+const { Writable } = require("stream");
+const ptz = require("../build/Release/ptz");
+
+// an object mode stream of commands for one camera, each written as
+// { command: "absolutePanTilt", pan, tilt }. whatever is buffered while the
+// camera works through the last batch goes to its thread as the next one in
+// a single native call, so write() returns false and "drain" follows once
+// the camera, not just the stream, has caught up. a failed command emits
+// "commandError" with the command and the stream carries on.
+class CommandStream extends Writable {
+  constructor(camera, options) {
+    super(Object.assign({ highWaterMark: camera.highWaterMark }, options, { objectMode: true }));
+    this.camera = camera;
+    this.batches = 0;
+    this.commands = 0;
+    this.failed = 0;
+  }
+
+  _write(command, encoding, callback) {
+    this.submit([command], callback);
+  }
+
+  _writev(chunks, callback) {
+    this.submit(chunks.map((chunk) => chunk.chunk), callback);
+  }
+
+  submit(commands, callback) {
+    const done = (err, results) => {
+      this.batches++;
+      commands.forEach((command, i) => {
+        const result = err || results[i];
+        this.commands++;
+        if (result instanceof Error) {
+          this.failed++;
+          this.emit("commandError", result, command);
+        } else {
+          this.emit("result", result, command);
+        }
+      });
+      callback();
+    };
+
+    // through ptzd the commands are pipelined instead
+    if (this.camera.client) {
+      return this.pipeline(commands, done);
+    }
+    const identity = this.camera.identity();
+    const entries = commands.map((command) => Object.assign({}, command, identity));
+    ptz.executeBatch(identity, entries, done);
+  }
+
+  pipeline(commands, done) {
+    const results = [];
+    let remaining = commands.length;
+    const settle = (i, result) => {
+      results[i] = result;
+      if (--remaining === 0) {
+        done(null, results);
+      }
+    };
+    commands.forEach((command, i) => {
+      const input = Object.assign({}, command, this.camera.identity());
+      try {
+        this.camera.client.execute(command.command, input, (err, result) => {
+          settle(i, err || result);
+        });
+      } catch (err) {
+        settle(i, err);
+      }
+    });
+  }
+
+  getStats() {
+    return { batches: this.batches, commands: this.commands, failed: this.failed };
+  }
+}
+
+module.exports = CommandStream;
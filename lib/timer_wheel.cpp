@@ -0,0 +1,126 @@
+#include "timer_wheel.h"
+#include <string.h>
+
+namespace ptz {
+
+#define WHEEL_BITS 6
+
+void wheelInit(struct TimerWheel* wheel, uint64_t tickNanos, uint64_t startNanos) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->tick_ns = tickNanos;
+    wheel->start   = startNanos;
+}
+
+void wheelTimerInit(struct WheelTimer* timer, WheelExpired expired) {
+    timer->next    = NULL;
+    timer->link    = NULL;
+    timer->expires = 0;
+    timer->expired = expired;
+}
+
+bool wheelArmed(const struct WheelTimer* timer) {
+    return timer->link != NULL;
+}
+
+static void unlink(struct WheelTimer* timer) {
+    *timer->link = timer->next;
+    if (timer->next != NULL) {
+        timer->next->link = timer->link;
+    }
+    timer->next = NULL;
+    timer->link = NULL;
+}
+
+// file a timer in the level whose span covers its distance from now. one
+// already due goes in the current slot while that slot is still to run,
+// when cascading, and in the next one once it has run.
+static void place(struct TimerWheel* wheel, struct WheelTimer* timer, bool cascading) {
+    uint64_t delta = timer->expires > wheel->now ? timer->expires - wheel->now : 0;
+    int      level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << (WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+
+    // past the last level, park in its furthest slot and cascade again later
+    uint64_t span = 1ULL << (WHEEL_BITS * WHEEL_LEVELS);
+    uint64_t at   = delta >= span ? wheel->now + span - 1 : timer->expires;
+    if (delta == 0) {
+        at = cascading ? wheel->now : wheel->now + 1;
+    }
+
+    int                 index = (at >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+    struct WheelTimer** slot  = &wheel->slots[level][index];
+    timer->next               = *slot;
+    timer->link               = slot;
+    if (*slot != NULL) {
+        (*slot)->link = &timer->next;
+    }
+    *slot = timer;
+}
+
+void wheelSchedule(struct TimerWheel* wheel, struct WheelTimer* timer, uint64_t deadline) {
+    if (timer->link != NULL) {
+        unlink(timer);
+    } else {
+        wheel->armed++;
+    }
+    uint64_t elapsed = deadline > wheel->start ? deadline - wheel->start : 0;
+    timer->expires   = (elapsed + wheel->tick_ns - 1) / wheel->tick_ns;
+    place(wheel, timer, false);
+}
+
+void wheelCancel(struct TimerWheel* wheel, struct WheelTimer* timer) {
+    if (timer->link != NULL) {
+        unlink(timer);
+        wheel->armed--;
+    }
+}
+
+// move every timer of a coarse slot down to where it now belongs
+static void cascade(struct TimerWheel* wheel, int level) {
+    int                slot  = (wheel->now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+    struct WheelTimer* timer = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+    while (timer != NULL) {
+        struct WheelTimer* next = timer->next;
+        timer->link             = NULL;
+        timer->next             = NULL;
+        place(wheel, timer, true);
+        timer = next;
+    }
+}
+
+void wheelAdvance(struct TimerWheel* wheel, uint64_t nowNanos) {
+    uint64_t target = nowNanos > wheel->start ? (nowNanos - wheel->start) / wheel->tick_ns : 0;
+    while (wheel->now < target) {
+        wheel->now++;
+
+        // crossing into a new lap of a level pulls its next coarse slot down
+        for (int level = 1; level < WHEEL_LEVELS; level++) {
+            if ((wheel->now & ((1ULL << (WHEEL_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(wheel, level);
+        }
+
+        struct WheelTimer** slot = &wheel->slots[0][wheel->now & (WHEEL_SLOTS - 1)];
+        while (*slot != NULL) {
+            struct WheelTimer* timer = *slot;
+            unlink(timer);
+            if (timer->expires > wheel->now) {
+                // parked beyond the wheel's span, not due yet
+                place(wheel, timer, false);
+                continue;
+            }
+            wheel->armed--;
+            timer->expired(timer);
+        }
+
+        // nothing left to fire, jump straight to the target
+        if (wheel->armed == 0) {
+            wheel->now = target;
+        }
+    }
+}
+
+}  // namespace ptz
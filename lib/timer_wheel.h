@@ -0,0 +1,46 @@
+#ifndef PTZ_TIMER_WHEEL_H
+#define PTZ_TIMER_WHEEL_H
+
+#include <stdint.h>
+
+namespace ptz {
+
+// hierarchical timing wheel: 4 levels of 64 slots, so adding, refreshing and
+// cancelling a timer are O(1) however many are armed. timers far out sit in
+// coarse slots and cascade down as their time approaches. not thread safe,
+// the owner serializes access.
+#define WHEEL_LEVELS 4
+#define WHEEL_SLOTS 64
+
+struct WheelTimer;
+typedef void (*WheelExpired)(struct WheelTimer* timer);
+
+// embed in whatever the timer is for, the wheel never allocates
+struct WheelTimer {
+    struct WheelTimer*  next;
+    struct WheelTimer** link;     // the pointer to this timer, NULL when not armed
+    uint64_t            expires;  // in ticks
+    WheelExpired        expired;
+};
+
+struct TimerWheel {
+    uint64_t           tick_ns;
+    uint64_t           now;    // ticks since start
+    uint64_t           start;  // monotonicNanos() at tick 0
+    uint32_t           armed;  // timers in the wheel
+    struct WheelTimer* slots[WHEEL_LEVELS][WHEEL_SLOTS];
+};
+
+void wheelInit(struct TimerWheel* wheel, uint64_t tickNanos, uint64_t startNanos);
+void wheelTimerInit(struct WheelTimer* timer, WheelExpired expired);
+// arms or re-arms for a monotonicNanos() deadline
+void wheelSchedule(struct TimerWheel* wheel, struct WheelTimer* timer, uint64_t deadline);
+void wheelCancel(struct TimerWheel* wheel, struct WheelTimer* timer);
+bool wheelArmed(const struct WheelTimer* timer);
+// runs every timer due by nowNanos, in tick order. expired callbacks may
+// schedule and cancel timers.
+void wheelAdvance(struct TimerWheel* wheel, uint64_t nowNanos);
+
+}  // namespace ptz
+
+#endif  // PTZ_TIMER_WHEEL_H
@@ -0,0 +1,347 @@
+#include "tour.h"
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "realtime.h"
+#include "session.h"
+#include "stats.h"
+
+namespace ptz {
+
+// moves failing back to back before a tour gives up
+#define TOUR_MAX_FAILURES 3
+
+struct Tour {
+    struct CameraSession*        session;
+    struct UVCDevice             uvcDevice;
+    std::vector<struct TourStop> stops;
+    struct TourConfig            config;
+
+    int      state;
+    uint32_t stop;
+    bool     arrived;         // at stop, the next move goes on to the one after
+    uint64_t due;             // when the next move starts, while waiting out a dwell
+    uint64_t remaining;       // dwell left when paused
+    bool     moving;          // a move is queued or running on the camera's thread
+    bool     pauseRequested;  // pause once the move in flight lands
+    bool     removed;         // stopped or replaced mid move, freed when it lands
+    uint32_t failures;        // in a row
+    uint64_t operatorWrites;  // the session's count when the tour last looked
+
+    // written by the move on the camera's thread, read when it lands
+    uint64_t moveStarted;
+    uint64_t moveWrites;
+    bool     moveInterrupted;
+
+    uint64_t                laps;
+    uint64_t                moves;
+    uint64_t                errors;
+    uint64_t                interruptions;
+    const char*             error;
+    struct LatencyHistogram timing;
+};
+
+// heap allocated and never freed, so the detached thread never waits on a
+// destroyed condition variable at exit
+struct TourScheduler {
+    std::mutex                                    mutex;
+    std::condition_variable                       changed;
+    std::map<struct CameraSession*, struct Tour*> tours;
+};
+
+static void schedulerLoop(struct TourScheduler* scheduler);
+
+static struct TourScheduler* schedulerGet() {
+    static struct TourScheduler* scheduler = [] {
+        struct TourScheduler* created = new TourScheduler();
+        std::thread(schedulerLoop, created).detach();
+        return created;
+    }();
+    return scheduler;
+}
+
+static uint64_t operatorWrites(struct CameraSession* session) {
+    struct SessionStats stats;
+    sessionGetStats(session, &stats);
+    return stats.operator_writes;
+}
+
+// runs on the camera's thread, behind whatever the camera was already doing
+static void runMove(void* context, struct CommandResult* commandResult) {
+    struct Tour*           tour = (struct Tour*)context;
+    const struct TourStop* stop = &tour->stops[tour->stop];
+    tour->moveStarted           = monotonicNanos();
+
+    // leave the camera to whoever took it over
+    tour->moveWrites      = operatorWrites(tour->session);
+    tour->moveInterrupted = tour->moveWrites != tour->operatorWrites;
+    if (tour->moveInterrupted) {
+        commandResult->result = UVC_SUCCESS;
+        commandResult->error  = NULL;
+        return;
+    }
+
+    struct Preset preset = stop->position;
+    if (stop->preset[0] != 0 && presetFind(&tour->uvcDevice, stop->preset, &preset) != 0) {
+        commandResult->result = UVC_ERROR_INVALID_PARAM;
+        commandResult->error  = "no such preset";
+        return;
+    }
+    presetRecall(tour->session,
+                 &tour->uvcDevice,
+                 &preset,
+                 stop->move_ms,
+                 COMMAND_SCHEDULED,
+                 commandResult);
+}
+
+static void onMoveDone(void* context, const struct CommandResult* commandResult, uint32_t pending) {
+    struct Tour*          tour      = (struct Tour*)context;
+    struct TourScheduler* scheduler = schedulerGet();
+    uint64_t              now       = monotonicNanos();
+    (void)pending;
+
+    std::lock_guard<std::mutex> lock(scheduler->mutex);
+    tour->moving = false;
+    if (tour->removed) {
+        delete tour;
+        return;
+    }
+
+    // the quiet spell is counted from the writes that interrupted it
+    if (tour->moveInterrupted) {
+        tour->interruptions++;
+        tour->operatorWrites = tour->moveWrites;
+        tour->state          = TOUR_INTERRUPTED;
+        tour->due            = now + (uint64_t)tour->config.resume_after_ms * 1000000;
+    } else {
+        tour->moves++;
+        tour->arrived = true;
+        histogramRecord(&tour->timing,
+                        tour->moveStarted > tour->due ? tour->moveStarted - tour->due : 0);
+        if (commandResult->result != 0) {
+            tour->errors++;
+            tour->error = commandResult->error;
+            if (++tour->failures >= TOUR_MAX_FAILURES) {
+                tour->state = TOUR_FAILED;
+                return;
+            }
+        } else {
+            tour->failures = 0;
+        }
+        tour->state = TOUR_DWELLING;
+        tour->due   = now + (uint64_t)tour->stops[tour->stop].dwell_ms * 1000000;
+    }
+
+    if (tour->pauseRequested) {
+        tour->pauseRequested = false;
+        tour->remaining      = tour->state == TOUR_DWELLING ? tour->due - now : 0;
+        tour->state          = TOUR_PAUSED;
+    }
+    scheduler->changed.notify_one();
+}
+
+// pick the stop to head for, false when the tour has run its laps
+static bool nextStop(struct Tour* tour) {
+    if (!tour->arrived) {
+        return true;
+    }
+    tour->arrived = false;
+    if (++tour->stop == tour->stops.size()) {
+        tour->stop = 0;
+        tour->laps++;
+        if (tour->config.laps != 0 && tour->laps >= tour->config.laps) {
+            tour->state = TOUR_FINISHED;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void schedulerLoop(struct TourScheduler* scheduler) {
+    realtimeEnter();
+    std::vector<struct Tour*>    due;
+    std::unique_lock<std::mutex> lock(scheduler->mutex);
+    for (;;) {
+        uint64_t now  = monotonicNanos();
+        uint64_t next = UINT64_MAX;
+        due.clear();
+        for (auto& entry : scheduler->tours) {
+            struct Tour* tour    = entry.second;
+            bool         resumes = tour->config.resume_after_ms != 0;
+            if (tour->moving ||
+                (tour->state != TOUR_DWELLING && !(tour->state == TOUR_INTERRUPTED && resumes))) {
+                continue;
+            }
+            if (tour->due > now) {
+                next = std::min(next, tour->due);
+                continue;
+            }
+
+            // an interrupted tour waits for the operator to go quiet
+            if (tour->state == TOUR_INTERRUPTED) {
+                uint64_t writes = operatorWrites(tour->session);
+                if (writes != tour->operatorWrites) {
+                    tour->operatorWrites = writes;
+                    tour->due            = now + (uint64_t)tour->config.resume_after_ms * 1000000;
+                    next                 = std::min(next, tour->due);
+                    continue;
+                }
+            }
+            if (!nextStop(tour)) {
+                continue;
+            }
+            tour->state  = TOUR_MOVING;
+            tour->moving = true;
+            due.push_back(tour);
+        }
+
+        // a moving tour is only freed once its move lands
+        if (!due.empty()) {
+            lock.unlock();
+            for (struct Tour* tour : due) {
+                sessionSubmitTask(tour->session, runMove, onMoveDone, tour);
+            }
+            lock.lock();
+            continue;
+        }
+        if (next == UINT64_MAX) {
+            scheduler->changed.wait(lock);
+        } else {
+            scheduler->changed.wait_for(lock, std::chrono::nanoseconds(next - now));
+        }
+    }
+}
+
+// drop a tour, or leave it for its move to free
+static void removeTour(struct TourScheduler* scheduler, struct CameraSession* session) {
+    auto found = scheduler->tours.find(session);
+    if (found == scheduler->tours.end()) {
+        return;
+    }
+    struct Tour* tour = found->second;
+    scheduler->tours.erase(found);
+    if (tour->moving) {
+        tour->removed = true;
+    } else {
+        delete tour;
+    }
+}
+
+static struct Tour* findTour(struct TourScheduler* scheduler, const struct UVCDevice* uvcDevice) {
+    auto found = scheduler->tours.find(sessionFind(uvcDevice));
+    return found == scheduler->tours.end() ? NULL : found->second;
+}
+
+bool tourStart(const struct UVCDevice*             uvcDevice,
+               const std::vector<struct TourStop>& stops,
+               const struct TourConfig*            config) {
+    if (stops.empty()) {
+        return false;
+    }
+    struct TourScheduler* scheduler = schedulerGet();
+    struct Tour*          tour      = new Tour();
+    tour->session                   = sessionFind(uvcDevice);
+    tour->uvcDevice                 = *uvcDevice;
+    tour->stops                     = stops;
+    tour->config                    = *config;
+    tour->state                     = TOUR_DWELLING;
+    tour->stop                      = 0;
+    tour->arrived                   = false;
+    tour->due                       = monotonicNanos();
+    tour->remaining                 = 0;
+    tour->moving                    = false;
+    tour->pauseRequested            = false;
+    tour->removed                   = false;
+    tour->failures                  = 0;
+    tour->operatorWrites            = operatorWrites(tour->session);
+    tour->moveStarted               = 0;
+    tour->moveInterrupted           = false;
+    tour->laps                      = 0;
+    tour->moves                     = 0;
+    tour->errors                    = 0;
+    tour->interruptions             = 0;
+    tour->error                     = NULL;
+    histogramReset(&tour->timing);
+
+    std::lock_guard<std::mutex> lock(scheduler->mutex);
+    removeTour(scheduler, tour->session);
+    scheduler->tours[tour->session] = tour;
+    scheduler->changed.notify_one();
+    return true;
+}
+
+void tourStop(const struct UVCDevice* uvcDevice) {
+    struct TourScheduler*       scheduler = schedulerGet();
+    std::lock_guard<std::mutex> lock(scheduler->mutex);
+    removeTour(scheduler, sessionFind(uvcDevice));
+}
+
+void tourPause(const struct UVCDevice* uvcDevice) {
+    struct TourScheduler*       scheduler = schedulerGet();
+    std::lock_guard<std::mutex> lock(scheduler->mutex);
+    struct Tour*                tour = findTour(scheduler, uvcDevice);
+    if (tour == NULL) {
+        return;
+    }
+    uint64_t now = monotonicNanos();
+    if (tour->moving) {
+        tour->pauseRequested = true;
+    } else if (tour->state == TOUR_DWELLING) {
+        tour->remaining = tour->due > now ? tour->due - now : 0;
+        tour->state     = TOUR_PAUSED;
+    } else if (tour->state == TOUR_INTERRUPTED) {
+        tour->remaining = 0;
+        tour->state     = TOUR_PAUSED;
+    }
+}
+
+void tourResume(const struct UVCDevice* uvcDevice) {
+    struct TourScheduler*       scheduler = schedulerGet();
+    std::lock_guard<std::mutex> lock(scheduler->mutex);
+    struct Tour*                tour = findTour(scheduler, uvcDevice);
+    if (tour == NULL) {
+        return;
+    }
+    if (tour->moving) {
+        tour->pauseRequested = false;
+        return;
+    }
+    if (tour->state != TOUR_PAUSED && tour->state != TOUR_INTERRUPTED) {
+        return;
+    }
+
+    // the operator handing back is not an interruption
+    tour->operatorWrites = operatorWrites(tour->session);
+    tour->due            = monotonicNanos() + tour->remaining;
+    tour->remaining      = 0;
+    tour->state          = TOUR_DWELLING;
+    scheduler->changed.notify_one();
+}
+
+void tourGetStats(const struct UVCDevice* uvcDevice, struct TourStats* stats) {
+    struct TourScheduler*       scheduler = schedulerGet();
+    std::lock_guard<std::mutex> lock(scheduler->mutex);
+    struct Tour*                tour = findTour(scheduler, uvcDevice);
+    memset(stats, 0, sizeof(*stats));
+    if (tour == NULL) {
+        stats->state = TOUR_IDLE;
+        return;
+    }
+    stats->state         = tour->state;
+    stats->stop          = tour->stop;
+    stats->laps          = tour->laps;
+    stats->moves         = tour->moves;
+    stats->errors        = tour->errors;
+    stats->interruptions = tour->interruptions;
+    stats->error         = tour->error;
+    stats->timing_mean   = histogramMean(&tour->timing);
+    stats->timing_p99    = histogramPercentile(&tour->timing, 99);
+    stats->timing_max    = tour->timing.count != 0 ? tour->timing.max : 0;
+}
+
+}  // namespace ptz
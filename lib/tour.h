@@ -0,0 +1,65 @@
+#ifndef PTZ_TOUR_H
+#define PTZ_TOUR_H
+
+#include <stdint.h>
+#include <vector>
+#include "device.h"
+#include "preset.h"
+
+namespace ptz {
+
+// patrol tours: a camera visits a list of stops and dwells at each. one
+// thread keeps the schedule of every tour and hands each move to the
+// camera's own thread, so a slow camera never delays another camera's tour.
+// dwell starts when the camera arrives. any operator command sent to a
+// touring camera interrupts its tour before the next move.
+struct TourStop {
+    char          preset[PRESET_NAME_SIZE];  // looked up at each visit, empty to use position
+    struct Preset position;
+    uint32_t      dwell_ms;
+    uint32_t      move_ms;  // smooth move over this long, 0 jumps
+};
+
+struct TourConfig {
+    uint32_t laps;             // 0 repeats until stopped
+    uint32_t resume_after_ms;  // resume once the operator is idle this long, 0 waits for tourResume
+};
+
+enum TourState {
+    TOUR_IDLE = 0,  // no tour for this camera
+    TOUR_MOVING,
+    TOUR_DWELLING,
+    TOUR_PAUSED,
+    TOUR_INTERRUPTED,
+    TOUR_FINISHED,
+    TOUR_FAILED,  // too many moves in a row failed
+};
+
+struct TourStats {
+    int         state;
+    uint32_t    stop;  // index of the stop being moved to or dwelled at
+    uint64_t    laps;
+    uint64_t    moves;
+    uint64_t    errors;
+    uint64_t    interruptions;
+    const char* error;  // last failure, NULL when none
+    // how late each move started against its schedule, in nanoseconds
+    uint64_t timing_mean;
+    uint64_t timing_p99;
+    uint64_t timing_max;
+};
+
+// one tour per camera, starting a tour replaces the camera's current one.
+// returns false when there are no stops.
+bool tourStart(const struct UVCDevice*             uvcDevice,
+               const std::vector<struct TourStop>& stops,
+               const struct TourConfig*            config);
+void tourStop(const struct UVCDevice* uvcDevice);
+void tourPause(const struct UVCDevice* uvcDevice);
+// also picks up an interrupted tour, going back to the stop it was headed for
+void tourResume(const struct UVCDevice* uvcDevice);
+void tourGetStats(const struct UVCDevice* uvcDevice, struct TourStats* stats);
+
+}  // namespace ptz
+
+#endif  // PTZ_TOUR_H
@@ -0,0 +1,390 @@
+#include "tracker.h"
+#include <math.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "command.h"
+#include "realtime.h"
+#include "ring.h"
+#include "session.h"
+#include "velocity.h"
+
+namespace ptz {
+
+enum TrackerAxis { TRACK_PAN = 0, TRACK_TILT, TRACK_ZOOM, TRACK_AXES };
+
+// outputs this close to 0 stop the axis rather than crawl at its slowest
+#define TRACKER_OUTPUT_DEADBAND 0.02
+// how quickly the subject's velocity follows new samples, 0..1
+#define TRACKER_VELOCITY_SMOOTHING 0.5
+// window the rms error is averaged over
+#define TRACKER_RMS_WINDOW_S 1.0
+
+struct PidState {
+    double integral;
+    double previous;  // error on the last tick, for the derivative
+    int    primed;
+};
+
+struct Tracker {
+    struct UVCDevice      uvcDevice;
+    struct CameraSession* session;
+    struct TrackerConfig  config;
+    std::thread           thread;
+    std::atomic<int>      closing;
+
+    SpscRing<struct TrackerSample, 256> samples;
+
+    struct AxisRange ranges[TRACK_AXES];
+
+    // the subject as last seen, and how fast it crosses the frame
+    struct TrackerSample subject;
+    int                  seen;
+    double               velocity[TRACK_AXES];  // x, y and size per second
+    uint64_t             unanswered;            // newest sample no command has followed yet
+
+    struct PidState     pid[TRACK_AXES];
+    struct AxisVelocity sent[TRACK_AXES];
+    uint64_t            panTiltSentAt;
+    uint64_t            zoomSentAt;
+    uint64_t            keepalive;  // resend a held velocity this often, for the watchdog
+
+    std::atomic<uint64_t> pushed;
+    std::atomic<uint64_t> dropped;
+
+    // everything else the thread reports, copied out under the lock
+    std::mutex          statsMutex;
+    struct TrackerStats stats;
+    double              meanSquare;
+};
+
+void trackerDefaults(struct TrackerConfig* config) {
+    config->interval_us         = 20000;
+    config->command_interval_us = 50000;
+    config->lost_ms             = 500;
+    config->lead_ms             = 0;
+    config->deadband            = 0.02;
+    config->max_output          = 1;
+    config->target_size         = 0;
+    config->pan                 = {4, 1, 0.1, 1};
+    config->tilt                = {4, 1, 0.1, 1};
+    config->zoom                = {2, 0, 0, 0};
+}
+
+static bool run(struct Tracker* tracker, struct Command* command, struct CommandResult* result) {
+    struct UVCDevice uvcDevice = tracker->uvcDevice;
+    sessionRun(tracker->session, &uvcDevice, command, result);
+    if (result->result != 0) {
+        std::lock_guard<std::mutex> lock(tracker->statsMutex);
+        tracker->stats.errors++;
+        return false;
+    }
+    return true;
+}
+
+static void readRanges(struct Tracker* tracker) {
+    struct Command       command = {};
+    struct CommandResult commandResult;
+
+    command.op = CMD_GET_RELATIVE_PAN_TILT;
+    if (run(tracker, &command, &commandResult)) {
+        const struct RelativePanTiltInfo* info = &commandResult.relativePanTiltInfo;
+        tracker->ranges[TRACK_PAN]            = {1,
+                                                 info->min_pan_speed,
+                                                 info->max_pan_speed,
+                                                 info->resolution_pan_speed};
+        tracker->ranges[TRACK_TILT]           = {1,
+                                                 info->min_tilt_speed,
+                                                 info->max_tilt_speed,
+                                                 info->resolution_tilt_speed};
+    }
+
+    // zoom is left alone unless asked to hold the subject's size
+    command.op = CMD_GET_RELATIVE_ZOOM;
+    if (tracker->config.target_size > 0 && run(tracker, &command, &commandResult)) {
+        const struct RelativeZoomInfo* info = &commandResult.relativeZoomInfo;
+        tracker->ranges[TRACK_ZOOM] = {1, info->min_speed, info->max_speed, info->resolution_speed};
+    }
+}
+
+// take in every sample pushed since the last tick
+static void takeSamples(struct Tracker* tracker, uint64_t now) {
+    struct TrackerSample sample;
+    while (tracker->samples.pop(&sample)) {
+        sample.at = sample.at > now ? now : sample.at;
+        if (!sample.visible) {
+            tracker->seen = 0;
+            continue;
+        }
+
+        const struct TrackerSample* previous          = &tracker->subject;
+        double                      seconds           = (double)(sample.at - previous->at) / 1e9;
+        double                      moved[TRACK_AXES] = {
+            sample.x - previous->x, sample.y - previous->y, sample.size - previous->size};
+        for (int axis = 0; axis < TRACK_AXES; axis++) {
+            if (!tracker->seen || sample.at <= previous->at) {
+                tracker->velocity[axis] = 0;
+                continue;
+            }
+            double speed  = moved[axis] / seconds;
+            double change = speed - tracker->velocity[axis];
+            tracker->velocity[axis] += TRACKER_VELOCITY_SMOOTHING * change;
+        }
+        tracker->subject    = sample;
+        tracker->seen       = 1;
+        tracker->unanswered = sample.at;
+    }
+}
+
+static double control(struct PidState*       state,
+                      const struct PidGains* gains,
+                      double                 error,
+                      double                 velocity,
+                      double                 dt,
+                      double                 deadband,
+                      double                 limit) {
+    double e          = fabs(error) <= deadband ? 0 : error;
+    double derivative = state->primed && dt > 0 ? (e - state->previous) / dt : 0;
+    state->previous   = e;
+    state->primed     = 1;
+    if (e == 0) {
+        return 0;
+    }
+
+    double integral = state->integral + e * dt;
+    double output   = gains->kp * e + gains->ki * integral + gains->kd * derivative +
+                    gains->kf * velocity;
+    double limited  = fmin(fmax(output, -limit), limit);
+    // only integrate while the output has room, so it cannot wind up
+    // against the limit and overshoot once the subject stops
+    if (limited == output || (output > 0) != (e > 0)) {
+        state->integral = integral;
+    }
+    return limited;
+}
+
+static void resetControl(struct Tracker* tracker) {
+    for (int axis = 0; axis < TRACK_AXES; axis++) {
+        tracker->pid[axis] = {0, 0, 0};
+    }
+}
+
+// quantize the outputs and send whatever changed, holding back speed changes
+// that come quicker than command_interval_us
+static void drive(struct Tracker* tracker, const double* output, uint64_t now) {
+    struct Command       command = {};
+    struct CommandResult commandResult;
+    uint64_t             interval    = (uint64_t)tracker->config.command_interval_us * 1000;
+    uint64_t             rateLimited = 0;
+
+    struct AxisVelocity velocity[TRACK_AXES];
+    for (int axis = 0; axis < TRACK_AXES; axis++) {
+        velocity[axis] =
+            velocityQuantize(&tracker->ranges[axis], output[axis], TRACKER_OUTPUT_DEADBAND, 1);
+    }
+
+    bool panTiltChanged = !velocitySame(&velocity[TRACK_PAN], &tracker->sent[TRACK_PAN]) ||
+                          !velocitySame(&velocity[TRACK_TILT], &tracker->sent[TRACK_TILT]);
+    bool panTiltStop = velocity[TRACK_PAN].direction == 0 && velocity[TRACK_TILT].direction == 0;
+    bool panTiltDue  = tracker->keepalive != 0 && !panTiltStop &&
+                      now - tracker->panTiltSentAt > tracker->keepalive;
+    if (panTiltChanged && !panTiltStop && now - tracker->panTiltSentAt < interval) {
+        rateLimited++;
+    } else if (panTiltChanged || panTiltDue) {
+        command.op      = CMD_RELATIVE_PAN_TILT;
+        command.args[0] = velocity[TRACK_PAN].direction;
+        command.args[1] = velocity[TRACK_PAN].speed;
+        command.args[2] = velocity[TRACK_TILT].direction;
+        command.args[3] = velocity[TRACK_TILT].speed;
+        bool sent       = run(tracker, &command, &commandResult);
+        if (sent) {
+            tracker->sent[TRACK_PAN]  = velocity[TRACK_PAN];
+            tracker->sent[TRACK_TILT] = velocity[TRACK_TILT];
+            tracker->panTiltSentAt    = now;
+        }
+        std::lock_guard<std::mutex> lock(tracker->statsMutex);
+        tracker->stats.pan_tilt_commands++;
+        if (sent && panTiltChanged && tracker->unanswered != 0) {
+            histogramRecord(&tracker->stats.latency, monotonicNanos() - tracker->unanswered);
+            tracker->unanswered = 0;
+        }
+    }
+
+    bool zoomChanged = !velocitySame(&velocity[TRACK_ZOOM], &tracker->sent[TRACK_ZOOM]);
+    bool zoomStop    = velocity[TRACK_ZOOM].direction == 0;
+    bool zoomDue =
+        tracker->keepalive != 0 && !zoomStop && now - tracker->zoomSentAt > tracker->keepalive;
+    if (zoomChanged && !zoomStop && now - tracker->zoomSentAt < interval) {
+        rateLimited++;
+    } else if (zoomChanged || zoomDue) {
+        command.op      = CMD_RELATIVE_ZOOM;
+        command.args[0] = velocity[TRACK_ZOOM].direction;
+        command.args[1] = velocity[TRACK_ZOOM].speed;
+        command.args[2] = 0;
+        command.args[3] = 0;
+        if (run(tracker, &command, &commandResult)) {
+            tracker->sent[TRACK_ZOOM] = velocity[TRACK_ZOOM];
+            tracker->zoomSentAt       = now;
+        }
+        std::lock_guard<std::mutex> lock(tracker->statsMutex);
+        tracker->stats.zoom_commands++;
+    }
+
+    if (rateLimited != 0) {
+        std::lock_guard<std::mutex> lock(tracker->statsMutex);
+        tracker->stats.rate_limited += rateLimited;
+    }
+}
+
+static void tick(struct Tracker* tracker, uint64_t now, double dt) {
+    const struct TrackerConfig* config = &tracker->config;
+    takeSamples(tracker, now);
+
+    double error[TRACK_AXES]  = {0, 0, 0};
+    double output[TRACK_AXES] = {0, 0, 0};
+    bool   tracking =
+        tracker->seen && now - tracker->subject.at <= (uint64_t)config->lost_ms * 1000000;
+    if (!tracking) {
+        resetControl(tracker);
+        tracker->unanswered = 0;
+    } else {
+        // where the subject should be by the time the camera reacts. image y
+        // grows downward and tilt up is positive.
+        double ahead = (double)(now - tracker->subject.at) / 1e9 + config->lead_ms / 1000.0;
+        double x     = tracker->subject.x + tracker->velocity[TRACK_PAN] * ahead;
+        double y     = tracker->subject.y + tracker->velocity[TRACK_TILT] * ahead;
+        double size  = tracker->subject.size + tracker->velocity[TRACK_ZOOM] * ahead;
+
+        double velocity[TRACK_AXES] = {tracker->velocity[TRACK_PAN],
+                                       -tracker->velocity[TRACK_TILT],
+                                       -tracker->velocity[TRACK_ZOOM]};
+        error[TRACK_PAN]            = x - 0.5;
+        error[TRACK_TILT]           = 0.5 - y;
+        if (config->target_size > 0 && tracker->subject.size > 0) {
+            error[TRACK_ZOOM] = config->target_size - size;
+        }
+        const struct PidGains* gains[TRACK_AXES] = {&config->pan, &config->tilt, &config->zoom};
+        for (int axis = 0; axis < TRACK_AXES; axis++) {
+            output[axis] = control(&tracker->pid[axis],
+                                   gains[axis],
+                                   error[axis],
+                                   velocity[axis],
+                                   dt,
+                                   config->deadband,
+                                   config->max_output);
+        }
+    }
+    drive(tracker, output, now);
+
+    std::lock_guard<std::mutex> lock(tracker->statsMutex);
+    struct TrackerStats*        stats = &tracker->stats;
+    stats->ticks++;
+    stats->tracking = tracking;
+    for (int axis = 0; axis < TRACK_AXES; axis++) {
+        stats->error[axis] = error[axis];
+    }
+    if (tracking) {
+        double square = error[TRACK_PAN] * error[TRACK_PAN] + error[TRACK_TILT] * error[TRACK_TILT];
+        tracker->meanSquare += fmin(dt / TRACKER_RMS_WINDOW_S, 1) * (square - tracker->meanSquare);
+        stats->rms_error = sqrt(tracker->meanSquare);
+        stats->max_error = fmax(stats->max_error, sqrt(square));
+    }
+}
+
+static void trackerThread(struct Tracker* tracker) {
+    realtimeEnter();
+    readRanges(tracker);
+
+    uint64_t interval = (uint64_t)tracker->config.interval_us * 1000;
+    uint64_t next     = monotonicNanos();
+    uint64_t last     = next;
+    while (!tracker->closing.load(std::memory_order_acquire)) {
+        next += interval;
+        sleepUntil(next);
+        uint64_t now = monotonicNanos();
+        {
+            std::lock_guard<std::mutex> lock(tracker->statsMutex);
+            histogramRecord(&tracker->stats.jitter, now > next ? now - next : 0);
+        }
+
+        struct SessionConfig sessionConfig;
+        sessionGetConfig(tracker->session, &sessionConfig);
+        tracker->keepalive = (uint64_t)sessionConfig.watchdog_ms * 1000000 / 2;
+
+        tick(tracker, now, (double)(now - last) / 1e9);
+        last = now;
+
+        // fell behind, skip ticks rather than bursting
+        now = monotonicNanos();
+        if (now > next + interval) {
+            next = now;
+        }
+    }
+
+    // leave the camera still
+    double stop[TRACK_AXES] = {0, 0, 0};
+    drive(tracker, stop, monotonicNanos());
+    realtimeLeave();
+}
+
+struct Tracker* trackerOpen(const struct UVCDevice* uvcDevice, const struct TrackerConfig* config) {
+    struct Tracker* tracker = new Tracker();
+    tracker->uvcDevice      = *uvcDevice;
+    tracker->session        = sessionFind(uvcDevice);
+    tracker->config         = *config;
+    if (tracker->config.interval_us == 0) {
+        tracker->config.interval_us = 20000;
+    }
+    tracker->config.deadband   = fmin(fmax(config->deadband, 0), 0.5);
+    tracker->config.max_output = fmin(fmax(config->max_output, 0), 1);
+    tracker->closing           = 0;
+    tracker->seen              = 0;
+    tracker->unanswered        = 0;
+    tracker->panTiltSentAt     = 0;
+    tracker->zoomSentAt        = 0;
+    tracker->keepalive         = 0;
+    tracker->pushed            = 0;
+    tracker->dropped           = 0;
+    tracker->stats             = TrackerStats();
+    tracker->meanSquare        = 0;
+    histogramReset(&tracker->stats.jitter);
+    histogramReset(&tracker->stats.latency);
+    for (int axis = 0; axis < TRACK_AXES; axis++) {
+        tracker->ranges[axis]   = AxisRange();
+        tracker->velocity[axis] = 0;
+        tracker->sent[axis]     = {0, 0};
+    }
+    resetControl(tracker);
+    tracker->thread = std::thread(trackerThread, tracker);
+    return tracker;
+}
+
+bool trackerPush(struct Tracker* tracker, const struct TrackerSample* sample) {
+    tracker->pushed.fetch_add(1, std::memory_order_relaxed);
+    struct TrackerSample stamped = *sample;
+    if (stamped.at == 0) {
+        stamped.at = monotonicNanos();
+    }
+    if (!tracker->samples.push(stamped)) {
+        tracker->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void trackerGetStats(struct Tracker* tracker, struct TrackerStats* stats) {
+    {
+        std::lock_guard<std::mutex> lock(tracker->statsMutex);
+        *stats = tracker->stats;
+    }
+    stats->samples = tracker->pushed.load(std::memory_order_relaxed);
+    stats->dropped = tracker->dropped.load(std::memory_order_relaxed);
+}
+
+void trackerClose(struct Tracker* tracker) {
+    tracker->closing.store(1, std::memory_order_release);
+    tracker->thread.join();
+    delete tracker;
+}
+
+}  // namespace ptz
@@ -0,0 +1,74 @@
+#ifndef PTZ_TRACKER_H
+#define PTZ_TRACKER_H
+
+#include <stdint.h>
+#include "device.h"
+#include "stats.h"
+
+namespace ptz {
+
+// closed loop auto-tracking. a producer pushes where the subject is in the
+// frame, a native thread runs a PID controller per axis on a fixed tick and
+// drives the camera with relative pan/tilt and zoom commands, so garbage
+// collection pauses on the producer's side never stall the loop.
+struct PidGains {
+    double kp;
+    double ki;
+    double kd;
+    double kf;  // feed forward on the subject's velocity across the frame
+};
+
+struct TrackerConfig {
+    uint32_t        interval_us;          // controller tick
+    uint32_t        command_interval_us;  // least time between speed changes, stops excepted
+    uint32_t        lost_ms;              // stop once the subject has not been seen this long
+    uint32_t        lead_ms;              // predict the subject this far ahead of its last sample
+    double          deadband;             // error treated as centered, in frame widths
+    double          max_output;           // cap on any axis' speed, 0..1
+    double          target_size;          // subject height to zoom to, 0 leaves zoom alone
+    struct PidGains pan;
+    struct PidGains tilt;
+    struct PidGains zoom;
+};
+
+// where the subject is, with 0,0 the top left of the frame and 1,1 the
+// bottom right. size is its height as a fraction of the frame's, 0 when
+// unknown. visible 0 says the subject is gone.
+struct TrackerSample {
+    float    x;
+    float    y;
+    float    size;
+    int      visible;
+    uint64_t at;  // monotonicNanos(), 0 for when it is pushed
+};
+
+struct TrackerStats {
+    uint64_t samples;            // pushed
+    uint64_t dropped;            // pushed while the buffer was full
+    uint64_t ticks;
+    uint64_t pan_tilt_commands;  // relativePanTilt sent
+    uint64_t zoom_commands;      // relativeZoom sent
+    uint64_t rate_limited;       // speed changes held back by command_interval_us
+    uint64_t errors;             // commands the camera failed
+    int      tracking;           // a subject seen within lost_ms
+    double   error[3];           // pan, tilt, zoom error on the last tick
+    double   rms_error;          // pan/tilt error over about the last second
+    double   max_error;          // worst pan/tilt error while tracking
+
+    struct LatencyHistogram jitter;   // how late each tick woke, nanoseconds
+    struct LatencyHistogram latency;  // from a sample to the command it caused
+};
+
+void trackerDefaults(struct TrackerConfig* config);
+
+struct Tracker;
+struct Tracker* trackerOpen(const struct UVCDevice* uvcDevice, const struct TrackerConfig* config);
+// producer side, one thread only, never blocks. false when the buffer is full
+bool trackerPush(struct Tracker* tracker, const struct TrackerSample* sample);
+void trackerGetStats(struct Tracker* tracker, struct TrackerStats* stats);
+// stops the camera, ends the thread and frees the tracker
+void trackerClose(struct Tracker* tracker);
+
+}  // namespace ptz
+
+#endif  // PTZ_TRACKER_H
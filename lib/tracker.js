@@ -0,0 +1,31 @@
+"use strict";
+const ptz = require("../build/Release/ptz");
+
+// auto-tracking for one camera. push() where the subject is in each frame; a
+// native thread runs the control loop on a fixed tick and drives the camera
+// with relative pan/tilt and zoom commands.
+class Tracker {
+  constructor(input) {
+    this.id = ptz.openTracker(input);
+  }
+
+  // x, y in 0..1 from the top left of the frame, size the subject's height as
+  // a fraction of the frame's. with no arguments the subject is lost.
+  push(x, y, size) {
+    if (x === undefined || x === null) {
+      return ptz.pushTracking(this.id);
+    }
+    return ptz.pushTracking(this.id, x, y, size || 0);
+  }
+
+  getStats() {
+    return ptz.getTrackerStats(this.id);
+  }
+
+  // stops the camera and the tracker's thread
+  close() {
+    ptz.closeTracker(this.id);
+  }
+}
+
+module.exports = Tracker;
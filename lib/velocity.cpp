@@ -0,0 +1,296 @@
+#include "velocity.h"
+#include <math.h>
+#include <atomic>
+#include <thread>
+#include "command.h"
+#include "realtime.h"
+#include "ring.h"
+#include "session.h"
+#include "stats.h"
+
+namespace ptz {
+
+// zoom position is re-read this often while zooming, for speed scaling
+#define VELOCITY_ZOOM_POLL_NS 200000000ULL
+
+struct VelocityChannel {
+    struct UVCDevice      uvcDevice;
+    struct CameraSession* session;
+    struct VelocityConfig config;
+    std::thread           thread;
+    std::atomic<int>      closing;
+
+    SpscRing<struct VelocitySample, 256> samples;
+
+    struct AxisRange pan;
+    struct AxisRange tilt;
+    struct AxisRange zoom;
+
+    // absolute zoom, when the camera has it
+    int      hasZoomPosition;
+    uint16_t zoomMin;
+    uint16_t zoomMax;
+    uint16_t zoomCurrent;
+    uint64_t zoomReadAt;
+
+    struct AxisVelocity sentPan;
+    struct AxisVelocity sentTilt;
+    struct AxisVelocity sentZoom;
+    uint64_t            panTiltSentAt;
+    uint64_t            zoomSentAt;
+    uint64_t            keepalive;  // resend a held velocity this often, for the watchdog
+
+    std::atomic<uint64_t> pushed;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> ticks;
+    std::atomic<uint64_t> panTiltCommands;
+    std::atomic<uint64_t> zoomCommands;
+    std::atomic<uint64_t> errors;
+};
+
+static bool run(struct VelocityChannel* channel,
+                struct Command*         command,
+                struct CommandResult*   commandResult) {
+    struct UVCDevice uvcDevice = channel->uvcDevice;
+    sessionRun(channel->session, &uvcDevice, command, commandResult);
+    if (commandResult->result != 0) {
+        channel->errors.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+static void readRanges(struct VelocityChannel* channel) {
+    struct Command       command = {};
+    struct CommandResult commandResult;
+
+    command.op = CMD_GET_RELATIVE_PAN_TILT;
+    if (run(channel, &command, &commandResult)) {
+        const struct RelativePanTiltInfo* info = &commandResult.relativePanTiltInfo;
+        channel->pan.supported                = 1;
+        channel->pan.min_speed                = info->min_pan_speed;
+        channel->pan.max_speed                = info->max_pan_speed;
+        channel->pan.resolution               = info->resolution_pan_speed;
+        channel->tilt.supported               = 1;
+        channel->tilt.min_speed               = info->min_tilt_speed;
+        channel->tilt.max_speed               = info->max_tilt_speed;
+        channel->tilt.resolution              = info->resolution_tilt_speed;
+    }
+
+    command.op = CMD_GET_RELATIVE_ZOOM;
+    if (run(channel, &command, &commandResult)) {
+        channel->zoom.supported  = 1;
+        channel->zoom.min_speed  = commandResult.relativeZoomInfo.min_speed;
+        channel->zoom.max_speed  = commandResult.relativeZoomInfo.max_speed;
+        channel->zoom.resolution = commandResult.relativeZoomInfo.resolution_speed;
+    }
+}
+
+static void readZoomPosition(struct VelocityChannel* channel) {
+    struct Command       command = {};
+    struct CommandResult commandResult;
+
+    command.op = CMD_GET_ABSOLUTE_ZOOM;
+    if (run(channel, &command, &commandResult)) {
+        channel->hasZoomPosition = 1;
+        channel->zoomMin         = commandResult.absoluteZoomInfo.min;
+        channel->zoomMax         = commandResult.absoluteZoomInfo.max;
+        channel->zoomCurrent     = commandResult.absoluteZoomInfo.current;
+    }
+    channel->zoomReadAt = monotonicNanos();
+}
+
+struct AxisVelocity velocityQuantize(const struct AxisRange* range,
+                                     double                  value,
+                                     double                  deadband,
+                                     double                  scale) {
+    struct AxisVelocity velocity;
+    velocity.direction = 0;
+    velocity.speed     = range->min_speed;
+
+    double magnitude = fabs(value);
+    if (!range->supported || magnitude <= deadband) {
+        return velocity;
+    }
+    magnitude = fmin((magnitude - deadband) / (1 - deadband), 1) * scale;
+
+    int step  = range->resolution > 0 ? range->resolution : 1;
+    int span  = range->max_speed - range->min_speed;
+    int speed = range->min_speed + (int)lround(magnitude * span / step) * step;
+    if (speed > range->max_speed) {
+        speed = range->max_speed;
+    }
+    velocity.direction = value > 0 ? 1 : -1;
+    velocity.speed     = (uint8_t)(speed > 0 ? speed : 1);
+    return velocity;
+}
+
+bool velocitySame(const struct AxisVelocity* a, const struct AxisVelocity* b) {
+    if (a->direction != b->direction) {
+        return false;
+    }
+    // speed means nothing while stopped
+    return a->direction == 0 || a->speed == b->speed;
+}
+
+static void apply(struct VelocityChannel* channel, const struct VelocitySample* sample) {
+    struct Command       command = {};
+    struct CommandResult commandResult;
+    double               deadband = channel->config.deadband;
+
+    // slow pan and tilt down as the view narrows
+    double scale = 1;
+    if (channel->hasZoomPosition && channel->zoomMax > channel->zoomMin) {
+        double zoomed = (double)(channel->zoomCurrent - channel->zoomMin) /
+                        (double)(channel->zoomMax - channel->zoomMin);
+        scale = 1 - channel->config.zoom_scaling * fmin(fmax(zoomed, 0), 1);
+    }
+
+    // while samples keep coming, a held stick refreshes the watchdog
+    uint64_t now = monotonicNanos();
+    bool     panTiltDue =
+        channel->keepalive != 0 && now - channel->panTiltSentAt > channel->keepalive &&
+        (channel->sentPan.direction != 0 || channel->sentTilt.direction != 0);
+    bool zoomDue = channel->keepalive != 0 && now - channel->zoomSentAt > channel->keepalive &&
+                   channel->sentZoom.direction != 0;
+
+    struct AxisVelocity pan  = velocityQuantize(&channel->pan, sample->pan, deadband, scale);
+    struct AxisVelocity tilt = velocityQuantize(&channel->tilt, sample->tilt, deadband, scale);
+    if (panTiltDue || !velocitySame(&pan, &channel->sentPan) ||
+        !velocitySame(&tilt, &channel->sentTilt)) {
+        command.op      = CMD_RELATIVE_PAN_TILT;
+        command.args[0] = pan.direction;
+        command.args[1] = pan.speed;
+        command.args[2] = tilt.direction;
+        command.args[3] = tilt.speed;
+        channel->panTiltCommands.fetch_add(1, std::memory_order_relaxed);
+        if (run(channel, &command, &commandResult)) {
+            channel->sentPan       = pan;
+            channel->sentTilt      = tilt;
+            channel->panTiltSentAt = now;
+        }
+    }
+
+    struct AxisVelocity zoom = velocityQuantize(&channel->zoom, sample->zoom, deadband, 1);
+    if (zoomDue || !velocitySame(&zoom, &channel->sentZoom)) {
+        command.op      = CMD_RELATIVE_ZOOM;
+        command.args[0] = zoom.direction;
+        command.args[1] = zoom.speed;
+        command.args[2] = 0;
+        command.args[3] = 0;
+        channel->zoomCommands.fetch_add(1, std::memory_order_relaxed);
+        if (run(channel, &command, &commandResult)) {
+            bool stopped        = zoom.direction == 0 && channel->sentZoom.direction != 0;
+            channel->sentZoom   = zoom;
+            channel->zoomSentAt = now;
+            if (stopped && channel->hasZoomPosition) {
+                readZoomPosition(channel);
+            }
+        }
+    }
+}
+
+static void velocityThread(struct VelocityChannel* channel) {
+    realtimeEnter();
+    readRanges(channel);
+    readZoomPosition(channel);
+
+    struct VelocitySample latest   = {0, 0, 0};
+    uint64_t              interval = (uint64_t)channel->config.interval_us * 1000;
+    uint64_t              next     = monotonicNanos();
+    while (!channel->closing.load(std::memory_order_acquire)) {
+        next += interval;
+        sleepUntil(next);
+        channel->ticks.fetch_add(1, std::memory_order_relaxed);
+
+        struct SessionConfig sessionConfig;
+        sessionGetConfig(channel->session, &sessionConfig);
+        channel->keepalive = (uint64_t)sessionConfig.watchdog_ms * 1000000 / 2;
+
+        // only the newest position of the stick matters
+        struct VelocitySample sample;
+        bool                  fresh = false;
+        while (channel->samples.pop(&sample)) {
+            latest = sample;
+            fresh  = true;
+        }
+        if (channel->sentZoom.direction != 0 && channel->hasZoomPosition &&
+            monotonicNanos() - channel->zoomReadAt > VELOCITY_ZOOM_POLL_NS) {
+            readZoomPosition(channel);
+            fresh = true;
+        }
+        if (fresh) {
+            apply(channel, &latest);
+        }
+
+        // fell behind, skip ticks rather than bursting
+        uint64_t now = monotonicNanos();
+        if (now > next + interval) {
+            next = now;
+        }
+    }
+
+    // leave the camera still
+    struct VelocitySample stop = {0, 0, 0};
+    apply(channel, &stop);
+    realtimeLeave();
+}
+
+struct VelocityChannel* velocityOpen(const struct UVCDevice*     uvcDevice,
+                                     const struct VelocityConfig* config) {
+    struct VelocityChannel* channel = new VelocityChannel();
+    channel->uvcDevice              = *uvcDevice;
+    channel->session                = sessionFind(uvcDevice);
+    channel->config                 = *config;
+    if (channel->config.interval_us == 0) {
+        channel->config.interval_us = 10000;
+    }
+    channel->config.deadband     = fmin(fmax(config->deadband, 0), 0.99);
+    channel->config.zoom_scaling = fmin(fmax(config->zoom_scaling, 0), 0.95);
+    channel->closing             = 0;
+    channel->pan                 = AxisRange();
+    channel->tilt                = AxisRange();
+    channel->zoom                = AxisRange();
+    channel->hasZoomPosition     = 0;
+    channel->zoomReadAt          = 0;
+    channel->sentPan             = {0, 0};
+    channel->sentTilt            = {0, 0};
+    channel->sentZoom            = {0, 0};
+    channel->panTiltSentAt       = 0;
+    channel->zoomSentAt          = 0;
+    channel->keepalive           = 0;
+    channel->pushed              = 0;
+    channel->dropped             = 0;
+    channel->ticks               = 0;
+    channel->panTiltCommands     = 0;
+    channel->zoomCommands        = 0;
+    channel->errors              = 0;
+    channel->thread              = std::thread(velocityThread, channel);
+    return channel;
+}
+
+bool velocityPush(struct VelocityChannel* channel, const struct VelocitySample* sample) {
+    channel->pushed.fetch_add(1, std::memory_order_relaxed);
+    if (!channel->samples.push(*sample)) {
+        channel->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void velocityGetStats(struct VelocityChannel* channel, struct VelocityStats* stats) {
+    stats->samples           = channel->pushed.load(std::memory_order_relaxed);
+    stats->dropped           = channel->dropped.load(std::memory_order_relaxed);
+    stats->ticks             = channel->ticks.load(std::memory_order_relaxed);
+    stats->pan_tilt_commands = channel->panTiltCommands.load(std::memory_order_relaxed);
+    stats->zoom_commands     = channel->zoomCommands.load(std::memory_order_relaxed);
+    stats->errors            = channel->errors.load(std::memory_order_relaxed);
+}
+
+void velocityClose(struct VelocityChannel* channel) {
+    channel->closing.store(1, std::memory_order_release);
+    channel->thread.join();
+    delete channel;
+}
+
+}  // namespace ptz
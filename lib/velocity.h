@@ -0,0 +1,68 @@
+#ifndef PTZ_VELOCITY_H
+#define PTZ_VELOCITY_H
+
+#include <stdint.h>
+#include "device.h"
+
+namespace ptz {
+
+// joystick style velocity control. the producer pushes raw axis values at
+// whatever rate it samples them, a native thread turns the latest sample into
+// relative pan/tilt and zoom commands on a fixed tick, and only sends when
+// the quantized direction or speed changes.
+struct VelocityConfig {
+    uint32_t interval_us;   // tick, samples arriving in between are coalesced
+    double   deadband;      // axis magnitude treated as centered, 0..1
+    double   zoom_scaling;  // pan/tilt speed given up at full zoom, 0..1
+};
+
+// axis values in -1..1: pan right, tilt up, zoom in are positive
+struct VelocitySample {
+    float pan;
+    float tilt;
+    float zoom;
+};
+
+struct VelocityStats {
+    uint64_t samples;            // pushed
+    uint64_t dropped;            // pushed while the buffer was full
+    uint64_t ticks;
+    uint64_t pan_tilt_commands;  // relativePanTilt sent
+    uint64_t zoom_commands;      // relativeZoom sent
+    uint64_t errors;             // commands the camera failed
+};
+
+// speed range of one axis, from the camera's relative control info
+struct AxisRange {
+    int     supported;
+    uint8_t min_speed;
+    uint8_t max_speed;
+    uint8_t resolution;
+};
+
+// what the camera was last told to do on one axis
+struct AxisVelocity {
+    int8_t  direction;
+    uint8_t speed;
+};
+
+// map an axis value in -1..1 to a direction and a speed on the camera's own
+// grid, slowed by scale. values within deadband of 0 stop the axis.
+struct AxisVelocity velocityQuantize(const struct AxisRange* range,
+                                     double                  value,
+                                     double                  deadband,
+                                     double                  scale);
+bool                velocitySame(const struct AxisVelocity* a, const struct AxisVelocity* b);
+
+struct VelocityChannel;
+struct VelocityChannel* velocityOpen(const struct UVCDevice*     uvcDevice,
+                                     const struct VelocityConfig* config);
+// producer side, one thread only. false when the buffer is full
+bool velocityPush(struct VelocityChannel* channel, const struct VelocitySample* sample);
+void velocityGetStats(struct VelocityChannel* channel, struct VelocityStats* stats);
+// stops any motion, ends the thread and frees the channel
+void velocityClose(struct VelocityChannel* channel);
+
+}  // namespace ptz
+
+#endif  // PTZ_VELOCITY_H
@@ -0,0 +1,27 @@
+"use strict";
+const ptz = require("../build/Release/ptz");
+
+// joystick input for one camera. push() raw axis values as often as they are
+// sampled; a native thread turns the newest one into relative pan/tilt/zoom
+// commands and only sends when the quantized velocity changes.
+class VelocityChannel {
+  constructor(input) {
+    this.id = ptz.openVelocity(input);
+  }
+
+  // axis values in -1..1, positive is pan right, tilt up, zoom in
+  push(pan, tilt, zoom) {
+    return ptz.pushVelocity(this.id, pan || 0, tilt || 0, zoom || 0);
+  }
+
+  getStats() {
+    return ptz.getVelocityStats(this.id);
+  }
+
+  // stops the camera and the channel's thread
+  close() {
+    ptz.closeVelocity(this.id);
+  }
+}
+
+module.exports = VelocityChannel;
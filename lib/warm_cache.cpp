@@ -0,0 +1,409 @@
+#include "warm_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <mutex>
+#include "device_index.h"
+#include "mapped_file.h"
+
+namespace ptz {
+
+static std::mutex         warmMutex;
+static struct MappedFile  warmFile    = {-1, NULL, 0};
+static struct WarmHeader* header      = NULL;
+static struct WarmEntry*  entries     = NULL;
+static uint64_t           hits        = 0;
+static uint64_t           misses      = 0;
+static uint64_t           validated   = 0;
+static uint64_t           invalidated = 0;
+
+static size_t cacheSize(uint32_t capacity) {
+    return sizeof(struct WarmHeader) + (size_t)capacity * sizeof(struct WarmEntry);
+}
+
+static void closeLocked() {
+    if (header != NULL) {
+        syncFile(&warmFile);
+    }
+    unmapFile(&warmFile, 0);
+    header  = NULL;
+    entries = NULL;
+}
+
+int warmCacheOpen(const char* path, uint32_t capacity) {
+    std::lock_guard<std::mutex> lock(warmMutex);
+    closeLocked();
+
+    uint32_t slots = 16;
+    while (slots < capacity && slots < (1U << 20)) {
+        slots <<= 1;
+    }
+
+    // an existing cache keeps the capacity it was made with, and anything
+    // else is left alone rather than grown into one
+    struct WarmHeader existing;
+    bool              fresh = true;
+    int               fd    = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        struct stat st;
+        bool        valid = fstat(fd, &st) == 0;
+        if (valid && st.st_size > 0) {
+            fresh = false;
+            valid = read(fd, &existing, sizeof(existing)) == (ssize_t)sizeof(existing) &&
+                    memcmp(existing.magic, PTZ_WARM_MAGIC, sizeof(existing.magic)) == 0 &&
+                    existing.version == PTZ_WARM_VERSION &&
+                    existing.entrySize == sizeof(struct WarmEntry) && existing.capacity != 0 &&
+                    (existing.capacity & (existing.capacity - 1)) == 0 &&
+                    (size_t)st.st_size >= cacheSize(existing.capacity);
+        }
+        close(fd);
+        if (!valid) {
+            return EINVAL;
+        }
+    }
+    if (!fresh) {
+        slots = existing.capacity;
+    }
+
+    int error = mapFile(&warmFile, path, cacheSize(slots));
+    if (error != 0) {
+        return error;
+    }
+    header  = (struct WarmHeader*)warmFile.data;
+    entries = (struct WarmEntry*)(warmFile.data + sizeof(struct WarmHeader));
+    if (fresh) {
+        header->version   = PTZ_WARM_VERSION;
+        header->entrySize = sizeof(struct WarmEntry);
+        header->capacity  = slots;
+        memcpy(header->magic, PTZ_WARM_MAGIC, sizeof(header->magic));
+    }
+    return 0;
+}
+
+void warmCacheClose() {
+    std::lock_guard<std::mutex> lock(warmMutex);
+    closeLocked();
+}
+
+bool warmCacheIsOpen() {
+    std::lock_guard<std::mutex> lock(warmMutex);
+    return header != NULL;
+}
+
+void warmCacheGetStats(struct WarmCacheStats* stats) {
+    std::lock_guard<std::mutex> lock(warmMutex);
+    stats->open        = header != NULL;
+    stats->capacity    = header != NULL ? header->capacity : 0;
+    stats->count       = header != NULL ? header->count : 0;
+    stats->hits        = hits;
+    stats->misses      = misses;
+    stats->validated   = validated;
+    stats->invalidated = invalidated;
+}
+
+bool warmCameraIdentify(const struct UVCDevice* uvcDevice, struct WarmCamera* camera) {
+    struct DeviceInfo info;
+    if (!deviceIdentify(uvcDevice, &info)) {
+        return false;
+    }
+    camera->vendorId  = (uint16_t)info.vendorId;
+    camera->productId = (uint16_t)info.productId;
+    camera->firmware  = info.firmware;
+    camera->simulated = (uint16_t)uvcDevice->simulated;
+    memcpy(camera->serial, info.serial, sizeof(camera->serial));
+    return true;
+}
+
+// fnv-1a over the camera
+static uint64_t warmHash(const struct WarmCamera* camera) {
+    uint64_t       hash   = 14695981039346656037ULL;
+    const uint32_t key[3] = {camera->vendorId, camera->productId, camera->simulated};
+    for (size_t i = 0; i < sizeof(key); i++) {
+        hash = (hash ^ ((const uint8_t*)key)[i]) * 1099511628211ULL;
+    }
+    for (const char* c = camera->serial; *c != 0; c++) {
+        hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// the entry for camera, claiming an empty one when create is set and there
+// is room. NULL otherwise. called with warmMutex held.
+static struct WarmEntry* findEntry(const struct WarmCamera* camera, bool create) {
+    uint64_t          hash  = warmHash(camera);
+    uint32_t          mask  = header->capacity - 1;
+    struct WarmEntry* entry = NULL;
+    for (uint32_t i = 0; i <= mask; i++) {
+        entry = &entries[(hash + i) & mask];
+        if (entry->state == WARM_ENTRY_EMPTY) {
+            break;
+        }
+        if (entry->hash == hash && entry->vendorId == camera->vendorId &&
+            entry->productId == camera->productId && entry->simulated == camera->simulated &&
+            strncmp(entry->serial, camera->serial, DEVICE_SERIAL_SIZE) == 0) {
+            return entry;
+        }
+        entry = NULL;
+    }
+    // at most three quarters full, so probe chains stay short
+    if (!create || entry == NULL || header->count >= header->capacity / 4 * 3) {
+        return NULL;
+    }
+    memset(entry, 0, sizeof(*entry));
+    entry->hash      = hash;
+    entry->vendorId  = camera->vendorId;
+    entry->productId = camera->productId;
+    entry->simulated = (uint8_t)camera->simulated;
+    entry->firmware  = camera->firmware;
+    memcpy(entry->serial, camera->serial, sizeof(entry->serial));
+    entry->state = WARM_ENTRY_USED;
+    header->count++;
+    return entry;
+}
+
+// nothing read from other firmware is trusted
+static void checkFirmware(struct WarmEntry* entry, const struct WarmCamera* camera) {
+    if (entry->firmware != camera->firmware) {
+        if (entry->fields != 0) {
+            invalidated++;
+        }
+        entry->fields   = 0;
+        entry->firmware = camera->firmware;
+    }
+}
+
+bool warmCacheFind(const struct WarmCamera* camera, int op, struct CommandResult* commandResult) {
+    std::lock_guard<std::mutex> lock(warmMutex);
+    if (header == NULL || op >= CMD_CONTROL_BASE) {
+        return false;
+    }
+    struct WarmEntry* entry = findEntry(camera, false);
+    if (entry != NULL) {
+        checkFirmware(entry, camera);
+    }
+    if (entry == NULL || !(entry->fields & (1U << op))) {
+        misses++;
+        return false;
+    }
+    hits++;
+
+    memset(commandResult, 0, sizeof(*commandResult));
+    switch (op) {
+        case CMD_GET_CAPABILITIES: {
+            struct DeviceCapability* capability = &commandResult->capability;
+            capability->absolute_zoom           = entry->capability[0];
+            capability->relative_zoom           = entry->capability[1];
+            capability->absolute_pan_tilt       = entry->capability[2];
+            capability->relative_pan_tilt       = entry->capability[3];
+            capability->absolute_roll           = entry->capability[4];
+            capability->relative_roll           = entry->capability[5];
+            break;
+        }
+        case CMD_GET_ABSOLUTE_ZOOM: {
+            struct AbsoluteZoomInfo* info = &commandResult->absoluteZoomInfo;
+            info->min                     = entry->absoluteZoom[0];
+            info->max                     = entry->absoluteZoom[1];
+            info->resolution              = entry->absoluteZoom[2];
+            info->current                 = entry->absoluteZoom[3];
+            info->def                     = entry->absoluteZoom[4];
+            break;
+        }
+        case CMD_GET_RELATIVE_ZOOM: {
+            struct RelativeZoomInfo* info = &commandResult->relativeZoomInfo;
+            info->direction               = (int8_t)entry->relativeZoom[0];
+            info->digital_zoom            = entry->relativeZoom[1];
+            info->min_speed               = entry->relativeZoom[2];
+            info->max_speed               = entry->relativeZoom[3];
+            info->resolution_speed        = entry->relativeZoom[4];
+            info->current_speed           = entry->relativeZoom[5];
+            info->default_speed           = entry->relativeZoom[6];
+            break;
+        }
+        case CMD_GET_ABSOLUTE_PAN_TILT: {
+            struct AbsolutePanTiltInfo* info = &commandResult->absolutePanTiltInfo;
+            info->min_pan                    = entry->absolutePanTilt[0];
+            info->min_tilt                   = entry->absolutePanTilt[1];
+            info->max_pan                    = entry->absolutePanTilt[2];
+            info->max_tilt                   = entry->absolutePanTilt[3];
+            info->resolution_pan             = entry->absolutePanTilt[4];
+            info->resolution_tilt            = entry->absolutePanTilt[5];
+            info->current_pan                = entry->absolutePanTilt[6];
+            info->current_tilt               = entry->absolutePanTilt[7];
+            info->default_pan                = entry->absolutePanTilt[8];
+            info->default_tilt               = entry->absolutePanTilt[9];
+            break;
+        }
+        case CMD_GET_RELATIVE_PAN_TILT: {
+            struct RelativePanTiltInfo* info = &commandResult->relativePanTiltInfo;
+            info->pan_direction              = (int8_t)entry->relativePanTilt[0];
+            info->tilt_direction             = (int8_t)entry->relativePanTilt[1];
+            info->min_pan_speed              = entry->relativePanTilt[2];
+            info->min_tilt_speed             = entry->relativePanTilt[3];
+            info->max_pan_speed              = entry->relativePanTilt[4];
+            info->max_tilt_speed             = entry->relativePanTilt[5];
+            info->resolution_pan_speed       = entry->relativePanTilt[6];
+            info->resolution_tilt_speed      = entry->relativePanTilt[7];
+            info->default_pan_speed          = entry->relativePanTilt[8];
+            info->default_tilt_speed         = entry->relativePanTilt[9];
+            info->current_pan_speed          = entry->relativePanTilt[10];
+            info->current_tilt_speed         = entry->relativePanTilt[11];
+            break;
+        }
+    }
+    commandResult->result = UVC_SUCCESS;
+    commandResult->error  = NULL;
+    return true;
+}
+
+// copy value into a field, noting whether it differed. position and motion
+// fields are copied without counting as a difference.
+template <typename T, typename V>
+static void update(T* field, V value, bool moving, bool* changed, bool* differs) {
+    if (*field != (T)value) {
+        *field   = (T)value;
+        *changed = true;
+        if (!moving) {
+            *differs = true;
+        }
+    }
+}
+
+static uint64_t realtimeNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void warmCacheStore(const struct WarmCamera*    camera,
+                    int                         op,
+                    const struct CommandResult* commandResult,
+                    bool                        checking) {
+    std::lock_guard<std::mutex> lock(warmMutex);
+    if (header == NULL || commandResult->result != 0 || op >= CMD_CONTROL_BASE ||
+        !commandSpec(op)->read) {
+        return;
+    }
+    struct WarmEntry* entry = findEntry(camera, true);
+    if (entry == NULL) {
+        return;
+    }
+    checkFirmware(entry, camera);
+
+    // only pages that change are written, a steady camera costs no io
+    bool changed = !(entry->fields & (1U << op));
+    bool differs = changed;
+    switch (op) {
+        case CMD_GET_CAPABILITIES: {
+            const struct DeviceCapability* capability = &commandResult->capability;
+            update(&entry->capability[0], capability->absolute_zoom, false, &changed, &differs);
+            update(&entry->capability[1], capability->relative_zoom, false, &changed, &differs);
+            update(
+                &entry->capability[2], capability->absolute_pan_tilt, false, &changed, &differs);
+            update(
+                &entry->capability[3], capability->relative_pan_tilt, false, &changed, &differs);
+            update(&entry->capability[4], capability->absolute_roll, false, &changed, &differs);
+            update(&entry->capability[5], capability->relative_roll, false, &changed, &differs);
+            break;
+        }
+        case CMD_GET_ABSOLUTE_ZOOM: {
+            const struct AbsoluteZoomInfo* info = &commandResult->absoluteZoomInfo;
+            update(&entry->absoluteZoom[0], info->min, false, &changed, &differs);
+            update(&entry->absoluteZoom[1], info->max, false, &changed, &differs);
+            update(&entry->absoluteZoom[2], info->resolution, false, &changed, &differs);
+            update(&entry->absoluteZoom[3], info->current, true, &changed, &differs);
+            update(&entry->absoluteZoom[4], info->def, false, &changed, &differs);
+            break;
+        }
+        case CMD_GET_RELATIVE_ZOOM: {
+            const struct RelativeZoomInfo* info = &commandResult->relativeZoomInfo;
+            update(&entry->relativeZoom[0], info->direction, true, &changed, &differs);
+            update(&entry->relativeZoom[1], info->digital_zoom, false, &changed, &differs);
+            update(&entry->relativeZoom[2], info->min_speed, false, &changed, &differs);
+            update(&entry->relativeZoom[3], info->max_speed, false, &changed, &differs);
+            update(&entry->relativeZoom[4], info->resolution_speed, false, &changed, &differs);
+            update(&entry->relativeZoom[5], info->current_speed, true, &changed, &differs);
+            update(&entry->relativeZoom[6], info->default_speed, false, &changed, &differs);
+            break;
+        }
+        case CMD_GET_ABSOLUTE_PAN_TILT: {
+            const struct AbsolutePanTiltInfo* info = &commandResult->absolutePanTiltInfo;
+            int32_t                           values[10];
+            values[0] = info->min_pan;
+            values[1] = info->min_tilt;
+            values[2] = info->max_pan;
+            values[3] = info->max_tilt;
+            values[4] = info->resolution_pan;
+            values[5] = info->resolution_tilt;
+            values[6] = info->current_pan;
+            values[7] = info->current_tilt;
+            values[8] = info->default_pan;
+            values[9] = info->default_tilt;
+            for (int i = 0; i < 10; i++) {
+                bool current = i == 6 || i == 7;
+                update(&entry->absolutePanTilt[i], values[i], current, &changed, &differs);
+            }
+            break;
+        }
+        case CMD_GET_RELATIVE_PAN_TILT: {
+            const struct RelativePanTiltInfo* info = &commandResult->relativePanTiltInfo;
+            uint8_t                           values[12];
+            values[0]  = (uint8_t)info->pan_direction;
+            values[1]  = (uint8_t)info->tilt_direction;
+            values[2]  = info->min_pan_speed;
+            values[3]  = info->min_tilt_speed;
+            values[4]  = info->max_pan_speed;
+            values[5]  = info->max_tilt_speed;
+            values[6]  = info->resolution_pan_speed;
+            values[7]  = info->resolution_tilt_speed;
+            values[8]  = info->default_pan_speed;
+            values[9]  = info->default_tilt_speed;
+            values[10] = info->current_pan_speed;
+            values[11] = info->current_tilt_speed;
+            for (int i = 0; i < 12; i++) {
+                bool motion = i < 2 || i >= 10;
+                update(&entry->relativePanTilt[i], values[i], motion, &changed, &differs);
+            }
+            break;
+        }
+    }
+    if (checking) {
+        if (differs) {
+            invalidated++;
+        } else {
+            validated++;
+        }
+    }
+    if (changed) {
+        entry->fields |= 1U << op;
+        entry->updated = realtimeNanos();
+    }
+}
+
+void warmCacheStorePose(const struct WarmCamera* camera, const struct Command* command) {
+    std::lock_guard<std::mutex> lock(warmMutex);
+    if (header == NULL) {
+        return;
+    }
+    struct WarmEntry* entry = findEntry(camera, false);
+    if (entry == NULL || entry->firmware != camera->firmware) {
+        return;
+    }
+    bool changed = false;
+    bool differs = false;
+    if (command->op == CMD_ABSOLUTE_PAN_TILT &&
+        (entry->fields & (1U << CMD_GET_ABSOLUTE_PAN_TILT))) {
+        update(&entry->absolutePanTilt[6], command->args[0], true, &changed, &differs);
+        update(&entry->absolutePanTilt[7], command->args[1], true, &changed, &differs);
+    } else if (command->op == CMD_ABSOLUTE_ZOOM &&
+               (entry->fields & (1U << CMD_GET_ABSOLUTE_ZOOM))) {
+        update(&entry->absoluteZoom[3], command->args[0], true, &changed, &differs);
+    }
+    if (changed) {
+        entry->updated = realtimeNanos();
+    }
+}
+
+}  // namespace ptz
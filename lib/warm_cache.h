@@ -0,0 +1,97 @@
+#ifndef PTZ_WARM_CACHE_H
+#define PTZ_WARM_CACHE_H
+
+#include <stdint.h>
+#include "command.h"
+#include "device.h"
+
+namespace ptz {
+
+// what every read command last returned for every camera, kept in one memory
+// mapped file so a restarted process can answer capability, range and
+// position reads before it has sent a single transfer. entries are keyed by
+// vendor, product and serial and hold the firmware they were read from; an
+// entry from other firmware is dropped rather than trusted. the layout is an
+// open addressed hash table like the preset store's.
+#define PTZ_WARM_MAGIC "PTZWRM1"
+#define PTZ_WARM_VERSION 1
+
+struct WarmHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint32_t capacity;  // entries, a power of two
+    uint32_t count;     // cameras held
+    uint8_t  reserved[40];
+};
+
+#define WARM_ENTRY_EMPTY 0
+#define WARM_ENTRY_USED 1
+
+// the fields of each read in the order the addon names them. pan/tilt and
+// zoom current values double as the last known pose.
+struct WarmEntry {
+    uint64_t hash;
+    uint16_t vendorId;
+    uint16_t productId;
+    uint8_t  state;  // written last, an entry only counts once it is USED
+    uint8_t  simulated;
+    uint16_t firmware;
+    uint32_t fields;  // bit per read command held below
+    uint32_t reserved;
+    uint64_t updated;  // CLOCK_REALTIME nanoseconds of the last change
+    int32_t  absolutePanTilt[10];
+    uint16_t absoluteZoom[5];
+    uint8_t  capability[6];
+    uint8_t  relativeZoom[7];
+    uint8_t  relativePanTilt[12];
+    uint8_t  reserved2[5];
+    char     serial[DEVICE_SERIAL_SIZE];
+};
+
+// who a camera is, as far as the cache is concerned
+struct WarmCamera {
+    uint16_t vendorId;
+    uint16_t productId;
+    uint16_t firmware;
+    uint16_t simulated;
+    char     serial[DEVICE_SERIAL_SIZE];
+};
+// the camera uvcDevice's selectors pick, from the device index rather than
+// the device. false when it is not attached.
+bool warmCameraIdentify(const struct UVCDevice* uvcDevice, struct WarmCamera* camera);
+
+struct WarmCacheStats {
+    int      open;
+    uint32_t capacity;
+    uint32_t count;
+    uint64_t hits;         // reads answered from the file
+    uint64_t misses;       // reads it had nothing for
+    uint64_t validated;    // answers the device later agreed with
+    uint64_t invalidated;  // answers the device or a firmware change contradicted
+};
+
+// open or create the cache, replacing any open one. capacity is only used
+// for a new file and is rounded up to a power of two. returns 0, an errno
+// value, or EINVAL when the file is not a warm start cache.
+int  warmCacheOpen(const char* path, uint32_t capacity);
+void warmCacheClose();
+bool warmCacheIsOpen();
+void warmCacheGetStats(struct WarmCacheStats* stats);
+
+// the last result of a read command for camera, false when there is none.
+// only the dedicated reads are kept, never getControl or getRanges.
+bool warmCacheFind(const struct WarmCamera* camera, int op, struct CommandResult* commandResult);
+// keep a read's result. checking says it was read to check an answer from
+// the cache, which is then counted as validated, or as invalidated when
+// anything but the current position and motion differs.
+void warmCacheStore(const struct WarmCamera*    camera,
+                    int                         op,
+                    const struct CommandResult* commandResult,
+                    bool                        checking);
+// the position an absolute write left the camera in
+void warmCacheStorePose(const struct WarmCamera* camera, const struct Command* command);
+
+}  // namespace ptz
+
+#endif  // PTZ_WARM_CACHE_H
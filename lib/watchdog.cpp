@@ -0,0 +1,99 @@
+#include "watchdog.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "realtime.h"
+#include "stats.h"
+
+namespace ptz {
+
+// deadlines are rounded up to this
+#define WATCHDOG_TICK_NS 5000000ULL
+
+// heap allocated and never freed, like the sessions it serves, so the
+// detached thread never waits on a destroyed condition variable at exit
+struct Watchdog {
+    std::mutex                         mutex;
+    std::condition_variable            armed;
+    struct TimerWheel                  wheel;
+    std::vector<struct WatchdogTimer*> due;
+};
+
+static void watchdogLoop(struct Watchdog* watchdog);
+
+static struct Watchdog* watchdogGet() {
+    static struct Watchdog* watchdog = [] {
+        struct Watchdog* created = new Watchdog();
+        wheelInit(&created->wheel, WATCHDOG_TICK_NS, monotonicNanos());
+        std::thread(watchdogLoop, created).detach();
+        return created;
+    }();
+    return watchdog;
+}
+
+// the wheel's callback, runs under the lock and only collects
+static void collect(struct WheelTimer* timer) {
+    watchdogGet()->due.push_back((struct WatchdogTimer*)timer);
+}
+
+static void watchdogLoop(struct Watchdog* watchdog) {
+    realtimeEnter();
+    std::unique_lock<std::mutex> lock(watchdog->mutex);
+    for (;;) {
+        watchdog->armed.wait(lock, [watchdog] { return watchdog->wheel.armed != 0; });
+
+        lock.unlock();
+        sleepUntil(monotonicNanos() + WATCHDOG_TICK_NS);
+        lock.lock();
+
+        // cancel and schedule take timers back out of the due list
+        wheelAdvance(&watchdog->wheel, monotonicNanos());
+        while (!watchdog->due.empty()) {
+            struct WatchdogTimer* timer = watchdog->due.back();
+            watchdog->due.pop_back();
+            lock.unlock();
+            timer->expired(timer);
+            lock.lock();
+        }
+    }
+}
+
+static void forgetDue(struct Watchdog* watchdog, struct WatchdogTimer* timer) {
+    watchdog->due.erase(std::remove(watchdog->due.begin(), watchdog->due.end(), timer),
+                        watchdog->due.end());
+}
+
+void watchdogTimerInit(struct WatchdogTimer* timer, WatchdogExpired expired) {
+    wheelTimerInit(&timer->wheel, collect);
+    timer->expired = expired;
+}
+
+void watchdogSchedule(struct WatchdogTimer* timer, uint64_t deadline) {
+    struct Watchdog*            watchdog = watchdogGet();
+    std::lock_guard<std::mutex> lock(watchdog->mutex);
+
+    // catch the wheel up after an idle spell, it only ticks while armed
+    if (watchdog->wheel.armed == 0) {
+        wheelAdvance(&watchdog->wheel, monotonicNanos());
+    }
+    forgetDue(watchdog, timer);
+    wheelSchedule(&watchdog->wheel, &timer->wheel, deadline);
+    if (watchdog->wheel.armed == 1) {
+        watchdog->armed.notify_one();
+    }
+}
+
+bool watchdogCancel(struct WatchdogTimer* timer) {
+    struct Watchdog*            watchdog = watchdogGet();
+    std::lock_guard<std::mutex> lock(watchdog->mutex);
+    auto                        end      = watchdog->due.end();
+    bool                        queued   = std::find(watchdog->due.begin(), end, timer) != end;
+    bool                        armed    = wheelArmed(&timer->wheel) || queued;
+    wheelCancel(&watchdog->wheel, &timer->wheel);
+    forgetDue(watchdog, timer);
+    return armed;
+}
+
+}  // namespace ptz
@@ -0,0 +1,29 @@
+#ifndef PTZ_WATCHDOG_H
+#define PTZ_WATCHDOG_H
+
+#include <stdint.h>
+#include "timer_wheel.h"
+
+namespace ptz {
+
+// deadlines for every camera in the process, kept in one timer wheel and
+// fired from one thread. expired runs on that thread without any lock held,
+// and not at all when the timer is re-armed or cancelled before it runs.
+struct WatchdogTimer;
+typedef void (*WatchdogExpired)(struct WatchdogTimer* timer);
+
+struct WatchdogTimer {
+    struct WheelTimer wheel;
+    WatchdogExpired   expired;
+};
+
+void watchdogTimerInit(struct WatchdogTimer* timer, WatchdogExpired expired);
+// arms, or pushes back, for a monotonicNanos() deadline
+void watchdogSchedule(struct WatchdogTimer* timer, uint64_t deadline);
+// true when the timer was armed and now never runs. false when it was not
+// armed, or has already been taken to run and may still be running.
+bool watchdogCancel(struct WatchdogTimer* timer);
+
+}  // namespace ptz
+
+#endif  // PTZ_WATCHDOG_H
@@ -0,0 +1,168 @@
+/*
+   Drives a simulated camera through the native command path, the one every
+   set and read of an open camera takes, with the heap counted, and fails if
+   anything was allocated once the camera and its session exist.
+
+   only simulated cameras are covered. a real camera is opened and closed
+   around every command, and uvc_open and the libusb transfer allocate there.
+
+   built as build/Release/alloc_test and run by test/ptz.js
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include "command.h"
+#include "control.h"
+#include "device.h"
+#include "session.h"
+#include "simulator.h"
+
+using namespace ptz;
+
+#define ALLOC_ROUNDS 1000
+
+static std::atomic<bool>     counting(false);
+static std::atomic<uint64_t> allocations(0);
+
+static void countAllocation() {
+    if (counting.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// every operator new funnels through these two
+void* operator new(size_t size) {
+    countAllocation();
+    void* p = malloc(size != 0 ? size : 1);
+    if (p == NULL) {
+        abort();
+    }
+    return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    countAllocation();
+    return malloc(size != 0 ? size : 1);
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+// c allocations too, libuvc and libusb make theirs with malloc
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+
+void* malloc(size_t size) {
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) {
+    countAllocation();
+    return __libc_realloc(p, size);
+}
+}
+#endif
+
+static void run(struct UVCDevice* uvcDevice, int op, int32_t a0, int32_t a1, int32_t a2 = 0) {
+    struct Command command;
+    command.op      = (uint8_t)op;
+    command.flags   = 0;
+    command.args[0] = a0;
+    command.args[1] = a1;
+    command.args[2] = a2;
+    command.args[3] = 1;
+
+    struct CommandResult commandResult;
+    sessionRun(sessionFind(uvcDevice), uvcDevice, &command, &commandResult);
+}
+
+// a round of what a joystick or automation sends an open camera
+static void drive(struct UVCDevice* uvcDevice, int i) {
+    run(uvcDevice, CMD_ABSOLUTE_ZOOM, 100 + i % 1000, 0);
+    run(uvcDevice, CMD_ABSOLUTE_PAN_TILT, (i % 100) * 3600, -(i % 30) * 3600);
+    run(uvcDevice, CMD_RELATIVE_PAN_TILT, 1, 1, -1);
+    run(uvcDevice, CMD_RELATIVE_PAN_TILT, 0, 1, 0);
+    run(uvcDevice, CMD_RELATIVE_ZOOM, i % 2 ? 1 : -1, 1);
+    run(uvcDevice, CMD_RELATIVE_ZOOM, 0, 1);
+    run(uvcDevice, controlOp(controlFind("focusAbsolute"), CONTROL_SET), i % 250, 0);
+    run(uvcDevice, controlOp(controlFind("rollAbsolute"), CONTROL_SET), i % 90, 0);
+    run(uvcDevice, controlOp(controlFind("zoomAbsolute"), CONTROL_GET), 0, 0);
+    run(uvcDevice, controlOp(controlFind("panTiltAbsolute"), CONTROL_GET), 0, 0);
+    run(uvcDevice, controlOp(controlFind("focusAbsolute"), CONTROL_GET), 0, 0);
+}
+
+static uint64_t measure(const char* name, struct UVCDevice* uvcDevice) {
+    // the first round makes the camera, its session and their tables
+    drive(uvcDevice, 0);
+
+    allocations.store(0);
+    counting.store(true);
+    for (int i = 1; i <= ALLOC_ROUNDS; i++) {
+        drive(uvcDevice, i);
+    }
+    counting.store(false);
+
+    uint64_t count = allocations.load();
+    printf("%-10s %d rounds, %llu allocations\n", name, ALLOC_ROUNDS, (unsigned long long)count);
+    return count;
+}
+
+int main(int argc, char** argv) {
+    struct SimConfig config;
+    simGetConfig(&config);
+    config.transfer_latency_us = 0;
+    config.transfer_jitter_us  = 0;
+    config.open_latency_us     = 0;
+    simSetConfig(&config);
+
+    // longer than any small string buffer, so keys can't hide in one
+    struct UVCDevice uvcDevice;
+    memset(&uvcDevice, 0, sizeof(uvcDevice));
+    uvcDevice.vendorId  = 0x5054;
+    uvcDevice.productId = 0x0100;
+    uvcDevice.simulated = 1;
+    snprintf(uvcDevice.serial, sizeof(uvcDevice.serial), "allocation-test-serial-number");
+    snprintf(uvcDevice.port, sizeof(uvcDevice.port), "1-2.3.4.5.6");
+
+    uint64_t total = measure("success", &uvcDevice);
+
+    // failures are reported from static tables too
+    config.error_rate = 0.5;
+    simSetConfig(&config);
+    total += measure("failure", &uvcDevice);
+
+    return total == 0 ? 0 : 1;
+}
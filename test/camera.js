@@ -1,5 +1,7 @@
 "use strict";
 
+const os = require("os");
+const path = require("path");
 const ptz = require("../lib/ptz");
 
 var _camera;
@@ -122,4 +124,29 @@ describe("camera", () => {
       return _camera.relativePanTilt(0, 1, 0, 1);
     }
   });
+
+  it("getPosition", () => {
+    if (_capabilities.absolutePanTilt) {
+      const panTilt = _camera.getAbsolutePanTilt();
+      const position = _camera.getPosition();
+      expect(position.pan).toBe(panTilt.currentPan);
+      expect(position.confidence).toBeGreaterThan(0);
+      expect(position).toHaveProperty("moving");
+    }
+  });
+
+  it("presets", () => {
+    if (_capabilities.absolutePanTilt) {
+      const file = path.join(os.tmpdir(), `ptz-presets-${process.pid}.bin`);
+      ptz.openPresets(file);
+      const preset = _camera.savePreset("test");
+      expect(preset).toHaveProperty("pan");
+      expect(preset).toHaveProperty("tilt");
+      expect(_camera.getPreset("test")).toEqual(preset);
+      expect(_camera.listPresets()).toContain("test");
+      _camera.recallPreset("test", { durationMs: 200 });
+      expect(_camera.deletePreset("test")).toBe(true);
+      ptz.closePresets();
+    }
+  });
 });
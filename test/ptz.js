@@ -1,5 +1,10 @@
 "use strict";
 
+const { execFileSync, spawn } = require("child_process");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const { Worker } = require("worker_threads");
 const ptz = require("../lib/ptz");
 
 describe("ptz", () => {
@@ -20,4 +25,379 @@ describe("ptz", () => {
     var camera = ptz.getCamera();
     expect(camera).not.toBeUndefined();
   });
+
+  it("listDevices reports where each camera is", () => {
+    ptz.listDevices().forEach((device) => {
+      expect(device).toHaveProperty("serialNumber");
+      expect(device).toHaveProperty("busNumber");
+      expect(device).toHaveProperty("port");
+    });
+  });
+
+  it("getCamera by serial number", () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const first = ptz.getCamera(Object.assign({ serialNumber: "A" }, identity));
+    const second = ptz.getCamera(Object.assign({ serialNumber: "B" }, identity));
+    first.absolutePanTilt(3600, 0);
+    expect(first.getStats().writes).toBe(1);
+    expect(second.getStats().writes).toBe(0);
+  });
+
+  it("workers share one camera session with the main thread", async () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const camera = ptz.getCamera(Object.assign({ serialNumber: "worker" }, identity));
+    const source = `
+      const { parentPort, workerData } = require("worker_threads");
+      const ptz = require(workerData.module);
+      const camera = ptz.getCamera(Object.assign({ async: true }, workerData.identity));
+      camera.absoluteZoom(workerData.zoom).then(() => parentPort.postMessage("moved"));
+    `;
+    const moves = [100, 200].map(
+      (zoom) =>
+        new Promise((resolve, reject) => {
+          const worker = new Worker(source, {
+            eval: true,
+            workerData: {
+              module: require.resolve("../lib/ptz"),
+              identity: camera.identity(),
+              zoom,
+            },
+          });
+          worker.on("message", resolve);
+          worker.on("error", reject);
+        })
+    );
+    expect(await Promise.all(moves)).toEqual(["moved", "moved"]);
+    expect(camera.getStats().writes).toBe(2);
+  });
+
+  it("cameras behind ptzd answer like local ones", async () => {
+    const socket = path.join(os.tmpdir(), `ptzd-${process.pid}.sock`);
+    const daemon = spawn(path.join(__dirname, "../build/Release/ptzd"), ["--socket", socket]);
+    while (!fs.existsSync(socket)) {
+      await new Promise((resolve) => setTimeout(resolve, 10));
+    }
+    const client = ptz.connect(socket);
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const camera = client.getCamera(Object.assign({ serialNumber: "daemon" }, identity));
+    expect((await camera.getCapabilities()).absolutePanTilt).toBe(true);
+    await camera.absoluteZoom(300);
+    const reads = await Promise.all([camera.getAbsoluteZoom(), camera.getAbsoluteZoom()]);
+    expect(reads[1].max).toBeGreaterThan(0);
+    const missing = client.getCamera({ vendorId: 1, productId: 1 });
+    await expect(missing.getAbsoluteZoom()).rejects.toThrow();
+    client.close();
+    daemon.kill();
+  });
+
+  it("command stream batches writes and reports failures", async () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const camera = ptz.getCamera(Object.assign({ serialNumber: "stream" }, identity));
+    const stream = camera.createWriteStream({ highWaterMark: 4 });
+    const failures = [];
+    stream.on("commandError", (err, command) => failures.push(command));
+    for (let zoom = 1; zoom <= 40; zoom++) {
+      stream.write({ command: zoom % 10 ? "absoluteZoom" : "noSuchCommand", zoom });
+    }
+    stream.end();
+    await new Promise((resolve) => stream.on("finish", resolve));
+    expect(failures.length).toBe(4);
+    expect(stream.getStats().commands).toBe(40);
+    expect(stream.getStats().batches).toBeLessThan(40);
+    expect(camera.getStats().writes).toBe(36);
+  });
+
+  it("calibrate saves a profile the camera keeps using", async () => {
+    const file = path.join(os.tmpdir(), `ptz-profiles-${process.pid}.bin`);
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const camera = ptz.getCamera(Object.assign({ serialNumber: "calibrate" }, identity));
+    ptz.openProfiles(file);
+    const profile = await camera.calibrate({ speeds: 2, moveMs: 300, sampleMs: 20 });
+    expect(profile.pan.speeds.length).toBe(2);
+    expect(profile.pan.perStep).toBeGreaterThan(0);
+    expect(camera.configure({}).speedModel.panSpeed).toBeCloseTo(profile.pan.perStep, 0);
+
+    ptz.closeProfiles();
+    expect(camera.getProfile()).toBeNull();
+    ptz.openProfiles(file);
+    expect(camera.getProfile().serialNumber).toBe("calibrate");
+    ptz.closeProfiles();
+    fs.unlinkSync(file);
+  });
+
+  it("identical cameras keep presets of their own", () => {
+    const file = path.join(os.tmpdir(), `ptz-presets-${process.pid}.bin`);
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const left = ptz.getCamera(Object.assign({ serialNumber: "preset-left" }, identity));
+    const right = ptz.getCamera(Object.assign({ serialNumber: "preset-right" }, identity));
+    ptz.openPresets({ path: file });
+    left.savePreset("door", { pan: 3600, tilt: 0, zoom: 100 });
+    right.savePreset("door", { pan: -3600, tilt: 0, zoom: 200 });
+    expect(left.listPresets()).toEqual(["door"]);
+    expect(right.listPresets()).toEqual(["door"]);
+
+    expect(left.getPreset("door").pan).toBe(3600);
+    expect(right.getPreset("door").pan).toBe(-3600);
+    right.deletePreset("door");
+    expect(left.getPreset("door").zoom).toBe(100);
+    ptz.closePresets();
+    fs.unlinkSync(file);
+  });
+
+  it("centerOn turns toward the point", () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const camera = ptz.getCamera(Object.assign({ serialNumber: "pointing" }, identity));
+    const start = camera.getAbsolutePanTilt();
+    const points = camera.pointsToPanTilt([0.5, 0.5, 0, 0, 1, 1]);
+    expect(points.length).toBe(6);
+    expect(points[0]).toBe(start.currentPan);
+    expect(points[2]).toBeLessThan(points[0]);
+    expect(points[4]).toBeGreaterThan(points[0]);
+    expect(camera.centerOn(0.75, 0.5).pan).toBeGreaterThan(start.currentPan);
+  });
+
+  it("warm start cache answers the first reads after a restart", () => {
+    const file = path.join(os.tmpdir(), `ptz-warm-${process.pid}.bin`);
+    const script = `
+      const ptz = require(${JSON.stringify(require.resolve("../lib/ptz"))});
+      ptz.openWarmCache(${JSON.stringify(file)});
+      const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+      const camera = ptz.getCamera(Object.assign({ serialNumber: "warm" }, identity));
+      const ranges = camera.getAbsolutePanTilt();
+      setTimeout(() => {
+        const stats = { ranges, hits: camera.getStats().warmHits, cache: ptz.getWarmCacheStats() };
+        console.log(JSON.stringify(stats));
+      }, 100);
+    `;
+    const run = () => JSON.parse(execFileSync(process.execPath, ["-e", script]).toString());
+    fs.rmSync(file, { force: true });
+    const cold = run();
+    const warm = run();
+    expect(cold.hits).toBe(0);
+    expect(warm.hits).toBe(1);
+    expect(warm.ranges).toEqual(cold.ranges);
+    expect(warm.cache.validated).toBe(1);
+    fs.rmSync(file, { force: true });
+  });
+
+  it("configureThreads applies what it can and reports the rest", () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const camera = ptz.getCamera(Object.assign({ serialNumber: "realtime" }, identity));
+    const channel = camera.openVelocity();
+    const status = ptz.configureThreads({ policy: "fifo", priority: 10, cpus: [0] });
+    expect(status.cpus).toEqual([0]);
+    expect(status.threads).toBeGreaterThan(0);
+    if (status.policyError === null) {
+      expect(status.policy).toBe("fifo");
+    } else {
+      expect(status.policy).toBe("other");
+    }
+    channel.close();
+    const reset = ptz.configureThreads({ policy: "other", cpus: [] });
+    expect(reset.policy).toBe("other");
+    expect(reset.cpus).toEqual([]);
+    expect(ptz.configureThreads().policy).toBe("other");
+  });
+
+  it("camera controls are driven by name", async () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const camera = ptz.getCamera(Object.assign({ serialNumber: "controls" }, identity));
+    camera.setControl("rollAbsolute", { roll: 20 });
+    await new Promise((resolve) => setTimeout(resolve, 1000));
+    expect(camera.getControl("rollAbsolute").roll).toBe(20);
+    expect(camera.getRanges("focusAbsolute").resolution.focus).toBe(5);
+    expect(camera.getRanges("autoExposureMode").min).toBeNull();
+    expect(() => camera.getControl("noSuchControl")).toThrow();
+  });
+
+  it("commands on a simulated camera never allocate", () => {
+    const output = execFileSync(path.join(__dirname, "../build/Release/alloc_test")).toString();
+    expect(output).toMatch(/success .* 0 allocations/);
+    expect(output).toMatch(/failure .* 0 allocations/);
+  });
+
+  it("ptzctl drives every camera with an unpinned script", () => {
+    const output = execFileSync(path.join(__dirname, "../build/Release/ptzctl"), [
+      "--sim", "4", "--command", "getAbsolutePanTilt", "--duration", "1",
+    ]).toString();
+    const rows = output.split("\n").filter((line) => /^\d+\s+[0-9a-f]{4}:[0-9a-f]{4}\s/.test(line));
+    expect(rows.length).toBe(4);
+    for (const row of rows) {
+      expect(Number(row.trim().split(/\s+/)[2])).toBeGreaterThan(0);
+    }
+  });
+
+  it("failed commands carry an error code", () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const camera = ptz.getCamera(Object.assign({ serialNumber: "codes" }, identity));
+    ptz.configureSimulator({ errorRate: 1 });
+    let error;
+    try {
+      camera.getAbsoluteZoom();
+    } catch (err) {
+      error = err;
+    }
+    ptz.configureSimulator({ errorRate: 0 });
+    expect(error.code).toBe("UVC_ERROR_IO");
+  });
+
+  it("a hung camera times out and fails fast without holding up others", async () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const hung = ptz.getCamera(Object.assign({ serialNumber: "hung", async: true }, identity));
+    const healthy = ptz.getCamera(Object.assign({ serialNumber: "healthy" }, identity));
+    hung.configure({ timeoutMs: 200 });
+    ptz.simulateHang(hung);
+
+    const started = Date.now();
+    const timedOut = hung.getAbsoluteZoom().catch((err) => err);
+    expect(healthy.getAbsoluteZoom().max).toBe(16384);
+    expect((await timedOut).code).toBe("UVC_ERROR_TIMEOUT");
+    expect(Date.now() - started).toBeLessThan(1000);
+
+    const fast = Date.now();
+    expect((await hung.getAbsoluteZoom().catch((err) => err)).code).toBe("UVC_ERROR_TIMEOUT");
+    expect(Date.now() - fast).toBeLessThan(50);
+
+    // a cancel aborts the transfer on the bus and drops the queue behind it.
+    // without a timeout the transfer would wait forever.
+    hung.configure({ timeoutMs: 0 });
+    await new Promise((resolve) => setTimeout(resolve, 250));
+    const aborted = hung.absoluteZoom(100).catch((err) => err);
+    const dropped = hung.absoluteZoom(200).catch((err) => err);
+    await new Promise((resolve) => setTimeout(resolve, 50));
+    expect(hung.cancel()).toBe(1);
+    expect((await aborted).code).toBe("UVC_ERROR_INTERRUPTED");
+    expect((await dropped).code).toBe("UVC_ERROR_INTERRUPTED");
+
+    ptz.simulateHang(hung, false);
+    expect((await hung.getAbsoluteZoom()).max).toBe(16384);
+    const stats = hung.getStats();
+    expect(stats.timeouts).toBe(1);
+    expect(stats.fastFailures).toBe(1);
+    expect(stats.cancelled).toBe(2);
+  });
+
+  it("a camera that drops off the bus is reopened and put back where it was", async () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const camera = ptz.getCamera(Object.assign({ serialNumber: "replug", async: true }, identity));
+    const direct = ptz.getCamera(Object.assign({ serialNumber: "replug" }, identity));
+    await camera.absolutePanTilt(3600, 7200);
+
+    ptz.simulateUnplug(camera);
+    const replayed = camera.absoluteZoom(500);
+    await new Promise((resolve) => setTimeout(resolve, 200));
+    let error;
+    try {
+      direct.getAbsoluteZoom();
+    } catch (err) {
+      error = err;
+    }
+    expect(error.code).toBe("UVC_ERROR_NO_DEVICE");
+
+    // it comes back at home, and is sent back before the lost zoom runs
+    ptz.simulateUnplug(camera, false);
+    await replayed;
+    await new Promise((resolve) => setTimeout(resolve, 400));
+    const panTilt = await camera.getAbsolutePanTilt();
+    expect(panTilt.currentPan).toBe(3600);
+    expect(panTilt.currentTilt).toBe(7200);
+    expect((await camera.getAbsoluteZoom()).current).toBe(500);
+
+    const stats = camera.getStats();
+    expect(stats.disconnects).toBe(1);
+    expect(stats.recoveries).toBe(1);
+    expect(stats.replayed).toBe(1);
+    expect(stats.recoveryAttempts).toBeGreaterThan(1);
+    expect(stats.lastRecoveryMs).toBeGreaterThanOrEqual(200);
+  });
+
+  it("a write lost with the camera leaves it back at the last pose it took", async () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const camera = ptz.getCamera(Object.assign({ serialNumber: "replug-sync" }, identity));
+    camera.absolutePanTilt(3600, 7200);
+
+    ptz.simulateUnplug(camera);
+    let error;
+    try {
+      camera.absolutePanTilt(9000, 0);
+    } catch (err) {
+      error = err;
+    }
+    expect(error.code).toBe("UVC_ERROR_NO_DEVICE");
+
+    ptz.simulateUnplug(camera, false);
+    while (camera.getStats().recoveries < 1) {
+      await new Promise((resolve) => setTimeout(resolve, 50));
+    }
+    const panTilt = camera.getAbsolutePanTilt();
+    expect(panTilt.currentPan).toBe(3600);
+    expect(panTilt.currentTilt).toBe(7200);
+  });
+
+  it("the watchdog stops a relative control that is not repeated", async () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const camera = ptz.getCamera(Object.assign({ serialNumber: "watchdog-roll" }, identity));
+    camera.configure({ watchdogMs: 100 });
+    camera.setControl("rollRelative", { direction: 1, speed: 1 });
+    await new Promise((resolve) => setTimeout(resolve, 300));
+    expect(camera.getStats().watchdogStops).toBe(1);
+    expect(camera.getControl("rollRelative").direction).toBe(0);
+  });
+
+  it("a group goes without a camera that is not ready in time", async () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const stuck = ptz.getCamera(
+      Object.assign({ serialNumber: "group-stuck", async: true }, identity)
+    );
+    const ready = ptz.getCamera(Object.assign({ serialNumber: "group-ready" }, identity));
+    stuck.configure({ timeoutMs: 0 });
+    ptz.simulateHang(stuck);
+    const blocking = stuck.getAbsoluteZoom().catch((err) => err);
+
+    const started = Date.now();
+    const result = await ptz.runGroup(
+      [
+        { camera: stuck, command: "absolutePanTilt", pan: 3600, tilt: 0 },
+        { camera: ready, command: "absolutePanTilt", pan: 3600, tilt: 0 },
+      ],
+      { timeoutMs: 200 }
+    );
+    expect(Date.now() - started).toBeLessThan(1000);
+    expect(result.cameras[0].error).toBe("Group started without this camera");
+    expect(result.cameras[1].error).toBeUndefined();
+
+    ptz.simulateHang(stuck, false);
+    await blocking;
+  });
+
+  it("tracker centers the subject", async () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const camera = ptz.getCamera(Object.assign({ serialNumber: "tracker" }, identity));
+    const tracker = camera.openTracker({ intervalMs: 10 });
+    for (let frame = 0; frame < 30; frame++) {
+      tracker.push(0.8, 0.5, 0.2);
+      await new Promise((resolve) => setTimeout(resolve, 20));
+    }
+    const stats = tracker.getStats();
+    expect(stats.tracking).toBe(true);
+    expect(stats.panError).toBeCloseTo(0.3, 1);
+    expect(stats.panTiltCommands).toBeGreaterThan(0);
+    tracker.push();
+    tracker.close();
+    expect(camera.getRelativePanTilt().panDirection).toBe(0);
+  });
+
+  it("a closed tracker's id never reaches the next one", () => {
+    const identity = { vendorId: 0x5054, productId: 0x0100, simulated: true };
+    const camera = ptz.getCamera(Object.assign({ serialNumber: "stale-id" }, identity));
+    const closed = camera.openTracker();
+    closed.close();
+    const tracker = camera.openTracker();
+    expect(tracker.id).not.toBe(closed.id);
+    expect(() => closed.getStats()).toThrow("tracker is closed");
+    expect(tracker.getStats().samples).toBe(0);
+    closed.close();
+    expect(tracker.getStats().samples).toBe(0);
+    tracker.close();
+  });
 });
@@ -0,0 +1,464 @@
+"use strict";
+
+// Soak test: drives many cameras through the Camera API with a mixed
+// workload for a long time and fails on leaks or drift.
+//
+//   node test/soak.js --sim 40 --duration 4h
+//   node test/soak.js --device 0x54c:0xb7f --device 0x46d:0x848 --rate 5
+//
+// Every interval it samples throughput, latency percentiles, RSS, open file
+// descriptors, active libuv handles, native device handles and event-loop
+// lag. After the warmup it checks those series for growth (leaks) and for
+// throughput or latency drifting between the start and the end of the run.
+
+const fs = require("fs");
+const { monitorEventLoopDelay } = require("perf_hooks");
+const ptz = require("../lib/ptz");
+
+const SIM_VENDOR_ID = 0x5054;
+
+const usage = `usage: node test/soak.js [options]
+
+cameras
+  --sim N                  drive N simulated cameras
+  --device VID:PID         drive a real camera (repeatable)
+
+workload
+  --rate N                 commands per second per camera (default 20)
+  --duration T             run time, e.g. 90s, 30m, 4h (default 60s)
+  --interval T             sampling interval (default 10s)
+  --warmup T               ignore samples before this (default 10% of duration)
+  --sim-latency US         simulated transfer latency (default 1000)
+  --sim-errors RATE        simulated transfer failure rate (default 0)
+
+limits
+  --max-rss-growth MB      RSS growth per hour after warmup (default 32)
+  --rss-noise MB           RSS growth always tolerated, for short runs (default 8)
+  --max-fd-growth N        file descriptor growth after warmup (default 4)
+  --max-handle-growth N    libuv handle growth after warmup (default 4)
+  --max-drift FRACTION     throughput drop or p99 rise start to end (default 0.25)
+  --max-lag MS             event-loop lag p99 in any interval (default 200)
+  --max-error-rate RATE    failed commands over all commands (default 0.001)
+
+output
+  --json FILE              write samples and verdict as json
+`;
+
+function parseTime(value) {
+  const match = /^([0-9.]+)(ms|s|m|h)?$/.exec(value);
+  if (!match) {
+    throw new Error(`bad time: ${value}`);
+  }
+  const scale = { ms: 1, s: 1000, m: 60000, h: 3600000 }[match[2] || "s"];
+  return parseFloat(match[1]) * scale;
+}
+
+function parseArgs(argv) {
+  const options = {
+    sim: 0,
+    devices: [],
+    rate: 20,
+    duration: 60000,
+    interval: 10000,
+    warmup: -1,
+    simLatency: 1000,
+    simErrors: 0,
+    maxRssGrowth: 32,
+    rssNoise: 8,
+    maxFdGrowth: 4,
+    maxHandleGrowth: 4,
+    maxDrift: 0.25,
+    maxLag: 200,
+    maxErrorRate: 0.001,
+    json: null,
+  };
+  for (let i = 2; i < argv.length; i++) {
+    const arg = argv[i];
+    const value = argv[i + 1];
+    switch (arg) {
+      case "--sim":
+        options.sim = parseInt(value, 10);
+        break;
+      case "--device": {
+        const [vendorId, productId] = value.split(":").map((id) => parseInt(id, 16));
+        options.devices.push({ vendorId, productId });
+        break;
+      }
+      case "--rate":
+        options.rate = parseFloat(value);
+        break;
+      case "--duration":
+        options.duration = parseTime(value);
+        break;
+      case "--interval":
+        options.interval = parseTime(value);
+        break;
+      case "--warmup":
+        options.warmup = parseTime(value);
+        break;
+      case "--sim-latency":
+        options.simLatency = parseInt(value, 10);
+        break;
+      case "--sim-errors":
+        options.simErrors = parseFloat(value);
+        break;
+      case "--max-rss-growth":
+        options.maxRssGrowth = parseFloat(value);
+        break;
+      case "--rss-noise":
+        options.rssNoise = parseFloat(value);
+        break;
+      case "--max-fd-growth":
+        options.maxFdGrowth = parseInt(value, 10);
+        break;
+      case "--max-handle-growth":
+        options.maxHandleGrowth = parseInt(value, 10);
+        break;
+      case "--max-drift":
+        options.maxDrift = parseFloat(value);
+        break;
+      case "--max-lag":
+        options.maxLag = parseFloat(value);
+        break;
+      case "--max-error-rate":
+        options.maxErrorRate = parseFloat(value);
+        break;
+      case "--json":
+        options.json = value;
+        break;
+      default:
+        process.stdout.write(usage);
+        process.exit(arg === "--help" || arg === "-h" ? 0 : 2);
+    }
+    i++;
+  }
+  if (options.warmup < 0) {
+    options.warmup = options.duration / 10;
+  }
+  return options;
+}
+
+// command mix, weighted roughly like an operator console: mostly position
+// polling, then absolute moves, with some relative jogging in between
+const workload = [
+  { weight: 30, capability: "absolutePanTilt", run: (c) => c.camera.getAbsolutePanTilt() },
+  { weight: 15, capability: "absoluteZoom", run: (c) => c.camera.getAbsoluteZoom() },
+  {
+    weight: 20,
+    capability: "absolutePanTilt",
+    run: (c) => c.camera.absolutePanTilt(pick(c.pans), pick(c.tilts)),
+  },
+  { weight: 10, capability: "absoluteZoom", run: (c) => c.camera.absoluteZoom(pick(c.zooms)) },
+  {
+    weight: 10,
+    capability: "relativePanTilt",
+    run: (c) => {
+      c.jogging = !c.jogging;
+      return c.jogging
+        ? c.camera.relativePanTilt(pick([-1, 1]), 1, pick([-1, 0, 1]), 1)
+        : c.camera.relativePanTilt(0, 1, 0, 1);
+    },
+  },
+  {
+    weight: 5,
+    capability: "relativeZoom",
+    run: (c) => {
+      c.zooming = !c.zooming;
+      return c.zooming ? c.camera.relativeZoomIn(1) : c.camera.relativeZoomStop(1);
+    },
+  },
+  { weight: 5, capability: null, run: (c) => c.camera.getCapabilities() },
+  { weight: 5, capability: "relativePanTilt", run: (c) => c.camera.getRelativePanTilt() },
+];
+
+function pick(values) {
+  return values[Math.floor(Math.random() * values.length)];
+}
+
+// evenly spaced setpoints inside the range the camera reports
+function setpoints(min, max, resolution, count) {
+  const values = [];
+  const step = Math.max(resolution, Math.floor((max - min) / count / resolution) * resolution);
+  for (let value = min; value <= max && values.length < count; value += step) {
+    values.push(value);
+  }
+  return values;
+}
+
+async function prepareCamera(options) {
+  const camera = ptz.getCamera(options);
+  const capabilities = await camera.getCapabilities();
+  const state = {
+    name: `${options.vendorId.toString(16)}:${options.productId.toString(16)}`,
+    camera,
+    mix: workload.filter((w) => w.capability === null || capabilities[w.capability]),
+    pans: [0],
+    tilts: [0],
+    zooms: [0],
+    jogging: false,
+    zooming: false,
+  };
+  if (capabilities.absolutePanTilt) {
+    const panTilt = await camera.getAbsolutePanTilt();
+    state.pans = setpoints(panTilt.minPan, panTilt.maxPan, panTilt.resolutionPan || 1, 16);
+    state.tilts = setpoints(panTilt.minTilt, panTilt.maxTilt, panTilt.resolutionTilt || 1, 8);
+  }
+  if (capabilities.absoluteZoom) {
+    const zoom = await camera.getAbsoluteZoom();
+    state.zooms = setpoints(zoom.min, zoom.max, zoom.resolution || 1, 8);
+  }
+  state.totalWeight = state.mix.reduce((sum, w) => sum + w.weight, 0);
+  return state;
+}
+
+function chooseCommand(state) {
+  let roll = Math.random() * state.totalWeight;
+  for (const w of state.mix) {
+    roll -= w.weight;
+    if (roll < 0) {
+      return w;
+    }
+  }
+  return state.mix[state.mix.length - 1];
+}
+
+function percentile(sorted, p) {
+  if (sorted.length === 0) {
+    return 0;
+  }
+  return sorted[Math.min(sorted.length - 1, Math.floor((sorted.length * p) / 100))];
+}
+
+function median(values) {
+  return percentile(values.slice().sort((a, b) => a - b), 50);
+}
+
+function countFds() {
+  try {
+    return fs.readdirSync("/proc/self/fd").length;
+  } catch (err) {
+    return -1; // not linux
+  }
+}
+
+function countHandles() {
+  return typeof process._getActiveHandles === "function" ? process._getActiveHandles().length : -1;
+}
+
+// least squares slope of y over x
+function slope(xs, ys) {
+  const n = xs.length;
+  const mx = xs.reduce((a, b) => a + b, 0) / n;
+  const my = ys.reduce((a, b) => a + b, 0) / n;
+  let num = 0;
+  let den = 0;
+  for (let i = 0; i < n; i++) {
+    num += (xs[i] - mx) * (ys[i] - my);
+    den += (xs[i] - mx) * (xs[i] - mx);
+  }
+  return den === 0 ? 0 : num / den;
+}
+
+function check(options, samples, totals, deviceStats) {
+  const failures = [];
+  const steady = samples.filter((s) => s.elapsed > options.warmup);
+  const errorRate = totals.commands ? totals.errors / totals.commands : 0;
+
+  if (errorRate > options.maxErrorRate) {
+    failures.push(`error rate ${errorRate.toFixed(5)} > ${options.maxErrorRate}`);
+  }
+  if (deviceStats.open !== 0) {
+    failures.push(`${deviceStats.open} native device handles still open after drain`);
+  }
+  if (steady.length < 3) {
+    failures.push(`only ${steady.length} samples after warmup, run longer`);
+    return failures;
+  }
+
+  // leaks
+  const first = steady[0];
+  const last = steady[steady.length - 1];
+  const hours = steady.map((s) => s.elapsed / 3600000);
+  const rssGrowth = slope(hours, steady.map((s) => s.rss / 1048576));
+  const rssDelta = (last.rss - first.rss) / 1048576;
+  if (rssGrowth > options.maxRssGrowth && rssDelta > options.rssNoise) {
+    failures.push(`rss grows ${rssGrowth.toFixed(1)} MB/h > ${options.maxRssGrowth}`);
+  }
+  if (first.fds >= 0 && last.fds - first.fds > options.maxFdGrowth) {
+    failures.push(`file descriptors grew ${first.fds} -> ${last.fds}`);
+  }
+  if (first.handles >= 0 && last.handles - first.handles > options.maxHandleGrowth) {
+    failures.push(`libuv handles grew ${first.handles} -> ${last.handles}`);
+  }
+
+  // drift, comparing the first and last third of the steady state
+  const third = Math.max(1, Math.floor(steady.length / 3));
+  const head = steady.slice(0, third);
+  const tail = steady.slice(-third);
+  const headRate = median(head.map((s) => s.rate));
+  const tailRate = median(tail.map((s) => s.rate));
+  if (tailRate < headRate * (1 - options.maxDrift)) {
+    failures.push(`throughput drifted ${headRate.toFixed(1)} -> ${tailRate.toFixed(1)} cmd/s`);
+  }
+  const headP99 = median(head.map((s) => s.p99));
+  const tailP99 = median(tail.map((s) => s.p99));
+  if (tailP99 > headP99 * (1 + options.maxDrift) && tailP99 - headP99 > 1) {
+    failures.push(`p99 latency drifted ${headP99.toFixed(2)} -> ${tailP99.toFixed(2)} ms`);
+  }
+  const worstLag = Math.max(...steady.map((s) => s.lagP99));
+  if (worstLag > options.maxLag) {
+    failures.push(`event-loop lag p99 reached ${worstLag.toFixed(1)} ms > ${options.maxLag}`);
+  }
+  return failures;
+}
+
+async function main() {
+  const options = parseArgs(process.argv);
+  const targets = options.devices.slice();
+  for (let i = 0; i < options.sim; i++) {
+    targets.push({ vendorId: SIM_VENDOR_ID, productId: i + 1, simulated: true });
+  }
+  if (targets.length === 0) {
+    process.stdout.write(usage);
+    process.exit(2);
+  }
+  ptz.configureSimulator({
+    transferLatencyUs: options.simLatency,
+    errorRate: options.simErrors,
+  });
+
+  const cameras = [];
+  for (const target of targets) {
+    cameras.push(await prepareCamera(target));
+  }
+
+  const lag = monitorEventLoopDelay({ resolution: 10 });
+  lag.enable();
+
+  const totals = { commands: 0, errors: 0, errorsByMessage: {} };
+  const samples = [];
+  let window = { commands: 0, errors: 0, latencies: [] };
+  let inFlight = 0;
+  let running = true;
+
+  const start = Date.now();
+  const period = 1000 / options.rate;
+
+  // one independent loop per camera, paced to the requested rate
+  const loops = cameras.map(async (state, index) => {
+    let next = Date.now() + (period * index) / cameras.length;
+    while (running) {
+      const wait = next - Date.now();
+      if (wait > 0) {
+        await new Promise((resolve) => setTimeout(resolve, wait));
+      }
+      next += period;
+      if (!running) {
+        break;
+      }
+
+      const command = chooseCommand(state);
+      const begin = process.hrtime.bigint();
+      inFlight++;
+      try {
+        await command.run(state);
+      } catch (err) {
+        window.errors++;
+        totals.errors++;
+        totals.errorsByMessage[err.message] = (totals.errorsByMessage[err.message] || 0) + 1;
+      }
+      inFlight--;
+      window.latencies.push(Number(process.hrtime.bigint() - begin) / 1e6);
+      window.commands++;
+      totals.commands++;
+
+      // sync calls block the loop; yield so timers and sampling still run
+      if (Date.now() > next) {
+        await new Promise((resolve) => setImmediate(resolve));
+      }
+    }
+  });
+
+  console.log(
+    "elapsed      cmd/s  errors   p50 ms   p99 ms  p999 ms   rss MB  fds  handles  devs  lag p99"
+  );
+
+  const sample = () => {
+    const now = Date.now();
+    const latencies = window.latencies.sort((a, b) => a - b);
+    const seconds = options.interval / 1000;
+    const device = ptz.getDeviceStats();
+    const s = {
+      elapsed: now - start,
+      commands: window.commands,
+      errors: window.errors,
+      rate: window.commands / seconds,
+      p50: percentile(latencies, 50),
+      p99: percentile(latencies, 99),
+      p999: percentile(latencies, 99.9),
+      max: latencies.length ? latencies[latencies.length - 1] : 0,
+      rss: process.memoryUsage().rss,
+      heapUsed: process.memoryUsage().heapUsed,
+      fds: countFds(),
+      handles: countHandles(),
+      deviceHandles: device.open,
+      inFlight,
+      lagP99: lag.percentile(99) / 1e6,
+      lagMax: lag.max / 1e6,
+    };
+    samples.push(s);
+    lag.reset();
+    window = { commands: 0, errors: 0, latencies: [] };
+    console.log(
+      [
+        `${(s.elapsed / 1000).toFixed(0)}s`.padStart(7),
+        s.rate.toFixed(1).padStart(10),
+        String(s.errors).padStart(7),
+        s.p50.toFixed(3).padStart(8),
+        s.p99.toFixed(3).padStart(8),
+        s.p999.toFixed(3).padStart(8),
+        (s.rss / 1048576).toFixed(1).padStart(8),
+        String(s.fds).padStart(4),
+        String(s.handles).padStart(8),
+        String(s.deviceHandles).padStart(5),
+        s.lagP99.toFixed(1).padStart(8),
+      ].join(" ")
+    );
+  };
+  const sampler = setInterval(sample, options.interval);
+
+  await new Promise((resolve) => setTimeout(resolve, options.duration));
+  running = false;
+  clearInterval(sampler);
+  await Promise.all(loops);
+  lag.disable();
+
+  const deviceStats = ptz.getDeviceStats();
+  const failures = check(options, samples, totals, deviceStats);
+
+  console.log("");
+  console.log(`cameras      ${cameras.length}`);
+  console.log(`commands     ${totals.commands}`);
+  console.log(`errors       ${totals.errors}`);
+  for (const message of Object.keys(totals.errorsByMessage)) {
+    console.log(`  ${String(totals.errorsByMessage[message]).padStart(10)}  ${message}`);
+  }
+  console.log(`device opens ${deviceStats.opens} closes ${deviceStats.closes}`);
+  console.log(failures.length ? "FAIL" : "PASS");
+  for (const failure of failures) {
+    console.log(`  ${failure}`);
+  }
+
+  if (options.json) {
+    fs.writeFileSync(
+      options.json,
+      JSON.stringify({ options, totals, deviceStats, samples, failures }, null, 2)
+    );
+  }
+  process.exit(failures.length ? 1 : 0);
+}
+
+main().catch((err) => {
+  console.error(err);
+  process.exit(2);
+});